@@ -5,8 +5,30 @@
 #ifndef ESPNIX_HASH_H
 #define ESPNIX_HASH_H
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
 
+// SHA-256, fed incrementally with Update and read out once with Final
 class Hash {
+public:
+    static const size_t DIGEST_SIZE = 32;
+
+    Hash();
+
+    void Update(const uint8_t *data, size_t size);
+    void Final(uint8_t digest[DIGEST_SIZE]);
+
+    // Digest of a whole buffer, as DIGEST_SIZE raw bytes
+    static std::string Sha256(const uint8_t *data, size_t size);
+
+private:
+    uint32_t state[8];
+    uint8_t block[64];
+    size_t blockSize;
+    uint64_t totalSize;
+
+    void Transform(const uint8_t *chunk);
 };
 
 
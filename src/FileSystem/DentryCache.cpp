@@ -0,0 +1,171 @@
+#include "DentryCache.h"
+#include "Folder.h"
+
+#include <cstring>
+
+namespace espnix
+{
+    static bool IsAbsolute(const std::string &path)
+    {
+        return !path.empty() && path[0] == '/';
+    }
+
+    static bool HasDotDot(const std::string &path)
+    {
+        for (size_t pos = path.find(".."); pos != std::string::npos; pos = path.find("..", pos + 1))
+        {
+            if ((pos == 0 || path[pos - 1] == '/') && (pos + 2 == path.size() || path[pos + 2] == '/'))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static uint32_t HashBytes(uint32_t hash, const char *data, size_t length)
+    {
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= static_cast<uint8_t>(data[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    DentryCache::DentryCache() : clock(0)
+    {
+        for (Entry &entry : this->entries)
+        {
+            entry.lastUse = 0;
+        }
+    }
+
+    uint32_t DentryCache::Tick()
+    {
+        if (this->clock == UINT32_MAX)
+        {
+            for (Entry &entry : this->entries)
+            {
+                entry.lastUse = 0;
+            }
+            this->clock = 0;
+        }
+        return ++this->clock;
+    }
+
+    bool DentryCache::Key(const std::string &base, const std::string &path, uint32_t &hash, size_t &length)
+    {
+        hash = 2166136261u;
+        if (IsAbsolute(path))
+        {
+            length = path.size();
+        }
+        else
+        {
+            length = base.size() + 1 + path.size();
+            hash = HashBytes(hash, base.data(), base.size());
+            hash = HashBytes(hash, "/", 1);
+        }
+        hash = HashBytes(hash, path.data(), path.size());
+        return length <= MAX_PATH && !HasDotDot(path) && (IsAbsolute(path) || !HasDotDot(base));
+    }
+
+    bool DentryCache::Matches(const Entry &entry, const std::string &base, const std::string &path)
+    {
+        if (IsAbsolute(path))
+        {
+            return memcmp(entry.path, path.data(), path.size()) == 0;
+        }
+        return memcmp(entry.path, base.data(), base.size()) == 0 &&
+               entry.path[base.size()] == '/' &&
+               memcmp(entry.path + base.size() + 1, path.data(), path.size()) == 0;
+    }
+
+    bool DentryCache::Lookup(const std::string &base, const std::string &path, EntityType type, FileSystemEntity *&entity)
+    {
+        uint32_t hash;
+        size_t length;
+        if (!Key(base, path, hash, length))
+        {
+            return false;
+        }
+
+        for (Entry &entry : this->entries)
+        {
+            if (entry.lastUse != 0 && entry.hash == hash && entry.length == length &&
+                entry.type == type && Matches(entry, base, path))
+            {
+                entry.lastUse = this->Tick();
+                entity = entry.entity;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void DentryCache::Insert(const std::string &base, const std::string &path, EntityType type, FileSystemEntity *entity)
+    {
+        uint32_t hash;
+        size_t length;
+        if (!Key(base, path, hash, length))
+        {
+            return;
+        }
+
+        uint32_t now = this->Tick();
+        Entry *victim = &this->entries[0];
+        for (Entry &entry : this->entries)
+        {
+            if (entry.lastUse < victim->lastUse)
+            {
+                victim = &entry;
+            }
+        }
+
+        victim->hash = hash;
+        victim->lastUse = now;
+        victim->entity = entity;
+        victim->type = type;
+        victim->length = static_cast<uint8_t>(length);
+        if (IsAbsolute(path))
+        {
+            memcpy(victim->path, path.data(), path.size());
+        }
+        else
+        {
+            memcpy(victim->path, base.data(), base.size());
+            victim->path[base.size()] = '/';
+            memcpy(victim->path + base.size() + 1, path.data(), path.size());
+        }
+    }
+
+    void DentryCache::Created()
+    {
+        for (Entry &entry : this->entries)
+        {
+            if (entry.entity == nullptr)
+            {
+                entry.lastUse = 0;
+            }
+        }
+    }
+
+    void DentryCache::Removed(const FileSystemEntity *entity)
+    {
+        for (Entry &entry : this->entries)
+        {
+            if (entry.lastUse == 0)
+            {
+                continue;
+            }
+            for (const FileSystemEntity *e = entry.entity; e != nullptr; e = e->parent)
+            {
+                if (e == entity)
+                {
+                    entry.lastUse = 0;
+                    break;
+                }
+            }
+        }
+    }
+}
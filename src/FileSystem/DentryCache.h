@@ -0,0 +1,68 @@
+#ifndef DENTRY_CACHE_H
+#define DENTRY_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+#include "FileSystemEntity.h"
+
+namespace espnix
+{
+    // Recently resolved paths and what they led to, so repeated lookups of
+    // the same path skip the walk. A miss is cached too, as a null entity.
+    // The table is a fixed array searched by hash and recycled least
+    // recently used first, so neither lookups nor inserts allocate; paths
+    // longer than MAX_PATH are not cached.
+    //
+    // A path is keyed as written, after the base it is relative to: the
+    // cache does not normalize, it only remembers. Folders report every
+    // child they gain or lose, which is what keeps the entries right:
+    // a new child can only turn a cached miss into a hit, and a removed
+    // one can only break hits on it or below it. A path that climbs out
+    // with ".." can pass through a folder that is not above what it leads
+    // to, so removing that folder would go unnoticed; such paths are not
+    // cached.
+    class DentryCache
+    {
+    public:
+        static const size_t ENTRIES = 32;
+        static const size_t MAX_PATH = 63;
+
+    private:
+        struct Entry
+        {
+            uint32_t hash;
+            uint32_t lastUse;       // 0 if the entry is free
+            FileSystemEntity *entity;
+            EntityType type;
+            uint8_t length;
+            char path[MAX_PATH];
+        };
+
+        Entry entries[ENTRIES];
+        uint32_t clock;
+
+        // Hash of base + "/" + path, or of path alone if it is absolute;
+        // false if that is too long to cache or goes through ".."
+        static bool Key(const std::string &base, const std::string &path, uint32_t &hash, size_t &length);
+        static bool Matches(const Entry &entry, const std::string &base, const std::string &path);
+        // Next use stamp; restarts the cache rather than let stamps wrap
+        uint32_t Tick();
+
+    public:
+        DentryCache();
+
+        // True if the path is cached, with entity set to what it resolved
+        // to, nullptr included
+        bool Lookup(const std::string &base, const std::string &path, EntityType type, FileSystemEntity *&entity);
+        void Insert(const std::string &base, const std::string &path, EntityType type, FileSystemEntity *entity);
+
+        // A folder gained a child, which cached misses may now find
+        void Created();
+        // The entity, and everything under it if it is a folder, is about
+        // to be removed
+        void Removed(const FileSystemEntity *entity);
+    };
+}
+
+#endif
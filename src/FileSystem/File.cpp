@@ -5,6 +5,7 @@
 #include <SD.h>
 
 #include "File.h"
+#include "IO/PageCache.h"
 #include "Folder.h"
 #include "FileSystem.h"
 
@@ -14,6 +15,7 @@ namespace espnix
     {
         this->permissions = 0644;
         this->fd = nullptr;
+        this->size = 0;
     }
 
     std::string File::Read()
@@ -28,26 +30,13 @@ namespace espnix
             }
         }
 
-        // If FileDescriptor has buffer content, return it
-        if (!this->fd->buffer.empty())
-        {
-            return this->fd->buffer;
-        }
-
-        // Read from SD card via FileDescriptor
-        if (this->fd->sdFile && this->fd->sdFile.available())
-        {
-            std::string content;
-            this->fd->sdFile.seek(0);  // Reset to beginning
-            while (this->fd->sdFile.available())
-            {
-                content += (char)this->fd->sdFile.read();
-            }
-            this->fd->buffer = content;  // Cache in buffer
-            return content;
-        }
-
-        return "";
+        // Read from SD card through the page cache, with changes not
+        // written back yet laid over it; the descriptor's position is
+        // left where it was
+        std::string content(this->fd->size(), '\0');
+        ssize_t bytesRead = this->fd->pread(&content[0], content.size(), 0);
+        content.resize(bytesRead > 0 ? bytesRead : 0);
+        return content;
     }
 
     void File::Append(std::string data)
@@ -133,7 +122,7 @@ namespace espnix
     {
         if (this->fd)
         {
-            this->fd->flush();
+            this->fd->fsync();
         }
     }
 
@@ -146,45 +135,17 @@ namespace espnix
     {
         if (this->fd)
         {
-            return this->fd->bufferSize();
-        }
-
-        // If no FileDescriptor, try to read file size from SD card
-        if (this->parent)
-        {
-            std::string fullPath = "";
-            Folder* currentFolder = this->parent;
-            std::vector<std::string> pathComponents;
-
-            while (currentFolder && currentFolder->parent)
-            {
-                pathComponents.push_back(currentFolder->name);
-                currentFolder = currentFolder->parent;
-            }
-
-            for (int i = pathComponents.size() - 1; i >= 0; i--)
-            {
-                fullPath += "/" + pathComponents[i];
-            }
-            fullPath += "/" + this->name;
-
-            if (SD.exists(fullPath.c_str()))
-            {
-                fs::File sdFile = SD.open(fullPath.c_str(), FILE_READ);
-                if (sdFile)
-                {
-                    size_t fileSize = sdFile.size();
-                    sdFile.close();
-                    return fileSize;
-                }
-            }
+            return this->fd->size();
         }
 
-        return 0;
+        // Known from the directory scan or the metadata index, so listing
+        // a folder does not open every file in it
+        return this->size;
     }
 
     File::~File()
     {
+        PageCache::instance().drop(this);
         if (this->fd)
         {
             Close();
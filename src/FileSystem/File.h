@@ -15,6 +15,7 @@ namespace espnix
     {
     public:
         FileDescriptor *fd;
+        size_t size;    // Bytes on the SD card when last written or read in
 
         File();
         std::string Read();
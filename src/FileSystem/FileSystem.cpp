@@ -1,5 +1,4 @@
 #include <Arduino.h>
-#include <sstream>
 #include <ctime>
 
 #include <FileSystem/Folder.h>
@@ -128,9 +127,26 @@ bool FileSystem::MountSDCard()
     return true;
 }
 
-void FileSystem::LoadDirectoryFromSD(const char *path, espnix::Folder *parent)
+// Where the folder lives on the SD card
+static std::string SDPath(const espnix::Folder *folder)
 {
-    File dir = SD.open(path);
+    std::string path;
+    for (; folder != nullptr && folder->parent != nullptr; folder = folder->parent)
+    {
+        path = "/" + folder->name + path;
+    }
+    return path.empty() ? "/" : path;
+}
+
+void FileSystem::LoadDirectoryFromSD(espnix::Folder *parent)
+{
+    std::string path = SDPath(parent);
+    if (!this->sdMounted || this->metadata.LoadFolder(parent, path))
+    {
+        return;
+    }
+
+    File dir = SD.open(path.c_str());
     if (!dir || !dir.isDirectory())
     {
         return;
@@ -148,20 +164,9 @@ void FileSystem::LoadDirectoryFromSD(const char *path, espnix::Folder *parent)
 
         if (entry.isDirectory())
         {
-            bool exists = false;
-            espnix::Folder *existingFolder = nullptr;
-
-            for (auto *folder : parent->folders)
-            {
-                if (folder->name == entryName)
-                {
-                    exists = true;
-                    existingFolder = folder;
-                    break;
-                }
-            }
+            espnix::Folder *existingFolder = parent->FindFolder(entryName);
 
-            if (!exists)
+            if (existingFolder == nullptr)
             {
                 espnix::Folder *folder = new espnix::Folder();
                 folder->name = entryName;
@@ -171,26 +176,17 @@ void FileSystem::LoadDirectoryFromSD(const char *path, espnix::Folder *parent)
                 existingFolder = folder;
             }
 
-            std::string subPath = std::string(path) + "/" + entryName;
-            LoadDirectoryFromSD(subPath.c_str(), existingFolder);
+            // Its own entries wait until something looks inside it
+            existingFolder->loaded = false;
         }
         else
         {
-            bool exists = false;
-            for (auto *file : parent->files)
-            {
-                if (file->name == entryName)
-                {
-                    exists = true;
-                    break;
-                }
-            }
-
-            if (!exists)
+            if (parent->FindFile(entryName) == nullptr)
             {
                 espnix::File *file = new espnix::File();
                 file->name = entryName;
                 file->permissions = 0644;
+                file->size = entry.size();
 
                 // Don't store content directly in file anymore
                 // FileDescriptor will handle this when the file is opened
@@ -209,11 +205,56 @@ void FileSystem::LoadFromSD()
         return;
     }
 
+    // Only the root is marked here; each folder reads its directory on the
+    // card the first time it is looked up or listed, so boot does not
+    // depend on how much the card holds
     BootMessages::PrintInfo("Loading filesystem from SD card");
-    LoadDirectoryFromSD("/", this->root);
+    if (this->metadata.Mount(this->root))
+    {
+        BootMessages::PrintOK("Metadata index found: " + std::string(espnix::MetadataIndex::PATH));
+    }
+    else
+    {
+        BootMessages::PrintInfo("No usable metadata index, directories will be scanned");
+    }
+    this->root->loaded = false;
     BootMessages::PrintOK("Filesystem mounted at / on SD card");
 }
 
+// Deletes a directory on the SD card and everything in it
+static void RemoveDirectoryFromSD(const std::string &path)
+{
+    File dir = SD.open(path.c_str());
+    if (!dir || !dir.isDirectory())
+    {
+        return;
+    }
+
+    std::vector<std::string> files;
+    std::vector<std::string> folders;
+    for (File entry = dir.openNextFile(); entry; entry = dir.openNextFile())
+    {
+        std::string entryName = entry.name();
+        size_t lastSlash = entryName.find_last_of('/');
+        if (lastSlash != std::string::npos)
+        {
+            entryName = entryName.substr(lastSlash + 1);
+        }
+        (entry.isDirectory() ? folders : files).push_back(path + "/" + entryName);
+    }
+    dir.close();
+
+    for (const std::string &file : files)
+    {
+        SD.remove(file.c_str());
+    }
+    for (const std::string &folder : folders)
+    {
+        RemoveDirectoryFromSD(folder);
+    }
+    SD.rmdir(path.c_str());
+}
+
 void FileSystem::SaveDirectoryToSD(const char *sdPath, espnix::Folder *folder)
 {
     if (!this->sdMounted)
@@ -221,38 +262,84 @@ void FileSystem::SaveDirectoryToSD(const char *sdPath, espnix::Folder *folder)
         return;
     }
 
+    // Removals go first, so a child added again under the same name is
+    // not deleted along with the old one
+    for (const std::string &name : folder->removedFiles)
+    {
+        espnix::File *current = folder->FindFile(name);
+        if (current != nullptr && !(current->dirty & espnix::FileSystemEntity::CREATED))
+        {
+            // A file added again under the name has been opened since, and
+            // the copy on the card is its own
+            continue;
+        }
+        SD.remove((std::string(sdPath) + "/" + name).c_str());
+    }
+    for (const std::string &name : folder->removedFolders)
+    {
+        RemoveDirectoryFromSD(std::string(sdPath) + "/" + name);
+    }
+    folder->removedFiles.clear();
+    folder->removedFolders.clear();
+
     for (auto *subFolder : folder->folders)
     {
+        // Unmarked folders hold nothing the card does not have, and a
+        // folder never read in cannot hold anything new
+        if (!subFolder->dirty || !subFolder->loaded)
+        {
+            continue;
+        }
+
         std::string newPath = std::string(sdPath) + "/" + subFolder->name;
-        if (!SD.exists(newPath.c_str()))
+        if ((subFolder->dirty & espnix::FileSystemEntity::CREATED) && !SD.exists(newPath.c_str()))
         {
             SD.mkdir(newPath.c_str());
         }
-        SaveDirectoryToSD(newPath.c_str(), subFolder);
+        if (subFolder->dirty & (espnix::FileSystemEntity::SUBTREE | espnix::FileSystemEntity::DELETED))
+        {
+            SaveDirectoryToSD(newPath.c_str(), subFolder);
+        }
+        subFolder->dirty = 0;
     }
 
     for (auto *file : folder->files)
     {
-        std::string filePath = std::string(sdPath) + "/" + file->name;
+        uint8_t changes = file->dirty;
+        file->dirty = 0;
+        if (!(changes & (espnix::FileSystemEntity::CREATED | espnix::FileSystemEntity::MODIFIED)))
+        {
+            continue;
+        }
 
-        // Delete existing file to ensure clean write
-        if (SD.exists(filePath.c_str()))
+        // The index is written by its own commits
+        std::string filePath = std::string(sdPath) + "/" + file->name;
+        if (SDPath(folder) + "/" + file->name == espnix::MetadataIndex::PATH)
         {
-            SD.remove(filePath.c_str());
+            continue;
         }
 
-        // Get data from file using Read() method (which uses FileDescriptor)
-        std::string data = file->Read();
+        size_t size;
+        if (file->fd && file->fd->isOpen && file->fd->sdFile)
+        {
+            // Writes reach the card through the descriptor; what is still
+            // in its buffer goes now
+            file->fd->fsync();
+            size = file->fd->size();
+        }
+        else
+        {
+            // Empty files are created too, so the card keeps what the index
+            // lists; one already there is left as it is
+            File sdFile = SD.open(filePath.c_str(), SD.exists(filePath.c_str()) ? FILE_READ : FILE_WRITE);
+            size = sdFile ? sdFile.size() : 0;
+            sdFile.close();
+        }
 
-        if (!data.empty())
+        if (file->size != size)
         {
-            // Open file for writing
-            File sdFile = SD.open(filePath.c_str(), FILE_WRITE);
-            if (sdFile)
-            {
-                sdFile.write((const uint8_t*)data.c_str(), data.length());
-                sdFile.close();
-            }
+            file->size = size;
+            this->metadata.Changed(folder);
         }
     }
 }
@@ -264,52 +351,52 @@ void FileSystem::SyncToSD()
         return;
     }
 
-    SaveDirectoryToSD("/", this->root);
+    // Only the marked parts of the tree are visited
+    if (this->root->dirty)
+    {
+        SaveDirectoryToSD("/", this->root);
+        this->root->dirty = 0;
+    }
+    this->metadata.Commit(this->root);
 }
 
-int FileSystem::SyncFileToSD(espnix::File *file, const std::string &path)
+void FileSystem::AutoSyncToSD()
 {
-    if (!this->sdMounted || this->inInitramfs || !this->autoSync)
+    if (this->autoSync && !this->inInitramfs)
     {
-        return -1;
+        SyncToSD();
     }
+}
 
-    if (file == nullptr)
+int FileSystem::SyncFileToSD(espnix::File *file, const std::string &path)
+{
+    if (!this->sdMounted || this->inInitramfs || !this->autoSync)
     {
         return -1;
     }
 
-    // Get data from FileDescriptor buffer
-    std::string data;
-    if (file->fd && !file->fd->buffer.empty())
-    {
-        data = file->fd->buffer;
-    }
-    else
-    {
-        // Try to read current content
-        data = file->Read();
-    }
-
-    if (data.empty())
+    if (file == nullptr)
     {
         return -1;
     }
 
-    // Delete existing file to ensure clean write
-    if (SD.exists(path.c_str()))
-    {
-        SD.remove(path.c_str());
-    }
-
-    // Write file to SD card
-    File sdFile = SD.open(path.c_str(), FILE_WRITE);
-    if (sdFile)
+    // Changes are only ever held by the file's descriptor, which writes
+    // them over the card's copy in place
+    if (file->fd && file->fd->isOpen)
     {
-        sdFile.write((const uint8_t*)data.c_str(), data.length());
-        sdFile.close();
+        if (file->fd->fsync() != 0)
+        {
+            return -1;
+        }
+        if (file->size != file->fd->size())
+        {
+            file->size = file->fd->size();
+            this->metadata.Changed(file->parent);
+        }
     }
 
+    // The new size goes to the index now, so it survives a reboot
+    this->metadata.Commit(this->root);
     return 0;
 }
 
@@ -323,11 +410,10 @@ void FileSystem::WriteFile(espnix::File *file, const std::string &data, const st
     // Write to file using FileDescriptor mechanism
     file->Write(data);
 
-    // Auto-sync to SD card if enabled (FileDescriptor handles this automatically)
-    if (this->autoSync && this->sdMounted && !this->inInitramfs)
-    {
-        file->Sync();
-    }
+    // The write waits in the descriptor's buffer; with auto-sync it goes
+    // to the card now, in one write and one flush, and the index learns
+    // the new size
+    this->SyncFileToSD(file, path);
 }
 
 FileSystem *FileSystem::GetInstance()
@@ -341,10 +427,11 @@ FileSystem *FileSystem::GetInstance()
 
 std::string FileSystem::GetStringPermissions(int permissions, std::string entryType)
 {
-    std::string str = std::to_string(permissions);
-    while (str.length() < 3)
+    // One octal digit per class of user
+    std::string str;
+    for (int shift = 6; shift >= 0; shift -= 3)
     {
-        str = "0" + str;
+        str += static_cast<char>('0' + ((permissions >> shift) & 7));
     }
 
     std::string result = "";
@@ -388,104 +475,121 @@ std::string FileSystem::GetStringPermissions(int permissions, std::string entryT
     return "-" + result;
 }
 
-espnix::Folder *FileSystem::GetFolder(std::string path)
+// Bounds of the next name in path at or after pos, skipping slashes;
+// false once there are none before end
+static bool NextComponent(const std::string &path, size_t &pos, size_t end, size_t &begin, size_t &length)
 {
-    espnix::Folder *current = this->root;
-    if (!path.empty() && path[0] != '/')
+    while (pos < end && path[pos] == '/')
+    {
+        pos++;
+    }
+    if (pos == end)
+    {
+        return false;
+    }
+    begin = pos;
+    while (pos < end && path[pos] != '/')
     {
-        path = "/" + path;
+        pos++;
     }
+    length = pos - begin;
+    return true;
+}
+
+static bool IsDot(const std::string &path, size_t begin, size_t length)
+{
+    return length == 1 && path[begin] == '.';
+}
 
-    std::vector<std::string> tokens;
-    std::string token;
-    std::istringstream tokenStream(path);
+static bool IsDotDot(const std::string &path, size_t begin, size_t length)
+{
+    return length == 2 && path[begin] == '.' && path[begin + 1] == '.';
+}
 
-    while (std::getline(tokenStream, token, '/'))
+espnix::Folder *FileSystem::WalkFolders(espnix::Folder *folder, const std::string &path, size_t pos, size_t end)
+{
+    size_t begin, length;
+    while (folder != nullptr && NextComponent(path, pos, end, begin, length))
     {
-        if (token == "..")
+        if (IsDotDot(path, begin, length))
         {
-            if (current->parent != nullptr)
+            if (folder->parent != nullptr)
             {
-                current = current->parent;
+                folder = folder->parent;
             }
         }
-        else if (!token.empty() && token != ".")
+        else if (!IsDot(path, begin, length))
         {
-            bool found = false;
-            for (auto *folder : current->folders)
-            {
-                if (folder->name == token)
-                {
-                    current = folder;
-                    found = true;
-                    break;
-                }
-            }
-
-            if (!found)
-            {
-                return nullptr;
-            }
+            folder = folder->FindFolder(path.data() + begin, length);
         }
     }
-
-    return current;
+    return folder;
 }
 
-espnix::File *FileSystem::GetFile(std::string path)
+espnix::Folder *FileSystem::GetFolder(const std::string &path)
 {
-    if (path[0] != '/' && path != ".")
+    // Relative folder paths start at the root
+    static const std::string rootBase;
+
+    espnix::FileSystemEntity *cached;
+    espnix::Folder *folder;
+    if (this->dentries.Lookup(rootBase, path, espnix::EntityType::FOLDER, cached))
     {
-        path = this->currentPath + "/" + path;
+        folder = static_cast<espnix::Folder *>(cached);
     }
-
-    std::vector<std::string> components;
-    std::stringstream ss(path);
-    std::string item;
-    while (getline(ss, item, '/'))
+    else
     {
-        if (!item.empty() && item != ".")
-        {
-            if (item == "..")
-            {
-                if (!components.empty())
-                {
-                    components.pop_back();
-                }
-            }
-            else
-            {
-                components.push_back(item);
-            }
-        }
+        folder = this->WalkFolders(this->root, path, 0, path.size());
+        this->dentries.Insert(rootBase, path, espnix::EntityType::FOLDER, folder);
     }
 
-    std::string folderPath;
-    for (size_t i = 0; i < components.size() - 1; ++i)
+    // Callers list what they get, so hand it over read in
+    if (folder != nullptr)
     {
-        folderPath += "/" + components[i];
+        folder->Load();
     }
+    return folder;
+}
 
-    espnix::Folder *folder = this->GetFolder(folderPath.empty() ? "/" : folderPath);
-    if (folder == nullptr)
+espnix::File *FileSystem::GetFile(const std::string &path)
+{
+    // Relative file paths start at the current directory
+    espnix::FileSystemEntity *cached;
+    if (this->dentries.Lookup(this->currentPath, path, espnix::EntityType::FILE, cached))
     {
-        return nullptr;
+        return static_cast<espnix::File *>(cached);
     }
 
-    std::string fileName = components.back();
+    // The last name is the file, everything before it the folders leading there
+    size_t end = path.size();
+    while (end > 0 && path[end - 1] == '/')
+    {
+        end--;
+    }
+    size_t nameBegin = path.find_last_of('/', end == 0 ? 0 : end - 1);
+    nameBegin = nameBegin == std::string::npos ? 0 : nameBegin + 1;
+    size_t nameLength = end - nameBegin;
 
-    for (auto &file : folder->files)
+    espnix::File *file = nullptr;
+    if (nameLength > 0 && !IsDot(path, nameBegin, nameLength) && !IsDotDot(path, nameBegin, nameLength))
     {
-        if (file->name == fileName)
+        espnix::Folder *folder = this->root;
+        if (path.empty() || path[0] != '/')
+        {
+            folder = this->WalkFolders(folder, this->currentPath, 0, this->currentPath.size());
+        }
+        folder = this->WalkFolders(folder, path, 0, nameBegin);
+        if (folder != nullptr)
         {
-            return file;
+            file = folder->FindFile(path.data() + nameBegin, nameLength);
         }
     }
 
-    return nullptr;
+    this->dentries.Insert(this->currentPath, path, espnix::EntityType::FILE, file);
+    return file;
 }
 
-bool FileSystem::FolderExists(std::string path)
+bool FileSystem::FolderExists(const std::string &path)
 {
     espnix::Folder *folder = this->GetFolder(path);
     return folder != nullptr;
@@ -4,6 +4,9 @@
 #include <string>
 #include <sys/_default_fcntl.h>
 
+#include "DentryCache.h"
+#include "MetadataIndex.h"
+
 namespace espnix
 {
     class Folder;
@@ -17,7 +20,9 @@ class FileSystem
     static FileSystem *instance;
     FileSystem();
 
-    void LoadDirectoryFromSD(const char *path, espnix::Folder *parent);
+    // Follows the folders named in path[pos, end) from folder, without
+    // copying any part of it; nullptr if one is missing
+    espnix::Folder *WalkFolders(espnix::Folder *folder, const std::string &path, size_t pos, size_t end);
     void SaveDirectoryToSD(const char *sdPath, espnix::Folder *folder);
 
 public:
@@ -26,6 +31,8 @@ public:
     bool sdMounted;
     bool inInitramfs;
     bool autoSync;  // Auto-sync files to SD card on write
+    espnix::DentryCache dentries;   // Recent GetFile/GetFolder results
+    espnix::MetadataIndex metadata; // Tree shape and attributes kept on the SD card
 
     FileSystem(const FileSystem &) = delete;
     FileSystem &operator=(const FileSystem &) = delete;
@@ -34,7 +41,15 @@ public:
     void InitializeInitramfs();
     bool MountSDCard();
     void LoadFromSD();
+    // Adds the entries of the folder's directory on the SD card that are
+    // not in memory yet, from the metadata index if it has them and by
+    // scanning the directory otherwise; subfolders are left to be read on
+    // their first use
+    void LoadDirectoryFromSD(espnix::Folder *folder);
     void SyncToSD();
+    // SyncToSD if auto-sync is on, so files and folders created or removed
+    // reach the card and the metadata index without waiting for a sync
+    void AutoSyncToSD();
 
     int SyncFileToSD(espnix::File *file, const std::string &path);
     void WriteFile(espnix::File *file, const std::string &data, const std::string &path);
@@ -44,9 +59,9 @@ public:
     void CreateDefaultDirectories();
     void MarkInitialized();
     std::string GetStringPermissions(int permissions, std::string entryType);
-    espnix::File *GetFile(std::string path);
-    espnix::Folder *GetFolder(std::string path);
-    bool FolderExists(std::string path);
+    espnix::File *GetFile(const std::string &path);
+    espnix::Folder *GetFolder(const std::string &path);
+    bool FolderExists(const std::string &path);
 };
 
 #endif
\ No newline at end of file
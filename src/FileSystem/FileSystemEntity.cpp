@@ -1,9 +1,21 @@
 #include "FileSystemEntity.h"
+#include "Folder.h"
 
 namespace espnix
 {
     FileSystemEntity::FileSystemEntity(EntityType entityType)
-        : type(entityType), parent(nullptr), owner(0), permissions(0755), creationDate(0)
+        : type(entityType), parent(nullptr), owner(0), permissions(0755), creationDate(0), dirty(0)
     {
     }
+
+    void FileSystemEntity::MarkDirty(uint8_t flags)
+    {
+        this->dirty |= flags;
+
+        // A folder already marked has its ancestors marked too
+        for (Folder *folder = this->parent; folder != nullptr && !(folder->dirty & SUBTREE); folder = folder->parent)
+        {
+            folder->dirty |= SUBTREE;
+        }
+    }
 }
@@ -1,6 +1,7 @@
 #ifndef FILESYSTEM_ENTITY_H
 #define FILESYSTEM_ENTITY_H
 
+#include <cstdint>
 #include <string>
 
 namespace espnix
@@ -15,14 +16,27 @@ namespace espnix
     class FileSystemEntity
     {
     public:
+        // What a sync has to do for the entity, in its dirty bits
+        enum DirtyFlags : uint8_t
+        {
+            CREATED = 1,        // Not on the SD card yet
+            MODIFIED = 2,       // Contents changed since they were synced
+            DELETED = 4,        // Children were removed (folders)
+            SUBTREE = 8         // Something below needs syncing (folders)
+        };
+
         std::string name;
         Folder *parent;
         int owner;
         int permissions;
         long creationDate;
         EntityType type;
+        uint8_t dirty;
 
         FileSystemEntity(EntityType entityType);
+        // Sets the flags and marks every folder above as holding something
+        // to sync, so a sync can skip whatever is not marked
+        void MarkDirty(uint8_t flags);
         virtual ~FileSystemEntity() = default;
 
         // Virtual methods for polymorphic behavior
@@ -4,35 +4,76 @@
 
 #include "Folder.h"
 #include "File.h"
+#include "FileSystem.h"
 
 namespace espnix
 {
     Folder::Folder() : FileSystemEntity(EntityType::FOLDER)
     {
         this->permissions = 0755;
+        this->loaded = true;
+        this->reading = false;
+        this->indexBlock = 0;
+        this->indexDirty = true;
         this->files.clear();
         this->folders.clear();
         this->entities.clear();
     }
 
+    void Folder::Load()
+    {
+        if (!this->loaded)
+        {
+            this->loaded = true;
+            this->reading = true;
+            FileSystem::GetInstance()->LoadDirectoryFromSD(this);
+            this->reading = false;
+        }
+    }
+
     void Folder::AddFile(File *file)
     {
-        file->creationDate = time(0);
+        this->Load();
+        if (file->creationDate == 0)
+        {
+            file->creationDate = time(0);
+        }
         file->parent = this;
         this->files.push_back(file);
         this->entities.push_back(static_cast<FileSystemEntity*>(file));
+        this->index.Insert(file);
+        FileSystem::GetInstance()->dentries.Created();
+        FileSystem::GetInstance()->metadata.Changed(this);
+        if (!this->reading)
+        {
+            file->MarkDirty(CREATED);
+            FileSystem::GetInstance()->AutoSyncToSD();
+        }
     }
 
     void Folder::AddFolder(Folder *folder)
     {
-        folder->creationDate = time(0);
+        this->Load();
+        if (folder->creationDate == 0)
+        {
+            folder->creationDate = time(0);
+        }
         folder->parent = this;
         this->folders.push_back(folder);
         this->entities.push_back(static_cast<FileSystemEntity*>(folder));
+        this->index.Insert(folder);
+        FileSystem::GetInstance()->dentries.Created();
+        FileSystem::GetInstance()->metadata.Changed(this);
+        if (!this->reading)
+        {
+            folder->MarkDirty(CREATED);
+            FileSystem::GetInstance()->AutoSyncToSD();
+        }
     }
 
     std::vector<void *> Folder::ListContent()
     {
+        this->Load();
         std::vector<void *> contents;
 
         for (auto &file : this->files)
@@ -48,46 +89,85 @@ namespace espnix
         return contents;
     }
 
+    // Drops the entity from an ordered child list; pointers compare without
+    // touching names, and erasing keeps the rest in listing order
+    template <typename T>
+    static void EraseChild(std::vector<T *> &children, FileSystemEntity *entity)
+    {
+        auto it = std::find(children.begin(), children.end(), entity);
+        if (it != children.end())
+        {
+            children.erase(it);
+        }
+    }
+
     void Folder::RemoveFile(std::string filename)
     {
-        for (size_t i = 0; i < this->files.size(); i++)
-        {
-            if (this->files[i]->name == filename)
-            {
-                // Remove from entities collection first
-                auto entityIt = std::find(this->entities.begin(), this->entities.end(),
-                                        static_cast<FileSystemEntity*>(this->files[i]));
-                if (entityIt != this->entities.end())
-                {
-                    this->entities.erase(entityIt);
-                }
-
-                delete this->files[i];
-                this->files.erase(this->files.begin() + i);
-                break;
-            }
+        File *file = this->FindFile(filename);
+        if (file == nullptr)
+        {
+            return;
         }
+
+        FileSystem::GetInstance()->dentries.Removed(file);
+        FileSystem::GetInstance()->metadata.Changed(this);
+        // A file is on the card once it has been synced or opened
+        if (!(file->dirty & CREATED))
+        {
+            this->removedFiles.push_back(filename);
+            this->MarkDirty(DELETED);
+        }
+        this->index.Remove(file);
+        EraseChild(this->entities, file);
+        EraseChild(this->files, file);
+        delete file;
+        FileSystem::GetInstance()->AutoSyncToSD();
     }
 
     void Folder::RemoveFolder(std::string foldername)
     {
-        for (size_t i = 0; i < this->folders.size(); i++)
-        {
-            if (this->folders[i]->name == foldername)
-            {
-                // Remove from entities collection first
-                auto entityIt = std::find(this->entities.begin(), this->entities.end(),
-                                        static_cast<FileSystemEntity*>(this->folders[i]));
-                if (entityIt != this->entities.end())
-                {
-                    this->entities.erase(entityIt);
-                }
-
-                delete this->folders[i];
-                this->folders.erase(this->folders.begin() + i);
-                break;
-            }
+        Folder *folder = this->FindFolder(foldername);
+        if (folder == nullptr)
+        {
+            return;
+        }
+
+        FileSystem::GetInstance()->dentries.Removed(folder);
+        FileSystem::GetInstance()->metadata.Changed(this);
+        if (!(folder->dirty & CREATED))
+        {
+            this->removedFolders.push_back(foldername);
+            this->MarkDirty(DELETED);
         }
+        this->index.Remove(folder);
+        EraseChild(this->entities, folder);
+        EraseChild(this->folders, folder);
+        delete folder;
+        FileSystem::GetInstance()->AutoSyncToSD();
+    }
+
+    File *Folder::FindFile(const std::string &filename)
+    {
+        this->Load();
+        return static_cast<File *>(this->index.Find(filename, EntityType::FILE));
+    }
+
+    Folder *Folder::FindFolder(const std::string &foldername)
+    {
+        this->Load();
+        return static_cast<Folder *>(this->index.Find(foldername, EntityType::FOLDER));
+    }
+
+    File *Folder::FindFile(const char *filename, size_t length)
+    {
+        this->Load();
+        return static_cast<File *>(this->index.Find(filename, length, EntityType::FILE));
+    }
+
+    Folder *Folder::FindFolder(const char *foldername, size_t length)
+    {
+        this->Load();
+        return static_cast<Folder *>(this->index.Find(foldername, length, EntityType::FOLDER));
     }
 
     std::string Folder::GetDisplayName() const
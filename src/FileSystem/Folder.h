@@ -1,10 +1,12 @@
 #ifndef FOLDER_H
 #define FOLDER_H
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "FileSystemEntity.h"
+#include "NameIndex.h"
 
 namespace espnix
 {
@@ -13,18 +15,41 @@ namespace espnix
 
     class Folder : public FileSystemEntity
     {
+    private:
+        NameIndex index;    // Children by name; the vectors keep listing order
+        bool reading;       // Children are being added from the SD card
+
     public:
         std::vector<File *> files;
         std::vector<Folder *> folders;
         std::vector<FileSystemEntity *> entities;  // Unified collection
         Folder *current{};
+        // Whether the children on the SD card have been read in. Folders
+        // found on the card start out false and are read on first use;
+        // any other folder has nothing to read.
+        bool loaded;
+        // Where the folder's entries sit in the metadata index, 0 if they
+        // are not there, and whether they changed since it was written
+        uint32_t indexBlock;
+        bool indexDirty;
+        // Children removed since the last sync that are still on the card
+        std::vector<std::string> removedFiles;
+        std::vector<std::string> removedFolders;
 
         Folder();
+        // Reads in the children on the SD card if that has not happened yet
+        void Load();
         void AddFile(File *file);
         void AddFolder(Folder *folder);
         std::vector<void *> ListContent();
         void RemoveFile(std::string filename);
         void RemoveFolder(std::string foldername);
+        // Child with this name, or nullptr
+        File *FindFile(const std::string &filename);
+        Folder *FindFolder(const std::string &foldername);
+        // Same for a name that is part of a path
+        File *FindFile(const char *filename, size_t length);
+        Folder *FindFolder(const char *foldername, size_t length);
 
         // Virtual method implementations
         std::string GetDisplayName() const override;
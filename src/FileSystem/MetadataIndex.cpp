@@ -0,0 +1,499 @@
+#include "MetadataIndex.h"
+#include "Folder.h"
+#include "File.h"
+
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
+namespace espnix
+{
+    const char *const MetadataIndex::PATH = "/sys/.index";
+
+    static const char *const REWRITE_PATH = "/sys/.index.new";
+    static const uint32_t MAGIC = 0x49584E45;     // "ENXI"
+    static const uint16_t VERSION = 1;
+    static const uint32_t HEADER_SIZE = 20;
+    static const uint32_t BLOCK_HEADER_SIZE = 8;
+    static const uint32_t ENTRY_HEADER_SIZE = 14;
+    // Appends allowed on top of twice the rewritten size, so a small index
+    // is not rewritten on every change
+    static const uint32_t SLACK = 4096;
+
+    static const uint8_t TYPE_FILE = 0;
+    static const uint8_t TYPE_FOLDER = 1;
+
+    struct IndexEntry
+    {
+        uint8_t type;
+        uint16_t permissions;
+        uint16_t owner;
+        uint32_t creationDate;
+        uint32_t value;         // Size of a file, block of a folder
+        size_t valueAt;         // Offset of value within the block's entries
+        std::string name;
+    };
+
+    static void Put16(std::string &out, uint16_t value)
+    {
+        out += static_cast<char>(value & 0xFF);
+        out += static_cast<char>(value >> 8);
+    }
+
+    static void Put32(std::string &out, uint32_t value)
+    {
+        Put16(out, static_cast<uint16_t>(value & 0xFFFF));
+        Put16(out, static_cast<uint16_t>(value >> 16));
+    }
+
+    static uint16_t Get16(const uint8_t *data)
+    {
+        return static_cast<uint16_t>(data[0] | (data[1] << 8));
+    }
+
+    static uint32_t Get32(const uint8_t *data)
+    {
+        return Get16(data) | (static_cast<uint32_t>(Get16(data + 2)) << 16);
+    }
+
+    static void PutEntry(std::string &out, uint8_t type, const FileSystemEntity *entity, uint32_t value)
+    {
+        out += static_cast<char>(type);
+        out += static_cast<char>(entity->name.size());
+        Put16(out, static_cast<uint16_t>(entity->permissions));
+        Put16(out, static_cast<uint16_t>(entity->owner));
+        Put32(out, static_cast<uint32_t>(entity->creationDate));
+        Put32(out, value);
+        out += entity->name;
+    }
+
+    // The entries of a block, unparsed; false if the block cannot be read
+    static bool ReadBlock(fs::File &in, uint32_t block, uint32_t &count, std::vector<uint8_t> &entries)
+    {
+        uint8_t header[BLOCK_HEADER_SIZE];
+        if (!in.seek(block) || in.read(header, BLOCK_HEADER_SIZE) != BLOCK_HEADER_SIZE)
+        {
+            return false;
+        }
+        count = Get32(header);
+        uint32_t length = Get32(header + 4);
+        if (length > in.size() - block)
+        {
+            return false;
+        }
+        entries.resize(length);
+        return length == 0 || in.read(entries.data(), length) == length;
+    }
+
+    // Parses the entry at pos and moves past it; false at the end or if
+    // the entry runs past the block
+    static bool NextEntry(const std::vector<uint8_t> &entries, size_t &pos, IndexEntry &entry)
+    {
+        if (entries.size() - pos < ENTRY_HEADER_SIZE)
+        {
+            return false;
+        }
+        const uint8_t *data = entries.data() + pos;
+        size_t nameLength = data[1];
+        if (entries.size() - pos - ENTRY_HEADER_SIZE < nameLength)
+        {
+            return false;
+        }
+        entry.type = data[0];
+        entry.permissions = Get16(data + 2);
+        entry.owner = Get16(data + 4);
+        entry.creationDate = Get32(data + 6);
+        entry.value = Get32(data + 10);
+        entry.valueAt = pos + 10;
+        entry.name.assign(reinterpret_cast<const char *>(data + ENTRY_HEADER_SIZE), nameLength);
+        pos += ENTRY_HEADER_SIZE + nameLength;
+        return true;
+    }
+
+    // Whether the directory on the card holds exactly the indexed names.
+    // Names are listed without opening each entry, so this costs far less
+    // than the scan it saves.
+    static bool MatchesDirectory(const std::string &path, const std::vector<IndexEntry> &indexed)
+    {
+        fs::File dir = SD.open(path.c_str());
+        if (!dir || !dir.isDirectory())
+        {
+            return false;
+        }
+
+        std::unordered_set<std::string> names;
+        names.reserve(indexed.size());
+        for (const IndexEntry &known : indexed)
+        {
+            names.insert(known.name);
+        }
+
+        size_t seen = 0;
+        for (String next = dir.getNextFileName(); next.length() > 0; next = dir.getNextFileName())
+        {
+            std::string name = next.c_str();
+            size_t lastSlash = name.find_last_of('/');
+            if (lastSlash != std::string::npos)
+            {
+                name = name.substr(lastSlash + 1);
+            }
+
+            if (names.count(name) == 0)
+            {
+                return false;
+            }
+            seen++;
+        }
+        return seen == indexed.size();
+    }
+
+    MetadataIndex::MetadataIndex() : valid(false), loading(false), end(0), compacted(0), writeFailed(false)
+    {
+    }
+
+    bool MetadataIndex::Mount(Folder *root)
+    {
+        this->valid = false;
+
+        fs::File in = SD.open(PATH, FILE_READ);
+        if (!in)
+        {
+            return false;
+        }
+
+        uint8_t header[HEADER_SIZE];
+        if (in.read(header, HEADER_SIZE) != HEADER_SIZE ||
+            Get32(header) != MAGIC || Get16(header + 4) != VERSION)
+        {
+            in.close();
+            return false;
+        }
+        uint32_t rootBlock = Get32(header + 8);
+        uint32_t dataEnd = Get32(header + 12);
+        if (dataEnd > in.size() || rootBlock < HEADER_SIZE || rootBlock >= dataEnd)
+        {
+            in.close();
+            return false;
+        }
+
+        // Its entries are checked against the card like any other
+        // folder's, when the root is first read
+        uint32_t count;
+        std::vector<uint8_t> entries;
+        bool readable = ReadBlock(in, rootBlock, count, entries);
+        in.close();
+        if (!readable)
+        {
+            return false;
+        }
+
+        this->valid = true;
+        this->end = dataEnd;
+        this->compacted = Get32(header + 16);
+        root->indexBlock = rootBlock;
+        return true;
+    }
+
+    bool MetadataIndex::LoadFolder(Folder *folder, const std::string &path)
+    {
+        if (!this->valid || folder->indexBlock == 0)
+        {
+            return false;
+        }
+
+        fs::File in = SD.open(PATH, FILE_READ);
+        if (!in)
+        {
+            return false;
+        }
+        uint32_t count;
+        std::vector<uint8_t> entries;
+        bool readable = ReadBlock(in, folder->indexBlock, count, entries);
+        in.close();
+        if (!readable)
+        {
+            return false;
+        }
+
+        std::vector<IndexEntry> indexed;
+        IndexEntry entry;
+        for (size_t pos = 0; NextEntry(entries, pos, entry);)
+        {
+            indexed.push_back(entry);
+        }
+
+        // A change made to the card that never reached the index, by a
+        // reset before the commit or by another machine, shows up as a
+        // name added or missing. The folder is then scanned, and written
+        // anew at the next commit.
+        if (indexed.size() != count || !MatchesDirectory(path, indexed))
+        {
+            this->Changed(folder);
+            return false;
+        }
+
+        this->loading = true;
+        for (const IndexEntry &entry : indexed)
+        {
+            FileSystemEntity *child;
+            if (entry.type == TYPE_FOLDER)
+            {
+                Folder *subFolder = folder->FindFolder(entry.name);
+                if (subFolder == nullptr)
+                {
+                    subFolder = new Folder();
+                    subFolder->name = entry.name;
+                    subFolder->indexDirty = false;
+                    folder->AddFolder(subFolder);
+                }
+                subFolder->indexBlock = entry.value;
+                // Its own entries wait until something looks inside it
+                subFolder->loaded = false;
+                child = subFolder;
+            }
+            else
+            {
+                File *file = folder->FindFile(entry.name);
+                if (file == nullptr)
+                {
+                    file = new File();
+                    file->name = entry.name;
+                    folder->AddFile(file);
+                }
+                file->size = entry.value;
+                child = file;
+            }
+            child->permissions = entry.permissions;
+            child->owner = entry.owner;
+            child->creationDate = entry.creationDate;
+        }
+        this->loading = false;
+        return true;
+    }
+
+    void MetadataIndex::Changed(Folder *folder)
+    {
+        if (this->loading)
+        {
+            return;
+        }
+
+        // Every folder above now points at a block that is about to move
+        for (; folder != nullptr; folder = folder->parent)
+        {
+            folder->indexDirty = true;
+        }
+    }
+
+    void MetadataIndex::Append(fs::File &out, const void *data, size_t size)
+    {
+        // Nothing after a short write is of any use, as the commit is
+        // dropped anyway
+        if (this->writeFailed)
+        {
+            return;
+        }
+        size_t written = out.write(static_cast<const uint8_t *>(data), size);
+        this->end += written;
+        this->writeFailed = written != size;
+    }
+
+    uint32_t MetadataIndex::WriteFolder(fs::File &out, Folder *folder, bool full, fs::File *source)
+    {
+        std::string entries;
+        uint32_t count = 0;
+
+        for (File *file : folder->files)
+        {
+            // FAT names fit in 255 bytes; anything longer never reached the card
+            if (file->name.size() <= 255)
+            {
+                PutEntry(entries, TYPE_FILE, file, static_cast<uint32_t>(file->size));
+                count++;
+            }
+        }
+
+        for (Folder *subFolder : folder->folders)
+        {
+            if (subFolder->name.size() > 255)
+            {
+                continue;
+            }
+
+            uint32_t block = subFolder->indexBlock;
+            if (subFolder->loaded && (full || subFolder->indexDirty))
+            {
+                block = this->WriteFolder(out, subFolder, full, source);
+            }
+            else if (full)
+            {
+                block = (source != nullptr && block != 0) ? this->CopyBlock(*source, block, out) : 0;
+                this->placed.push_back(std::make_pair(subFolder, block));
+            }
+            PutEntry(entries, TYPE_FOLDER, subFolder, block);
+            count++;
+        }
+
+        std::string block;
+        Put32(block, count);
+        Put32(block, static_cast<uint32_t>(entries.size()));
+        block += entries;
+
+        uint32_t offset = this->end;
+        this->Append(out, block.data(), block.size());
+        this->placed.push_back(std::make_pair(folder, offset));
+        return offset;
+    }
+
+    uint32_t MetadataIndex::CopyBlock(fs::File &in, uint32_t block, fs::File &out)
+    {
+        uint32_t count;
+        std::vector<uint8_t> entries;
+        if (!ReadBlock(in, block, count, entries))
+        {
+            // The folder goes back to being scanned
+            return 0;
+        }
+
+        IndexEntry entry;
+        for (size_t pos = 0; NextEntry(entries, pos, entry);)
+        {
+            if (entry.type == TYPE_FOLDER && entry.value != 0)
+            {
+                std::string value;
+                Put32(value, this->CopyBlock(in, entry.value, out));
+                std::copy(value.begin(), value.end(), entries.begin() + entry.valueAt);
+            }
+        }
+
+        std::string header;
+        Put32(header, count);
+        Put32(header, static_cast<uint32_t>(entries.size()));
+
+        uint32_t offset = this->end;
+        this->Append(out, header.data(), header.size());
+        this->Append(out, entries.data(), entries.size());
+        return offset;
+    }
+
+    bool MetadataIndex::WriteHeader(fs::File &out, uint32_t root)
+    {
+        std::string header;
+        Put32(header, MAGIC);
+        Put16(header, VERSION);
+        Put16(header, 0);
+        Put32(header, root);
+        Put32(header, this->end);
+        Put32(header, this->compacted);
+
+        return out.seek(0) &&
+            out.write(reinterpret_cast<const uint8_t *>(header.data()), header.size()) == header.size();
+    }
+
+    void MetadataIndex::Place()
+    {
+        for (const std::pair<Folder *, uint32_t> &block : this->placed)
+        {
+            block.first->indexBlock = block.second;
+            // An unloaded folder's block was only copied; whether it still
+            // has to be written is left as it was
+            if (block.first->loaded)
+            {
+                block.first->indexDirty = false;
+            }
+        }
+        this->placed.clear();
+    }
+
+    void MetadataIndex::Rewrite(Folder *root)
+    {
+        fs::File out = SD.open(REWRITE_PATH, FILE_WRITE);
+        if (!out)
+        {
+            return;
+        }
+        fs::File source;
+        if (this->valid)
+        {
+            source = SD.open(PATH, FILE_READ);
+        }
+
+        uint32_t previousEnd = this->end;
+        uint32_t previousCompacted = this->compacted;
+        this->writeFailed = false;
+        this->placed.clear();
+
+        // Room for the header, which is filled in once the root is placed
+        this->end = 0;
+        std::string placeholder(HEADER_SIZE, '\0');
+        this->Append(out, placeholder.data(), placeholder.size());
+
+        uint32_t rootBlock = this->WriteFolder(out, root, true, source ? &source : nullptr);
+        this->compacted = this->end;
+        bool written = !this->writeFailed && this->WriteHeader(out, rootBlock);
+        out.close();
+        if (source)
+        {
+            source.close();
+        }
+
+        // An incomplete copy is never swapped in; the index on the card,
+        // if any, stays as it was
+        if (!written)
+        {
+            SD.remove(REWRITE_PATH);
+            this->end = previousEnd;
+            this->compacted = previousCompacted;
+            this->placed.clear();
+            return;
+        }
+
+        SD.remove(PATH);
+        this->valid = SD.rename(REWRITE_PATH, PATH);
+        if (this->valid)
+        {
+            this->Place();
+        }
+        this->placed.clear();
+    }
+
+    void MetadataIndex::Commit(Folder *root)
+    {
+        if (!root->indexDirty)
+        {
+            return;
+        }
+
+        if (!this->valid || this->end > 2 * this->compacted + SLACK)
+        {
+            this->Rewrite(root);
+            return;
+        }
+
+        fs::File out = SD.open(PATH, "r+");
+        if (!out)
+        {
+            this->Rewrite(root);
+            return;
+        }
+        uint32_t previousEnd = this->end;
+        this->writeFailed = !out.seek(this->end);
+        this->placed.clear();
+        uint32_t rootBlock = this->WriteFolder(out, root, false, nullptr);
+
+        // Blocks the card did not take in full are left past the end, to
+        // be written over by the next commit, and the header keeps
+        // pointing at the previous tree
+        if (!this->writeFailed && this->WriteHeader(out, rootBlock))
+        {
+            this->Place();
+        }
+        else
+        {
+            this->end = previousEnd;
+            this->placed.clear();
+        }
+        out.flush();
+        out.close();
+    }
+}
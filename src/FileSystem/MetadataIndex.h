@@ -0,0 +1,83 @@
+#ifndef METADATA_INDEX_H
+#define METADATA_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include <SD.h>
+
+namespace espnix
+{
+    class Folder;
+
+    // Names, attributes and sizes of everything on the SD card, kept in one
+    // binary file so folders can be read in without scanning directories
+    // and attributes survive a reboot.
+    //
+    // The file holds a header and one block per folder. A block lists the
+    // folder's entries; a subfolder's entry points at the subfolder's own
+    // block, or is 0 if that folder has never been indexed and has to be
+    // scanned. Blocks are never changed once written: a folder that
+    // changes is appended as a new block, and so is every folder above it,
+    // since their entries now point elsewhere. The header is rewritten
+    // last, and only once every block is on the card, so a commit cut
+    // short or refused by the card leaves the previous tree in place. Once
+    // appends have doubled the file it is rewritten without the stale
+    // blocks. A block is checked against the names in its directory when
+    // the folder is read, and a folder that does not match is scanned.
+    //
+    // All numbers are little endian.
+    //   header: magic, version, root block, end of data, size when last
+    //           rewritten (u32, u16 + u16 spare, u32, u32, u32)
+    //   block:  entry count, byte length of the entries (u32, u32)
+    //   entry:  type, name length, permissions, owner (u8, u8, u16, u16),
+    //           creation date, size or block (u32, u32), name
+    class MetadataIndex
+    {
+    public:
+        static const char *const PATH;
+
+    private:
+        bool valid;         // The file on the card can be read and appended to
+        bool loading;       // Entries are being added from the index
+        uint32_t end;       // Where the next block goes
+        uint32_t compacted; // Size of the file when it was last rewritten
+        bool writeFailed;   // A write of the commit in progress came up short
+        // Folders given a new block by the commit in progress; they only
+        // take it once the header points at the new tree
+        std::vector<std::pair<Folder *, uint32_t>> placed;
+
+        // Writes at the end of the index and moves the end past what the
+        // card took
+        void Append(fs::File &out, const void *data, size_t size);
+        // Appends the folder's block, after those of its loaded subfolders
+        // that need writing; with full set every subfolder is written,
+        // copying the blocks of unloaded ones over from source if given
+        uint32_t WriteFolder(fs::File &out, Folder *folder, bool full, fs::File *source);
+        // Copies a block and everything under it from one index to another
+        uint32_t CopyBlock(fs::File &in, uint32_t block, fs::File &out);
+        bool WriteHeader(fs::File &out, uint32_t root);
+        // Points the folders at the blocks just written, once those and
+        // the header are all on the card
+        void Place();
+        // Writes the whole tree into a new file and swaps it in
+        void Rewrite(Folder *root);
+
+    public:
+        MetadataIndex();
+
+        // Checks the index's header and points the root at its block;
+        // false if there is no usable index and folders have to be scanned
+        bool Mount(Folder *root);
+        // Adds the folder's entries from its block; false if it has none
+        // or the directory at path no longer holds what it lists
+        bool LoadFolder(Folder *folder, const std::string &path);
+        // The folder's entries, or the attributes of one of them, changed
+        void Changed(Folder *folder);
+        // Writes out every folder changed since the last commit
+        void Commit(Folder *root);
+    };
+}
+
+#endif
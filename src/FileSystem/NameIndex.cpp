@@ -0,0 +1,121 @@
+#include "NameIndex.h"
+
+namespace espnix
+{
+    static const size_t MIN_SLOTS = 8;
+
+    NameIndex::NameIndex() : count(0) {}
+
+    // FNV-1a
+    uint32_t NameIndex::Hash(const char *name, size_t length)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= static_cast<uint8_t>(name[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    void NameIndex::Place(uint32_t hash, FileSystemEntity *entity)
+    {
+        size_t mask = this->slots.size() - 1;
+        size_t i = hash & mask;
+        while (this->slots[i].entity != nullptr)
+        {
+            i = (i + 1) & mask;
+        }
+        this->slots[i].hash = hash;
+        this->slots[i].entity = entity;
+    }
+
+    void NameIndex::Grow()
+    {
+        std::vector<Slot> old;
+        old.swap(this->slots);
+        Slot empty = {0, nullptr};
+        this->slots.assign(old.empty() ? MIN_SLOTS : old.size() * 2, empty);
+        for (const Slot &slot : old)
+        {
+            if (slot.entity != nullptr)
+            {
+                this->Place(slot.hash, slot.entity);
+            }
+        }
+    }
+
+    void NameIndex::Insert(FileSystemEntity *entity)
+    {
+        // Linear probing stays short up to three quarters full
+        if ((this->count + 1) * 4 > this->slots.size() * 3)
+        {
+            this->Grow();
+        }
+        this->Place(Hash(entity->name.data(), entity->name.size()), entity);
+        this->count++;
+    }
+
+    void NameIndex::Remove(FileSystemEntity *entity)
+    {
+        if (this->slots.empty())
+        {
+            return;
+        }
+
+        size_t mask = this->slots.size() - 1;
+        size_t i = Hash(entity->name.data(), entity->name.size()) & mask;
+        while (this->slots[i].entity != entity)
+        {
+            if (this->slots[i].entity == nullptr)
+            {
+                return;
+            }
+            i = (i + 1) & mask;
+        }
+
+        // Move later entries of the same probe run back into the hole, so
+        // lookups never need tombstones to keep going
+        size_t hole = i;
+        for (size_t next = (i + 1) & mask; this->slots[next].entity != nullptr; next = (next + 1) & mask)
+        {
+            size_t home = this->slots[next].hash & mask;
+            // The entry may move to the hole unless its home lies after the
+            // hole, up to where it sits now
+            bool homeBetween = hole <= next ? (hole < home && home <= next) : (hole < home || home <= next);
+            if (!homeBetween)
+            {
+                this->slots[hole] = this->slots[next];
+                hole = next;
+            }
+        }
+        this->slots[hole].entity = nullptr;
+        this->count--;
+    }
+
+    FileSystemEntity *NameIndex::Find(const std::string &name, EntityType type) const
+    {
+        return this->Find(name.data(), name.size(), type);
+    }
+
+    FileSystemEntity *NameIndex::Find(const char *name, size_t length, EntityType type) const
+    {
+        if (this->slots.empty())
+        {
+            return nullptr;
+        }
+
+        uint32_t hash = Hash(name, length);
+        size_t mask = this->slots.size() - 1;
+        for (size_t i = hash & mask; this->slots[i].entity != nullptr; i = (i + 1) & mask)
+        {
+            const Slot &slot = this->slots[i];
+            if (slot.hash == hash && slot.entity->type == type &&
+                slot.entity->name.compare(0, std::string::npos, name, length) == 0)
+            {
+                return slot.entity;
+            }
+        }
+        return nullptr;
+    }
+}
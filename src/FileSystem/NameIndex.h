@@ -0,0 +1,45 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FileSystemEntity.h"
+
+namespace espnix
+{
+    // Hash index over the children of a folder, so finding one by name does
+    // not scan the whole directory. Open addressing with linear probing; a
+    // slot holds the entity and the hash of its name, which settles most
+    // mismatches without comparing strings, and names are not copied. A
+    // file and a folder may share a name, so lookups also match the type.
+    class NameIndex
+    {
+    private:
+        struct Slot
+        {
+            uint32_t hash;
+            FileSystemEntity *entity;   // nullptr if the slot is empty
+        };
+
+        std::vector<Slot> slots;
+        size_t count;
+
+        static uint32_t Hash(const char *name, size_t length);
+        void Place(uint32_t hash, FileSystemEntity *entity);
+        void Grow();
+
+    public:
+        NameIndex();
+
+        // The entity's name must not change while it is in the index
+        void Insert(FileSystemEntity *entity);
+        void Remove(FileSystemEntity *entity);
+        FileSystemEntity *Find(const std::string &name, EntityType type) const;
+        // Same for a name that is part of a longer string, such as a path
+        FileSystemEntity *Find(const char *name, size_t length, EntityType type) const;
+    };
+}
+
+#endif
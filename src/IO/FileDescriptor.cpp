@@ -1,13 +1,21 @@
 #include <Arduino.h>
+#include <cstring>
 #include <vector>
 #include <stdexcept>
 #include <algorithm>
 
 #include "FileDescriptor.h"
+#include "PageCache.h"
 #include "FileSystem/File.h"
 
 std::vector<FileDescriptor*> FileDescriptor::dtable;
 
+// Writing needs one of these; without them the descriptor only reads
+static bool IsWritable(int flags)
+{
+    return (flags & (O_WRONLY | O_RDWR | O_APPEND)) != 0;
+}
+
 FileDescriptor::FileDescriptor(int descriptor)
 {
     if (descriptor < -1)
@@ -19,6 +27,11 @@ FileDescriptor::FileDescriptor(int descriptor)
     this->file = nullptr;
     this->isOpen = true;
     this->flags = O_RDWR;
+    this->position = 0;
+    this->length = 0;
+    this->cardLength = 0;
+    this->pending = 0;
+    this->dirtySince = 0;
 
     if (descriptor == -1) {
         // This is a file descriptor for a file asking for an id, assign the next available id
@@ -36,6 +49,11 @@ FileDescriptor::FileDescriptor(espnix::File* file, const std::string& path, int
     this->filePath = path;
     this->flags = flags;
     this->isOpen = false;
+    this->position = 0;
+    this->length = 0;
+    this->cardLength = 0;
+    this->pending = 0;
+    this->dirtySince = 0;
 
     // Add to descriptor table
     this->dtable.push_back(this);
@@ -55,28 +73,28 @@ bool FileDescriptor::open()
 
     if (this->type == FDType::FILE && !this->filePath.empty())
     {
+        // A writable file is opened for update, so changes can go over
+        // the card's copy where they belong; one not there yet is created.
+        // Whatever the card holds under the name of a file not created
+        // there yet is left from a file removed before it
+        bool created = this->file && (this->file->dirty & espnix::FileSystemEntity::CREATED);
         const char* mode = FILE_READ;
-        if (this->flags & O_WRONLY)
-            mode = FILE_WRITE;
-        else if (this->flags & O_RDWR)
-            mode = FILE_WRITE;  // SD library uses FILE_WRITE for read/write
-        else if (this->flags & O_APPEND)
-            mode = FILE_APPEND;
+        if (created)
+            mode = "w+";
+        else if (IsWritable(this->flags))
+            mode = SD.exists(this->filePath.c_str()) ? "r+" : "w+";
 
+        // Contents are not read in here; reads fetch what they need
+        // through the page cache
         this->sdFile = SD.open(this->filePath.c_str(), mode);
         this->isOpen = this->sdFile ? true : false;
-
-        // If opening for read and file exists, load content into buffer
-        if (this->isOpen && (this->flags & O_RDONLY || this->flags & O_RDWR))
-        {
-            this->buffer.clear();
-            while (this->sdFile.available())
-            {
-                this->buffer += (char)this->sdFile.read();
-            }
-            // Reset file position for read operations
-            this->sdFile.seek(0);
-        }
+        if (created && this->isOpen)
+            this->file->dirty &= ~espnix::FileSystemEntity::CREATED;
+        this->position = 0;
+        this->length = this->sdFile ? this->sdFile.size() : 0;
+        this->cardLength = this->length;
+        this->ranges.clear();
+        this->pending = 0;
 
         return this->isOpen;
     }
@@ -84,29 +102,250 @@ bool FileDescriptor::open()
     return false;
 }
 
-void FileDescriptor::close()
+int FileDescriptor::close()
 {
+    int result = 0;
     if (this->type == FDType::FILE && this->sdFile)
     {
-        flush();
+        result = fsync();
         this->sdFile.close();
     }
 
     this->isOpen = false;
+    return result;
+}
+
+bool FileDescriptor::isDirty() const
+{
+    return !this->ranges.empty() || this->length != this->cardLength;
+}
+
+ssize_t FileDescriptor::readAt(size_t offset, void *buffer, size_t count)
+{
+    if (offset >= this->length)
+        return 0;
+    count = std::min(count, this->length - offset);
+
+    // What the card holds comes through the page cache; past its end
+    // every byte is in a range
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t fromCard = offset < this->cardLength ? std::min(count, this->cardLength - offset) : 0;
+    size_t copied = fromCard > 0 ? PageCache::instance().read(this->file, this->sdFile, offset, out, fromCard) : 0;
+    if (copied < fromCard)
+    {
+        // The card gave back less than it holds; a page it cut short
+        // must not pass for the end of the file next time
+        PageCache::instance().drop(this->file);
+        return -1;
+    }
+    memset(out + copied, 0, count - copied);
+
+    // Unwritten changes go over it
+    size_t end = offset + count;
+    auto it = this->ranges.upper_bound(offset);
+    if (it != this->ranges.begin())
+        --it;
+    for (; it != this->ranges.end() && it->first < end; ++it)
+    {
+        size_t from = std::max(offset, it->first);
+        size_t to = std::min(end, it->first + it->second.size());
+        if (from < to)
+            memcpy(out + (from - offset), it->second.data() + (from - it->first), to - from);
+    }
+
+    return static_cast<ssize_t>(count);
+}
+
+void FileDescriptor::stage(size_t offset, const char *data, size_t count)
+{
+    if (count == 0)
+        return;
+
+    // The range the write starts in or right after, or a new one
+    auto it = this->ranges.upper_bound(offset);
+    if (it != this->ranges.begin() && std::prev(it)->first + std::prev(it)->second.size() >= offset)
+        --it;
+    else
+        it = this->ranges.emplace_hint(it, offset, std::string());
+
+    std::string& range = it->second;
+    size_t at = offset - it->first;
+    if (range.size() < at + count)
+        range.resize(at + count);
+    range.replace(at, count, data, count);
+
+    // Ranges the write reached are folded into it
+    size_t end = it->first + range.size();
+    for (auto next = std::next(it); next != this->ranges.end() && next->first <= end;)
+    {
+        size_t overlap = end - next->first;
+        if (next->second.size() > overlap)
+        {
+            range.append(next->second, overlap, std::string::npos);
+            end = it->first + range.size();
+        }
+        next = this->ranges.erase(next);
+    }
+}
+
+void FileDescriptor::resize(size_t newLength)
+{
+    if (newLength < this->length)
+    {
+        // Changes past the new end are dropped
+        this->ranges.erase(this->ranges.lower_bound(newLength), this->ranges.end());
+        if (!this->ranges.empty())
+        {
+            auto last = std::prev(this->ranges.end());
+            if (last->first + last->second.size() > newLength)
+                last->second.resize(newLength - last->first);
+        }
+    }
+    else if (newLength > this->length)
+    {
+        // The gap reads as zeros, and is written to the card as such
+        std::string zeros(newLength - this->length, '\0');
+        this->stage(this->length, zeros.data(), zeros.size());
+    }
+
+    this->length = newLength;
 }
 
-void FileDescriptor::flush()
+// A name beside path that nothing on the card uses
+static std::string UnusedPath(const std::string &path)
 {
-    if (this->type == FDType::FILE && this->isOpen && this->sdFile)
+    std::string unused = path + "~";
+    while (SD.exists(unused.c_str()))
+        unused += "~";
+    return unused;
+}
+
+bool FileDescriptor::rewrite()
+{
+    std::string copyPath = UnusedPath(this->filePath);
+    File copy = SD.open(copyPath.c_str(), FILE_WRITE);
+    if (!copy)
+        return false;
+
+    uint8_t page[PageCache::PAGE_SIZE];
+    bool complete = true;
+    for (size_t offset = 0; complete && offset < this->length; offset += sizeof(page))
+    {
+        ssize_t count = this->readAt(offset, page, sizeof(page));
+        complete = count >= 0 && copy.write(page, count) == static_cast<size_t>(count);
+    }
+    copy.close();
+    if (!complete)
     {
+        // The card's copy is left as it was
+        SD.remove(copyPath.c_str());
+        return false;
+    }
+
+    // Renaming does not replace an existing file, so the card's copy
+    // steps aside first; it is only removed once the new one has its
+    // name, and goes back if the new one cannot take it
+    std::string oldPath = UnusedPath(this->filePath);
+    this->sdFile.close();
+    bool replaced = false;
+    bool restored = true;
+    if (SD.rename(this->filePath.c_str(), oldPath.c_str()))
+    {
+        replaced = SD.rename(copyPath.c_str(), this->filePath.c_str());
+        if (!replaced)
+            restored = SD.rename(oldPath.c_str(), this->filePath.c_str());
+    }
+    // Should the old copy not go back either, both stay on the card
+    if (replaced)
+        SD.remove(oldPath.c_str());
+    else if (restored)
+        SD.remove(copyPath.c_str());
+
+    // The descriptor stays open on whichever copy has the name; after a
+    // failure the changes are still waiting, for the next write-back
+    this->sdFile = SD.open(this->filePath.c_str(), "r+");
+    this->isOpen = this->sdFile ? true : false;
+    if (!replaced || !this->isOpen)
+        return false;
+    this->ranges.clear();
+    this->cardLength = this->length;
+    return true;
+}
+
+bool FileDescriptor::writeBack()
+{
+    if (!this->isDirty())
+        return true;
+
+    bool complete = true;
+    if (this->length < this->cardLength)
+    {
+        complete = this->rewrite();
+    }
+    else
+    {
+        // Each range goes over the bytes it changed, or at the end. The
+        // card's size may not count bytes still in its write buffer, so
+        // its new length comes from the ranges
+        for (auto it = this->ranges.begin(); it != this->ranges.end();)
+        {
+            const std::string& data = it->second;
+            if (!this->sdFile.seek(it->first) ||
+                this->sdFile.write(reinterpret_cast<const uint8_t*>(data.data()), data.size()) != data.size())
+            {
+                complete = false;
+                ++it;
+                continue;
+            }
+            this->cardLength = std::max(this->cardLength, it->first + data.size());
+            it = this->ranges.erase(it);
+        }
+    }
+
+    this->pending = 0;
+
+    // Pages read before hold the old contents
+    PageCache::instance().drop(this->file);
+
+    return complete;
+}
+
+int FileDescriptor::fsync()
+{
+    if (this->type != FDType::FILE)
+        return 0;
+
+    if (!this->isOpen || !this->sdFile)
+        return this->isDirty() ? -1 : 0;
+
+    bool complete = this->writeBack();
+    if (this->sdFile)
         this->sdFile.flush();
 
-        // Note: File object no longer stores content directly
-        // All content is managed through the FileDescriptor buffer
-        // and synchronized to SD card automatically
+    return complete ? 0 : -1;
+}
+
+void FileDescriptor::writeBackExpired()
+{
+    unsigned long now = millis();
+    for (FileDescriptor* fd : dtable)
+    {
+        if (fd->type == FDType::FILE && fd->isDirty() && now - fd->dirtySince >= WRITE_BACK_AGE)
+            fd->fsync();
     }
 }
 
+int FileDescriptor::syncAll()
+{
+    int failed = 0;
+    for (FileDescriptor* fd : dtable)
+    {
+        if (fd->fsync() != 0)
+            failed++;
+    }
+    return failed;
+}
+
 ssize_t FileDescriptor::read(void *buffer, size_t count, size_t nmemb)
 {
     if (!this->isOpen)
@@ -136,18 +375,11 @@ ssize_t FileDescriptor::read(void *buffer, size_t count, size_t nmemb)
         if (!this->sdFile)
             return -1;
 
-        size_t totalBytes = count * nmemb;
-        size_t bytesRead = 0;
-        char* charBuffer = static_cast<char*>(buffer);
-
-        // Read from SD file
-        while (bytesRead < totalBytes && this->sdFile.available())
-        {
-            charBuffer[bytesRead] = this->sdFile.read();
-            bytesRead++;
-        }
+        ssize_t bytesRead = this->readAt(this->position, buffer, count * nmemb);
+        if (bytesRead > 0)
+            this->position += bytesRead;
 
-        return static_cast<ssize_t>(bytesRead);
+        return bytesRead;
     }
 
     return -1;
@@ -171,40 +403,112 @@ ssize_t FileDescriptor::write(const void *buffer, size_t count)
 
     if (this->type == FDType::FILE)
     {
-        if (!(this->flags & (O_WRONLY | O_RDWR | O_APPEND)))
+        if (!IsWritable(this->flags))
             return -1;  // File not open for writing
 
-        const char* charBuffer = static_cast<const char*>(buffer);
-        std::string data(charBuffer, count);
+        // Appends go at the end wherever the position is
+        size_t offset = (this->flags & O_APPEND) ? this->length : this->position;
+        ssize_t written = this->writeAt(offset, buffer, count);
+        if (written >= 0)
+            this->position = offset + written;
 
-        // Add to internal buffer
-        if (this->flags & O_APPEND)
-        {
-            this->buffer += data;
-        }
-        else
-        {
-            // For write mode, replace buffer content
-            this->buffer = data;
-        }
+        return written;
+    }
 
-        // Write to SD file if available
-        if (this->sdFile)
-        {
-            size_t written = this->sdFile.write(static_cast<const uint8_t*>(buffer), count);
-            this->sdFile.flush();
+    return -1;
+}
 
-            return static_cast<ssize_t>(written);
-        }
+void FileDescriptor::markChanged()
+{
+    if (!this->isDirty())
+        this->dirtySince = millis();
+    if (this->file)
+        this->file->MarkDirty(espnix::FileSystemEntity::MODIFIED);
+}
 
-        return count;
+ssize_t FileDescriptor::writeAt(size_t offset, const void *buffer, size_t count)
+{
+    this->markChanged();
+    if (offset > this->length)
+        this->resize(offset);
+    this->stage(offset, static_cast<const char*>(buffer), count);
+    this->length = std::max(this->length, offset + count);
+    this->pending += count;
+
+    // The card sees the writes once enough of them have piled up. They
+    // are taken either way: a write-back that fails leaves them waiting,
+    // for fsync or close to report, so a caller retrying the write would
+    // only write them twice
+    if (this->pending >= WRITE_BACK_BYTES ||
+        millis() - this->dirtySince >= WRITE_BACK_AGE)
+    {
+        this->writeBack();
     }
 
-    return -1;
+    return count;
+}
+
+off_t FileDescriptor::lseek(off_t offset, int whence)
+{
+    if (!this->isOpen || this->type != FDType::FILE)
+        return -1;
+
+    off_t base;
+    if (whence == SEEK_SET)
+        base = 0;
+    else if (whence == SEEK_CUR)
+        base = static_cast<off_t>(this->position);
+    else if (whence == SEEK_END)
+        base = static_cast<off_t>(this->length);
+    else
+        return -1;
+
+    if (offset < -base)
+        return -1;
+
+    this->position = static_cast<size_t>(base + offset);
+    return static_cast<off_t>(this->position);
+}
+
+ssize_t FileDescriptor::pread(void *buffer, size_t count, off_t offset)
+{
+    if (!this->isOpen || this->type != FDType::FILE || !this->sdFile || offset < 0)
+        return -1;
+
+    return this->readAt(static_cast<size_t>(offset), buffer, count);
+}
+
+ssize_t FileDescriptor::pwrite(const void *buffer, size_t count, off_t offset)
+{
+    if (!this->isOpen || this->type != FDType::FILE || !IsWritable(this->flags) || offset < 0)
+        return -1;
+
+    // As with write, an append descriptor only ever adds to the end
+    size_t at = (this->flags & O_APPEND) ? this->length : static_cast<size_t>(offset);
+    return this->writeAt(at, buffer, count);
+}
+
+int FileDescriptor::ftruncate(off_t length)
+{
+    if (!this->isOpen || this->type != FDType::FILE || !IsWritable(this->flags) || length < 0)
+        return -1;
+
+    if (static_cast<size_t>(length) != this->length)
+    {
+        this->markChanged();
+        this->resize(static_cast<size_t>(length));
+    }
+
+    return 0;
 }
 
 void FileDescriptor::clearBuffer()
 {
+    if (this->type == FDType::FILE && this->ftruncate(0) == 0)
+    {
+        this->position = 0;
+    }
+
     this->buffer.clear();
 }
 
@@ -213,6 +517,14 @@ size_t FileDescriptor::bufferSize() const
     return this->buffer.size();
 }
 
+size_t FileDescriptor::size()
+{
+    if (this->type == FDType::FILE)
+        return this->length;
+
+    return this->buffer.size();
+}
+
 FileDescriptor::~FileDescriptor()
 {
     close();
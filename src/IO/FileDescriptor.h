@@ -1,6 +1,8 @@
 #ifndef FILE_DESCRIPTOR_IO_H
 #define FILE_DESCRIPTOR_IO_H
 
+#include <cstdio>
+#include <map>
 #include <vector>
 #include <string>
 #include <SD.h>
@@ -16,19 +18,38 @@ enum class FDType {
     DEVICE       // Device file
 };
 
+// Writes to a file are kept as the byte ranges they changed and reach the
+// SD card once enough of them are waiting or the oldest has waited long
+// enough, or when the file is synced or closed. Each range is written in
+// place over the card's copy or at its end. The card cannot cut a file
+// short in place, so a file that got shorter is copied out a page at a
+// time and the copy takes its place once complete.
 class FileDescriptor
 {
 public:
+    // Bytes written since the last write-back that send them to the card
+    static const size_t WRITE_BACK_BYTES = 4096;
+    // How long a write may wait for the card, in milliseconds
+    static const unsigned long WRITE_BACK_AGE = 1000;
+
     int descriptor;
     static std::vector<FileDescriptor*> dtable;
 
     FDType type;
-    std::string buffer;
+    std::string buffer;    // What was written to a standard descriptor
     std::string filePath;  // Path for file descriptors
     espnix::File* file;    // Associated file object
     File sdFile;       // SD card file handle
     bool isOpen;
     int flags;             // Open flags (read/write/append)
+    size_t position;       // Where the next read or write starts
+    size_t length;         // Bytes in the file, counting unwritten changes
+    size_t cardLength;     // Bytes in the card's copy
+    // Changes not on the card yet, by offset; ranges never overlap or
+    // touch, and together cover whatever lies past cardLength
+    std::map<size_t, std::string> ranges;
+    size_t pending;        // Bytes written since the last write-back
+    unsigned long dirtySince; // millis() of the oldest unwritten write
 
     FileDescriptor(int descriptor);
     FileDescriptor(espnix::File* file, const std::string& path, int flags = O_RDWR);
@@ -36,18 +57,63 @@ public:
     ssize_t read(void *buffer, size_t count, size_t nmemb = 1);
     ssize_t write(const void *buffer, size_t count);
 
+    // Random access on a file; the standard descriptors cannot seek and
+    // get -1
+    // Moves the position relative to SEEK_SET, SEEK_CUR or SEEK_END and
+    // returns it; it may go past the end, where a write leaves zeros
+    off_t lseek(off_t offset, int whence);
+    // Read and write at offset without using or moving the position
+    ssize_t pread(void *buffer, size_t count, off_t offset);
+    ssize_t pwrite(const void *buffer, size_t count, off_t offset);
+    // Cuts the file short or extends it with zeros. The file is never read
+    // in whole: the card cannot truncate in place, so a shorter file is
+    // copied over a page at a time at the next write-back
+    int ftruncate(off_t length);
+
     bool open();
-    void close();
-    void flush();
+    // Writes back what is waiting and closes the card's file; 0 on
+    // success, -1 if the card did not take all of it
+    int close();
+    // Puts every unwritten byte on the card and flushes it; 0 on success,
+    // -1 if the card did not take all of it
+    int fsync();
+    bool isDirty() const;
 
-    // Buffer management
+    // Writes back files whose oldest write has waited WRITE_BACK_AGE
+    static void writeBackExpired();
+    // fsync on every open file; the number that failed
+    static int syncAll();
+
+    // Buffer management; for a file, clearing empties it
     void clearBuffer();
     size_t bufferSize() const;
+    // Bytes in the file, or written to a standard descriptor
+    size_t size();
 
     FileDescriptor(const FileDescriptor &) = delete;
     FileDescriptor &operator=(const FileDescriptor &) = delete;
 
     ~FileDescriptor();
+
+private:
+    // Copies up to count bytes of the file at offset, unwritten changes
+    // included; returns the bytes copied, or -1 if the card could not
+    // supply its part
+    ssize_t readAt(size_t offset, void *buffer, size_t count);
+    // Records count bytes of data at offset as changed
+    void stage(size_t offset, const char *data, size_t count);
+    // Cuts the file short or fills it out with zeros
+    void resize(size_t newLength);
+    // Notes that the contents are about to change, for write-back and
+    // the next sync
+    void markChanged();
+    // Shared by write and pwrite
+    ssize_t writeAt(size_t offset, const void *buffer, size_t count);
+    // Sends the changed ranges to the card without flushing it
+    bool writeBack();
+    // Writes the file as it now reads to a copy beside it, which replaces
+    // the card's copy once it is complete
+    bool rewrite();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "PageCache.h"
+
+PageCache::PageCache()
+{
+    this->capacity = DEFAULT_BUDGET / PAGE_SIZE;
+    // Pages never move once the budget is reserved, so filling the cache
+    // does not copy it around or leave holes in the heap
+    this->pages.reserve(this->capacity);
+    this->newest = NONE;
+    this->oldest = NONE;
+    this->hitCount = 0;
+    this->missCount = 0;
+}
+
+PageCache& PageCache::instance()
+{
+    static PageCache cache;
+    return cache;
+}
+
+void PageCache::unlink(uint32_t page)
+{
+    Page& entry = this->pages[page];
+    if (entry.older != NONE)
+        this->pages[entry.older].newer = entry.newer;
+    else
+        this->oldest = entry.newer;
+    if (entry.newer != NONE)
+        this->pages[entry.newer].older = entry.older;
+    else
+        this->newest = entry.older;
+}
+
+void PageCache::pushNewest(uint32_t page)
+{
+    Page& entry = this->pages[page];
+    entry.older = this->newest;
+    entry.newer = NONE;
+    if (this->newest != NONE)
+        this->pages[this->newest].newer = page;
+    else
+        this->oldest = page;
+    this->newest = page;
+}
+
+void PageCache::release(uint32_t page)
+{
+    Page& entry = this->pages[page];
+    this->lookup.erase(Key{entry.file, entry.index});
+    this->unlink(page);
+    entry.file = nullptr;
+    this->freePages.push_back(page);
+}
+
+uint32_t PageCache::claim()
+{
+    if (!this->freePages.empty())
+    {
+        uint32_t page = this->freePages.back();
+        this->freePages.pop_back();
+        return page;
+    }
+
+    if (this->pages.size() < this->capacity)
+    {
+        this->pages.emplace_back();
+        return static_cast<uint32_t>(this->pages.size() - 1);
+    }
+
+    uint32_t page = this->oldest;
+    this->release(page);
+    this->freePages.pop_back();
+    return page;
+}
+
+PageCache::Page* PageCache::fetch(espnix::File* file, fs::File& source, uint32_t index)
+{
+    auto it = this->lookup.find(Key{file, index});
+    if (it != this->lookup.end())
+    {
+        this->hitCount++;
+        this->unlink(it->second);
+        this->pushNewest(it->second);
+        return &this->pages[it->second];
+    }
+
+    this->missCount++;
+    if (!source.seek(static_cast<uint32_t>(index) * PAGE_SIZE))
+    {
+        return nullptr;
+    }
+
+    uint32_t page = this->claim();
+    Page& entry = this->pages[page];
+    entry.length = 0;
+    while (entry.length < PAGE_SIZE)
+    {
+        size_t got = source.read(entry.data + entry.length, PAGE_SIZE - entry.length);
+        if (got == 0)
+            break;
+        entry.length += got;
+    }
+
+    if (entry.length == 0)
+    {
+        entry.file = nullptr;
+        this->freePages.push_back(page);
+        return nullptr;
+    }
+
+    entry.file = file;
+    entry.index = index;
+    this->lookup[Key{file, index}] = page;
+    this->pushNewest(page);
+    return &entry;
+}
+
+size_t PageCache::read(espnix::File* file, fs::File& source, size_t offset, void* buffer, size_t count)
+{
+    uint8_t* out = static_cast<uint8_t*>(buffer);
+    size_t copied = 0;
+
+    while (copied < count)
+    {
+        size_t position = offset + copied;
+        Page* page = this->fetch(file, source, static_cast<uint32_t>(position / PAGE_SIZE));
+        size_t within = position % PAGE_SIZE;
+        if (page == nullptr || within >= page->length)
+            break;
+
+        size_t chunk = std::min(count - copied, page->length - within);
+        memcpy(out + copied, page->data + within, chunk);
+        copied += chunk;
+
+        // A short page is the last one of the file
+        if (page->length < PAGE_SIZE)
+            break;
+    }
+
+    return copied;
+}
+
+void PageCache::drop(const espnix::File* file)
+{
+    for (uint32_t page = 0; page < this->pages.size(); page++)
+    {
+        if (this->pages[page].file == file)
+            this->release(page);
+    }
+}
+
+void PageCache::setBudget(size_t bytes)
+{
+    // Without a page to fill, nothing could be read at all
+    if (bytes < PAGE_SIZE)
+    {
+        throw std::invalid_argument("Page cache budget is smaller than a page");
+    }
+
+    size_t capacity = bytes / PAGE_SIZE;
+    if (capacity < this->pages.capacity())
+    {
+        this->pages.clear();
+        this->pages.shrink_to_fit();
+        this->freePages.clear();
+        this->lookup.clear();
+        this->newest = NONE;
+        this->oldest = NONE;
+    }
+    this->capacity = capacity;
+    this->pages.reserve(capacity);
+}
+
+size_t PageCache::budget() const
+{
+    return this->capacity * PAGE_SIZE;
+}
+
+uint32_t PageCache::hits() const
+{
+    return this->hitCount;
+}
+
+uint32_t PageCache::misses() const
+{
+    return this->missCount;
+}
@@ -0,0 +1,99 @@
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include <SD.h>
+
+namespace espnix {
+    class File;
+}
+
+// Fixed-size pieces of file contents, shared by every descriptor so a file
+// read twice is fetched from the SD card once. Pages are keyed by the file
+// and their offset in it; the cache never holds more than its budget and
+// recycles the least recently used page when it needs room.
+class PageCache
+{
+public:
+    static const size_t PAGE_SIZE = 1024;
+    static const size_t DEFAULT_BUDGET = 32 * 1024;
+
+private:
+    static const uint32_t NONE = UINT32_MAX;
+
+    struct Page
+    {
+        espnix::File* file;     // nullptr while the page is free
+        uint32_t index;         // Offset in the file / PAGE_SIZE
+        size_t length;          // Bytes of the file it holds
+        uint32_t older;         // Neighbours in use order, NONE at the ends
+        uint32_t newer;
+        uint8_t data[PAGE_SIZE];
+    };
+
+    struct Key
+    {
+        const espnix::File* file;
+        uint32_t index;
+
+        bool operator==(const Key& other) const
+        {
+            return file == other.file && index == other.index;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            return std::hash<const void*>()(key.file) ^ (key.index * 2654435761u);
+        }
+    };
+
+    std::vector<Page> pages;
+    std::vector<uint32_t> freePages;
+    std::unordered_map<Key, uint32_t, KeyHash> lookup;
+    size_t capacity;        // Pages the budget allows
+    uint32_t newest;
+    uint32_t oldest;
+    uint32_t hitCount;
+    uint32_t missCount;
+
+    PageCache();
+
+    void unlink(uint32_t page);
+    void pushNewest(uint32_t page);
+    void release(uint32_t page);
+    // A page to fill: a free one, a new one while under budget, or the
+    // least recently used
+    uint32_t claim();
+    // The page, read from source if it is not cached; nullptr past the end
+    // of the file
+    Page* fetch(espnix::File* file, fs::File& source, uint32_t index);
+
+public:
+    static PageCache& instance();
+
+    // Copies up to count bytes of the file at offset, reading pages missing
+    // from the cache through source; returns the bytes copied
+    size_t read(espnix::File* file, fs::File& source, size_t offset, void* buffer, size_t count);
+    // Forgets the file's pages, after it changed on the card or went away
+    void drop(const espnix::File* file);
+
+    // Bytes the cache may hold, at least PAGE_SIZE; shrinking it drops
+    // every page
+    void setBudget(size_t bytes);
+    size_t budget() const;
+
+    uint32_t hits() const;
+    uint32_t misses() const;
+
+    PageCache(const PageCache&) = delete;
+    PageCache& operator=(const PageCache&) = delete;
+};
+
+#endif
@@ -0,0 +1,193 @@
+#include "Arena.h"
+#include <cstdio>
+#include <new>
+
+// Every block is aligned for any type
+static const size_t ALIGNMENT = alignof(std::max_align_t);
+static const size_t HEADER_SIZE = (sizeof(void*) * 2 + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+static const size_t SMALLEST_BLOCK = 16;
+
+// Size class of a block: 0 for up to 16 bytes, 1 for up to 32 and so on
+static int sizeClass(size_t size) {
+    int index = 0;
+    while ((SMALLEST_BLOCK << index) < size) index++;
+    return index;
+}
+
+// Size of a block too large for a size class, in whole smallest blocks
+static size_t rangeSize(size_t size) {
+    return (size + SMALLEST_BLOCK - 1) & ~(SMALLEST_BLOCK - 1);
+}
+
+Arena* Arena::current = nullptr;
+
+Arena::Scope::Scope(Arena& arena) : previous(current) {
+    current = &arena;
+}
+
+Arena::Scope::~Scope() {
+    current = previous;
+}
+
+Arena::Arena() : chunks(nullptr), cursor(nullptr), limit(nullptr), reservedBytes(0), freeRanges(nullptr) {
+    for (int i = 0; i < SIZE_CLASSES; i++) freeBlocks[i] = nullptr;
+}
+
+Arena::~Arena() {
+    release();
+}
+
+Arena::Chunk* Arena::newChunk(size_t size) {
+    Chunk* chunk = static_cast<Chunk*>(::operator new(HEADER_SIZE + size));
+    chunk->size = size;
+    reservedBytes += HEADER_SIZE + size;
+    return chunk;
+}
+
+// Cuts a block from the smallest free range that holds it, leaving the
+// rest free
+void* Arena::takeRange(size_t size) {
+    FreeRange** best = nullptr;
+    for (FreeRange** link = &freeRanges; *link; link = &(*link)->next) {
+        if ((*link)->size >= size && (!best || (*link)->size < (*best)->size)) best = link;
+    }
+    if (!best) return nullptr;
+
+    FreeRange* range = *best;
+    *best = range->next;
+    uint8_t* start = reinterpret_cast<uint8_t*>(range);
+    if (range->size > size) freeRange(start + size, range->size - size);
+    return start;
+}
+
+// Puts memory back on the free lists. Pieces too small to be a range go to
+// the size classes; a range is merged with the free ranges either side.
+void Arena::freeRange(uint8_t* start, size_t size) {
+    if (size <= (SMALLEST_BLOCK << (SIZE_CLASSES - 1))) {
+        for (int index = SIZE_CLASSES - 1; index >= 0; index--) {
+            size_t blockSize = SMALLEST_BLOCK << index;
+            if (size & blockSize) {
+                FreeBlock* block = reinterpret_cast<FreeBlock*>(start);
+                block->next = freeBlocks[index];
+                freeBlocks[index] = block;
+                start += blockSize;
+            }
+        }
+        return;
+    }
+
+    FreeRange* previous = nullptr;
+    FreeRange* next = freeRanges;
+    while (next && reinterpret_cast<uint8_t*>(next) < start) {
+        previous = next;
+        next = next->next;
+    }
+    if (next && start + size == reinterpret_cast<uint8_t*>(next)) {
+        size += next->size;
+        next = next->next;
+    }
+    if (previous && reinterpret_cast<uint8_t*>(previous) + previous->size == start) {
+        previous->size += size;
+        previous->next = next;
+        return;
+    }
+
+    FreeRange* range = reinterpret_cast<FreeRange*>(start);
+    range->next = next;
+    range->size = size;
+    if (previous) previous->next = range;
+    else freeRanges = range;
+}
+
+void* Arena::allocate(size_t size) {
+    bool small = size <= (SMALLEST_BLOCK << (SIZE_CLASSES - 1));
+    int index = small ? sizeClass(size) : SIZE_CLASSES;
+    if (small && freeBlocks[index]) {
+        FreeBlock* block = freeBlocks[index];
+        freeBlocks[index] = block->next;
+        return block;
+    }
+
+    size_t blockSize = small ? SMALLEST_BLOCK << index : rangeSize(size);
+    bool fits = cursor && blockSize <= static_cast<size_t>(limit - cursor);
+    if (!small || !fits) {
+        void* block = takeRange(blockSize);
+        if (block) return block;
+    }
+
+    // Blocks bigger than a chunk get a chunk of their own behind the one
+    // being bumped, so they neither waste its tail nor end it early
+    if (blockSize > CHUNK_SIZE) {
+        Chunk* chunk = newChunk(blockSize);
+        if (chunks) {
+            chunk->next = chunks->next;
+            chunks->next = chunk;
+        } else {
+            chunk->next = nullptr;
+            chunks = chunk;
+        }
+        return reinterpret_cast<uint8_t*>(chunk) + HEADER_SIZE;
+    }
+
+    if (!fits) {
+        // The old chunk's tail stays usable
+        if (cursor) freeRange(cursor, limit - cursor);
+        Chunk* chunk = newChunk(CHUNK_SIZE);
+        chunk->next = chunks;
+        chunks = chunk;
+        cursor = reinterpret_cast<uint8_t*>(chunk) + HEADER_SIZE;
+        limit = cursor + CHUNK_SIZE;
+    }
+
+    void* block = cursor;
+    cursor += blockSize;
+    return block;
+}
+
+void Arena::deallocate(void* pointer, size_t size) {
+    if (!pointer) return;
+    if (size > (SMALLEST_BLOCK << (SIZE_CLASSES - 1))) {
+        freeRange(static_cast<uint8_t*>(pointer), rangeSize(size));
+        return;
+    }
+
+    int index = sizeClass(size);
+    FreeBlock* block = static_cast<FreeBlock*>(pointer);
+    block->next = freeBlocks[index];
+    freeBlocks[index] = block;
+}
+
+void Arena::release() {
+    while (chunks) {
+        Chunk* next = chunks->next;
+        ::operator delete(chunks);
+        chunks = next;
+    }
+    cursor = limit = nullptr;
+    reservedBytes = 0;
+    freeRanges = nullptr;
+    for (int i = 0; i < SIZE_CLASSES; i++) freeBlocks[i] = nullptr;
+}
+
+size_t Arena::reserved() const {
+    return reservedBytes;
+}
+
+Arena* Arena::active() {
+    return current;
+}
+
+size_t ArenaStringHash::operator()(const ArenaString& str) const {
+    uint32_t hash = 2166136261u;
+    for (char c : str) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+ArenaString arenaNumber(long value) {
+    char digits[24];
+    snprintf(digits, sizeof(digits), "%ld", value);
+    return ArenaString(digits);
+}
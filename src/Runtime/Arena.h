@@ -0,0 +1,147 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// Region allocator for everything one compile or run allocates. Memory
+// comes from a few large chunks instead of many small heap blocks, and all
+// of it goes back to the heap at once when the arena is released, so a
+// command leaves no holes behind in the heap however much it allocated.
+// Small blocks are rounded up to a power of two and freed ones are kept on
+// a list per size, so containers that churn (set copies, rebuilt strings)
+// reuse their memory instead of growing the arena. Larger blocks (a
+// growing stack, code or array) come from the arena too: freed ones are
+// kept in address order and merged with their free neighbours, and a
+// later block of any size is cut from the best fitting one. Blocks bigger
+// than a chunk get a chunk of their own, which is kept the same way until
+// the arena is released.
+class Arena {
+private:
+    static const size_t CHUNK_SIZE = 2048;
+    static const int SIZE_CLASSES = 6;      // 16 to 512 bytes
+
+    struct Chunk {
+        Chunk* next;
+        size_t size;        // Usable bytes following the header
+    };
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct FreeRange {
+        FreeRange* next;
+        size_t size;
+    };
+
+    Chunk* chunks;          // Most recent first; the first is being bumped
+    uint8_t* cursor;
+    uint8_t* limit;
+    size_t reservedBytes;
+    FreeBlock* freeBlocks[SIZE_CLASSES];
+    FreeRange* freeRanges;  // Free memory too large for a size class, by address
+
+    // One for the whole program: commands run one at a time on the loop
+    // task, and a Scope opened inside another restores the outer arena
+    // when it ends
+    static Arena* current;
+
+    Chunk* newChunk(size_t size);
+    void* takeRange(size_t size);
+    void freeRange(uint8_t* start, size_t size);
+
+public:
+    // Makes an arena the one containers created from now on allocate
+    // from, until the scope ends. Only the loop task may open one.
+    class Scope {
+    private:
+        Arena* previous;
+
+    public:
+        explicit Scope(Arena& arena);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    Arena();
+    ~Arena();
+
+    void* allocate(size_t size);
+    // The block is kept for reuse by later allocations; only release
+    // gives memory back to the heap
+    void deallocate(void* pointer, size_t size);
+    // Returns every chunk to the heap
+    void release();
+
+    // Heap bytes the arena holds
+    size_t reserved() const;
+
+    // Arena of the innermost Scope, or nullptr outside any
+    static Arena* active();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+};
+
+// Standard allocator over the arena active when it is created, or the
+// heap if there is none. Containers remember their arena, so they must
+// go away before it is released.
+template <class T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    Arena* arena;
+
+    ArenaAllocator() : arena(Arena::active()) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) {
+        size_t size = count * sizeof(T);
+        return static_cast<T*>(arena ? arena->allocate(size) : ::operator new(size));
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        if (arena) arena->deallocate(pointer, count * sizeof(T));
+        else ::operator delete(pointer);
+    }
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena; }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena != b.arena; }
+
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+struct ArenaStringHash {
+    size_t operator()(const ArenaString& str) const;
+};
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+template <class T>
+using ArenaSet = std::set<T, std::less<T>, ArenaAllocator<T>>;
+template <class K, class V>
+using ArenaMap = std::map<K, V, std::less<K>, ArenaAllocator<std::pair<const K, V>>>;
+template <class V>
+using ArenaStringMap = std::unordered_map<ArenaString, V, ArenaStringHash, std::equal_to<ArenaString>,
+                                          ArenaAllocator<std::pair<const ArenaString, V>>>;
+
+// Decimal form of value, like std::to_string
+ArenaString arenaNumber(long value);
+
+#endif
@@ -0,0 +1,70 @@
+// The firmware is built with -Os, which disables loop vectorization and
+// unrolling. These kernels are small and hot, so opt them back in.
+#pragma GCC optimize("O3")
+
+#include "ArrayKernels.h"
+#include <cstddef>
+#include <cstdint>
+
+void arrayFill(int32_t* __restrict dst, size_t count, int32_t value) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = value;
+    }
+}
+
+void arrayCopy(int32_t* __restrict dst, const int32_t* __restrict src, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+int32_t arraySum(const int32_t* __restrict src, size_t count) {
+    // Unsigned accumulation gives two's complement wraparound without UB
+    uint32_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += static_cast<uint32_t>(src[i]);
+    }
+    return static_cast<int32_t>(total);
+}
+
+int32_t arrayMin(const int32_t* __restrict src, size_t count) {
+    int32_t result = src[0];
+    for (size_t i = 1; i < count; i++) {
+        result = src[i] < result ? src[i] : result;
+    }
+    return result;
+}
+
+int32_t arrayMax(const int32_t* __restrict src, size_t count) {
+    int32_t result = src[0];
+    for (size_t i = 1; i < count; i++) {
+        result = src[i] > result ? src[i] : result;
+    }
+    return result;
+}
+
+int32_t arrayDot(const int32_t* __restrict a, const int32_t* __restrict b, size_t count) {
+    uint32_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += static_cast<uint32_t>(a[i]) * static_cast<uint32_t>(b[i]);
+    }
+    return static_cast<int32_t>(total);
+}
+
+int32_t arrayFind(const int32_t* __restrict src, size_t count, int32_t value) {
+    // Test whole blocks branch-free, only scan element by element inside
+    // the block that actually contains a match.
+    const size_t block = 16;
+    size_t i = 0;
+    for (; i + block <= count; i += block) {
+        int32_t hit = 0;
+        for (size_t j = 0; j < block; j++) {
+            hit |= src[i + j] == value;
+        }
+        if (hit) break;
+    }
+    for (; i < count; i++) {
+        if (src[i] == value) return static_cast<int32_t>(i);
+    }
+    return -1;
+}
@@ -0,0 +1,19 @@
+#ifndef ARRAYKERNELS_H
+#define ARRAYKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Bulk operations over contiguous int32 storage used by the array builtins.
+// Each kernel is a single flat loop with no calls or bounds checks inside,
+// so the compiler can unroll and vectorize it. Arithmetic wraps like the
+// scalar VM opcodes do on the target.
+void arrayFill(int32_t* dst, size_t count, int32_t value);
+void arrayCopy(int32_t* dst, const int32_t* src, size_t count);
+int32_t arraySum(const int32_t* src, size_t count);
+int32_t arrayMin(const int32_t* src, size_t count);
+int32_t arrayMax(const int32_t* src, size_t count);
+int32_t arrayDot(const int32_t* a, const int32_t* b, size_t count);
+int32_t arrayFind(const int32_t* src, size_t count, int32_t value);
+
+#endif
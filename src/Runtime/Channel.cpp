@@ -0,0 +1,60 @@
+#include "Channel.h"
+#include <stdexcept>
+#include <string>
+
+Channel::Channel() : head(0), tail(0), sender(nullptr), receiver(nullptr) {}
+
+bool Channel::trySend(const void* program, int32_t value) {
+    if (sender != program) {
+        if (sender != nullptr) {
+            throw std::runtime_error("Channel already has another sender");
+        }
+        sender = program;
+    }
+    if (slots.empty()) {
+        slots.assign(CHANNEL_CAPACITY, 0);
+    }
+
+    // Indices run freely and wrap; their difference is the fill level
+    uint32_t back = tail.load(std::memory_order_relaxed);
+    if (back - head.load(std::memory_order_acquire) == CHANNEL_CAPACITY) {
+        return false;
+    }
+    slots[back & (CHANNEL_CAPACITY - 1)] = value;
+    tail.store(back + 1, std::memory_order_release);
+    return true;
+}
+
+bool Channel::tryReceive(const void* program, int32_t& value) {
+    if (receiver != program) {
+        if (receiver != nullptr) {
+            throw std::runtime_error("Channel already has another receiver");
+        }
+        receiver = program;
+    }
+
+    uint32_t front = head.load(std::memory_order_relaxed);
+    if (front == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    value = slots[front & (CHANNEL_CAPACITY - 1)];
+    head.store(front + 1, std::memory_order_release);
+    return true;
+}
+
+ChannelSet::ChannelSet() : transfers(0) {}
+
+Channel& ChannelSet::get(int32_t id) {
+    if (id < 0 || static_cast<size_t>(id) >= MAX_CHANNELS) {
+        throw std::runtime_error("Invalid channel: " + std::to_string(id));
+    }
+    return channels[id];
+}
+
+void ChannelSet::transferred() {
+    transfers++;
+}
+
+uint32_t ChannelSet::transferCount() const {
+    return transfers;
+}
@@ -0,0 +1,58 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "Arena.h"
+
+// Channels programs run side by side can talk over, numbered from 0
+const size_t MAX_CHANNELS = 16;
+// Messages a channel buffers before a sender has to wait
+const size_t CHANNEL_CAPACITY = 64;
+
+// Bounded queue of integers from one program to another. It is a
+// single-producer, single-consumer ring: only the sender moves tail and
+// only the receiver moves head, so neither takes a lock, and the
+// acquire/release pairs publish a slot's contents together with the index
+// that hands it over. The ring is allocated on first use.
+class Channel {
+private:
+    ArenaVector<int32_t> slots;
+    std::atomic<uint32_t> head;     // Next slot to receive from
+    std::atomic<uint32_t> tail;     // Next slot to send into
+    // The one program that may send and the one that may receive, bound
+    // by their first operation; a second of either would break the ring
+    const void* sender;
+    const void* receiver;
+
+public:
+    Channel();
+
+    // False if the channel is full
+    bool trySend(const void* program, int32_t value);
+    // False if the channel is empty
+    bool tryReceive(const void* program, int32_t& value);
+
+    Channel(const Channel&) = delete;
+    Channel& operator=(const Channel&) = delete;
+};
+
+// The channels of one run, shared by every program in it
+class ChannelSet {
+private:
+    Channel channels[MAX_CHANNELS];
+    uint32_t transfers;     // Messages sent or received so far
+
+public:
+    ChannelSet();
+
+    // Throws for a number outside 0..MAX_CHANNELS-1
+    Channel& get(int32_t id);
+    // Counts a completed send or receive, so a scheduler can tell when
+    // a round left every channel as it was
+    void transferred();
+    uint32_t transferCount() const;
+};
+
+#endif
@@ -0,0 +1,362 @@
+#include "CodeGenerator.h"
+#include "VirtualMachine.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <utility>
+
+CodeGenerator::CodeGenerator(ControlFlowGraph& cfg, ArenaVector<uint8_t>& out)
+    : graph(cfg), code(out) {}
+
+void CodeGenerator::emit(uint8_t byte) {
+    code.push_back(byte);
+}
+
+void CodeGenerator::emitInt32(int32_t value) {
+    code.push_back(value & 0xFF);
+    code.push_back((value >> 8) & 0xFF);
+    code.push_back((value >> 16) & 0xFF);
+    code.push_back((value >> 24) & 0xFF);
+}
+
+void CodeGenerator::emitString(const ArenaString& str) {
+    size_t len = str.size();
+    if (len > 255) len = 255;
+    code.push_back(static_cast<uint8_t>(len));
+    for (size_t i = 0; i < len; i++) {
+        code.push_back(static_cast<uint8_t>(str[i]));
+    }
+}
+
+void CodeGenerator::emitAddress(int block) {
+    Fixup fixup;
+    fixup.position = code.size();
+    fixup.block = graph.resolve(block);
+    fixups.push_back(fixup);
+    emitInt32(0);
+}
+
+void CodeGenerator::emitJump(uint8_t opcode, int block) {
+    emit(opcode);
+    emitAddress(block);
+}
+
+static ArenaString spillSlot(int temp) {
+    return "$s" + arenaNumber(temp);
+}
+
+void CodeGenerator::countUses() {
+    uses.assign(graph.tempCount, 0);
+    for (const BasicBlock& block : graph.blocks) {
+        for (const Instr& instr : block.instrs) {
+            for (int operand : instr.operands) uses[operand]++;
+        }
+        if (block.term.kind == TermKind::BRANCH || block.term.kind == TermKind::SWITCH) {
+            uses[block.term.operand]++;
+        }
+    }
+}
+
+// Decide which single-use temporaries can stay on the stack. Instructions
+// are emitted in order, so a temporary can only stay if it is exactly
+// where its user expects it; anything that is not gets spilled and the
+// check starts over until it holds everywhere.
+void CodeGenerator::assignStackSlots(const BasicBlock& block) {
+    for (const Instr& instr : block.instrs) {
+        if (instr.dest >= 0) onStack[instr.dest] = uses[instr.dest] == 1;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        ArenaVector<int> stack;
+
+        for (size_t i = 0; i <= block.instrs.size() && !changed; i++) {
+            ArenaVector<int> operands;
+            int dest = -1;
+            if (i < block.instrs.size()) {
+                operands = block.instrs[i].operands;
+                dest = block.instrs[i].dest;
+            } else if (block.term.kind == TermKind::BRANCH || block.term.kind == TermKind::SWITCH) {
+                operands.push_back(block.term.operand);
+            }
+
+            // Stacked operands must come first and sit on top in order;
+            // spilled ones are loaded above them
+            size_t stacked = 0;
+            while (stacked < operands.size() && onStack[operands[stacked]]) stacked++;
+            bool valid = stacked <= stack.size();
+            for (size_t j = stacked; j < operands.size() && valid; j++) {
+                if (onStack[operands[j]]) valid = false;
+            }
+            for (size_t j = 0; j < stacked && valid; j++) {
+                if (stack[stack.size() - stacked + j] != operands[j]) valid = false;
+            }
+
+            if (!valid) {
+                for (int operand : operands) onStack[operand] = false;
+                for (int temp : stack) onStack[temp] = false;
+                changed = true;
+                break;
+            }
+
+            stack.resize(stack.size() - stacked);
+            if (dest >= 0 && onStack[dest]) stack.push_back(dest);
+        }
+    }
+}
+
+void CodeGenerator::useOperand(int temp) {
+    if (!onStack[temp]) {
+        emit(OP_LOAD);
+        emitString(spillSlot(temp));
+    }
+}
+
+void CodeGenerator::defineTemp(int temp) {
+    if (temp < 0 || onStack[temp]) return;
+    if (uses[temp] > 0) {
+        emit(OP_STORE);
+        emitString(spillSlot(temp));
+    }
+    emit(OP_POP);
+}
+
+void CodeGenerator::generate() {
+    countUses();
+    onStack.assign(graph.tempCount, false);
+
+    // Lay out reachable blocks in layout order, leaving out pure jumps;
+    // coroutine bodies are reached through their creation
+    ArenaVector<bool> reachable(graph.blocks.size(), false);
+    ArenaVector<int> pending(1, 0);
+    reachable[0] = true;
+    for (int entry : graph.coroutineEntries) {
+        entry = graph.resolve(entry);
+        if (!reachable[entry]) {
+            reachable[entry] = true;
+            pending.push_back(entry);
+        }
+    }
+    while (!pending.empty()) {
+        int block = pending.back();
+        pending.pop_back();
+        for (int target : graph.blocks[block].term.targets) {
+            target = graph.resolve(target);
+            if (!reachable[target]) {
+                reachable[target] = true;
+                pending.push_back(target);
+            }
+        }
+    }
+
+    ArenaVector<int> layout;
+    for (size_t i = 0; i < graph.blocks.size(); i++) {
+        int b = graph.layout.empty() ? static_cast<int>(i) : graph.layout[i];
+        if (reachable[b]) layout.push_back(b);
+    }
+
+    addresses.assign(graph.blocks.size(), 0);
+    for (size_t i = 0; i < layout.size(); i++) {
+        const BasicBlock& block = graph.blocks[layout[i]];
+        addresses[layout[i]] = code.size();
+        assignStackSlots(block);
+        for (const Instr& instr : block.instrs) {
+            instruction(instr);
+        }
+        terminator(layout[i], i + 1 < layout.size() ? layout[i + 1] : -1);
+    }
+
+    for (const Fixup& fixup : fixups) {
+        int32_t target = static_cast<int32_t>(addresses[fixup.block]);
+        code[fixup.position] = target & 0xFF;
+        code[fixup.position + 1] = (target >> 8) & 0xFF;
+        code[fixup.position + 2] = (target >> 16) & 0xFF;
+        code[fixup.position + 3] = (target >> 24) & 0xFF;
+    }
+}
+
+void CodeGenerator::instruction(const Instr& instr) {
+    for (int operand : instr.operands) {
+        useOperand(operand);
+    }
+
+    switch (instr.kind) {
+        case InstrKind::CONST:
+            emit(OP_PUSH);
+            emitInt32(instr.value);
+            break;
+
+        case InstrKind::LOAD:
+            emit(OP_LOAD);
+            emitString(instr.name);
+            break;
+
+        case InstrKind::STORE:
+            emit(OP_STORE);
+            emitString(instr.name);
+            emit(OP_POP);
+            break;
+
+        case InstrKind::INC:
+            emit(OP_INC);
+            emitString(instr.name);
+            emitInt32(instr.value);
+            break;
+
+        case InstrKind::UNARY:
+        case InstrKind::BINARY:
+            emit(instr.op);
+            break;
+
+        case InstrKind::BINARY_IMM:
+            switch (instr.op) {
+                case OP_ADD:
+                    emit(OP_ADD_CONST);
+                    emitInt32(instr.value);
+                    break;
+                case OP_BIT_AND:
+                    emit(OP_AND_CONST);
+                    emitInt32(instr.value);
+                    break;
+                case OP_SHL:
+                case OP_SHR:
+                    emit(instr.op == OP_SHL ? OP_SHL_CONST : OP_SHR_CONST);
+                    emit(static_cast<uint8_t>(instr.value));
+                    break;
+                default:
+                    emit(instr.op);
+                    emit(static_cast<uint8_t>(instr.value));
+                    break;
+            }
+            break;
+
+        case InstrKind::INDEX_GET:
+            emit(instr.unchecked ? OP_INDEX_GET_UNCHECKED : OP_INDEX_GET);
+            break;
+
+        case InstrKind::INDEX_SET:
+            emit(instr.unchecked ? OP_INDEX_SET_UNCHECKED : OP_INDEX_SET);
+            break;
+
+        case InstrKind::NEW_ARRAY:
+            emit(OP_NEW_ARRAY);
+            break;
+
+        case InstrKind::CALL:
+            emit(OP_CALL_NATIVE);
+            emit(instr.op);
+            emit(static_cast<uint8_t>(instr.operands.size()));
+            break;
+
+        case InstrKind::PRINT:
+            emit(OP_PRINT);
+            break;
+
+        case InstrKind::SLEEP:
+            emit(OP_SLEEP);
+            break;
+
+        case InstrKind::STRING:
+            emit(OP_PUSH_STRING);
+            emitString(instr.name);
+            break;
+
+        case InstrKind::NEW_COROUTINE:
+            emitJump(OP_NEW_COROUTINE, instr.value);
+            break;
+
+        case InstrKind::RESUME:
+            emit(OP_RESUME);
+            break;
+
+        case InstrKind::YIELD:
+            emit(OP_YIELD);
+            break;
+    }
+
+    defineTemp(instr.dest);
+}
+
+const ArenaVector<CodeGenerator::BranchSite>& CodeGenerator::branchSites() const {
+    return branches;
+}
+
+void CodeGenerator::terminator(int block, int next) {
+    const Terminator& term = graph.blocks[block].term;
+
+    switch (term.kind) {
+        case TermKind::JUMP:
+            if (graph.resolve(term.targets[0]) != next) {
+                emitJump(OP_JMP, term.targets[0]);
+            }
+            break;
+
+        case TermKind::BRANCH: {
+            useOperand(term.operand);
+            int onTrue = graph.resolve(term.targets[0]);
+            int onFalse = graph.resolve(term.targets[1]);
+            BranchSite site;
+            site.address = static_cast<uint32_t>(code.size());
+            site.block = block;
+            site.jumpsOnTrue = onTrue != next && onFalse == next;
+            branches.push_back(site);
+            if (onTrue == next) {
+                emitJump(OP_JMP_NOT, onFalse);
+            } else if (onFalse == next) {
+                emitJump(OP_JMP_IF, onTrue);
+            } else {
+                emitJump(OP_JMP_NOT, onFalse);
+                emitJump(OP_JMP, onTrue);
+            }
+            break;
+        }
+
+        case TermKind::SWITCH: {
+            useOperand(term.operand);
+            ArenaVector<std::pair<int32_t, int>> sorted;
+            for (size_t i = 0; i < term.cases.size(); i++) {
+                sorted.push_back(std::make_pair(term.cases[i], term.targets[i + 1]));
+            }
+            std::sort(sorted.begin(), sorted.end());
+            int defaultTarget = term.targets[0];
+
+            // Dense case sets get a direct jump table, sparse ones a sorted
+            // table searched by bisection
+            size_t count = sorted.size();
+            int64_t range = count ? static_cast<int64_t>(sorted.back().first) - sorted.front().first + 1 : 0;
+            if (count >= 3 && range <= static_cast<int64_t>(count) * 2) {
+                emit(OP_TABLESWITCH);
+                emitInt32(sorted.front().first);
+                emitInt32(static_cast<int32_t>(range));
+                emitAddress(defaultTarget);
+                size_t slot = 0;
+                for (int64_t value = sorted.front().first; value <= sorted.back().first; value++) {
+                    if (sorted[slot].first == value) {
+                        emitAddress(sorted[slot].second);
+                        slot++;
+                    } else {
+                        emitAddress(defaultTarget);
+                    }
+                }
+            } else {
+                emit(OP_LOOKUPSWITCH);
+                emitInt32(static_cast<int32_t>(count));
+                emitAddress(defaultTarget);
+                for (size_t i = 0; i < count; i++) {
+                    emitInt32(sorted[i].first);
+                    emitAddress(sorted[i].second);
+                }
+            }
+            break;
+        }
+
+        case TermKind::HALT:
+            emit(OP_HALT);
+            break;
+
+        case TermKind::FINISH:
+            emit(OP_END_COROUTINE);
+            break;
+    }
+}
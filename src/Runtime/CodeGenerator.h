@@ -0,0 +1,55 @@
+#ifndef CODEGENERATOR_H
+#define CODEGENERATOR_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "ControlFlowGraph.h"
+
+// Emits bytecode for a ControlFlowGraph. Temporaries live on the VM stack
+// when they are used once in stack order; any other temporary is spilled
+// to a hidden variable and loaded back at each use.
+class CodeGenerator {
+public:
+    // Where a BRANCH block's conditional jump ended up
+    struct BranchSite {
+        uint32_t address;
+        int block;
+        bool jumpsOnTrue;   // OP_JMP_IF; otherwise OP_JMP_NOT
+    };
+
+private:
+    struct Fixup {
+        size_t position;
+        int block;
+    };
+
+    ControlFlowGraph& graph;
+    ArenaVector<uint8_t>& code;
+    ArenaVector<size_t> addresses;  // Bytecode address of each emitted block
+    ArenaVector<Fixup> fixups;
+    ArenaVector<int> uses;          // Number of uses of each temporary
+    ArenaVector<bool> onStack;      // Temporary is left on the VM stack for its use
+    ArenaVector<BranchSite> branches;
+
+    void emit(uint8_t byte);
+    void emitInt32(int32_t value);
+    void emitString(const ArenaString& str);
+    void emitAddress(int block);
+    void emitJump(uint8_t opcode, int block);
+
+    void countUses();
+    void assignStackSlots(const BasicBlock& block);
+    void useOperand(int temp);
+    void defineTemp(int temp);
+    void instruction(const Instr& instr);
+    void terminator(int block, int next);
+
+public:
+    CodeGenerator(ControlFlowGraph& cfg, ArenaVector<uint8_t>& out);
+    void generate();
+
+    const ArenaVector<BranchSite>& branchSites() const;
+};
+
+#endif
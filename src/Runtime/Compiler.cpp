@@ -1,10 +1,26 @@
 #include "Compiler.h"
 #include "VirtualMachine.h"
 #include "Lexer.h"
+#include "Natives.h"
+#include "Optimizer.h"
+#include "CodeGenerator.h"
 #include <vector>
+#include <string>
+#include <stdexcept>
 
-Compiler::Compiler(std::vector<Token>& toks)
-    : tokens(toks), pos(0), labelCount(0), jumpCount(0), labelCounter(0) {}
+Compiler::Compiler(ArenaVector<Token>& toks)
+    : tokens(toks), pos(0), optimize(true), useProfile(false),
+      profileChecksum(0), fixedArrayCount(0), coroutineDepth(0) {}
+
+void Compiler::setOptimize(bool enabled) {
+    optimize = enabled;
+}
+
+void Compiler::setProfile(const BranchProfile& counts, uint32_t checksum) {
+    profile = counts;
+    profileChecksum = checksum;
+    useProfile = true;
+}
 
 Token& Compiler::current() {
     return tokens[pos];
@@ -27,317 +43,561 @@ bool Compiler::match(TokenType type) {
     return false;
 }
 
-void Compiler::emit(uint8_t byte) {
-    code.push_back(byte);
-}
-
-void Compiler::emitInt32(int32_t value) {
-    code.push_back(value & 0xFF);
-    code.push_back((value >> 8) & 0xFF);
-    code.push_back((value >> 16) & 0xFF);
-    code.push_back((value >> 24) & 0xFF);
+void Compiler::markArray(const char* name, int32_t size) {
+    for (size_t i = 0; i < fixedArrayCount; i++) {
+        if (strEq(fixedArrays[i].name, name)) {
+            if (fixedArrays[i].value != size) fixedArrays[i].value = -1;
+            return;
+        }
+    }
+    if (size >= 0 && fixedArrayCount < 32) {
+        strCpy(fixedArrays[fixedArrayCount].name, name, 32);
+        fixedArrays[fixedArrayCount].value = size;
+        fixedArrayCount++;
+    }
 }
 
-void Compiler::emitString(const char* str) {
-    size_t len = strLen(str);
-    if (len > 255) len = 255;
-    code.push_back(static_cast<uint8_t>(len));
-    for (size_t i = 0; i < len; i++) {
-        code.push_back(static_cast<uint8_t>(str[i]));
+void Compiler::scanFixedArrays() {
+    // First pass: every `var name[N];` with a literal size
+    for (size_t i = 0; i + 4 < tokens.size(); i++) {
+        if (tokens[i].type == TokenType::VAR &&
+            tokens[i + 1].type == TokenType::IDENTIFIER &&
+            tokens[i + 2].type == TokenType::LBRACKET &&
+            tokens[i + 3].type == TokenType::NUMBER &&
+            tokens[i + 4].type == TokenType::RBRACKET) {
+            markArray(tokens[i + 1].value, toInt(tokens[i + 3].value));
+        }
     }
-}
 
-void Compiler::makeLabel(char* buf) {
-    buf[0] = 'L';
-    int n = labelCounter++;
-    int i = 1;
-    if (n == 0) { buf[i++] = '0'; }
-    else {
-        char digits[16];
-        int j = 0;
-        while (n > 0) {
-            digits[j++] = '0' + (n % 10);
-            n /= 10;
+    // Second pass: any other declaration or assignment rebinds the name
+    for (size_t i = 0; i + 1 < tokens.size(); i++) {
+        if (tokens[i].type == TokenType::VAR && tokens[i + 1].type == TokenType::IDENTIFIER) {
+            bool literalArray = i + 4 < tokens.size() &&
+                tokens[i + 2].type == TokenType::LBRACKET &&
+                tokens[i + 3].type == TokenType::NUMBER &&
+                tokens[i + 4].type == TokenType::RBRACKET;
+            if (!literalArray) markArray(tokens[i + 1].value, -1);
+        }
+        else if (tokens[i].type == TokenType::IDENTIFIER && tokens[i + 1].type == TokenType::ASSIGN) {
+            markArray(tokens[i].value, -1);
         }
-        while (j > 0) {
-            buf[i++] = digits[--j];
+        else if (tokens[i].type == TokenType::COROUTINE && tokens[i + 1].type == TokenType::IDENTIFIER) {
+            markArray(tokens[i + 1].value, -1);
         }
     }
-    buf[i] = '\0';
 }
 
-void Compiler::label(const char* name) {
-    if (labelCount < 64) {
-        strCpy(labels[labelCount].name, name, 16);
-        labels[labelCount].address = code.size();
-        labelCount++;
+bool Compiler::fixedIndex(const char* name, size_t tokenPos) {
+    if (tokenPos + 1 >= tokens.size() ||
+        tokens[tokenPos].type != TokenType::NUMBER ||
+        tokens[tokenPos + 1].type != TokenType::RBRACKET) {
+        return false;
     }
+
+    int32_t index = toInt(tokens[tokenPos].value);
+    for (size_t i = 0; i < fixedArrayCount; i++) {
+        if (strEq(fixedArrays[i].name, name)) {
+            return index >= 0 && index < fixedArrays[i].value;
+        }
+    }
+    return false;
 }
 
-void Compiler::emitJump(uint8_t opcode, const char* labelName) {
-    emit(opcode);
-    if (jumpCount < 128) {
-        jumps[jumpCount].position = code.size();
-        strCpy(jumps[jumpCount].label, labelName, 16);
-        jumpCount++;
+bool Compiler::isIndexAssignment() {
+    int depth = 0;
+    for (size_t i = pos + 1; i < tokens.size(); i++) {
+        if (tokens[i].type == TokenType::LBRACKET) depth++;
+        else if (tokens[i].type == TokenType::RBRACKET) {
+            if (--depth == 0) {
+                return i + 1 < tokens.size() && tokens[i + 1].type == TokenType::ASSIGN;
+            }
+        }
+        else if (tokens[i].type == TokenType::SEMICOLON || tokens[i].type == TokenType::END_OF_FILE) {
+            return false;
+        }
     }
-    emitInt32(0);
+    return false;
 }
 
-std::vector<uint8_t>& Compiler::compile() {
+ArenaVector<uint8_t>& Compiler::compile() {
+    scanFixedArrays();
+
     while (current().type != TokenType::END_OF_FILE) {
-        statement();
+        program.body.push_back(statement());
+    }
+
+    if (optimize) {
+        Optimizer optimizer(program);
+        optimizer.run();
     }
 
-    emit(OP_HALT);
+    graph.build(program);
+    if (optimize) {
+        eliminateCommonSubexpressions(graph);
+        eliminateDeadStores(graph);
+    }
 
-    for (size_t i = 0; i < jumpCount; i++) {
-        size_t jumpPos = jumps[i].position;
-        const char* labelName = jumps[i].label;
+    CodeGenerator generator(graph, code);
+    generator.generate();
 
-        int32_t target = -1;
-        for (size_t j = 0; j < labelCount; j++) {
-            if (strEq(labels[j].name, labelName)) {
-                target = labels[j].address;
-                break;
-            }
+    if (useProfile) {
+        // Profile addresses refer to the default layout, so this first
+        // image must be the one the profile was collected from
+        if (codeChecksum(code.data(), code.size()) != profileChecksum) {
+            throw std::runtime_error("profile was collected from a different build of this program");
         }
 
-        if (target >= 0) {
-            code[jumpPos] = target & 0xFF;
-            code[jumpPos + 1] = (target >> 8) & 0xFF;
-            code[jumpPos + 2] = (target >> 16) & 0xFF;
-            code[jumpPos + 3] = (target >> 24) & 0xFF;
+        ArenaVector<BranchWeights> weights(graph.blocks.size());
+        for (const CodeGenerator::BranchSite& site : generator.branchSites()) {
+            BranchProfile::const_iterator found = profile.find(site.address);
+            if (found == profile.end()) continue;
+            BranchWeights& weight = weights[site.block];
+            weight.known = true;
+            weight.onTrue = site.jumpsOnTrue ? found->second.taken : found->second.notTaken;
+            weight.onFalse = site.jumpsOnTrue ? found->second.notTaken : found->second.taken;
         }
+
+        graph.layout = profileLayout(graph, weights);
+        code.clear();
+        CodeGenerator laidOut(graph, code);
+        laidOut.generate();
     }
 
     return code;
 }
 
-void Compiler::statement() {
+std::string Compiler::dumpIR() const {
+    return graph.dump();
+}
+
+Stmt* Compiler::statement() {
     if (match(TokenType::VAR)) {
-        varDeclaration();
+        return varDeclaration();
     }
     else if (match(TokenType::IF)) {
-        ifStatement();
+        return ifStatement();
     }
     else if (match(TokenType::WHILE)) {
-        whileStatement();
+        return whileStatement();
+    }
+    else if (match(TokenType::SWITCH)) {
+        return switchStatement();
     }
     else if (match(TokenType::PRINT)) {
-        printStatement();
+        return printStatement();
     } else if (match(TokenType::SLEEP)) {
-        sleepStatement();
+        return sleepStatement();
+    }
+    else if (match(TokenType::COROUTINE)) {
+        return coroutineStatement();
+    }
+    else if (match(TokenType::YIELD)) {
+        return yieldStatement();
     }
     else if (match(TokenType::LBRACE)) {
-        block();
+        return block();
     }
     else {
-        expressionStatement();
+        return expressionStatement();
     }
 }
 
-void Compiler::varDeclaration() {
+Stmt* Compiler::varDeclaration() {
+    int line = current().line;
     char name[32];
     strCpy(name, current().value, 32);
     match(TokenType::IDENTIFIER);
     
-    if (match(TokenType::ASSIGN)) {
-        expression();
+    Expr* value;
+    if (match(TokenType::LBRACKET)) {
+        value = program.newExpr(ExprKind::NEW_ARRAY, line);
+        value->args.push_back(expression());
+        match(TokenType::RBRACKET);
+    } else if (match(TokenType::ASSIGN)) {
+        value = expression();
     } else {
-        emit(OP_PUSH);
-        emitInt32(0);
+        value = program.constant(0, line);
     }
     
-    emit(OP_STORE);
-    emitString(name);
     match(TokenType::SEMICOLON);
+    return program.expression(program.assign(name, value, line), line);
 }
 
-void Compiler::ifStatement() {
+Stmt* Compiler::ifStatement() {
+    Stmt* stmt = program.newStmt(StmtKind::IF, current().line);
     match(TokenType::LPAREN);
-    expression();
+    stmt->expr = expression();
     match(TokenType::RPAREN);
     
-    char elseLabel[16], endLabel[16];
-    makeLabel(elseLabel);
-    makeLabel(endLabel);
-    
-    emitJump(OP_JMP_NOT, elseLabel);
-    statement();
-    
+    stmt->body.push_back(statement());
     if (match(TokenType::ELSE)) {
-        emitJump(OP_JMP, endLabel);
-        label(elseLabel);
-        statement();
-        label(endLabel);
-    } else {
-        label(elseLabel);
+        stmt->body.push_back(statement());
     }
+    return stmt;
 }
 
-void Compiler::whileStatement() {
-    char startLabel[16], endLabel[16];
-    makeLabel(startLabel);
-    makeLabel(endLabel);
-    
-    label(startLabel);
+Stmt* Compiler::whileStatement() {
+    Stmt* stmt = program.newStmt(StmtKind::WHILE, current().line);
     match(TokenType::LPAREN);
-    expression();
+    stmt->expr = expression();
     match(TokenType::RPAREN);
     
-    emitJump(OP_JMP_NOT, endLabel);
-    statement();
-    emitJump(OP_JMP, startLabel);
-    label(endLabel);
+    stmt->body.push_back(statement());
+    return stmt;
+}
+
+int32_t Compiler::caseValue() {
+    bool negative = match(TokenType::MINUS);
+    if (current().type != TokenType::NUMBER) {
+        throw std::runtime_error("line " + std::to_string(current().line) +
+                                 ": case label must be an integer constant");
+    }
+    int32_t value = toInt(current().value);
+    advance();
+    return negative ? static_cast<int32_t>(0u - static_cast<uint32_t>(value)) : value;
+}
+
+Stmt* Compiler::switchStatement() {
+    Stmt* stmt = program.newStmt(StmtKind::SWITCH, current().line);
+    match(TokenType::LPAREN);
+    stmt->expr = expression();
+    match(TokenType::RPAREN);
+
+    // Cases do not fall through; each one owns the statements up to the next label
+    match(TokenType::LBRACE);
+    while (current().type != TokenType::RBRACE && current().type != TokenType::END_OF_FILE) {
+        int line = current().line;
+        if (match(TokenType::CASE)) {
+            int32_t value = caseValue();
+            for (size_t i = 0; i < stmt->cases.size(); i++) {
+                if (static_cast<int>(i) != stmt->defaultCase && stmt->cases[i] == value) {
+                    throw std::runtime_error("line " + std::to_string(line) +
+                                             ": duplicate case value " + std::to_string(value));
+                }
+            }
+            stmt->cases.push_back(value);
+        } else if (match(TokenType::DEFAULT)) {
+            if (stmt->defaultCase >= 0) {
+                throw std::runtime_error("line " + std::to_string(line) +
+                                         ": multiple default labels in one switch");
+            }
+            stmt->defaultCase = static_cast<int>(stmt->cases.size());
+            stmt->cases.push_back(0);
+        } else {
+            throw std::runtime_error("line " + std::to_string(line) +
+                                     ": expected 'case' or 'default' in switch");
+        }
+        match(TokenType::COLON);
+
+        Stmt* body = program.newStmt(StmtKind::BLOCK, line);
+        while (current().type != TokenType::CASE && current().type != TokenType::DEFAULT &&
+               current().type != TokenType::RBRACE && current().type != TokenType::END_OF_FILE) {
+            body->body.push_back(statement());
+        }
+        stmt->body.push_back(body);
+    }
+    match(TokenType::RBRACE);
+    return stmt;
 }
 
-void Compiler::sleepStatement() {
+Stmt* Compiler::sleepStatement() {
+    Stmt* stmt = program.newStmt(StmtKind::SLEEP, current().line);
     match(TokenType::LPAREN);
-    expression();
+    stmt->expr = expression();
     match(TokenType::RPAREN);
-    emit(OP_SLEEP);
     match(TokenType::SEMICOLON);
+    return stmt;
 }
 
-void Compiler::printStatement() {
+Stmt* Compiler::printStatement() {
+    Stmt* stmt = program.newStmt(StmtKind::PRINT, current().line);
     match(TokenType::LPAREN);
-    expression();
+    stmt->expr = expression();
     match(TokenType::RPAREN);
-    emit(OP_PRINT);
     match(TokenType::SEMICOLON);
+    return stmt;
 }
 
-void Compiler::block() {
+// coroutine name { ... } stores a new coroutine in name each time it runs;
+// the body only runs when the coroutine is resumed
+Stmt* Compiler::coroutineStatement() {
+    int line = current().line;
+    if (current().type != TokenType::IDENTIFIER) {
+        throw std::runtime_error("line " + std::to_string(line) + ": expected coroutine name");
+    }
+    Stmt* stmt = program.newStmt(StmtKind::COROUTINE, line);
+    stmt->expr = program.variable(current().value, line);
+    advance();
+
+    match(TokenType::LBRACE);
+    coroutineDepth++;
+    stmt->body.push_back(block());
+    coroutineDepth--;
+    return stmt;
+}
+
+Stmt* Compiler::yieldStatement() {
+    int line = current().line;
+    if (coroutineDepth == 0) {
+        throw std::runtime_error("line " + std::to_string(line) + ": yield outside a coroutine");
+    }
+    Stmt* stmt = program.newStmt(StmtKind::YIELD, line);
+    stmt->expr = current().type == TokenType::SEMICOLON ? program.constant(0, line) : expression();
+    match(TokenType::SEMICOLON);
+    return stmt;
+}
+
+Stmt* Compiler::block() {
+    Stmt* stmt = program.newStmt(StmtKind::BLOCK, current().line);
     while (current().type != TokenType::RBRACE && current().type != TokenType::END_OF_FILE) {
-        statement();
+        stmt->body.push_back(statement());
     }
     match(TokenType::RBRACE);
+    return stmt;
 }
 
-void Compiler::expressionStatement() {
-    expression();
-    emit(OP_POP);
+Stmt* Compiler::expressionStatement() {
+    int line = current().line;
+    Expr* expr = expression();
     match(TokenType::SEMICOLON);
+    return program.expression(expr, line);
 }
 
-void Compiler::expression() {
+Expr* Compiler::expression() {
+    int line = current().line;
     if (current().type == TokenType::IDENTIFIER && peek().type == TokenType::ASSIGN) {
         char name[32];
         strCpy(name, current().value, 32);
         advance();
         advance();
-        expression();
-        emit(OP_STORE);
-        emitString(name);
+        return program.assign(name, expression(), line);
+    } else if (current().type == TokenType::IDENTIFIER && peek().type == TokenType::LBRACKET && isIndexAssignment()) {
+        char name[32];
+        strCpy(name, current().value, 32);
+        advance();
+        advance();
+        Expr* expr = program.newExpr(ExprKind::INDEX_ASSIGN, line);
+        expr->unchecked = fixedIndex(name, pos);
+        expr->args.push_back(program.variable(name, line));
+        expr->args.push_back(expression());
+        match(TokenType::RBRACKET);
+        match(TokenType::ASSIGN);
+        expr->args.push_back(expression());
+        return expr;
     } else {
-        logicalOr();
+        return logicalOr();
+    }
+}
+
+Expr* Compiler::logicalOr() {
+    Expr* expr = logicalAnd();
+    while (current().type == TokenType::OR) {
+        int line = current().line;
+        advance();
+        expr = program.binary(OP_OR, expr, logicalAnd(), line);
     }
+    return expr;
 }
 
-void Compiler::logicalOr() {
-    logicalAnd();
-    while (match(TokenType::OR)) {
-        logicalAnd();
-        emit(OP_OR);
+Expr* Compiler::logicalAnd() {
+    Expr* expr = bitOr();
+    while (current().type == TokenType::AND) {
+        int line = current().line;
+        advance();
+        expr = program.binary(OP_AND, expr, bitOr(), line);
     }
+    return expr;
 }
 
-void Compiler::logicalAnd() {
-    equality();
-    while (match(TokenType::AND)) {
-        equality();
-        emit(OP_AND);
+Expr* Compiler::bitOr() {
+    Expr* expr = bitXor();
+    while (current().type == TokenType::BIT_OR) {
+        int line = current().line;
+        advance();
+        expr = program.binary(OP_BIT_OR, expr, bitXor(), line);
     }
+    return expr;
 }
 
-void Compiler::equality() {
-    comparison();
+Expr* Compiler::bitXor() {
+    Expr* expr = bitAnd();
+    while (current().type == TokenType::BIT_XOR) {
+        int line = current().line;
+        advance();
+        expr = program.binary(OP_BIT_XOR, expr, bitAnd(), line);
+    }
+    return expr;
+}
+
+Expr* Compiler::bitAnd() {
+    Expr* expr = equality();
+    while (current().type == TokenType::BIT_AND) {
+        int line = current().line;
+        advance();
+        expr = program.binary(OP_BIT_AND, expr, equality(), line);
+    }
+    return expr;
+}
+
+Expr* Compiler::equality() {
+    Expr* expr = comparison();
     while (true) {
+        int line = current().line;
         if (match(TokenType::EQ)) {
-            comparison();
-            emit(OP_EQ);
+            expr = program.binary(OP_EQ, expr, comparison(), line);
         } else if (match(TokenType::NE)) {
-            comparison();
-            emit(OP_NE);
+            expr = program.binary(OP_NE, expr, comparison(), line);
         } else break;
     }
+    return expr;
 }
 
-void Compiler::comparison() {
-    term();
+Expr* Compiler::comparison() {
+    Expr* expr = shift();
     while (true) {
+        int line = current().line;
         if (match(TokenType::LT)) {
-            term();
-            emit(OP_LT);
+            expr = program.binary(OP_LT, expr, shift(), line);
         } else if (match(TokenType::LE)) {
-            term();
-            emit(OP_LE);
+            expr = program.binary(OP_LE, expr, shift(), line);
         } else if (match(TokenType::GT)) {
-            term();
-            emit(OP_GT);
+            expr = program.binary(OP_GT, expr, shift(), line);
         } else if (match(TokenType::GE)) {
-            term();
-            emit(OP_GE);
+            expr = program.binary(OP_GE, expr, shift(), line);
+        } else break;
+    }
+    return expr;
+}
+
+Expr* Compiler::shift() {
+    Expr* expr = term();
+    while (true) {
+        int line = current().line;
+        if (match(TokenType::SHL)) {
+            expr = program.binary(OP_SHL, expr, term(), line);
+        } else if (match(TokenType::SHR)) {
+            expr = program.binary(OP_SHR, expr, term(), line);
         } else break;
     }
+    return expr;
 }
 
-void Compiler::term() {
-    factor();
+Expr* Compiler::term() {
+    Expr* expr = factor();
     while (true) {
+        int line = current().line;
         if (match(TokenType::PLUS)) {
-            factor();
-            emit(OP_ADD);
+            expr = program.binary(OP_ADD, expr, factor(), line);
         } else if (match(TokenType::MINUS)) {
-            factor();
-            emit(OP_SUB);
+            expr = program.binary(OP_SUB, expr, factor(), line);
         } else break;
     }
+    return expr;
 }
 
-void Compiler::factor() {
-    unary();
+Expr* Compiler::factor() {
+    Expr* expr = unary();
     while (true) {
+        int line = current().line;
         if (match(TokenType::STAR)) {
-            unary();
-            emit(OP_MUL);
+            expr = program.binary(OP_MUL, expr, unary(), line);
         } else if (match(TokenType::SLASH)) {
-            unary();
-            emit(OP_DIV);
+            expr = program.binary(OP_DIV, expr, unary(), line);
         } else if (match(TokenType::PERCENT)) {
-            unary();
-            emit(OP_MOD);
+            expr = program.binary(OP_MOD, expr, unary(), line);
         } else break;
     }
+    return expr;
 }
 
-void Compiler::unary() {
-    if (match(TokenType::MINUS)) {
-        unary();
-        emit(OP_NEG);
-    } else if (match(TokenType::NOT)) {
-        unary();
-        emit(OP_NOT);
-    } else {
-        primary();
-    }
+Expr* Compiler::unary() {
+    int line = current().line;
+    uint8_t op;
+    if (match(TokenType::MINUS)) op = OP_NEG;
+    else if (match(TokenType::NOT)) op = OP_NOT;
+    else if (match(TokenType::BIT_NOT)) op = OP_BIT_NOT;
+    else return primary();
+
+    Expr* expr = program.newExpr(ExprKind::UNARY, line);
+    expr->op = op;
+    expr->args.push_back(unary());
+    return expr;
 }
 
-void Compiler::primary() {
+Expr* Compiler::primary() {
+    int line = current().line;
     if (match(TokenType::NUMBER)) {
-        int32_t value = toInt(tokens[pos - 1].value);
-        emit(OP_PUSH);
-        emitInt32(value);
+        return program.constant(toInt(tokens[pos - 1].value), line);
+    }
+    else if (match(TokenType::STRING)) {
+        if (tokens[pos - 1].text.size() > MAX_STRING_LENGTH) {
+            throw std::runtime_error("line " + std::to_string(line) + ": string literal longer than " +
+                                     std::to_string(MAX_STRING_LENGTH) + " characters");
+        }
+        Expr* expr = program.newExpr(ExprKind::STRING, line);
+        expr->name = tokens[pos - 1].text;
+        return expr;
     }
     else if (match(TokenType::IDENTIFIER)) {
         char name[32];
         strCpy(name, tokens[pos - 1].value, 32);
-        emit(OP_LOAD);
-        emitString(name);
+        if (current().type == TokenType::LPAREN) {
+            return nativeCall(name);
+        } else if (current().type == TokenType::LBRACKET) {
+            return indexExpression(name);
+        }
+        return program.variable(name, line);
+    }
+    else if (match(TokenType::RESUME)) {
+        Expr* expr = program.newExpr(ExprKind::RESUME, line);
+        match(TokenType::LPAREN);
+        expr->args.push_back(expression());
+        match(TokenType::RPAREN);
+        return expr;
     }
     else if (match(TokenType::LPAREN)) {
-        expression();
+        Expr* expr = expression();
         match(TokenType::RPAREN);
+        return expr;
+    }
+
+    throw std::runtime_error("line " + std::to_string(line) + ": expected expression, found '" +
+                             current().value + "'");
+}
+
+Expr* Compiler::indexExpression(const char* name) {
+    int line = current().line;
+    match(TokenType::LBRACKET);
+    Expr* expr = program.newExpr(ExprKind::INDEX, line);
+    expr->unchecked = fixedIndex(name, pos);
+    expr->args.push_back(program.variable(name, line));
+    expr->args.push_back(expression());
+    match(TokenType::RBRACKET);
+    return expr;
+}
+
+Expr* Compiler::nativeCall(const char* name) {
+    int index = findNative(name);
+    int line = current().line;
+    if (index < 0) {
+        throw std::runtime_error("line " + std::to_string(line) + ": unknown function '" + name + "'");
     }
-}
\ No newline at end of file
+
+    Expr* expr = program.newExpr(ExprKind::CALL, line);
+    expr->value = index;
+
+    match(TokenType::LPAREN);
+    if (current().type != TokenType::RPAREN) {
+        do {
+            expr->args.push_back(expression());
+        } while (match(TokenType::COMMA));
+    }
+    match(TokenType::RPAREN);
+
+    if (expr->args.size() != nativeTable[index].arity) {
+        throw std::runtime_error("line " + std::to_string(line) + ": " + name + "() expects " +
+                                 std::to_string(nativeTable[index].arity) + " argument(s)");
+    }
+
+    return expr;
+}
@@ -2,55 +2,78 @@
 #define COMPILER_H
 
 #include <vector>
+#include <string>
 #include <cstdint>
 #include "Lexer.h"
+#include "IR.h"
+#include "ControlFlowGraph.h"
+#include "Profile.h"
 
 class Compiler {
 private:
-    std::vector<Token>& tokens;
+    ArenaVector<Token>& tokens;
     size_t pos;
-    std::vector<uint8_t> code;
+    ArenaVector<uint8_t> code;
+    Program program;
+    ControlFlowGraph graph;
+    bool optimize;
+    bool useProfile;
+    uint32_t profileChecksum;
+    BranchProfile profile;
 
-    Label labels[64];
-    size_t labelCount;
-
-    Jump jumps[128];
-    size_t jumpCount;
-
-    int labelCounter;
+    // Arrays declared once with a literal size and never rebound, so
+    // literal indexes into them can be bounds-checked at compile time
+    Variable fixedArrays[32];
+    size_t fixedArrayCount;
+    int coroutineDepth;     // Coroutine bodies the parser is inside
 
     Token& current();
     Token& peek(int offset = 1);
     void advance();
     bool match(TokenType type);
-    void emit(uint8_t byte);
-    void emitInt32(int32_t value);
-    void emitString(const char* str);
-    void makeLabel(char* buf);
-    void label(const char* name);
-    void emitJump(uint8_t opcode, const char* labelName);
-
-    void expression();
-    void logicalOr();
-    void logicalAnd();
-    void equality();
-    void comparison();
-    void term();
-    void factor();
-    void unary();
-    void primary();
-    void statement();
-    void varDeclaration();
-    void ifStatement();
-    void whileStatement();
-    void printStatement();
-    void sleepStatement();
-    void block();
-    void expressionStatement();
+    void scanFixedArrays();
+    void markArray(const char* name, int32_t size);
+    bool fixedIndex(const char* name, size_t tokenPos);
+    bool isIndexAssignment();
+
+    Expr* expression();
+    Expr* logicalOr();
+    Expr* logicalAnd();
+    Expr* bitOr();
+    Expr* bitXor();
+    Expr* bitAnd();
+    Expr* equality();
+    Expr* comparison();
+    Expr* shift();
+    Expr* term();
+    Expr* factor();
+    Expr* unary();
+    Expr* primary();
+    Expr* indexExpression(const char* name);
+    Expr* nativeCall(const char* name);
+    Stmt* statement();
+    Stmt* varDeclaration();
+    Stmt* ifStatement();
+    Stmt* whileStatement();
+    Stmt* switchStatement();
+    int32_t caseValue();
+    Stmt* printStatement();
+    Stmt* sleepStatement();
+    Stmt* coroutineStatement();
+    Stmt* yieldStatement();
+    Stmt* block();
+    Stmt* expressionStatement();
 
 public:
-    Compiler(std::vector<Token>& toks);
-    std::vector<uint8_t>& compile();
+    Compiler(ArenaVector<Token>& toks);
+    void setOptimize(bool enabled);
+    // Lay out blocks by branch counts collected from running the program
+    // as compiled without a profile
+    void setProfile(const BranchProfile& counts, uint32_t checksum);
+    ArenaVector<uint8_t>& compile();
+
+    // Textual form of the control-flow graph the last compile() emitted
+    std::string dumpIR() const;
 };
 
 #endif
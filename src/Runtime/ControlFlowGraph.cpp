@@ -0,0 +1,451 @@
+#include "ControlFlowGraph.h"
+#include "VirtualMachine.h"
+#include "Natives.h"
+#include "Optimizer.h"
+#include <vector>
+#include <string>
+
+bool definesTemp(InstrKind kind) {
+    return kind != InstrKind::STORE && kind != InstrKind::INC &&
+           kind != InstrKind::PRINT && kind != InstrKind::SLEEP && kind != InstrKind::YIELD;
+}
+
+ControlFlowGraph::ControlFlowGraph() : current(0), tempCount(0), usesStrings(false) {}
+
+int ControlFlowGraph::newBlock() {
+    BasicBlock block;
+    block.term.kind = TermKind::HALT;
+    block.term.operand = -1;
+    blocks.push_back(block);
+    return static_cast<int>(blocks.size()) - 1;
+}
+
+int ControlFlowGraph::newTemp() {
+    return tempCount++;
+}
+
+Instr& ControlFlowGraph::append(InstrKind kind, int line) {
+    Instr instr;
+    instr.kind = kind;
+    instr.op = 0;
+    instr.value = 0;
+    instr.unchecked = false;
+    instr.dest = definesTemp(kind) ? newTemp() : -1;
+    instr.line = line;
+    blocks[current].instrs.push_back(instr);
+    return blocks[current].instrs.back();
+}
+
+void ControlFlowGraph::endBlock(TermKind kind, int operand) {
+    blocks[current].term.kind = kind;
+    blocks[current].term.operand = operand;
+}
+
+int ControlFlowGraph::resolve(int block) const {
+    for (size_t hops = 0; hops < blocks.size(); hops++) {
+        const BasicBlock& candidate = blocks[block];
+        if (!candidate.instrs.empty() || candidate.term.kind != TermKind::JUMP) break;
+        block = candidate.term.targets[0];
+    }
+    return block;
+}
+
+void ControlFlowGraph::build(const Program& program) {
+    blocks.clear();
+    layout.clear();
+    coroutineEntries.clear();
+    tempCount = 0;
+    usesStrings = program.usesStrings;
+    current = newBlock();
+
+    for (const Stmt* stmt : program.body) {
+        lower(stmt);
+    }
+
+    endBlock(TermKind::HALT, -1);
+}
+
+int ControlFlowGraph::lower(const Expr* expr) {
+    ArenaVector<int> operands;
+
+    switch (expr->kind) {
+        case ExprKind::CONSTANT: {
+            Instr& instr = append(InstrKind::CONST, expr->line);
+            instr.value = expr->value;
+            return instr.dest;
+        }
+
+        case ExprKind::VARIABLE: {
+            Instr& instr = append(InstrKind::LOAD, expr->line);
+            instr.name = expr->name;
+            return instr.dest;
+        }
+
+        case ExprKind::STRING: {
+            Instr& instr = append(InstrKind::STRING, expr->line);
+            instr.name = expr->name;
+            return instr.dest;
+        }
+
+        case ExprKind::ASSIGN: {
+            int value = lower(expr->args[0]);
+            Instr& instr = append(InstrKind::STORE, expr->line);
+            instr.name = expr->name;
+            instr.operands.push_back(value);
+            return value;
+        }
+
+        case ExprKind::BINARY: {
+            const Expr* left = expr->args[0];
+            const Expr* right = expr->args[1];
+            bool leftConstant = left->kind == ExprKind::CONSTANT;
+            bool rightConstant = right->kind == ExprKind::CONSTANT;
+
+            // Constant operands become immediates, which the VM has fused
+            // instructions for. The fused add is integer-only, so '+' keeps
+            // both operands once the program has strings to concatenate
+            uint8_t op = expr->op;
+            const Expr* operand = nullptr;
+            int32_t value = 0;
+            bool integerAdd = !usesStrings;
+            if (op == OP_BIT_AND && (leftConstant || rightConstant)) {
+                operand = rightConstant ? left : right;
+                value = rightConstant ? right->value : left->value;
+            } else if (op == OP_ADD && integerAdd && (leftConstant || rightConstant)) {
+                operand = rightConstant ? left : right;
+                value = rightConstant ? right->value : left->value;
+            } else if (op == OP_SUB && integerAdd && rightConstant) {
+                op = OP_ADD;
+                operand = left;
+                value = static_cast<int32_t>(0u - static_cast<uint32_t>(right->value));
+            } else if ((op == OP_SHL || op == OP_SHR) && rightConstant) {
+                operand = left;
+                value = right->value & 31;
+            } else if (op == OP_DIV_POW2 || op == OP_MOD_POW2) {
+                operand = left;
+                value = right->value;
+            }
+
+            if (operand) {
+                int a = lower(operand);
+                Instr& instr = append(InstrKind::BINARY_IMM, expr->line);
+                instr.op = op;
+                instr.value = value;
+                instr.operands.push_back(a);
+                return instr.dest;
+            }
+
+            int a = lower(left);
+            int b = lower(right);
+            Instr& instr = append(InstrKind::BINARY, expr->line);
+            instr.op = op;
+            instr.operands.push_back(a);
+            instr.operands.push_back(b);
+            return instr.dest;
+        }
+
+        default:
+            break;
+    }
+
+    for (const Expr* arg : expr->args) {
+        operands.push_back(lower(arg));
+    }
+
+    InstrKind kind = InstrKind::CALL;
+    switch (expr->kind) {
+        case ExprKind::RESUME: kind = InstrKind::RESUME; break;
+        case ExprKind::INDEX: kind = InstrKind::INDEX_GET; break;
+        case ExprKind::INDEX_ASSIGN: kind = InstrKind::INDEX_SET; break;
+        case ExprKind::NEW_ARRAY: kind = InstrKind::NEW_ARRAY; break;
+        case ExprKind::UNARY: kind = InstrKind::UNARY; break;
+        default: break;
+    }
+
+    Instr& instr = append(kind, expr->line);
+    instr.op = kind == InstrKind::CALL ? static_cast<uint8_t>(expr->value) : expr->op;
+    instr.unchecked = expr->unchecked;
+    instr.operands = operands;
+    return instr.dest;
+}
+
+void ControlFlowGraph::lower(const Stmt* stmt) {
+    switch (stmt->kind) {
+        case StmtKind::EXPRESSION: {
+            ArenaString name;
+            int32_t step;
+            if (!usesStrings && isConstantStep(stmt, name, step)) {
+                Instr& instr = append(InstrKind::INC, stmt->line);
+                instr.name = name;
+                instr.value = step;
+            } else {
+                lower(stmt->expr);
+            }
+            break;
+        }
+
+        case StmtKind::PRINT:
+        case StmtKind::SLEEP: {
+            int value = lower(stmt->expr);
+            Instr& instr = append(stmt->kind == StmtKind::PRINT ? InstrKind::PRINT : InstrKind::SLEEP,
+                                  stmt->line);
+            instr.operands.push_back(value);
+            break;
+        }
+
+        case StmtKind::BLOCK:
+            for (const Stmt* child : stmt->body) {
+                lower(child);
+            }
+            break;
+
+        case StmtKind::COROUTINE: {
+            // The body goes out of line; only its entry address is taken here
+            int resumeAt = current;
+            int entry = newBlock();
+            coroutineEntries.push_back(entry);
+            current = entry;
+            lower(stmt->body[0]);
+            endBlock(TermKind::FINISH, -1);
+            current = resumeAt;
+
+            Instr& create = append(InstrKind::NEW_COROUTINE, stmt->line);
+            create.value = entry;
+            int coroutine = create.dest;
+            Instr& store = append(InstrKind::STORE, stmt->line);
+            store.name = stmt->expr->name;
+            store.operands.push_back(coroutine);
+            break;
+        }
+
+        case StmtKind::YIELD: {
+            int value = lower(stmt->expr);
+            append(InstrKind::YIELD, stmt->line).operands.push_back(value);
+            // Code after a yield runs on a later resume; starting a block
+            // there keeps temporaries from living across it
+            int next = newBlock();
+            blocks[current].term.kind = TermKind::JUMP;
+            blocks[current].term.targets.push_back(next);
+            current = next;
+            break;
+        }
+
+        case StmtKind::IF: {
+            int condition = lower(stmt->expr);
+            int head = current;
+
+            int thenBlock = newBlock();
+            current = thenBlock;
+            lower(stmt->body[0]);
+            int thenEnd = current;
+
+            int elseBlock = -1;
+            int elseEnd = -1;
+            if (stmt->body.size() > 1) {
+                elseBlock = newBlock();
+                current = elseBlock;
+                lower(stmt->body[1]);
+                elseEnd = current;
+            }
+
+            int join = newBlock();
+            blocks[head].term.kind = TermKind::BRANCH;
+            blocks[head].term.operand = condition;
+            blocks[head].term.targets.push_back(thenBlock);
+            blocks[head].term.targets.push_back(elseBlock >= 0 ? elseBlock : join);
+            blocks[thenEnd].term.kind = TermKind::JUMP;
+            blocks[thenEnd].term.targets.push_back(join);
+            if (elseEnd >= 0) {
+                blocks[elseEnd].term.kind = TermKind::JUMP;
+                blocks[elseEnd].term.targets.push_back(join);
+            }
+            current = join;
+            break;
+        }
+
+        case StmtKind::WHILE: {
+            for (const Stmt* pre : stmt->preheader) {
+                lower(pre);
+            }
+
+            int head = newBlock();
+            blocks[current].term.kind = TermKind::JUMP;
+            blocks[current].term.targets.push_back(head);
+            current = head;
+            int condition = lower(stmt->expr);
+            int test = current;
+
+            int body = newBlock();
+            current = body;
+            lower(stmt->body[0]);
+            blocks[current].term.kind = TermKind::JUMP;
+            blocks[current].term.targets.push_back(head);
+
+            int exit = newBlock();
+            blocks[test].term.kind = TermKind::BRANCH;
+            blocks[test].term.operand = condition;
+            blocks[test].term.targets.push_back(body);
+            blocks[test].term.targets.push_back(exit);
+            current = exit;
+            break;
+        }
+
+        case StmtKind::SWITCH: {
+            int value = lower(stmt->expr);
+            int head = current;
+
+            ArenaVector<int> caseEnds;
+            ArenaVector<int> caseBlocks;
+            for (const Stmt* body : stmt->body) {
+                current = newBlock();
+                caseBlocks.push_back(current);
+                lower(body);
+                caseEnds.push_back(current);
+            }
+
+            int join = newBlock();
+            Terminator& term = blocks[head].term;
+            term.kind = TermKind::SWITCH;
+            term.operand = value;
+            term.targets.push_back(stmt->defaultCase >= 0 ? caseBlocks[stmt->defaultCase] : join);
+            for (size_t i = 0; i < stmt->cases.size(); i++) {
+                if (static_cast<int>(i) == stmt->defaultCase) continue;
+                term.cases.push_back(stmt->cases[i]);
+                term.targets.push_back(caseBlocks[i]);
+            }
+            for (int end : caseEnds) {
+                blocks[end].term.kind = TermKind::JUMP;
+                blocks[end].term.targets.push_back(join);
+            }
+            current = join;
+            break;
+        }
+    }
+}
+
+static const char* opName(uint8_t op) {
+    switch (op) {
+        case OP_ADD: return "add";
+        case OP_SUB: return "sub";
+        case OP_MUL: return "mul";
+        case OP_DIV: return "div";
+        case OP_MOD: return "mod";
+        case OP_NEG: return "neg";
+        case OP_EQ: return "eq";
+        case OP_NE: return "ne";
+        case OP_LT: return "lt";
+        case OP_LE: return "le";
+        case OP_GT: return "gt";
+        case OP_GE: return "ge";
+        case OP_AND: return "and";
+        case OP_OR: return "or";
+        case OP_NOT: return "not";
+        case OP_BIT_AND: return "band";
+        case OP_BIT_OR: return "bor";
+        case OP_BIT_XOR: return "bxor";
+        case OP_BIT_NOT: return "bnot";
+        case OP_SHL: return "shl";
+        case OP_SHR: return "shr";
+        case OP_DIV_POW2: return "divpow2";
+        case OP_MOD_POW2: return "modpow2";
+        default: return "op";
+    }
+}
+
+static std::string temp(int id) {
+    return "%" + std::to_string(id);
+}
+
+static std::string blockName(int id) {
+    return "B" + std::to_string(id);
+}
+
+static std::string operandList(const ArenaVector<int>& operands) {
+    std::string out;
+    for (size_t i = 0; i < operands.size(); i++) {
+        if (i > 0) out += ", ";
+        out += temp(operands[i]);
+    }
+    return out;
+}
+
+std::string ControlFlowGraph::dump() const {
+    std::vector<std::vector<int>> preds(blocks.size());
+    for (size_t b = 0; b < blocks.size(); b++) {
+        for (int target : blocks[b].term.targets) {
+            preds[target].push_back(static_cast<int>(b));
+        }
+    }
+
+    std::string out;
+    for (size_t b = 0; b < blocks.size(); b++) {
+        const BasicBlock& block = blocks[b];
+        out += blockName(static_cast<int>(b)) + ":";
+        if (!preds[b].empty()) {
+            out += "    ; preds";
+            for (int pred : preds[b]) out += " " + blockName(pred);
+        }
+        out += "\n";
+
+        for (const Instr& instr : block.instrs) {
+            std::string line = "    ";
+            if (instr.dest >= 0) line += temp(instr.dest) + " = ";
+            switch (instr.kind) {
+                case InstrKind::CONST: line += "const " + std::to_string(instr.value); break;
+                case InstrKind::LOAD: line += "load " + std::string(instr.name.c_str()); break;
+                case InstrKind::STORE: line += "store " + std::string(instr.name.c_str()) + ", " + operandList(instr.operands); break;
+                case InstrKind::INC: line += "inc " + std::string(instr.name.c_str()) + ", " + std::to_string(instr.value); break;
+                case InstrKind::UNARY:
+                case InstrKind::BINARY:
+                    line += std::string(opName(instr.op)) + " " + operandList(instr.operands);
+                    break;
+                case InstrKind::BINARY_IMM:
+                    line += std::string(opName(instr.op)) + " " + operandList(instr.operands) +
+                            ", #" + std::to_string(instr.value);
+                    break;
+                case InstrKind::INDEX_GET:
+                    line += std::string(instr.unchecked ? "index.u " : "index ") + operandList(instr.operands);
+                    break;
+                case InstrKind::INDEX_SET:
+                    line += std::string(instr.unchecked ? "setindex.u " : "setindex ") + operandList(instr.operands);
+                    break;
+                case InstrKind::NEW_ARRAY: line += "newarray " + operandList(instr.operands); break;
+                case InstrKind::CALL:
+                    line += std::string("call ") + nativeTable[instr.op].name + "(" + operandList(instr.operands) + ")";
+                    break;
+                case InstrKind::PRINT: line += "print " + operandList(instr.operands); break;
+                case InstrKind::SLEEP: line += "sleep " + operandList(instr.operands); break;
+                case InstrKind::STRING: line += "string \"" + std::string(instr.name.c_str()) + "\""; break;
+                case InstrKind::NEW_COROUTINE: line += "coroutine " + blockName(instr.value); break;
+                case InstrKind::RESUME: line += "resume " + operandList(instr.operands); break;
+                case InstrKind::YIELD: line += "yield " + operandList(instr.operands); break;
+            }
+            out += line + "\n";
+        }
+
+        const Terminator& term = block.term;
+        switch (term.kind) {
+            case TermKind::JUMP:
+                out += "    jump " + blockName(term.targets[0]) + "\n";
+                break;
+            case TermKind::BRANCH:
+                out += "    br " + temp(term.operand) + ", " + blockName(term.targets[0]) + ", " +
+                       blockName(term.targets[1]) + "\n";
+                break;
+            case TermKind::SWITCH:
+                out += "    switch " + temp(term.operand) + ", default " + blockName(term.targets[0]);
+                for (size_t i = 0; i < term.cases.size(); i++) {
+                    out += ", " + std::to_string(term.cases[i]) + ": " + blockName(term.targets[i + 1]);
+                }
+                out += "\n";
+                break;
+            case TermKind::HALT:
+                out += "    halt\n";
+                break;
+            case TermKind::FINISH:
+                out += "    finish\n";
+                break;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,99 @@
+#ifndef CONTROLFLOWGRAPH_H
+#define CONTROLFLOWGRAPH_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "IR.h"
+
+// Low-level form of a program: basic blocks of three-address instructions.
+// Every instruction result is a fresh temporary (%N) that is defined once
+// and only used inside its own block; source variables are read and
+// written through explicit load and store instructions.
+
+enum class InstrKind {
+    CONST,          // %d = value
+    LOAD,           // %d = name
+    STORE,          // name = %a
+    INC,            // name += value
+    UNARY,          // %d = op %a
+    BINARY,         // %d = %a op %b
+    BINARY_IMM,     // %d = %a op value
+    INDEX_GET,      // %d = %a[%b]
+    INDEX_SET,      // %d = %a[%b] = %c
+    NEW_ARRAY,      // %d = new array of %a elements
+    CALL,           // %d = nativeTable[op](operands...)
+    PRINT,          // print %a
+    SLEEP,          // sleep %a
+    STRING,         // %d = string literal name
+    NEW_COROUTINE,  // %d = new coroutine starting at block value
+    RESUME,         // %d = value yielded by running coroutine %a
+    YIELD           // hand %a to whoever resumed this coroutine
+};
+
+enum class TermKind {
+    JUMP,           // targets[0]
+    BRANCH,         // operand true: targets[0], false: targets[1]
+    SWITCH,         // operand == cases[i]: targets[i + 1], otherwise targets[0]
+    HALT,
+    FINISH          // End of a coroutine body
+};
+
+struct Instr {
+    InstrKind kind;
+    uint8_t op;             // Opcode for UNARY/BINARY/BINARY_IMM, native index for CALL
+    int32_t value;          // CONST value, immediate operand or INC step
+    bool unchecked;         // INDEX_GET/INDEX_SET proven in bounds
+    ArenaString name;       // LOAD, STORE and INC variable
+    int dest;               // Temporary defined, or -1
+    ArenaVector<int> operands;
+    int line;
+};
+
+struct Terminator {
+    TermKind kind;
+    int operand;
+    ArenaVector<int> targets;
+    ArenaVector<int32_t> cases;
+};
+
+struct BasicBlock {
+    ArenaVector<Instr> instrs;
+    Terminator term;
+};
+
+class ControlFlowGraph {
+private:
+    int current;    // Block instructions are appended to while lowering
+
+    int newBlock();
+    int newTemp();
+    Instr& append(InstrKind kind, int line);
+    void endBlock(TermKind kind, int operand);
+    int lower(const Expr* expr);
+    void lower(const Stmt* stmt);
+
+public:
+    // blocks[0] is the entry
+    ArenaVector<BasicBlock> blocks;
+    int tempCount;
+    // Order blocks are emitted in; empty means the order of blocks
+    ArenaVector<int> layout;
+    // Copied from the program: '+' may concatenate strings
+    bool usesStrings;
+    // Entry blocks of coroutine bodies, which nothing jumps to
+    ArenaVector<int> coroutineEntries;
+
+    ControlFlowGraph();
+
+    void build(const Program& program);
+    std::string dump() const;
+
+    // Follow blocks that hold nothing but a jump to where they lead
+    int resolve(int block) const;
+};
+
+// Whether the instruction kind produces a temporary
+bool definesTemp(InstrKind kind);
+
+#endif
@@ -0,0 +1,90 @@
+#include "IR.h"
+#include <vector>
+#include <string>
+#include <new>
+
+Program::Program() : tempCounter(0), usesStrings(false) {}
+
+// Nodes come from the arena the node lists were created in
+Program::~Program() {
+    for (Expr* expr : exprs) {
+        expr->~Expr();
+        ArenaAllocator<Expr>(exprs.get_allocator()).deallocate(expr, 1);
+    }
+    for (Stmt* stmt : stmts) {
+        stmt->~Stmt();
+        ArenaAllocator<Stmt>(stmts.get_allocator()).deallocate(stmt, 1);
+    }
+}
+
+Expr* Program::newExpr(ExprKind kind, int line) {
+    Expr* expr = new (ArenaAllocator<Expr>(exprs.get_allocator()).allocate(1)) Expr();
+    expr->kind = kind;
+    expr->op = 0;
+    expr->value = 0;
+    expr->unchecked = false;
+    expr->line = line;
+    if (kind == ExprKind::STRING) usesStrings = true;
+    exprs.push_back(expr);
+    return expr;
+}
+
+Stmt* Program::newStmt(StmtKind kind, int line) {
+    Stmt* stmt = new (ArenaAllocator<Stmt>(stmts.get_allocator()).allocate(1)) Stmt();
+    stmt->kind = kind;
+    stmt->expr = nullptr;
+    stmt->defaultCase = -1;
+    stmt->line = line;
+    stmts.push_back(stmt);
+    return stmt;
+}
+
+Expr* Program::constant(int32_t value, int line) {
+    Expr* expr = newExpr(ExprKind::CONSTANT, line);
+    expr->value = value;
+    return expr;
+}
+
+Expr* Program::variable(const ArenaString& name, int line) {
+    Expr* expr = newExpr(ExprKind::VARIABLE, line);
+    expr->name = name;
+    return expr;
+}
+
+Expr* Program::assign(const ArenaString& name, Expr* value, int line) {
+    Expr* expr = newExpr(ExprKind::ASSIGN, line);
+    expr->name = name;
+    expr->args.push_back(value);
+    return expr;
+}
+
+Expr* Program::binary(uint8_t op, Expr* left, Expr* right, int line) {
+    Expr* expr = newExpr(ExprKind::BINARY, line);
+    expr->op = op;
+    expr->args.push_back(left);
+    expr->args.push_back(right);
+    return expr;
+}
+
+Stmt* Program::expression(Expr* expr, int line) {
+    Stmt* stmt = newStmt(StmtKind::EXPRESSION, line);
+    stmt->expr = expr;
+    return stmt;
+}
+
+ArenaString Program::newTemp() {
+    return "$t" + arenaNumber(tempCounter++);
+}
+
+bool sameExpr(const Expr* a, const Expr* b) {
+    if (a == b) return true;
+    if (a->kind != b->kind || a->op != b->op || a->value != b->value ||
+        a->unchecked != b->unchecked || a->name != b->name ||
+        a->args.size() != b->args.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a->args.size(); i++) {
+        if (!sameExpr(a->args[i], b->args[i])) return false;
+    }
+    return true;
+}
@@ -0,0 +1,94 @@
+#ifndef IR_H
+#define IR_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "Arena.h"
+
+// Tree form of a program between parsing and bytecode generation. The
+// Compiler builds it, the Optimizer rewrites it in place and the
+// CodeGenerator turns it into bytecode.
+
+enum class ExprKind {
+    CONSTANT,       // value
+    VARIABLE,       // name
+    ASSIGN,         // name = args[0]
+    INDEX,          // args[0][args[1]]
+    INDEX_ASSIGN,   // args[0][args[1]] = args[2]
+    NEW_ARRAY,      // array of args[0] zeroed elements
+    UNARY,          // op args[0]
+    BINARY,         // args[0] op args[1]
+    CALL,           // nativeTable[value](args...)
+    STRING,         // string literal with contents name
+    RESUME          // resume(args[0])
+};
+
+enum class StmtKind {
+    EXPRESSION,     // expr, result discarded
+    PRINT,          // print(expr)
+    SLEEP,          // sleep(expr)
+    BLOCK,          // body in order
+    IF,             // if (expr) body[0] else body[1]
+    WHILE,          // preheader once, then while (expr) body[0]
+    SWITCH,         // switch (expr), body[i] runs for cases[i]
+    COROUTINE,      // coroutine expr->name { body[0] }
+    YIELD           // yield expr
+};
+
+struct Expr {
+    ExprKind kind;
+    uint8_t op;             // Opcode for UNARY and BINARY
+    int32_t value;          // CONSTANT value, native index for CALL
+    bool unchecked;         // INDEX/INDEX_ASSIGN proven in bounds
+    ArenaString name;       // VARIABLE and ASSIGN target
+    ArenaVector<Expr*> args;
+    int line;
+};
+
+struct Stmt {
+    StmtKind kind;
+    Expr* expr;
+    ArenaVector<Stmt*> body;
+    ArenaVector<Stmt*> preheader;
+    ArenaVector<int32_t> cases;
+    int defaultCase;        // SWITCH body index of default, or -1
+    int line;
+};
+
+// Owns every node of one compilation; nodes are freed together when the
+// program goes away, so passes can drop or share subtrees freely.
+class Program {
+private:
+    ArenaVector<Expr*> exprs;
+    ArenaVector<Stmt*> stmts;
+    int tempCounter;
+
+public:
+    ArenaVector<Stmt*> body;
+    // Whether any string literal was seen; until one is, no value can be a
+    // string and '+' is plain integer addition
+    bool usesStrings;
+
+    Program();
+    ~Program();
+
+    Expr* newExpr(ExprKind kind, int line);
+    Stmt* newStmt(StmtKind kind, int line);
+    Expr* constant(int32_t value, int line);
+    Expr* variable(const ArenaString& name, int line);
+    Expr* assign(const ArenaString& name, Expr* value, int line);
+    Expr* binary(uint8_t op, Expr* left, Expr* right, int line);
+    Stmt* expression(Expr* expr, int line);
+
+    // Fresh compiler temporary; the '$' keeps it out of the source namespace
+    ArenaString newTemp();
+
+    Program(const Program&) = delete;
+    Program& operator=(const Program&) = delete;
+};
+
+// Structural equality of two expression trees
+bool sameExpr(const Expr* a, const Expr* b);
+
+#endif
@@ -0,0 +1,106 @@
+#include "IntMap.h"
+#include <utility>
+
+IntMap::IntMap() : count(0), shift(32) {}
+
+// Fibonacci hashing: the multiply spreads consecutive keys, such as
+// device IDs, across the table and the top bits pick the slot
+size_t IntMap::home(int32_t key) const {
+    return (static_cast<uint32_t>(key) * 2654435769u) >> shift;
+}
+
+void IntMap::place(int32_t key, int32_t value) {
+    size_t mask = slots.size() - 1;
+    Slot incoming = {key, value, 1};
+    for (size_t i = home(key);; i = (i + 1) & mask) {
+        Slot& slot = slots[i];
+        if (slot.distance == 0) {
+            slot = incoming;
+            count++;
+            return;
+        }
+        if (slot.distance < incoming.distance) {
+            std::swap(slot, incoming);
+        }
+        incoming.distance++;
+    }
+}
+
+size_t IntMap::locate(int32_t key) const {
+    if (slots.empty()) return NOT_FOUND;
+    size_t mask = slots.size() - 1;
+    size_t distance = 1;
+    for (size_t i = home(key);; i = (i + 1) & mask, distance++) {
+        const Slot& slot = slots[i];
+        // Past this point the key would have displaced what is here
+        if (slot.distance < distance) return NOT_FOUND;
+        if (slot.key == key) return i;
+    }
+}
+
+const int32_t* IntMap::find(int32_t key) const {
+    size_t i = locate(key);
+    return i == NOT_FOUND ? nullptr : &slots[i].value;
+}
+
+void IntMap::set(int32_t key, int32_t value) {
+    size_t i = locate(key);
+    if (i != NOT_FOUND) {
+        slots[i].value = value;
+        return;
+    }
+    place(key, value);
+}
+
+bool IntMap::erase(int32_t key) {
+    size_t i = locate(key);
+    if (i == NOT_FOUND) return false;
+
+    // Pull the entries that follow one slot closer to home, up to the
+    // first that is already home or an empty slot
+    size_t mask = slots.size() - 1;
+    for (size_t next = (i + 1) & mask; slots[next].distance > 1; i = next, next = (next + 1) & mask) {
+        slots[i] = slots[next];
+        slots[i].distance--;
+    }
+    slots[i].distance = 0;
+    count--;
+    return true;
+}
+
+size_t IntMap::size() const {
+    return count;
+}
+
+size_t IntMap::capacity() const {
+    return slots.size();
+}
+
+bool IntMap::full() const {
+    // Robin Hood probing stays short up to seven eighths full
+    return (count + 1) * 8 > slots.size() * 7;
+}
+
+size_t IntMap::grownCapacity() const {
+    return slots.empty() ? MIN_CAPACITY : slots.size() * 2;
+}
+
+void IntMap::rehash(size_t newCapacity) {
+    IntMap grown;
+    grown.slots.assign(newCapacity, Slot());
+    while ((size_t(1) << (32 - grown.shift)) < newCapacity) grown.shift--;
+
+    for (const Slot& slot : slots) {
+        if (slot.distance) grown.place(slot.key, slot.value);
+    }
+    slots.swap(grown.slots);
+    count = grown.count;
+    shift = grown.shift;
+}
+
+bool IntMap::entry(size_t slot, int32_t& key, int32_t& value) const {
+    if (!slots[slot].distance) return false;
+    key = slots[slot].key;
+    value = slots[slot].value;
+    return true;
+}
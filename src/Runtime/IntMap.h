@@ -0,0 +1,63 @@
+#ifndef INTMAP_H
+#define INTMAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include "Arena.h"
+
+// Upper bound on the slots all maps of a program may hold together
+const size_t MAX_MAP_SLOTS = 4096;
+
+// Integer to integer hash map behind the map_* natives. Open addressing
+// with Robin Hood probing: an entry that has probed further than the one
+// in its way takes that slot and the displaced entry moves on, which keeps
+// every probe sequence short and lets a lookup stop as soon as it meets an
+// entry closer to home than the key would be. Keys, values and probe
+// lengths sit together in one flat array, so a lookup usually touches a
+// single cache line. Deleting shifts the following entries back instead of
+// leaving tombstones.
+class IntMap {
+private:
+    struct Slot {
+        int32_t key;
+        int32_t value;
+        // Probe length + 1, or 0 if the slot is empty; tables stay below
+        // MAX_MAP_SLOTS, so it cannot overflow
+        uint16_t distance;
+    };
+
+    static const size_t MIN_CAPACITY = 8;
+    static const size_t NOT_FOUND = SIZE_MAX;
+
+    ArenaVector<Slot> slots;
+    size_t count;
+    uint8_t shift;          // 32 - log2(capacity), for the hash
+
+    size_t home(int32_t key) const;
+    // Slot holding key, or NOT_FOUND
+    size_t locate(int32_t key) const;
+    void place(int32_t key, int32_t value);
+
+public:
+    IntMap();
+
+    // Value stored under key, or nullptr
+    const int32_t* find(int32_t key) const;
+    // Stores the value; the caller grows the table first if it is full
+    void set(int32_t key, int32_t value);
+    bool erase(int32_t key);
+
+    size_t size() const;
+    size_t capacity() const;
+    // Whether adding one more key needs a larger table
+    bool full() const;
+    // Capacity that full() asks for
+    size_t grownCapacity() const;
+    // Rebuilds the table with the given power-of-two capacity
+    void rehash(size_t newCapacity);
+
+    // Walks the table in slot order; false for empty slots
+    bool entry(size_t slot, int32_t& key, int32_t& value) const;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include <stdexcept>
 
 bool strEq(const char* a, const char* b) {
     while (*a && *b && *a == *b) { a++; b++; }
@@ -26,10 +27,13 @@ size_t strLen(const char* s) {
 bool isDigit(char c) { return c >= '0' && c <= '9'; }
 bool isAlpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
 bool isAlnum(char c) { return isAlpha(c) || isDigit(c); }
+bool isHexDigit(char c) { return isDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
 bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; }
 
+// Accumulated unsigned, so a literal past INT32_MAX keeps its low 32 bits
+// instead of overflowing: 4294967295, the text of 0xFFFFFFFF, gives -1
 int32_t toInt(const char* str) {
-    int32_t result = 0;
+    uint32_t result = 0;
     bool negative = false;
     size_t i = 0;
 
@@ -39,11 +43,11 @@ int32_t toInt(const char* str) {
     }
 
     while (str[i]) {
-        result = result * 10 + (str[i] - '0');
+        result = result * 10 + static_cast<uint32_t>(str[i] - '0');
         i++;
     }
 
-    return negative ? -result : result;
+    return static_cast<int32_t>(negative ? 0u - result : result);
 }
 
 Lexer::Lexer(const char* src) : source(src), pos(0), line(1) {}
@@ -82,6 +86,38 @@ void Lexer::addToken(TokenType type, const char* val) {
 void Lexer::number() {
     char num[32];
     size_t i = 0;
+
+    if (current() == '0' && (peek() == 'x' || peek() == 'X')) {
+        advance(); advance();
+        uint32_t value = 0;
+        size_t count = 0;
+        while (isHexDigit(current())) {
+            if (++count > 8) {
+                throw std::runtime_error("line " + std::to_string(line) + ": hex literal longer than 32 bits");
+            }
+            char c = current();
+            uint32_t digit = isDigit(c) ? c - '0' : (c | 0x20) - 'a' + 10;
+            value = (value << 4) | digit;
+            advance();
+        }
+        if (count == 0) {
+            throw std::runtime_error("line " + std::to_string(line) + ": expected hex digits after 0x");
+        }
+
+        // Stored in decimal so the compiler parses every literal the same
+        // way; toInt turns 0x80000000 and up back into the same bits
+        char digits[16];
+        size_t j = 0;
+        do {
+            digits[j++] = '0' + (value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (j > 0) num[i++] = digits[--j];
+        num[i] = '\0';
+        addToken(TokenType::NUMBER, num);
+        return;
+    }
+
     while (isDigit(current()) && i < 31) {
         num[i++] = current();
         advance();
@@ -105,13 +141,50 @@ void Lexer::identifier() {
     else if (strEq(id, "var")) addToken(TokenType::VAR, id);
     else if (strEq(id, "print")) addToken(TokenType::PRINT, id);
     else if (strEq(id, "sleep")) addToken(TokenType::SLEEP, id);
+    else if (strEq(id, "switch")) addToken(TokenType::SWITCH, id);
+    else if (strEq(id, "case")) addToken(TokenType::CASE, id);
+    else if (strEq(id, "default")) addToken(TokenType::DEFAULT, id);
+    else if (strEq(id, "coroutine")) addToken(TokenType::COROUTINE, id);
+    else if (strEq(id, "yield")) addToken(TokenType::YIELD, id);
+    else if (strEq(id, "resume")) addToken(TokenType::RESUME, id);
     else if (strEq(id, "and")) addToken(TokenType::AND, id);
     else if (strEq(id, "or")) addToken(TokenType::OR, id);
     else if (strEq(id, "not")) addToken(TokenType::NOT, id);
     else addToken(TokenType::IDENTIFIER, id);
 }
 
-std::vector<Token>& Lexer::tokenize() {
+void Lexer::string() {
+    int startLine = line;
+    advance();
+
+    Token tok;
+    tok.type = TokenType::STRING;
+    tok.line = startLine;
+    strCpy(tok.value, "\"", 32);
+    while (current() != '"') {
+        char c = current();
+        if (c == '\0' || c == '\n') {
+            throw std::runtime_error("line " + std::to_string(startLine) + ": unterminated string");
+        }
+        if (c == '\\') {
+            advance();
+            switch (current()) {
+                case 'n': c = '\n'; break;
+                case 't': c = '\t'; break;
+                case '"': c = '"'; break;
+                case '\\': c = '\\'; break;
+                default:
+                    throw std::runtime_error("line " + std::to_string(startLine) + ": unknown escape in string");
+            }
+        }
+        tok.text += c;
+        advance();
+    }
+    advance();
+    tokens.push_back(tok);
+}
+
+ArenaVector<Token>& Lexer::tokenize() {
     while (current() != '\0') {
         skipWhitespace();
         skipComment();
@@ -124,6 +197,9 @@ std::vector<Token>& Lexer::tokenize() {
         else if (isAlpha(current()) || current() == '_') {
             identifier();
         }
+        else if (current() == '"') {
+            string();
+        }
         else if (current() == '+') {
             addToken(TokenType::PLUS, "+");
             advance();
@@ -166,6 +242,9 @@ std::vector<Token>& Lexer::tokenize() {
             if (peek() == '=') {
                 addToken(TokenType::LE, "<=");
                 advance(); advance();
+            } else if (peek() == '<') {
+                addToken(TokenType::SHL, "<<");
+                advance(); advance();
             } else {
                 addToken(TokenType::LT, "<");
                 advance();
@@ -175,18 +254,39 @@ std::vector<Token>& Lexer::tokenize() {
             if (peek() == '=') {
                 addToken(TokenType::GE, ">=");
                 advance(); advance();
+            } else if (peek() == '>') {
+                addToken(TokenType::SHR, ">>");
+                advance(); advance();
             } else {
                 addToken(TokenType::GT, ">");
                 advance();
             }
         }
-        else if (current() == '&' && peek() == '&') {
-            addToken(TokenType::AND, "&&");
-            advance(); advance();
+        else if (current() == '&') {
+            if (peek() == '&') {
+                addToken(TokenType::AND, "&&");
+                advance(); advance();
+            } else {
+                addToken(TokenType::BIT_AND, "&");
+                advance();
+            }
+        }
+        else if (current() == '|') {
+            if (peek() == '|') {
+                addToken(TokenType::OR, "||");
+                advance(); advance();
+            } else {
+                addToken(TokenType::BIT_OR, "|");
+                advance();
+            }
+        }
+        else if (current() == '^') {
+            addToken(TokenType::BIT_XOR, "^");
+            advance();
         }
-        else if (current() == '|' && peek() == '|') {
-            addToken(TokenType::OR, "||");
-            advance(); advance();
+        else if (current() == '~') {
+            addToken(TokenType::BIT_NOT, "~");
+            advance();
         }
         else if (current() == '(') {
             addToken(TokenType::LPAREN, "(");
@@ -204,6 +304,14 @@ std::vector<Token>& Lexer::tokenize() {
             addToken(TokenType::RBRACE, "}");
             advance();
         }
+        else if (current() == '[') {
+            addToken(TokenType::LBRACKET, "[");
+            advance();
+        }
+        else if (current() == ']') {
+            addToken(TokenType::RBRACKET, "]");
+            advance();
+        }
         else if (current() == ';') {
             addToken(TokenType::SEMICOLON, ";");
             advance();
@@ -212,6 +320,10 @@ std::vector<Token>& Lexer::tokenize() {
             addToken(TokenType::COMMA, ",");
             advance();
         }
+        else if (current() == ':') {
+            addToken(TokenType::COLON, ":");
+            advance();
+        }
         else {
             advance();
         }
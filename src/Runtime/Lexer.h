@@ -4,6 +4,7 @@
 #include <vector>
 #include <string>
 #include <cstdint>
+#include "Arena.h"
 
 // Helper structs
 struct Variable {
@@ -28,24 +29,29 @@ size_t strLen(const char* s);
 bool isDigit(char c);
 bool isAlpha(char c);
 bool isAlnum(char c);
+bool isHexDigit(char c);
 bool isSpace(char c);
 int32_t toInt(const char* str);
 
 // Token types
 enum class TokenType {
-    NUMBER, IDENTIFIER,
+    NUMBER, IDENTIFIER, STRING,
     IF, ELSE, WHILE, VAR, PRINT, SLEEP,
+    SWITCH, CASE, DEFAULT,
+    COROUTINE, YIELD, RESUME,
     PLUS, MINUS, STAR, SLASH, PERCENT,
     ASSIGN, EQ, NE, LT, LE, GT, GE,
     AND, OR, NOT,
-    LPAREN, RPAREN, LBRACE, RBRACE,
-    SEMICOLON, COMMA,
+    BIT_AND, BIT_OR, BIT_XOR, BIT_NOT, SHL, SHR,
+    LPAREN, RPAREN, LBRACE, RBRACE, LBRACKET, RBRACKET,
+    SEMICOLON, COMMA, COLON,
     END_OF_FILE, UNKNOWN
 };
 
 struct Token {
     TokenType type;
     char value[32];
+    ArenaString text;       // Contents of a STRING literal, escapes resolved
     int line;
 };
 
@@ -54,7 +60,7 @@ private:
     const char* source;
     size_t pos;
     int line;
-    std::vector<Token> tokens;
+    ArenaVector<Token> tokens;
 
     char current();
     char peek(int offset = 1);
@@ -64,10 +70,11 @@ private:
     void addToken(TokenType type, const char* val);
     void number();
     void identifier();
+    void string();
 
 public:
     Lexer(const char* src);
-    std::vector<Token>& tokenize();
+    ArenaVector<Token>& tokenize();
 };
 
 #endif
@@ -0,0 +1,39 @@
+#include "NativePrograms.h"
+#include <string>
+#include <stdexcept>
+
+// Registrars link themselves into this list during static initialization;
+// being zero-initialized, the head is valid before any of them runs
+static NativeProgramRegistrar* registeredPrograms = nullptr;
+
+NativeProgramRegistrar::NativeProgramRegistrar(const char* programName, uint32_t bytecodeChecksum, NativeProgramFn function)
+    : name(programName), checksum(bytecodeChecksum), run(function), next(registeredPrograms) {
+    registeredPrograms = this;
+}
+
+const NativeProgramRegistrar* findNativeProgram(const std::string& name) {
+    for (const NativeProgramRegistrar* program = registeredPrograms; program; program = program->next) {
+        if (name == program->name) {
+            return program;
+        }
+    }
+    return nullptr;
+}
+
+std::string nativeProgramName(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    size_t dot = name.find_last_of('.');
+    if (dot != std::string::npos && dot > 0) {
+        name = name.substr(0, dot);
+    }
+    return name;
+}
+
+void throwUndefinedVariable(const char* name) {
+    throw std::runtime_error("Undefined variable: " + std::string(name));
+}
+
+void throwIndexOutOfBounds(int32_t index) {
+    throw std::runtime_error("Array index out of bounds: " + std::to_string(index));
+}
@@ -0,0 +1,45 @@
+#ifndef NATIVEPROGRAMS_H
+#define NATIVEPROGRAMS_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "VirtualMachine.h"
+
+// Programs translated ahead of time by enix2cpp. A generated file defines
+// one function that runs the program against a freshly loaded VM (for
+// arrays, natives and output) and registers it with a static
+// NativeProgramRegistrar, so linking the file in is all it takes for run
+// to pick it up.
+typedef void (*NativeProgramFn)(VirtualMachine& vm);
+
+class NativeProgramRegistrar {
+public:
+    const char* name;       // Program name: the .enix file name without extension
+    uint32_t checksum;      // codeChecksum of the bytecode it was translated from
+    NativeProgramFn run;
+    NativeProgramRegistrar* next;
+
+    NativeProgramRegistrar(const char* programName, uint32_t bytecodeChecksum, NativeProgramFn function);
+};
+
+// Registered program with the given name, or nullptr if there is none
+const NativeProgramRegistrar* findNativeProgram(const std::string& name);
+
+// Name a program registers under: /root/ctl.enix -> ctl
+std::string nativeProgramName(const std::string& path);
+
+// Runtime errors raised by translated code, worded like the interpreter's
+void throwUndefinedVariable(const char* name);
+void throwIndexOutOfBounds(int32_t index);
+
+// Bounds-checked array element for translated code
+inline int32_t& checkedElement(VirtualMachine& vm, const Value& array, int32_t index) {
+    ArenaVector<int32_t>& elements = vm.arrayRef(array);
+    if (index < 0 || static_cast<size_t>(index) >= elements.size()) {
+        throwIndexOutOfBounds(index);
+    }
+    return elements[index];
+}
+
+#endif
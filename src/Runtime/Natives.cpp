@@ -0,0 +1,176 @@
+#include <Arduino.h>
+#include <vector>
+#include <stdexcept>
+
+#include "Natives.h"
+#include "VirtualMachine.h"
+#include "ArrayKernels.h"
+#include "Lexer.h"
+
+static Value nativeLen(VirtualMachine& vm, Value* args, uint8_t argc) {
+    if (args[0].type == ValueType::STRING) {
+        return Value(static_cast<int32_t>(vm.stringRef(args[0]).size()));
+    }
+    return Value(static_cast<int32_t>(vm.arrayRef(args[0]).size()));
+}
+
+static Value nativeFill(VirtualMachine& vm, Value* args, uint8_t argc) {
+    ArenaVector<int32_t>& array = vm.arrayRef(args[0]);
+    arrayFill(array.data(), array.size(), args[1].toInt());
+    return Value();
+}
+
+static Value nativeCopy(VirtualMachine& vm, Value* args, uint8_t argc) {
+    ArenaVector<int32_t>& dst = vm.arrayRef(args[0]);
+    ArenaVector<int32_t>& src = vm.arrayRef(args[1]);
+    size_t count = src.size() < dst.size() ? src.size() : dst.size();
+    if (&src != &dst) {
+        arrayCopy(dst.data(), src.data(), count);
+    }
+    return Value(static_cast<int32_t>(count));
+}
+
+static Value nativeSum(VirtualMachine& vm, Value* args, uint8_t argc) {
+    ArenaVector<int32_t>& array = vm.arrayRef(args[0]);
+    return Value(arraySum(array.data(), array.size()));
+}
+
+static Value nativeMin(VirtualMachine& vm, Value* args, uint8_t argc) {
+    ArenaVector<int32_t>& array = vm.arrayRef(args[0]);
+    return Value(arrayMin(array.data(), array.size()));
+}
+
+static Value nativeMax(VirtualMachine& vm, Value* args, uint8_t argc) {
+    ArenaVector<int32_t>& array = vm.arrayRef(args[0]);
+    return Value(arrayMax(array.data(), array.size()));
+}
+
+static Value nativeDot(VirtualMachine& vm, Value* args, uint8_t argc) {
+    ArenaVector<int32_t>& a = vm.arrayRef(args[0]);
+    ArenaVector<int32_t>& b = vm.arrayRef(args[1]);
+    if (a.size() != b.size()) {
+        throw std::runtime_error("dot: array lengths differ");
+    }
+    return Value(arrayDot(a.data(), b.data(), a.size()));
+}
+
+static Value nativeFind(VirtualMachine& vm, Value* args, uint8_t argc) {
+    ArenaVector<int32_t>& array = vm.arrayRef(args[0]);
+    return Value(arrayFind(array.data(), array.size(), args[1].toInt()));
+}
+
+static Value nativeMillis(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return Value(static_cast<int32_t>(millis()));
+}
+
+static Value nativeSnapshot(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return vm.requestSnapshot();
+}
+
+// substr(s, start, count): at most count characters of s from start on
+static Value nativeSubstr(VirtualMachine& vm, Value* args, uint8_t argc) {
+    const ArenaString& text = vm.stringRef(args[0]);
+    int32_t start = args[1].toInt();
+    int32_t count = args[2].toInt();
+    if (start < 0 || static_cast<size_t>(start) > text.size() || count < 0) {
+        throw std::runtime_error("String index out of bounds");
+    }
+    size_t length = text.size() - start;
+    if (static_cast<size_t>(count) < length) length = count;
+    return vm.newString(text.data() + start, length);
+}
+
+static Value nativeMapNew(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return vm.newMap();
+}
+
+static Value nativeMapSet(VirtualMachine& vm, Value* args, uint8_t argc) {
+    vm.mapSet(args[0], args[1].toInt(), args[2].toInt());
+    return Value();
+}
+
+static Value nativeMapGet(VirtualMachine& vm, Value* args, uint8_t argc) {
+    const int32_t* value = vm.mapRef(args[0]).find(args[1].toInt());
+    if (!value) {
+        throw std::runtime_error("Map key not found: " + std::to_string(args[1].toInt()));
+    }
+    return Value(*value);
+}
+
+static Value nativeMapHas(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return Value(vm.mapRef(args[0]).find(args[1].toInt()) != nullptr);
+}
+
+static Value nativeMapDel(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return Value(vm.mapRef(args[0]).erase(args[1].toInt()));
+}
+
+// map_size(m): number of keys in m
+static Value nativeMapSize(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return Value(static_cast<int32_t>(vm.mapRef(args[0]).size()));
+}
+
+// map_keys(m, a): fills a with the keys of m, as many as fit, and returns
+// how many it wrote; the way to iterate over a map
+static Value nativeMapKeys(VirtualMachine& vm, Value* args, uint8_t argc) {
+    const IntMap& map = vm.mapRef(args[0]);
+    ArenaVector<int32_t>& keys = vm.arrayRef(args[1]);
+    size_t written = 0;
+    for (size_t slot = 0; slot < map.capacity() && written < keys.size(); slot++) {
+        int32_t key, value;
+        if (map.entry(slot, key, value)) keys[written++] = key;
+    }
+    return Value(static_cast<int32_t>(written));
+}
+
+static Value nativeAlive(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return Value(vm.coroutineAlive(args[0]));
+}
+
+static Value nativeChanSend(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return vm.channelSend(args[0], args[1]);
+}
+
+static Value nativeChanRecv(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return vm.channelReceive(args[0], true);
+}
+
+static Value nativeChanTryRecv(VirtualMachine& vm, Value* args, uint8_t argc) {
+    return vm.channelReceive(args[0], false);
+}
+
+const NativeFunction nativeTable[] = {
+    {"len",      1, NATIVE_PURE,          nativeLen},
+    {"fill",     2, NATIVE_WRITES_ARRAYS, nativeFill},
+    {"copy",     2, NATIVE_WRITES_ARRAYS, nativeCopy},
+    {"sum",      1, NATIVE_READS_ARRAYS,  nativeSum},
+    {"min",      1, NATIVE_READS_ARRAYS,  nativeMin},
+    {"max",      1, NATIVE_READS_ARRAYS,  nativeMax},
+    {"dot",      2, NATIVE_READS_ARRAYS,  nativeDot},
+    {"find",     2, NATIVE_READS_ARRAYS,  nativeFind},
+    {"millis",   0, NATIVE_IMPURE,        nativeMillis},
+    {"snapshot", 0, NATIVE_IMPURE,        nativeSnapshot},
+    {"substr",   3, NATIVE_PURE,          nativeSubstr},
+    {"map_new",  0, NATIVE_IMPURE,        nativeMapNew},
+    {"map_set",  3, NATIVE_WRITES_ARRAYS, nativeMapSet},
+    {"map_get",  2, NATIVE_READS_ARRAYS,  nativeMapGet},
+    {"map_has",  2, NATIVE_READS_ARRAYS,  nativeMapHas},
+    {"map_del",  2, NATIVE_WRITES_ARRAYS, nativeMapDel},
+    {"map_size", 1, NATIVE_READS_ARRAYS,  nativeMapSize},
+    {"map_keys", 2, NATIVE_WRITES_ARRAYS, nativeMapKeys},
+    {"alive",    1, NATIVE_IMPURE,        nativeAlive},
+    {"chan_send", 2, NATIVE_IMPURE,       nativeChanSend},
+    {"chan_recv", 1, NATIVE_IMPURE,       nativeChanRecv},
+    {"chan_try_recv", 1, NATIVE_IMPURE,   nativeChanTryRecv},
+};
+
+const size_t nativeCount = sizeof(nativeTable) / sizeof(nativeTable[0]);
+
+int findNative(const char* name) {
+    for (size_t i = 0; i < nativeCount; i++) {
+        if (strEq(nativeTable[i].name, name)) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,39 @@
+#ifndef NATIVES_H
+#define NATIVES_H
+
+#include <cstddef>
+#include <cstdint>
+
+class VirtualMachine;
+struct Value;
+
+// A native receives its arguments in place on the VM stack, left to right.
+// It must not push to or pop from the VM stack while it runs; the VM drops
+// the arguments and pushes the returned value once it is done.
+typedef Value (*NativeFn)(VirtualMachine& vm, Value* args, uint8_t argc);
+
+// What a native may touch besides its arguments, so the optimizer knows
+// which calls it can move or share. Map contents count as array contents.
+enum NativeEffect {
+    NATIVE_PURE,            // Result depends only on the argument values
+    NATIVE_READS_ARRAYS,    // Also reads array contents
+    NATIVE_WRITES_ARRAYS,   // Modifies array contents
+    NATIVE_IMPURE           // Depends on or changes outside state
+};
+
+struct NativeFunction {
+    const char* name;
+    uint8_t arity;
+    uint8_t effect;
+    NativeFn function;
+};
+
+// Compiled programs refer to natives by position in this table, so new
+// entries must only ever be appended.
+extern const NativeFunction nativeTable[];
+extern const size_t nativeCount;
+
+// Index of the named native, or -1 if there is none
+int findNative(const char* name);
+
+#endif
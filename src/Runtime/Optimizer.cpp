@@ -0,0 +1,801 @@
+#include "Optimizer.h"
+#include "VirtualMachine.h"
+#include "Natives.h"
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <climits>
+
+// Constant operations wrap like the VM does on the target
+static int32_t wrapAdd(int32_t a, int32_t b) {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+
+static int32_t wrapSub(int32_t a, int32_t b) {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+}
+
+static int32_t wrapMul(int32_t a, int32_t b) {
+    return static_cast<int32_t>(static_cast<uint32_t>(a) * static_cast<uint32_t>(b));
+}
+
+// log2 of value if it is a power of two of at least 2, otherwise -1
+static int powerOfTwo(int32_t value) {
+    if (value < 2 || (value & (value - 1)) != 0) return -1;
+    int k = 0;
+    while ((1 << k) != value) k++;
+    return k;
+}
+
+static bool isConstant(const Expr* expr) {
+    return expr->kind == ExprKind::CONSTANT;
+}
+
+bool isConstantStep(const Stmt* stmt, ArenaString& name, int32_t& step) {
+    if (stmt->kind != StmtKind::EXPRESSION || stmt->expr->kind != ExprKind::ASSIGN) {
+        return false;
+    }
+    const Expr* value = stmt->expr->args[0];
+    if (value->kind != ExprKind::BINARY || (value->op != OP_ADD && value->op != OP_SUB) ||
+        value->args[0]->kind != ExprKind::VARIABLE || value->args[0]->name != stmt->expr->name ||
+        !isConstant(value->args[1])) {
+        return false;
+    }
+    name = stmt->expr->name;
+    step = value->op == OP_ADD ? value->args[1]->value : wrapSub(0, value->args[1]->value);
+    return true;
+}
+
+Optimizer::Optimizer(Program& prog) : program(prog) {}
+
+void Optimizer::run() {
+    for (Stmt* stmt : program.body) {
+        foldStmt(stmt);
+    }
+
+    ArenaSet<ArenaString> defined;
+    for (Stmt* stmt : program.body) {
+        optimizeStmt(stmt, defined);
+    }
+}
+
+Expr* Optimizer::fold(Expr* expr) {
+    for (size_t i = 0; i < expr->args.size(); i++) {
+        expr->args[i] = fold(expr->args[i]);
+    }
+
+    // Comparisons and logical operators produce booleans, which a constant
+    // push cannot express, so only integer-valued operations are folded
+    if (expr->kind == ExprKind::UNARY && isConstant(expr->args[0])) {
+        int32_t a = expr->args[0]->value;
+        if (expr->op == OP_NEG) return program.constant(wrapSub(0, a), expr->line);
+        if (expr->op == OP_BIT_NOT) return program.constant(~a, expr->line);
+    }
+    else if (expr->kind == ExprKind::BINARY && isConstant(expr->args[0]) && isConstant(expr->args[1])) {
+        int32_t a = expr->args[0]->value;
+        int32_t b = expr->args[1]->value;
+        // Leave faulting or undefined divisions for the VM to report
+        bool divisible = b != 0 && !(a == INT_MIN && b == -1);
+        switch (expr->op) {
+            case OP_ADD: return program.constant(wrapAdd(a, b), expr->line);
+            case OP_SUB: return program.constant(wrapSub(a, b), expr->line);
+            case OP_MUL: return program.constant(wrapMul(a, b), expr->line);
+            case OP_DIV: if (divisible) return program.constant(a / b, expr->line); break;
+            case OP_MOD: if (divisible) return program.constant(a % b, expr->line); break;
+            case OP_BIT_AND: return program.constant(a & b, expr->line);
+            case OP_BIT_OR: return program.constant(a | b, expr->line);
+            case OP_BIT_XOR: return program.constant(a ^ b, expr->line);
+            case OP_SHL:
+                return program.constant(static_cast<int32_t>(static_cast<uint32_t>(a) << (b & 31)), expr->line);
+            case OP_SHR: return program.constant(a >> (b & 31), expr->line);
+            default: break;
+        }
+    }
+
+    return reduceStrength(expr);
+}
+
+Expr* Optimizer::reduceStrength(Expr* expr) {
+    if (expr->kind != ExprKind::BINARY) return expr;
+
+    Expr* left = expr->args[0];
+    Expr* right = expr->args[1];
+
+    if (expr->op == OP_MUL) {
+        // x * 2^k and 2^k * x both become x << k
+        if (isConstant(left) && !isConstant(right)) {
+            Expr* swap = left;
+            left = right;
+            right = swap;
+        }
+        int k = isConstant(right) ? powerOfTwo(right->value) : -1;
+        if (k >= 0) {
+            return program.binary(OP_SHL, left, program.constant(k, right->line), expr->line);
+        }
+    }
+    else if (expr->op == OP_DIV || expr->op == OP_MOD) {
+        // A plain shift or mask would round negative dividends the wrong
+        // way, so these get their own operations that keep '/' and '%'
+        // semantics
+        int k = isConstant(right) ? powerOfTwo(right->value) : -1;
+        if (k >= 0) {
+            uint8_t op = expr->op == OP_DIV ? OP_DIV_POW2 : OP_MOD_POW2;
+            return program.binary(op, left, program.constant(k, right->line), expr->line);
+        }
+    }
+
+    return expr;
+}
+
+void Optimizer::foldStmt(Stmt* stmt) {
+    if (stmt->expr) {
+        stmt->expr = fold(stmt->expr);
+    }
+    for (Stmt* child : stmt->body) {
+        foldStmt(child);
+    }
+}
+
+// Names every evaluation of the expression is guaranteed to assign. There
+// is no short-circuit evaluation, so that is every assignment in it.
+static void addAssigned(const Expr* expr, ArenaSet<ArenaString>& names) {
+    if (expr->kind == ExprKind::ASSIGN) {
+        names.insert(expr->name);
+    }
+    for (const Expr* arg : expr->args) {
+        addAssigned(arg, names);
+    }
+}
+
+void Optimizer::optimizeStmt(Stmt* stmt, ArenaSet<ArenaString>& defined) {
+    switch (stmt->kind) {
+        case StmtKind::EXPRESSION:
+        case StmtKind::PRINT:
+        case StmtKind::SLEEP:
+        case StmtKind::YIELD:
+            addAssigned(stmt->expr, defined);
+            break;
+
+        case StmtKind::COROUTINE: {
+            // The body runs later, when everything defined by now still is
+            ArenaSet<ArenaString> body = defined;
+            optimizeStmt(stmt->body[0], body);
+            defined.insert(stmt->expr->name);
+            break;
+        }
+
+        case StmtKind::BLOCK:
+            for (Stmt* child : stmt->body) {
+                optimizeStmt(child, defined);
+            }
+            break;
+
+        case StmtKind::IF:
+        case StmtKind::SWITCH: {
+            addAssigned(stmt->expr, defined);
+            // Branches only see what was defined before them
+            for (Stmt* child : stmt->body) {
+                ArenaSet<ArenaString> branch = defined;
+                optimizeStmt(child, branch);
+            }
+            break;
+        }
+
+        case StmtKind::WHILE: {
+            optimizeLoop(stmt, defined);
+            for (Stmt* pre : stmt->preheader) {
+                addAssigned(pre->expr, defined);
+            }
+            addAssigned(stmt->expr, defined);
+            ArenaSet<ArenaString> inner = defined;
+            optimizeStmt(stmt->body[0], inner);
+            break;
+        }
+    }
+}
+
+void Optimizer::optimizeLoop(Stmt* loop, const ArenaSet<ArenaString>& defined) {
+    LoopInfo info;
+    info.writesArrays = false;
+    info.switchesCoroutine = false;
+    collectEffects(loop->expr, info);
+    collectEffects(loop->body[0], info);
+    if (info.switchesCoroutine) return;
+
+    hoistInvariants(loop, info, defined);
+    // A step on a string variable concatenates, which no scaled
+    // temporary can follow
+    if (!program.usesStrings) {
+        reduceInductionVariables(loop, defined);
+    }
+}
+
+void Optimizer::collectEffects(const Expr* expr, LoopInfo& info) {
+    if (expr->kind == ExprKind::ASSIGN) {
+        info.assigned.insert(expr->name);
+    }
+    else if (expr->kind == ExprKind::INDEX_ASSIGN) {
+        info.writesArrays = true;
+    }
+    else if (expr->kind == ExprKind::CALL && nativeTable[expr->value].effect >= NATIVE_WRITES_ARRAYS) {
+        info.writesArrays = true;
+    }
+    else if (expr->kind == ExprKind::RESUME) {
+        info.switchesCoroutine = true;
+    }
+    for (const Expr* arg : expr->args) {
+        collectEffects(arg, info);
+    }
+}
+
+void Optimizer::collectEffects(const Stmt* stmt, LoopInfo& info) {
+    if (stmt->kind == StmtKind::YIELD) {
+        info.switchesCoroutine = true;
+    }
+    else if (stmt->kind == StmtKind::COROUTINE) {
+        // Creating one is not a switch, but its body would be taken for
+        // part of the loop
+        info.assigned.insert(stmt->expr->name);
+        info.switchesCoroutine = true;
+    }
+    for (const Stmt* pre : stmt->preheader) {
+        collectEffects(pre, info);
+    }
+    if (stmt->expr) {
+        collectEffects(stmt->expr, info);
+    }
+    for (const Stmt* child : stmt->body) {
+        collectEffects(child, info);
+    }
+}
+
+bool Optimizer::isInvariant(const Expr* expr, const LoopInfo& info) {
+    switch (expr->kind) {
+        case ExprKind::CONSTANT:
+        case ExprKind::STRING:
+            return true;
+        case ExprKind::VARIABLE:
+            return info.assigned.count(expr->name) == 0;
+        case ExprKind::INDEX:
+            if (info.writesArrays) return false;
+            break;
+        case ExprKind::CALL: {
+            uint8_t effect = nativeTable[expr->value].effect;
+            if (effect == NATIVE_PURE) break;
+            if (effect == NATIVE_READS_ARRAYS && !info.writesArrays) break;
+            return false;
+        }
+        case ExprKind::UNARY:
+        case ExprKind::BINARY:
+            break;
+        default:
+            return false;
+    }
+    for (const Expr* arg : expr->args) {
+        if (!isInvariant(arg, info)) return false;
+    }
+    return true;
+}
+
+// Whether the expression can be evaluated ahead of time on a path that
+// might not have evaluated it at all: it must not be able to fail
+bool Optimizer::isSpeculable(const Expr* expr, const ArenaSet<ArenaString>& defined) {
+    switch (expr->kind) {
+        case ExprKind::CONSTANT:
+            return true;
+        case ExprKind::VARIABLE:
+            return defined.count(expr->name) != 0;
+        case ExprKind::INDEX:
+            if (!expr->unchecked) return false;
+            break;
+        case ExprKind::UNARY:
+            break;
+        case ExprKind::BINARY:
+            // Joining strings fails once the result or the heap is too big
+            if (expr->op == OP_ADD && program.usesStrings) return false;
+            if (expr->op == OP_DIV || expr->op == OP_MOD) {
+                const Expr* divisor = expr->args[1];
+                if (!isConstant(divisor) || divisor->value == 0 || divisor->value == -1) {
+                    return false;
+                }
+            }
+            break;
+        default:
+            return false;
+    }
+    for (const Expr* arg : expr->args) {
+        if (!isSpeculable(arg, defined)) return false;
+    }
+    return true;
+}
+
+void Optimizer::hoistInvariants(Stmt* loop, const LoopInfo& info, const ArenaSet<ArenaString>& defined) {
+    // The condition runs at least once, so anything invariant in it can
+    // move; the body might not run at all
+    hoist(loop->expr, loop, info, defined, false);
+    hoistStmt(loop->body[0], loop, info, defined);
+}
+
+void Optimizer::hoist(Expr*& slot, Stmt* loop, const LoopInfo& info,
+                      const ArenaSet<ArenaString>& defined, bool speculative) {
+    Expr* expr = slot;
+    bool trivial = expr->kind == ExprKind::CONSTANT || expr->kind == ExprKind::VARIABLE ||
+                   expr->kind == ExprKind::STRING;
+    if (trivial) return;
+
+    if (isInvariant(expr, info) && (!speculative || isSpeculable(expr, defined))) {
+        // Reuse the temporary of an identical expression hoisted earlier
+        for (Stmt* pre : loop->preheader) {
+            if (sameExpr(pre->expr->args[0], expr)) {
+                slot = program.variable(pre->expr->name, expr->line);
+                return;
+            }
+        }
+        ArenaString temp = program.newTemp();
+        loop->preheader.push_back(program.expression(program.assign(temp, expr, expr->line), expr->line));
+        slot = program.variable(temp, expr->line);
+        return;
+    }
+
+    for (size_t i = 0; i < expr->args.size(); i++) {
+        hoist(expr->args[i], loop, info, defined, speculative);
+    }
+}
+
+void Optimizer::hoistStmt(Stmt* stmt, Stmt* loop, const LoopInfo& info,
+                          const ArenaSet<ArenaString>& defined) {
+    if (stmt->expr) {
+        hoist(stmt->expr, loop, info, defined, true);
+    }
+    for (Stmt* child : stmt->body) {
+        hoistStmt(child, loop, info, defined);
+    }
+}
+
+// One temporary standing for name * factor
+struct ScaledUse {
+    ArenaString name;
+    uint32_t factor;
+    int savings;
+    Expr* first;
+    ArenaVector<Expr**> slots;
+};
+
+// Match `name * K`, `K * name` or `name << k`; return the scale factor and
+// the instructions a load of a temporary would save
+static bool matchScaled(const Expr* expr, ArenaString& name, uint32_t& factor, int& savings) {
+    if (expr->kind != ExprKind::BINARY) return false;
+    const Expr* left = expr->args[0];
+    const Expr* right = expr->args[1];
+
+    if (expr->op == OP_MUL) {
+        if (isConstant(left)) {
+            const Expr* swap = left;
+            left = right;
+            right = swap;
+        }
+        if (left->kind != ExprKind::VARIABLE || !isConstant(right)) return false;
+        factor = static_cast<uint32_t>(right->value);
+        savings = 2;
+    }
+    else if (expr->op == OP_SHL) {
+        if (left->kind != ExprKind::VARIABLE || !isConstant(right)) return false;
+        factor = 1u << (right->value & 31);
+        savings = 1;
+    }
+    else {
+        return false;
+    }
+    name = left->name;
+    return true;
+}
+
+static void collectScaled(Expr*& slot, const ArenaSet<ArenaString>& candidates,
+                          ArenaVector<ScaledUse>& uses) {
+    ArenaString name;
+    uint32_t factor;
+    int savings;
+    if (matchScaled(slot, name, factor, savings) && candidates.count(name)) {
+        for (ScaledUse& use : uses) {
+            if (use.name == name && use.factor == factor) {
+                use.savings += savings;
+                use.slots.push_back(&slot);
+                return;
+            }
+        }
+        ScaledUse use;
+        use.name = name;
+        use.factor = factor;
+        use.savings = savings;
+        use.first = slot;
+        use.slots.push_back(&slot);
+        uses.push_back(use);
+        return;
+    }
+    for (size_t i = 0; i < slot->args.size(); i++) {
+        collectScaled(slot->args[i], candidates, uses);
+    }
+}
+
+static void collectScaled(Stmt* stmt, const ArenaSet<ArenaString>& candidates,
+                          ArenaVector<ScaledUse>& uses) {
+    for (Stmt* pre : stmt->preheader) {
+        collectScaled(pre, candidates, uses);
+    }
+    if (stmt->expr) {
+        collectScaled(stmt->expr, candidates, uses);
+    }
+    for (Stmt* child : stmt->body) {
+        collectScaled(child, candidates, uses);
+    }
+}
+
+static void countAssignments(const Expr* expr, ArenaMap<ArenaString, int>& counts) {
+    if (expr->kind == ExprKind::ASSIGN) {
+        counts[expr->name]++;
+    }
+    for (const Expr* arg : expr->args) {
+        countAssignments(arg, counts);
+    }
+}
+
+static void countAssignments(const Stmt* stmt, ArenaMap<ArenaString, int>& counts) {
+    for (const Stmt* pre : stmt->preheader) {
+        countAssignments(pre, counts);
+    }
+    if (stmt->expr) {
+        countAssignments(stmt->expr, counts);
+    }
+    for (const Stmt* child : stmt->body) {
+        countAssignments(child, counts);
+    }
+}
+
+// Statement slots holding `name = name +/- C`, wherever they sit in the body
+static void collectSteps(Stmt*& slot, ArenaMap<ArenaString, ArenaVector<Stmt**>>& steps) {
+    ArenaString name;
+    int32_t step;
+    if (isConstantStep(slot, name, step)) {
+        steps[name].push_back(&slot);
+        return;
+    }
+    for (size_t i = 0; i < slot->body.size(); i++) {
+        collectSteps(slot->body[i], steps);
+    }
+}
+
+void Optimizer::reduceInductionVariables(Stmt* loop, const ArenaSet<ArenaString>& defined) {
+    // An induction variable is only ever changed by constant steps, and
+    // must hold a value on entry for the preheader to scale it
+    ArenaMap<ArenaString, int> assignments;
+    countAssignments(loop->expr, assignments);
+    countAssignments(loop->body[0], assignments);
+
+    ArenaMap<ArenaString, ArenaVector<Stmt**>> steps;
+    collectSteps(loop->body[0], steps);
+
+    ArenaSet<ArenaString> candidates;
+    for (const auto& entry : steps) {
+        if (defined.count(entry.first) && assignments[entry.first] == static_cast<int>(entry.second.size())) {
+            candidates.insert(entry.first);
+        }
+    }
+    if (candidates.empty()) return;
+
+    ArenaVector<ScaledUse> uses;
+    collectScaled(loop->expr, candidates, uses);
+    collectScaled(loop->body[0], candidates, uses);
+
+    for (ScaledUse& use : uses) {
+        ArenaVector<Stmt**>& sites = steps[use.name];
+        // Each step costs one extra instruction to keep the temporary in line
+        if (use.savings <= static_cast<int>(sites.size())) continue;
+
+        ArenaString temp = program.newTemp();
+        int line = use.first->line;
+        loop->preheader.push_back(program.expression(program.assign(temp, use.first, line), line));
+        for (Expr** slot : use.slots) {
+            *slot = program.variable(temp, (*slot)->line);
+        }
+
+        for (Stmt**& site : sites) {
+            ArenaString name;
+            int32_t step;
+            isConstantStep(*site, name, step);
+            int32_t delta = static_cast<int32_t>(static_cast<uint32_t>(step) * use.factor);
+            int stepLine = (*site)->line;
+
+            Stmt* block = program.newStmt(StmtKind::BLOCK, stepLine);
+            block->body.push_back(*site);
+            Expr* next = program.binary(OP_ADD, program.variable(temp, stepLine),
+                                        program.constant(delta, stepLine), stepLine);
+            block->body.push_back(program.expression(program.assign(temp, next, stepLine), stepLine));
+            *site = block;
+            // Later temporaries of the same variable wrap the step again
+            site = &block->body[0];
+        }
+    }
+}
+
+static ArenaVector<int> countUses(const ControlFlowGraph& graph) {
+    ArenaVector<int> uses(graph.tempCount, 0);
+    for (const BasicBlock& block : graph.blocks) {
+        for (const Instr& instr : block.instrs) {
+            for (int operand : instr.operands) uses[operand]++;
+        }
+        if (block.term.kind == TermKind::BRANCH || block.term.kind == TermKind::SWITCH) {
+            uses[block.term.operand]++;
+        }
+    }
+    return uses;
+}
+
+// Instructions that can be dropped when their result is unused without
+// hiding a runtime error
+static bool cannotFault(const Instr& instr, bool usesStrings) {
+    switch (instr.kind) {
+        case InstrKind::CONST:
+        case InstrKind::UNARY:
+        case InstrKind::BINARY_IMM:
+            return true;
+        case InstrKind::STRING:
+            // Interning only fails for lack of room, which not creating
+            // the string cannot run into
+            return true;
+        case InstrKind::BINARY:
+            if (instr.op == OP_ADD && usesStrings) return false;
+            return instr.op != OP_DIV && instr.op != OP_MOD;
+        default:
+            return false;
+    }
+}
+
+// Drop unused instructions that cannot fault, along with operands that
+// only they used
+static void removeUnused(BasicBlock& block, ArenaVector<int>& uses, bool usesStrings) {
+    ArenaVector<bool> dead(block.instrs.size(), false);
+    for (size_t i = block.instrs.size(); i-- > 0;) {
+        const Instr& instr = block.instrs[i];
+        if (instr.dest < 0 || uses[instr.dest] > 0 || !cannotFault(instr, usesStrings)) continue;
+        dead[i] = true;
+        for (int operand : instr.operands) uses[operand]--;
+    }
+
+    ArenaVector<Instr> kept;
+    for (size_t i = 0; i < block.instrs.size(); i++) {
+        if (!dead[i]) kept.push_back(block.instrs[i]);
+    }
+    block.instrs.swap(kept);
+}
+
+// Rough cost of evaluating an instruction on the VM; variable access goes
+// through a hashed name lookup and dominates simple arithmetic
+static int instrCost(const Instr& instr) {
+    switch (instr.kind) {
+        case InstrKind::LOAD: return 3;
+        case InstrKind::INDEX_GET: return 2;
+        case InstrKind::CALL: return 6;
+        default: return 1;
+    }
+}
+
+void eliminateCommonSubexpressions(ControlFlowGraph& graph) {
+    const int REMOVED = -2;
+    ArenaVector<int> uses = countUses(graph);
+    ArenaVector<int> number(graph.tempCount);
+    for (int t = 0; t < graph.tempCount; t++) number[t] = t;
+
+    for (BasicBlock& block : graph.blocks) {
+        // Local value numbering: a variable load is keyed by how many stores
+        // to the variable came before it, an array read by how many array
+        // writes did. A coroutine switch may write anything, so it starts
+        // a new epoch for both
+        ArenaMap<ArenaString, int> table;
+        ArenaMap<ArenaString, int> versions;
+        int arrayWrites = 0;
+        int switches = 0;
+        ArenaVector<int> first(block.instrs.size(), -1);
+        ArenaMap<int, size_t> definedAt;
+        ArenaVector<int> cost(block.instrs.size(), 0);
+
+        for (size_t i = 0; i < block.instrs.size(); i++) {
+            const Instr& instr = block.instrs[i];
+            cost[i] = instrCost(instr);
+            for (int operand : instr.operands) {
+                cost[i] += cost[definedAt[operand]];
+            }
+            if (instr.dest >= 0) definedAt[instr.dest] = i;
+
+            bool shareable = false;
+            ArenaString key = arenaNumber(static_cast<long>(instr.kind)) + ":" +
+                              arenaNumber(instr.op) + ":" + arenaNumber(instr.value) +
+                              (instr.unchecked ? "u" : "");
+            switch (instr.kind) {
+                case InstrKind::CONST:
+                case InstrKind::UNARY:
+                case InstrKind::BINARY:
+                case InstrKind::BINARY_IMM:
+                    shareable = true;
+                    break;
+                case InstrKind::STRING:
+                    key += instr.name;
+                    shareable = true;
+                    break;
+                case InstrKind::LOAD:
+                    key += instr.name + "@" + arenaNumber(versions[instr.name]) +
+                           "." + arenaNumber(switches);
+                    shareable = true;
+                    break;
+                case InstrKind::INDEX_GET:
+                    key += "@" + arenaNumber(arrayWrites);
+                    shareable = true;
+                    break;
+                case InstrKind::CALL: {
+                    uint8_t effect = nativeTable[instr.op].effect;
+                    if (effect == NATIVE_READS_ARRAYS) key += "@" + arenaNumber(arrayWrites);
+                    shareable = effect <= NATIVE_READS_ARRAYS;
+                    if (effect >= NATIVE_WRITES_ARRAYS) arrayWrites++;
+                    break;
+                }
+                case InstrKind::STORE:
+                case InstrKind::INC:
+                    versions[instr.name]++;
+                    break;
+                case InstrKind::INDEX_SET:
+                    arrayWrites++;
+                    break;
+                case InstrKind::RESUME:
+                case InstrKind::YIELD:
+                    switches++;
+                    arrayWrites++;
+                    break;
+                default:
+                    break;
+            }
+            if (!shareable) continue;
+
+            for (int operand : instr.operands) {
+                key += "," + arenaNumber(number[operand]);
+            }
+            ArenaMap<ArenaString, int>::iterator found = table.find(key);
+            if (found == table.end()) {
+                table[key] = instr.dest;
+            } else {
+                number[instr.dest] = found->second;
+                first[i] = found->second;
+            }
+        }
+
+        // Most expensive expressions first, so that sharing one makes the
+        // duplicates of its parts disappear with it
+        ArenaVector<size_t> order;
+        for (size_t i = 0; i < block.instrs.size(); i++) {
+            if (first[i] >= 0) order.push_back(i);
+        }
+        std::stable_sort(order.begin(), order.end(), [&cost](size_t a, size_t b) {
+            return cost[a] > cost[b];
+        });
+
+        ArenaSet<int> decided;
+        for (size_t i : order) {
+            int rep = first[i];
+            if (rep < 0 || !decided.insert(rep).second) continue;
+
+            ArenaVector<size_t> copies;
+            for (size_t j : order) {
+                if (first[j] == rep && uses[block.instrs[j].dest] > 0) copies.push_back(j);
+            }
+            // Sharing costs a spill store plus a load per use
+            int n = static_cast<int>(copies.size()) + 1;
+            if (copies.empty() || (n - 1) * cost[i] <= 4 + 3 * n) continue;
+
+            for (size_t j : copies) {
+                int copy = block.instrs[j].dest;
+                for (Instr& user : block.instrs) {
+                    for (int& operand : user.operands) {
+                        if (operand == copy) operand = rep;
+                    }
+                }
+                if (block.term.operand == copy) block.term.operand = rep;
+                uses[rep] += uses[copy];
+                uses[copy] = 0;
+            }
+
+            // Unused duplicates go, together with duplicated operands only
+            // they used; operands come before their users, so one backward
+            // sweep catches the whole tree
+            for (size_t j = block.instrs.size(); j-- > 0;) {
+                const Instr& instr = block.instrs[j];
+                if (first[j] < 0 || uses[instr.dest] > 0) continue;
+                first[j] = REMOVED;
+                for (int operand : instr.operands) uses[operand]--;
+            }
+        }
+
+        ArenaVector<Instr> kept;
+        for (size_t i = 0; i < block.instrs.size(); i++) {
+            if (first[i] != REMOVED) kept.push_back(block.instrs[i]);
+        }
+        block.instrs.swap(kept);
+        removeUnused(block, uses, graph.usesStrings);
+    }
+}
+
+// Whether control may pass to another coroutine, which can read any
+// variable, right after the instruction
+static bool switchesCoroutine(const Instr& instr) {
+    return instr.kind == InstrKind::RESUME || instr.kind == InstrKind::YIELD;
+}
+
+void eliminateDeadStores(ControlFlowGraph& graph) {
+    size_t count = graph.blocks.size();
+    ArenaVector<ArenaSet<ArenaString>> liveIn(count);
+    ArenaVector<ArenaSet<ArenaString>> liveOut(count);
+
+    ArenaSet<ArenaString> everything;
+    for (const BasicBlock& block : graph.blocks) {
+        for (const Instr& instr : block.instrs) {
+            if (instr.kind == InstrKind::LOAD || instr.kind == InstrKind::STORE || instr.kind == InstrKind::INC) {
+                everything.insert(instr.name);
+            }
+        }
+    }
+
+    // Backward liveness of variables; nothing is live once the program
+    // halts, everything once a coroutine switches away
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t b = count; b-- > 0;) {
+            const BasicBlock& block = graph.blocks[b];
+            ArenaSet<ArenaString> live;
+            if (block.term.kind == TermKind::FINISH) live = everything;
+            for (int target : block.term.targets) {
+                live.insert(liveIn[target].begin(), liveIn[target].end());
+            }
+            liveOut[b] = live;
+            for (size_t i = block.instrs.size(); i-- > 0;) {
+                const Instr& instr = block.instrs[i];
+                if (switchesCoroutine(instr)) live = everything;
+                else if (instr.kind == InstrKind::STORE) live.erase(instr.name);
+                else if (instr.kind == InstrKind::LOAD || instr.kind == InstrKind::INC) live.insert(instr.name);
+            }
+            if (live != liveIn[b]) {
+                liveIn[b].swap(live);
+                changed = true;
+            }
+        }
+    }
+
+    ArenaVector<int> uses = countUses(graph);
+    for (size_t b = 0; b < count; b++) {
+        BasicBlock& block = graph.blocks[b];
+        ArenaSet<ArenaString> live = liveOut[b];
+        ArenaVector<bool> dead(block.instrs.size(), false);
+        for (size_t i = block.instrs.size(); i-- > 0;) {
+            const Instr& instr = block.instrs[i];
+            if (switchesCoroutine(instr)) {
+                live = everything;
+            }
+            else if (instr.kind == InstrKind::STORE) {
+                if (live.count(instr.name) == 0) {
+                    dead[i] = true;
+                    uses[instr.operands[0]]--;
+                }
+                live.erase(instr.name);
+            }
+            else if (instr.kind == InstrKind::LOAD || instr.kind == InstrKind::INC) {
+                live.insert(instr.name);
+            }
+        }
+
+        ArenaVector<Instr> kept;
+        for (size_t i = 0; i < block.instrs.size(); i++) {
+            if (!dead[i]) kept.push_back(block.instrs[i]);
+        }
+        block.instrs.swap(kept);
+        removeUnused(block, uses, graph.usesStrings);
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <set>
+#include <string>
+#include <vector>
+#include "IR.h"
+#include "ControlFlowGraph.h"
+
+// Rewrites a parsed Program before code generation:
+//  - folds integer arithmetic on constants
+//  - turns multiply, divide and remainder by a power of two into shifts
+//    and the dedicated DIV_POW2/MOD_POW2 operations
+//  - hoists loop-invariant expressions into the loop preheader
+//  - replaces i*K in loops where i only moves by constant steps with a
+//    temporary that is stepped alongside i
+class Optimizer {
+private:
+    // What a loop's condition and body may modify
+    struct LoopInfo {
+        ArenaSet<ArenaString> assigned;
+        bool writesArrays;
+        // Hands control to a coroutine, or back from one, so code outside
+        // the loop may run in the middle of it and change anything
+        bool switchesCoroutine;
+    };
+
+    Program& program;
+
+    Expr* fold(Expr* expr);
+    void foldStmt(Stmt* stmt);
+    Expr* reduceStrength(Expr* expr);
+
+    void optimizeStmt(Stmt* stmt, ArenaSet<ArenaString>& defined);
+    void optimizeLoop(Stmt* loop, const ArenaSet<ArenaString>& defined);
+
+    void collectEffects(const Expr* expr, LoopInfo& info);
+    void collectEffects(const Stmt* stmt, LoopInfo& info);
+    bool isInvariant(const Expr* expr, const LoopInfo& info);
+    bool isSpeculable(const Expr* expr, const ArenaSet<ArenaString>& defined);
+
+    void hoistInvariants(Stmt* loop, const LoopInfo& info, const ArenaSet<ArenaString>& defined);
+    void hoist(Expr*& slot, Stmt* loop, const LoopInfo& info,
+               const ArenaSet<ArenaString>& defined, bool speculative);
+    void hoistStmt(Stmt* stmt, Stmt* loop, const LoopInfo& info,
+                   const ArenaSet<ArenaString>& defined);
+
+    void reduceInductionVariables(Stmt* loop, const ArenaSet<ArenaString>& defined);
+
+public:
+    Optimizer(Program& prog);
+    void run();
+};
+
+// Passes over the lowered graph. Common subexpressions are shared within a
+// basic block when recomputing them would cost more than keeping the
+// value; stores to variables that are never read again are dropped.
+void eliminateCommonSubexpressions(ControlFlowGraph& graph);
+void eliminateDeadStores(ControlFlowGraph& graph);
+
+// If stmt is `name = name + C` or `name = name - C`, the signed step C
+bool isConstantStep(const Stmt* stmt, ArenaString& name, int32_t& step);
+
+#endif
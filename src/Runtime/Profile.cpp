@@ -0,0 +1,148 @@
+#include "Profile.h"
+#include "ControlFlowGraph.h"
+#include <Utils/Utils.h>
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+
+static const char* PROFILE_HEADER = "espnix-profile 1";
+
+uint32_t codeChecksum(const uint8_t* code, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= code[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t codeChecksum(const std::vector<uint8_t>& code) {
+    return codeChecksum(code.data(), code.size());
+}
+
+std::string profilePath(const std::string& programPath) {
+    return Utils::ReplaceExtension(programPath, ".prof");
+}
+
+std::string formatProfile(uint32_t checksum, const BranchProfile& profile) {
+    char line[48];
+    std::string out = std::string(PROFILE_HEADER) + "\n";
+    snprintf(line, sizeof(line), "checksum %08lx\n", static_cast<unsigned long>(checksum));
+    out += line;
+    for (const auto& entry : profile) {
+        snprintf(line, sizeof(line), "%lu %lu %lu\n", static_cast<unsigned long>(entry.first),
+                 static_cast<unsigned long>(entry.second.taken),
+                 static_cast<unsigned long>(entry.second.notTaken));
+        out += line;
+    }
+    return out;
+}
+
+bool parseProfile(const std::string& text, uint32_t& checksum, BranchProfile& profile) {
+    size_t pos = 0;
+    int lineNumber = 0;
+    bool sawChecksum = false;
+    profile.clear();
+
+    while (pos < text.size()) {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos) end = text.size();
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+        lineNumber++;
+
+        if (lineNumber == 1) {
+            if (line != PROFILE_HEADER) return false;
+            continue;
+        }
+        if (line.empty()) continue;
+
+        const char* cursor = line.c_str();
+        char* next;
+        if (line.compare(0, 9, "checksum ") == 0) {
+            checksum = static_cast<uint32_t>(strtoul(cursor + 9, &next, 16));
+            sawChecksum = next != cursor + 9;
+            continue;
+        }
+
+        uint32_t values[3];
+        for (int i = 0; i < 3; i++) {
+            values[i] = static_cast<uint32_t>(strtoul(cursor, &next, 10));
+            if (next == cursor) return false;
+            cursor = next;
+        }
+        BranchCount count;
+        count.taken = values[1];
+        count.notTaken = values[2];
+        profile[values[0]] = count;
+    }
+
+    return sawChecksum;
+}
+
+ArenaVector<int> profileLayout(const ControlFlowGraph& graph, const ArenaVector<BranchWeights>& weights) {
+    size_t count = graph.blocks.size();
+
+    // Blocks reachable from the entry or a coroutine body without crossing
+    // a branch edge the profile never took are hot; the rest is cold
+    ArenaVector<bool> hot(count, false);
+    ArenaVector<int> pending(1, 0);
+    hot[0] = true;
+    for (int entry : graph.coroutineEntries) {
+        entry = graph.resolve(entry);
+        if (!hot[entry]) {
+            hot[entry] = true;
+            pending.push_back(entry);
+        }
+    }
+    while (!pending.empty()) {
+        int block = pending.back();
+        pending.pop_back();
+        const Terminator& term = graph.blocks[block].term;
+        const BranchWeights& weight = weights[block];
+        for (size_t i = 0; i < term.targets.size(); i++) {
+            if (term.kind == TermKind::BRANCH && weight.known && weight.onTrue + weight.onFalse > 0 &&
+                (i == 0 ? weight.onTrue : weight.onFalse) == 0) {
+                continue;
+            }
+            int target = graph.resolve(term.targets[i]);
+            if (!hot[target]) {
+                hot[target] = true;
+                pending.push_back(target);
+            }
+        }
+    }
+
+    // Grow chains of hot blocks, each continuing with its most frequent
+    // successor, so that successor becomes the fall-through
+    ArenaVector<int> layout;
+    ArenaVector<bool> placed(count, false);
+    for (size_t start = 0; start < count; start++) {
+        int block = static_cast<int>(start);
+        while (block >= 0 && hot[block] && !placed[block]) {
+            placed[block] = true;
+            layout.push_back(block);
+
+            const Terminator& term = graph.blocks[block].term;
+            int next = -1;
+            if (term.kind == TermKind::JUMP) {
+                next = graph.resolve(term.targets[0]);
+            } else if (term.kind == TermKind::BRANCH) {
+                int onTrue = graph.resolve(term.targets[0]);
+                int onFalse = graph.resolve(term.targets[1]);
+                const BranchWeights& weight = weights[block];
+                bool preferFalse = weight.known && weight.onFalse > weight.onTrue;
+                next = preferFalse ? onFalse : onTrue;
+                if (placed[next] || !hot[next]) next = preferFalse ? onTrue : onFalse;
+            }
+            block = next;
+        }
+    }
+
+    for (size_t b = 0; b < count; b++) {
+        if (!placed[b]) layout.push_back(static_cast<int>(b));
+    }
+    return layout;
+}
@@ -0,0 +1,44 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Arena.h"
+
+class ControlFlowGraph;
+
+// How often one conditional jump was taken and fallen through
+struct BranchCount {
+    uint32_t taken;
+    uint32_t notTaken;
+};
+
+// Counts for every OP_JMP_IF/OP_JMP_NOT, keyed by the bytecode address of
+// the jump instruction
+typedef std::map<uint32_t, BranchCount> BranchProfile;
+
+// Identifies the exact bytecode a profile was collected from (FNV-1a)
+uint32_t codeChecksum(const uint8_t* code, size_t size);
+uint32_t codeChecksum(const std::vector<uint8_t>& code);
+
+// Sidecar file a program's profile is kept in: prog.enix -> prog.prof
+std::string profilePath(const std::string& programPath);
+
+// Text form stored in the .prof file next to a program
+std::string formatProfile(uint32_t checksum, const BranchProfile& profile);
+bool parseProfile(const std::string& text, uint32_t& checksum, BranchProfile& profile);
+
+// Measured direction counts of a BRANCH block, if it was profiled
+struct BranchWeights {
+    bool known;
+    uint32_t onTrue;
+    uint32_t onFalse;
+};
+
+// Block order that makes the hot successor of each profiled branch the
+// fall-through and moves blocks the profile never reached to the end
+ArenaVector<int> profileLayout(const ControlFlowGraph& graph, const ArenaVector<BranchWeights>& weights);
+
+#endif
@@ -0,0 +1,40 @@
+#include "ProgramImage.h"
+#include <Drivers/Crypto/Hash.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+ProgramImage::ProgramImage(const std::string& imagePath, const uint8_t* bytes, size_t size, const std::string& codeHash)
+    : path(imagePath), code(bytes, bytes + size), hash(codeHash) {}
+
+std::shared_ptr<const ProgramImage> makeProgramImage(const std::vector<uint8_t>& bytecode) {
+    return std::make_shared<ProgramImage>("", bytecode.data(), bytecode.size(),
+                                          Hash::Sha256(bytecode.data(), bytecode.size()));
+}
+
+// Keyed by path and content hash, so a recompiled file gets a new image
+// while VMs still running the old one keep it
+static std::map<std::string, std::weak_ptr<const ProgramImage>> loadedImages;
+
+std::shared_ptr<const ProgramImage> loadProgramImage(const std::string& path, const std::string& content) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(content.data());
+    std::string hash = Hash::Sha256(bytes, content.size());
+    std::string key = path + '\0' + hash;
+
+    // Drop entries whose programs are no longer running
+    for (auto it = loadedImages.begin(); it != loadedImages.end();) {
+        if (it->second.expired()) it = loadedImages.erase(it);
+        else ++it;
+    }
+
+    auto found = loadedImages.find(key);
+    if (found != loadedImages.end()) {
+        std::shared_ptr<const ProgramImage> image = found->second.lock();
+        if (image) return image;
+    }
+
+    std::shared_ptr<const ProgramImage> image = std::make_shared<ProgramImage>(path, bytes, content.size(), hash);
+    loadedImages[key] = image;
+    return image;
+}
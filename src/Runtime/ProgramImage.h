@@ -0,0 +1,30 @@
+#ifndef PROGRAMIMAGE_H
+#define PROGRAMIMAGE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The immutable part of a loaded program, shared by every VirtualMachine
+// running it; each VM keeps only its own stack, globals and arrays.
+// Variable names and constants are stored inline in the bytecode, so the
+// code and what is derived from it once, its hash, is all there is.
+class ProgramImage {
+public:
+    const std::string path;         // File it was loaded from; empty if none
+    const std::vector<uint8_t> code;
+    const std::string hash;         // SHA-256 of code, as raw bytes
+
+    ProgramImage(const std::string& imagePath, const uint8_t* bytes, size_t size, const std::string& codeHash);
+};
+
+// Image of bytecode that did not come from a file; not shared
+std::shared_ptr<const ProgramImage> makeProgramImage(const std::vector<uint8_t>& bytecode);
+
+// Image of the file at path holding content. While any VM still holds an
+// image of the same path and content it is returned instead of a copy;
+// the cache itself does not keep images alive.
+std::shared_ptr<const ProgramImage> loadProgramImage(const std::string& path, const std::string& content);
+
+#endif
@@ -0,0 +1,7 @@
+#include "Snapshot.h"
+#include <Utils/Utils.h>
+#include <string>
+
+std::string snapshotPath(const std::string& programPath) {
+    return Utils::ReplaceExtension(programPath, ".snap");
+}
@@ -0,0 +1,21 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <string>
+
+class VirtualMachine;
+
+// Receives the VM whenever the running program calls snapshot(); the sink
+// decides where VirtualMachine::snapshot() is stored. The VM is positioned
+// just after the call, with the call's result set to what a restored run
+// should see.
+class SnapshotSink {
+public:
+    virtual ~SnapshotSink() = default;
+    virtual void write(const VirtualMachine& vm) = 0;
+};
+
+// Sidecar file a program's snapshot is kept in: prog.enix -> prog.snap
+std::string snapshotPath(const std::string& programPath);
+
+#endif
@@ -0,0 +1,162 @@
+#include "StringHeap.h"
+#include <stdexcept>
+#include <utility>
+
+StringHeap::StringHeap()
+    : liveCount(0), threshold(MIN_THRESHOLD), liveMark(true), marking(false), sweeping(false), sweepPos(0) {}
+
+int32_t StringHeap::intern(const char* data, size_t length) {
+    if (length > MAX_STRING_LENGTH) {
+        throw std::runtime_error("String too long");
+    }
+
+    ArenaString key(data, length);
+    auto found = interned.find(key);
+    if (found != interned.end()) {
+        // Might be garbage the sweep has not reached yet; it is live again
+        slots[found->second].mark = liveMark;
+        return found->second;
+    }
+
+    if (liveCount >= MAX_STRINGS) {
+        throw std::runtime_error("String memory limit exceeded");
+    }
+    if (slots.empty()) {
+        // Sized once for the limit, so adding a string never rehashes
+        interned.reserve(MAX_STRINGS);
+    }
+
+    int32_t handle;
+    if (!freeSlots.empty()) {
+        handle = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        handle = static_cast<int32_t>(slots.size());
+        slots.push_back(Slot());
+    }
+
+    auto inserted = interned.insert(std::make_pair(key, handle)).first;
+    slots[handle].text = &inserted->first;
+    slots[handle].mark = liveMark;
+    liveCount++;
+    return handle;
+}
+
+const ArenaString& StringHeap::text(int32_t handle) const {
+    return *slots[handle].text;
+}
+
+bool StringHeap::contains(int32_t handle) const {
+    return handle >= 0 && static_cast<size_t>(handle) < slots.size() && slots[handle].text != nullptr;
+}
+
+size_t StringHeap::count() const {
+    return liveCount;
+}
+
+bool StringHeap::cycleDue() const {
+    return !collecting() && liveCount >= threshold;
+}
+
+void StringHeap::beginCycle() {
+    liveMark = !liveMark;
+    marking = true;
+}
+
+void StringHeap::mark(int32_t handle) {
+    slots[handle].mark = liveMark;
+}
+
+bool StringHeap::markingRoots() const {
+    return marking;
+}
+
+void StringHeap::finishMarking() {
+    marking = false;
+    sweeping = true;
+    sweepPos = 0;
+}
+
+void StringHeap::release(size_t slot) {
+    interned.erase(*slots[slot].text);
+    slots[slot].text = nullptr;
+    freeSlots.push_back(static_cast<int32_t>(slot));
+    liveCount--;
+}
+
+void StringHeap::step() {
+    size_t end = sweepPos + SWEEP_STEP;
+    if (end > slots.size()) end = slots.size();
+
+    for (; sweepPos < end; sweepPos++) {
+        if (slots[sweepPos].text && slots[sweepPos].mark != liveMark) {
+            release(sweepPos);
+        }
+    }
+
+    if (sweepPos == slots.size()) {
+        sweeping = false;
+        // Let the heap grow to twice what survived before collecting again
+        threshold = liveCount * 2;
+        if (threshold < MIN_THRESHOLD) threshold = MIN_THRESHOLD;
+        if (threshold > MAX_STRINGS * 3 / 4) threshold = MAX_STRINGS * 3 / 4;
+    }
+}
+
+bool StringHeap::collecting() const {
+    return marking || sweeping;
+}
+
+void StringHeap::clear() {
+    slots.clear();
+    freeSlots.clear();
+    interned.clear();
+    liveCount = 0;
+    threshold = MIN_THRESHOLD;
+    marking = false;
+    sweeping = false;
+    sweepPos = 0;
+}
+
+void StringHeap::swap(StringHeap& other) {
+    slots.swap(other.slots);
+    freeSlots.swap(other.freeSlots);
+    interned.swap(other.interned);
+    std::swap(liveCount, other.liveCount);
+    std::swap(threshold, other.threshold);
+    std::swap(liveMark, other.liveMark);
+    std::swap(marking, other.marking);
+    std::swap(sweeping, other.sweeping);
+    std::swap(sweepPos, other.sweepPos);
+}
+
+bool StringHeap::restore(int32_t handle, const char* data, size_t length) {
+    // Strings come back in handle order, leaving free slots for the gaps
+    if (handle < static_cast<int32_t>(slots.size()) || static_cast<size_t>(handle) >= MAX_STRINGS ||
+        length > MAX_STRING_LENGTH) {
+        return false;
+    }
+    ArenaString key(data, length);
+    if (interned.count(key)) {
+        return false;
+    }
+    if (slots.empty()) {
+        interned.reserve(MAX_STRINGS);
+    }
+
+    while (static_cast<int32_t>(slots.size()) < handle) {
+        freeSlots.push_back(static_cast<int32_t>(slots.size()));
+        slots.push_back(Slot());
+    }
+    slots.push_back(Slot());
+
+    auto inserted = interned.insert(std::make_pair(key, handle)).first;
+    slots[handle].text = &inserted->first;
+    slots[handle].mark = liveMark;
+    liveCount++;
+    return true;
+}
+
+size_t StringHeap::capacity() const {
+    return slots.size();
+}
@@ -0,0 +1,79 @@
+#ifndef STRINGHEAP_H
+#define STRINGHEAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include "Arena.h"
+
+// Longest string a literal or an operation may produce
+const size_t MAX_STRING_LENGTH = 255;
+// Upper bound on the number of strings a program may hold at once
+const size_t MAX_STRINGS = 1024;
+
+// The string values of one VM, referred to by handle. Strings are interned:
+// equal contents always get the same handle, so comparing two strings for
+// equality is comparing their handles.
+//
+// Unreachable strings are reclaimed by an incremental mark-sweep collector.
+// Strings hold no references, so marking only visits the VM's roots; the VM
+// marks a few of them per step, then the heap is swept in steps of at most
+// SWEEP_STEP slots each. Strings created or looked up while a cycle is
+// under way are marked right away, so they survive it.
+class StringHeap {
+private:
+    struct Slot {
+        const ArenaString* text;    // Its key in interned, or nullptr if the slot is free
+        bool mark;
+    };
+
+    static const size_t SWEEP_STEP = 16;
+    static const size_t MIN_THRESHOLD = 64;
+
+    // A deque never moves its elements, so growing it costs no copy
+    std::deque<Slot, ArenaAllocator<Slot>> slots;
+    ArenaVector<int32_t> freeSlots;
+    ArenaStringMap<int32_t> interned;
+    size_t liveCount;       // Occupied slots, garbage not yet swept included
+    size_t threshold;       // liveCount at which the next cycle is due
+    bool liveMark;          // Value of mark that means live; flips each cycle
+    bool marking;           // The VM is still marking roots
+    bool sweeping;
+    size_t sweepPos;
+
+    void release(size_t slot);
+
+public:
+    StringHeap();
+
+    // Handle of the string with these contents, created if there is none
+    int32_t intern(const char* data, size_t length);
+    const ArenaString& text(int32_t handle) const;
+    bool contains(int32_t handle) const;
+    size_t count() const;
+
+    // Enough strings were created since the last cycle to start another
+    bool cycleDue() const;
+    // Starts a cycle; the caller then marks every root, over as many steps
+    // as it likes, and calls finishMarking
+    void beginCycle();
+    void mark(int32_t handle);
+    bool markingRoots() const;
+    void finishMarking();
+    // Sweeps the next few slots, ending the cycle at the last one
+    void step();
+    bool collecting() const;
+
+    void clear();
+    void swap(StringHeap& other);
+    // Puts a string back under the handle it had, for restoring snapshots;
+    // false if the contents are already present
+    bool restore(int32_t handle, const char* data, size_t length);
+    // Handle range for walking every string, free slots included
+    size_t capacity() const;
+
+    StringHeap(const StringHeap&) = delete;
+    StringHeap& operator=(const StringHeap&) = delete;
+};
+
+#endif
@@ -0,0 +1,583 @@
+#include "Translator.h"
+#include "VirtualMachine.h"
+#include "Natives.h"
+#include "Profile.h"
+#include <map>
+#include <iterator>
+#include <set>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdio>
+
+// One instruction as found in the bytecode
+struct DecodedInstr {
+    uint8_t opcode;
+    int32_t operand;                // Inline constant, count, mask or native index
+    uint8_t argc;                   // OP_CALL_NATIVE argument count
+    std::string name;               // Variable of LOAD, STORE, INC and INPUT
+    std::vector<int32_t> keys;      // Switch case values, one per targets[i + 1]
+    std::vector<size_t> targets;    // Jump targets; for switches targets[0] is the default
+    size_t next;                    // Address of the following instruction
+    int depth;                      // Stack depth on entry
+};
+
+class BytecodeReader {
+private:
+    const std::vector<uint8_t>& code;
+    size_t start;
+
+public:
+    size_t pos;
+
+    BytecodeReader(const std::vector<uint8_t>& bytecode, size_t address)
+        : code(bytecode), start(address), pos(address) {}
+
+    uint8_t readByte() {
+        if (pos >= code.size()) {
+            throw std::runtime_error("Truncated instruction at " + std::to_string(start));
+        }
+        return code[pos++];
+    }
+
+    int32_t readInt32() {
+        uint32_t value = readByte();
+        value |= static_cast<uint32_t>(readByte()) << 8;
+        value |= static_cast<uint32_t>(readByte()) << 16;
+        value |= static_cast<uint32_t>(readByte()) << 24;
+        return static_cast<int32_t>(value);
+    }
+
+    size_t readAddress() {
+        // The VM treats addresses as unsigned; anything past the end stops it
+        return static_cast<uint32_t>(readInt32());
+    }
+
+    std::string readString() {
+        uint8_t length = readByte();
+        std::string str;
+        for (uint8_t i = 0; i < length; i++) {
+            str += static_cast<char>(readByte());
+        }
+        return str;
+    }
+};
+
+static DecodedInstr decode(const std::vector<uint8_t>& code, size_t address) {
+    BytecodeReader reader(code, address);
+    DecodedInstr instr;
+    instr.opcode = reader.readByte();
+    instr.operand = 0;
+    instr.argc = 0;
+
+    switch (instr.opcode) {
+        case OP_PUSH:
+        case OP_AND_CONST:
+        case OP_ADD_CONST:
+            instr.operand = reader.readInt32();
+            break;
+
+        case OP_SHL_CONST:
+        case OP_SHR_CONST:
+        case OP_DIV_POW2:
+        case OP_MOD_POW2:
+            instr.operand = reader.readByte();
+            break;
+
+        case OP_LOAD:
+        case OP_STORE:
+        case OP_INPUT:
+            instr.name = reader.readString();
+            break;
+
+        case OP_INC:
+            instr.name = reader.readString();
+            instr.operand = reader.readInt32();
+            break;
+
+        case OP_JMP:
+        case OP_JMP_IF:
+        case OP_JMP_NOT:
+            instr.targets.push_back(reader.readAddress());
+            break;
+
+        case OP_CALL_NATIVE:
+            instr.operand = reader.readByte();
+            instr.argc = reader.readByte();
+            break;
+
+        case OP_TABLESWITCH: {
+            int32_t low = reader.readInt32();
+            uint32_t count = static_cast<uint32_t>(reader.readInt32());
+            instr.targets.push_back(reader.readAddress());
+            if (reader.pos + static_cast<size_t>(count) * 4 > code.size()) {
+                throw std::runtime_error("Switch table out of bounds");
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                instr.keys.push_back(static_cast<int32_t>(static_cast<uint32_t>(low) + i));
+                instr.targets.push_back(reader.readAddress());
+            }
+            break;
+        }
+
+        case OP_LOOKUPSWITCH: {
+            uint32_t count = static_cast<uint32_t>(reader.readInt32());
+            instr.targets.push_back(reader.readAddress());
+            if (reader.pos + static_cast<size_t>(count) * 8 > code.size()) {
+                throw std::runtime_error("Switch table out of bounds");
+            }
+            for (uint32_t i = 0; i < count; i++) {
+                instr.keys.push_back(reader.readInt32());
+                instr.targets.push_back(reader.readAddress());
+                // The VM bisects the table, which a C++ switch only matches
+                // when the keys are sorted and distinct
+                if (i > 0 && instr.keys[i] <= instr.keys[i - 1]) {
+                    throw std::runtime_error("Lookup switch keys out of order at " + std::to_string(address));
+                }
+            }
+            break;
+        }
+
+        case OP_CALL:
+        case OP_RET:
+            throw std::runtime_error("Function calls cannot be translated (at " + std::to_string(address) + ")");
+
+        case OP_PUSH_STRING:
+            throw std::runtime_error("Strings cannot be translated (at " + std::to_string(address) + ")");
+
+        case OP_NEW_COROUTINE:
+        case OP_RESUME:
+        case OP_YIELD:
+        case OP_END_COROUTINE:
+            throw std::runtime_error("Coroutines cannot be translated (at " + std::to_string(address) + ")");
+
+        default:
+            if (instr.opcode > OP_INC) {
+                throw std::runtime_error("Unknown opcode: " + std::to_string(instr.opcode));
+            }
+            break;
+    }
+
+    instr.next = reader.pos;
+    return instr;
+}
+
+// Values an instruction pops and pushes
+static void stackEffect(const DecodedInstr& instr, int& pops, int& pushes) {
+    pops = 0;
+    pushes = 0;
+    switch (instr.opcode) {
+        case OP_PUSH:
+        case OP_LOAD:
+            pushes = 1;
+            break;
+
+        case OP_POP:
+        case OP_JMP_IF:
+        case OP_JMP_NOT:
+        case OP_PRINT:
+        case OP_SLEEP:
+        case OP_TABLESWITCH:
+        case OP_LOOKUPSWITCH:
+            pops = 1;
+            break;
+
+        case OP_NEG:
+        case OP_NOT:
+        case OP_BIT_NOT:
+        case OP_STORE:
+        case OP_NEW_ARRAY:
+        case OP_SHL_CONST:
+        case OP_SHR_CONST:
+        case OP_AND_CONST:
+        case OP_ADD_CONST:
+        case OP_DIV_POW2:
+        case OP_MOD_POW2:
+            pops = 1;
+            pushes = 1;
+            break;
+
+        case OP_INDEX_SET:
+        case OP_INDEX_SET_UNCHECKED:
+            pops = 3;
+            pushes = 1;
+            break;
+
+        case OP_CALL_NATIVE:
+            pops = instr.argc;
+            pushes = 1;
+            break;
+
+        case OP_JMP:
+        case OP_INPUT:
+        case OP_HALT:
+        case OP_INC:
+            break;
+
+        default:
+            // Binary operators and array reads
+            pops = 2;
+            pushes = 1;
+            break;
+    }
+}
+
+static bool fallsThrough(uint8_t opcode) {
+    return opcode != OP_JMP && opcode != OP_HALT &&
+           opcode != OP_TABLESWITCH && opcode != OP_LOOKUPSWITCH;
+}
+
+static std::string slot(int index) {
+    return "s" + std::to_string(index);
+}
+
+// int32_t literal that is valid C++ for every value, INT32_MIN included
+static std::string intLiteral(int32_t value) {
+    if (value == INT32_MIN) return "(-2147483647 - 1)";
+    return std::to_string(value);
+}
+
+static std::string quote(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (byte < 32 || byte > 126) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\%03o", byte);
+            out += escape;
+        } else {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+static std::string identifier(const std::string& name) {
+    std::string out;
+    for (char c : name) {
+        bool word = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+        out += word ? c : '_';
+    }
+    return out;
+}
+
+std::string translateProgram(const std::vector<uint8_t>& code, const std::string& name) {
+    // Walk every reachable instruction, fixing the stack depth at each
+    // address; bytecode whose depth depends on the path taken has no
+    // static translation
+    std::map<size_t, DecodedInstr> instrs;
+    std::set<size_t> labels;
+    std::map<std::string, int> variables;
+    std::vector<std::string> variableNames;
+    std::set<int> checked;      // Variables that are read, so need a defined flag
+    int maxDepth = 0;
+
+    std::vector<std::pair<size_t, int>> pending(1, std::make_pair(static_cast<size_t>(0), 0));
+    while (!pending.empty()) {
+        size_t address = pending.back().first;
+        int depth = pending.back().second;
+        pending.pop_back();
+        if (address >= code.size()) continue;
+
+        auto found = instrs.find(address);
+        if (found != instrs.end()) {
+            if (found->second.depth != depth) {
+                throw std::runtime_error("Stack depth differs between paths at " + std::to_string(address));
+            }
+            continue;
+        }
+
+        DecodedInstr instr = decode(code, address);
+        instr.depth = depth;
+        int pops, pushes;
+        stackEffect(instr, pops, pushes);
+        if (depth < pops) {
+            throw std::runtime_error("Stack underflow at " + std::to_string(address));
+        }
+        if (instr.opcode == OP_CALL_NATIVE &&
+            (static_cast<size_t>(instr.operand) >= nativeCount || instr.argc != nativeTable[instr.operand].arity)) {
+            throw std::runtime_error("Invalid native call: " + std::to_string(instr.operand));
+        }
+        if (instr.opcode == OP_CALL_NATIVE && instr.operand == findNative("snapshot")) {
+            // There is no interpreter state to capture or resume from
+            throw std::runtime_error("snapshot() needs the interpreter and cannot be translated");
+        }
+        if (instr.opcode == OP_CALL_NATIVE &&
+            (instr.operand == findNative("chan_send") || instr.operand == findNative("chan_recv"))) {
+            // Waiting on a channel hands control back to the interpreter's scheduler
+            throw std::runtime_error(std::string(nativeTable[instr.operand].name) +
+                                     "() needs the interpreter and cannot be translated");
+        }
+        if ((instr.opcode == OP_DIV_POW2 || instr.opcode == OP_MOD_POW2) && instr.operand > 31) {
+            throw std::runtime_error("Invalid power of two at " + std::to_string(address));
+        }
+
+        if (instr.opcode == OP_LOAD || instr.opcode == OP_STORE ||
+            instr.opcode == OP_INC || instr.opcode == OP_INPUT) {
+            if (variables.find(instr.name) == variables.end()) {
+                variables[instr.name] = static_cast<int>(variableNames.size());
+                variableNames.push_back(instr.name);
+            }
+            if (instr.opcode == OP_LOAD || instr.opcode == OP_INC) {
+                checked.insert(variables[instr.name]);
+            }
+        }
+
+        int after = depth - pops + pushes;
+        if (after > maxDepth) maxDepth = after;
+        if (fallsThrough(instr.opcode)) {
+            pending.push_back(std::make_pair(instr.next, after));
+        }
+        for (size_t target : instr.targets) {
+            pending.push_back(std::make_pair(target, after));
+            if (target < code.size()) labels.insert(target);
+        }
+        instrs[address] = instr;
+    }
+
+    uint32_t checksum = codeChecksum(code);
+    std::string function = "run_" + identifier(name);
+    char checksumText[16];
+    snprintf(checksumText, sizeof(checksumText), "0x%08lxu", static_cast<unsigned long>(checksum));
+
+    bool usesInput = false, usesSleep = false;
+    for (const auto& entry : instrs) {
+        if (entry.second.opcode == OP_INPUT) usesInput = true;
+        if (entry.second.opcode == OP_SLEEP) usesSleep = true;
+    }
+
+    std::string out;
+    out += "// Generated by enix2cpp from " + name + ".enix; do not edit.\n";
+    out += "// Linked into the firmware, it replaces the interpreter for `run " + name + ".enix`\n";
+    out += "// as long as the bytecode still matches.\n";
+    out += "#include <Runtime/NativePrograms.h>\n";
+    out += "#include <Runtime/Natives.h>\n";
+    if (usesInput) out += "#include <iostream>\n";
+    if (usesSleep) out += "#include <unistd.h>\n";
+    out += "#include <stdexcept>\n\n";
+    out += "static void " + function + "(VirtualMachine& vm) {\n";
+    out += "    (void)vm;\n";
+    if (maxDepth > 0) {
+        out += "    Value";
+        for (int i = 0; i < maxDepth; i++) {
+            out += (i ? ", " : " ") + slot(i);
+        }
+        out += ";\n";
+    }
+    for (size_t i = 0; i < variableNames.size(); i++) {
+        out += "    Value v" + std::to_string(i) + ";";
+        if (checked.count(static_cast<int>(i))) {
+            out += " bool d" + std::to_string(i) + " = false;";
+        }
+        out += "  // " + quote(variableNames[i]) + "\n";
+    }
+
+    auto jumpTo = [&](size_t target) -> std::string {
+        return target >= code.size() ? "return;" : "goto a" + std::to_string(target) + ";";
+    };
+
+    for (auto it = instrs.begin(); it != instrs.end(); ++it) {
+        size_t address = it->first;
+        const DecodedInstr& instr = it->second;
+        int depth = instr.depth;
+        std::string top = depth > 0 ? slot(depth - 1) : "";
+        std::string below = depth > 1 ? slot(depth - 2) : "";
+        std::string var, defined;
+        if (variables.find(instr.name) != variables.end()) {
+            int index = variables[instr.name];
+            var = "v" + std::to_string(index);
+            if (checked.count(index)) defined = "d" + std::to_string(index);
+        }
+        std::string guard = defined.empty() ? "" :
+            "if (!" + defined + ") throwUndefinedVariable(" + quote(instr.name) + ");\n    ";
+        std::string define = defined.empty() ? "" : " " + defined + " = true;";
+
+        if (labels.count(address)) {
+            out += "a" + std::to_string(address) + ":\n";
+        }
+        std::string line;
+        switch (instr.opcode) {
+            case OP_PUSH:
+                line = slot(depth) + " = Value(int32_t(" + intLiteral(instr.operand) + "));";
+                break;
+            case OP_POP:
+                break;
+
+            case OP_ADD:
+            case OP_SUB:
+            case OP_MUL: {
+                const char* op = instr.opcode == OP_ADD ? " + " : instr.opcode == OP_SUB ? " - " : " * ";
+                line = below + " = Value(int32_t(uint32_t(" + below + ".toInt())" + op + "uint32_t(" + top + ".toInt())));";
+                break;
+            }
+            case OP_DIV:
+                line = "if (" + top + ".toInt() == 0) throw std::runtime_error(\"Division by zero\");\n    " +
+                       below + " = Value(" + below + ".toInt() / " + top + ".toInt());";
+                break;
+            case OP_MOD:
+                line = below + " = Value(" + below + ".toInt() % " + top + ".toInt());";
+                break;
+            case OP_NEG:
+                line = top + " = Value(int32_t(0u - uint32_t(" + top + ".toInt())));";
+                break;
+
+            case OP_EQ:
+            case OP_NE:
+            case OP_LT:
+            case OP_LE:
+            case OP_GT:
+            case OP_GE:
+            case OP_BIT_AND:
+            case OP_BIT_OR:
+            case OP_BIT_XOR: {
+                static const char* const ops[] = {" == ", " != ", " < ", " <= ", " > ", " >= "};
+                const char* op = instr.opcode == OP_BIT_AND ? " & " : instr.opcode == OP_BIT_OR ? " | " :
+                                 instr.opcode == OP_BIT_XOR ? " ^ " : ops[instr.opcode - OP_EQ];
+                line = below + " = Value(" + below + ".toInt()" + op + top + ".toInt());";
+                break;
+            }
+            case OP_AND:
+            case OP_OR:
+                line = below + " = Value(" + below + ".toBool()" + (instr.opcode == OP_AND ? " && " : " || ") +
+                       top + ".toBool());";
+                break;
+            case OP_NOT:
+                line = top + " = Value(!" + top + ".toBool());";
+                break;
+            case OP_BIT_NOT:
+                line = top + " = Value(~" + top + ".toInt());";
+                break;
+
+            case OP_SHL:
+                line = below + " = Value(int32_t(uint32_t(" + below + ".toInt()) << (" + top + ".toInt() & 31)));";
+                break;
+            case OP_SHR:
+                line = below + " = Value(" + below + ".toInt() >> (" + top + ".toInt() & 31));";
+                break;
+            case OP_SHL_CONST:
+                line = top + " = Value(int32_t(uint32_t(" + top + ".toInt()) << " + std::to_string(instr.operand & 31) + "));";
+                break;
+            case OP_SHR_CONST:
+                line = top + " = Value(" + top + ".toInt() >> " + std::to_string(instr.operand & 31) + ");";
+                break;
+            case OP_AND_CONST:
+                line = top + " = Value(" + top + ".toInt() & int32_t(" + intLiteral(instr.operand) + "));";
+                break;
+            case OP_ADD_CONST:
+                line = top + " = Value(int32_t(uint32_t(" + top + ".toInt()) + uint32_t(" + intLiteral(instr.operand) + ")));";
+                break;
+            case OP_DIV_POW2:
+            case OP_MOD_POW2: {
+                // Same rounding toward zero as divPow2 in the VM
+                std::string k = std::to_string(instr.operand);
+                std::string mask = std::to_string((1u << instr.operand) - 1) + "u";
+                line = "{ int32_t value = " + top + ".toInt(); int32_t quotient = (value + int32_t(uint32_t(value >> 31) & " +
+                       mask + ")) >> " + k + "; ";
+                if (instr.opcode == OP_DIV_POW2) {
+                    line += top + " = Value(quotient); }";
+                } else {
+                    line += top + " = Value(int32_t(uint32_t(value) - (uint32_t(quotient) << " + k + "))); }";
+                }
+                break;
+            }
+
+            case OP_LOAD:
+                line = guard + slot(depth) + " = " + var + ";";
+                break;
+            case OP_STORE:
+                line = var + " = " + top + ";" + define;
+                break;
+            case OP_INC:
+                line = guard + var + " = Value(int32_t(uint32_t(" + var + ".toInt()) + uint32_t(" + intLiteral(instr.operand) + ")));";
+                break;
+            case OP_INPUT:
+                line = "{ int32_t value; std::cin >> value; " + var + " = Value(value);" + define + " }";
+                break;
+
+            case OP_JMP:
+                line = jumpTo(instr.targets[0]);
+                break;
+            case OP_JMP_IF:
+                line = "if (" + top + ".toBool()) " + jumpTo(instr.targets[0]);
+                break;
+            case OP_JMP_NOT:
+                line = "if (!" + top + ".toBool()) " + jumpTo(instr.targets[0]);
+                break;
+            case OP_TABLESWITCH:
+            case OP_LOOKUPSWITCH:
+                line = "switch (" + top + ".toInt()) {";
+                for (size_t i = 0; i < instr.keys.size(); i++) {
+                    if (instr.targets[i + 1] == instr.targets[0]) continue;
+                    line += " case " + intLiteral(instr.keys[i]) + ": " + jumpTo(instr.targets[i + 1]);
+                }
+                line += " default: " + jumpTo(instr.targets[0]) + " }";
+                break;
+
+            case OP_PRINT:
+                line = "vm.printValue(" + top + ");";
+                break;
+            case OP_SLEEP:
+                line = "sleep(" + top + ".toInt());";
+                break;
+            case OP_HALT:
+                line = "return;";
+                break;
+
+            case OP_NEW_ARRAY:
+                line = top + " = vm.newArray(" + top + ".toInt());";
+                break;
+            case OP_INDEX_GET:
+                line = below + " = Value(checkedElement(vm, " + below + ", " + top + ".toInt()));";
+                break;
+            case OP_INDEX_GET_UNCHECKED:
+                line = below + " = Value(vm.arrayRef(" + below + ")[" + top + ".toInt()]);";
+                break;
+            case OP_INDEX_SET:
+            case OP_INDEX_SET_UNCHECKED: {
+                std::string array = slot(depth - 3);
+                line = instr.opcode == OP_INDEX_SET
+                    ? "checkedElement(vm, " + array + ", " + below + ".toInt())"
+                    : "vm.arrayRef(" + array + ")[" + below + ".toInt()]";
+                line += " = " + top + ".toInt(); " + array + " = " + top + ";";
+                break;
+            }
+
+            case OP_CALL_NATIVE: {
+                const NativeFunction& native = nativeTable[instr.operand];
+                std::string first = slot(depth - instr.argc);
+                std::string call = "nativeTable[" + std::to_string(instr.operand) + "].function(vm, ";
+                if (instr.argc == 0) {
+                    line = first + " = " + call + "nullptr, 0);";
+                } else {
+                    line = "{ Value args[] = {";
+                    for (int i = 0; i < instr.argc; i++) {
+                        line += (i ? ", " : "") + slot(depth - instr.argc + i);
+                    }
+                    line += "}; " + first + " = " + call + "args, " + std::to_string(instr.argc) + "); }";
+                }
+                line += "  // " + std::string(native.name);
+                break;
+            }
+        }
+        if (!line.empty()) {
+            out += "    " + line + "\n";
+        } else if (labels.count(address)) {
+            out += "    ;\n";
+        }
+
+        // Continue where the VM would if the next instruction emitted is
+        // not the one that follows in the bytecode
+        auto following = std::next(it);
+        size_t nextAddress = following == instrs.end() ? code.size() : following->first;
+        if (fallsThrough(instr.opcode) && instr.next != nextAddress) {
+            out += "    " + jumpTo(instr.next) + "\n";
+        }
+    }
+
+    out += "}\n\n";
+    out += "static NativeProgramRegistrar registrar(" + quote(name) + ", " + checksumText + ", " + function + ");\n";
+    return out;
+}
@@ -0,0 +1,16 @@
+#ifndef TRANSLATOR_H
+#define TRANSLATOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Ahead-of-time translation of .enix bytecode to C++ (enix2cpp). The VM
+// stack is resolved at translation time: every stack slot becomes a local
+// Value, every variable a local with a defined flag, and jumps become
+// gotos, so the result runs without dispatch or name lookups. The output
+// registers itself as a native program under name (see NativePrograms.h).
+// Throws if the bytecode uses something that cannot be translated.
+std::string translateProgram(const std::vector<uint8_t>& code, const std::string& name);
+
+#endif
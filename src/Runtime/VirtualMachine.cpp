@@ -1,46 +1,467 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstring>
 #include <stdexcept>
+#include <unistd.h>
 
 #include "VirtualMachine.h"
+#include "Natives.h"
+#include "Snapshot.h"
+#include "Channel.h"
 
-Value::Value() : type(ValueType::NIL), intValue(0) {}
-
-Value::Value(int32_t val) : type(ValueType::INTEGER), intValue(val) {}
-
-Value::Value(bool val) : type(ValueType::BOOLEAN), intValue(val ? 1 : 0) {}
+std::string Value::toString() const {
+    if (type == ValueType::BOOLEAN) return intValue ? "true" : "false";
+    if (type == ValueType::INTEGER) return std::to_string(intValue);
+    if (type == ValueType::ARRAY) return "array";
+    if (type == ValueType::MAP) return "map";
+    if (type == ValueType::COROUTINE) return "coroutine";
+    if (type == ValueType::STRING) return "string";
+    return "nil";
+}
 
-bool Value::toBool() const {
-    if (type == ValueType::BOOLEAN) return intValue != 0;
-    if (type == ValueType::INTEGER) return intValue != 0;
-    return false;
+// Shifts go through uint32_t so left shifts of negative values are defined
+static int32_t shiftLeft(int32_t value, int32_t count) {
+    return static_cast<int32_t>(static_cast<uint32_t>(value) << (count & 31));
 }
 
-int32_t Value::toInt() const {
-    return intValue;
+static int32_t shiftRight(int32_t value, int32_t count) {
+    return value >> (count & 31);
 }
 
-std::string Value::toString() const {
-    if (type == ValueType::BOOLEAN) return intValue ? "true" : "false";
-    if (type == ValueType::INTEGER) return std::to_string(intValue);
-    return "nil";
+// Signed division by 2^k that truncates toward zero like '/': negative
+// dividends are biased by 2^k - 1 before the arithmetic shift
+static int32_t divPow2(int32_t value, uint8_t k) {
+    int32_t bias = static_cast<int32_t>(static_cast<uint32_t>(value >> 31) & ((1u << k) - 1));
+    return (value + bias) >> k;
 }
 
 CallFrame::CallFrame(size_t ret, size_t fp) : returnAddress(ret), framePointer(fp) {}
 
-VirtualMachine::VirtualMachine() : ip(0), fp(0) {}
+VirtualMachine::VirtualMachine()
+    : code(nullptr), codeSize(0), arrayCells(0), mapSlots(0), ip(0), fp(0),
+      roots(), mainContext(), runningCoroutine(-1), profile(nullptr), snapshotSink(nullptr), snapshotRequested(false),
+      channels(nullptr), waiting(false) {}
 
-void VirtualMachine::load(const std::vector<uint8_t>& bytecode) {
-    code = bytecode;
+void VirtualMachine::load(std::shared_ptr<const ProgramImage> image) {
+    program = image;
+    code = program->code.data();
+    codeSize = program->code.size();
     ip = 0;
     fp = 0;
     stack.clear();
     globals.clear();
     callStack.clear();
+    arrays.clear();
+    arrayCells = 0;
+    maps.clear();
+    mapSlots = 0;
+    strings.clear();
+    stringConstants.clear();
+    coroutines.clear();
+    mainContext.stack.clear();
+    mainContext.callStack.clear();
+    runningCoroutine = -1;
+    snapshotRequested = false;
+    waiting = false;
+}
+
+void VirtualMachine::load(const std::vector<uint8_t>& bytecode) {
+    load(makeProgramImage(bytecode));
+}
+
+void VirtualMachine::setProfile(BranchProfile* counts) {
+    profile = counts;
+}
+
+void VirtualMachine::setSnapshotSink(SnapshotSink* sink) {
+    snapshotSink = sink;
+}
+
+void VirtualMachine::setChannels(ChannelSet* set) {
+    channels = set;
+}
+
+Value VirtualMachine::requestSnapshot() {
+    if (snapshotSink == nullptr) {
+        return Value(-1);
+    }
+    snapshotRequested = true;
+    return Value(0);
+}
+
+// Snapshot images: "ESNP", a version byte, the program path, the code
+// hash, then ip, fp, arrays, strings, maps, stack, globals, call stack
+// and coroutines. Integers are stored as LEB128 varints, signed ones
+// zigzag encoded, so the small values that make up most state take a byte
+// or two. Sections added later are missing from older images: strings
+// came with version 2, maps with 3 and coroutines with 4.
+static const char SNAPSHOT_MAGIC[] = "ESNP";
+static const uint8_t SNAPSHOT_VERSION = 4;
+
+static void writeUnsigned(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+static void writeSigned(std::vector<uint8_t>& out, int32_t value) {
+    writeUnsigned(out, (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31));
+}
+
+template <class Bytes>
+static void writeBytes(std::vector<uint8_t>& out, const Bytes& bytes) {
+    writeUnsigned(out, static_cast<uint32_t>(bytes.size()));
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+static void writeValue(std::vector<uint8_t>& out, const Value& value) {
+    out.push_back(static_cast<uint8_t>(value.type));
+    writeSigned(out, value.intValue);
+}
+
+static void writeContext(std::vector<uint8_t>& out, const Coroutine& context) {
+    writeUnsigned(out, static_cast<uint32_t>(context.ip));
+    writeUnsigned(out, static_cast<uint32_t>(context.fp));
+    writeUnsigned(out, static_cast<uint32_t>(context.stack.size()));
+    for (const Value& value : context.stack) {
+        writeValue(out, value);
+    }
+    writeUnsigned(out, static_cast<uint32_t>(context.callStack.size()));
+    for (const CallFrame& frame : context.callStack) {
+        writeUnsigned(out, static_cast<uint32_t>(frame.returnAddress));
+        writeUnsigned(out, static_cast<uint32_t>(frame.framePointer));
+    }
+}
+
+class SnapshotReader {
+private:
+    const std::vector<uint8_t>& image;
+    size_t pos;
+
+public:
+    uint8_t version;
+
+    explicit SnapshotReader(const std::vector<uint8_t>& data) : image(data), pos(0), version(0) {}
+
+    bool atEnd() const {
+        return pos == image.size();
+    }
+
+    uint8_t readByte() {
+        if (pos >= image.size()) {
+            throw std::runtime_error("Corrupt snapshot");
+        }
+        return image[pos++];
+    }
+
+    uint32_t readUnsigned() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte = readByte();
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Corrupt snapshot");
+    }
+
+    int32_t readSigned() {
+        uint32_t value = readUnsigned();
+        return static_cast<int32_t>((value >> 1) ^ (0u - (value & 1)));
+    }
+
+    // Element count that the rest of the image can actually hold
+    uint32_t readCount() {
+        uint32_t count = readUnsigned();
+        if (count > image.size() - pos) {
+            throw std::runtime_error("Corrupt snapshot");
+        }
+        return count;
+    }
+
+    std::string readBytes() {
+        uint32_t length = readCount();
+        std::string bytes(image.begin() + pos, image.begin() + pos + length);
+        pos += length;
+        return bytes;
+    }
+
+    Value readValue() {
+        uint8_t type = readByte();
+        if (type > static_cast<uint8_t>(ValueType::COROUTINE)) {
+            throw std::runtime_error("Corrupt snapshot");
+        }
+        return Value(static_cast<ValueType>(type), readSigned());
+    }
+
+    // A saved execution context; false if it points outside the code or
+    // its own stack
+    bool readContext(Coroutine& context, size_t codeSize) {
+        context.ip = readUnsigned();
+        context.fp = readUnsigned();
+        context.stack.resize(readCount());
+        for (Value& value : context.stack) {
+            value = readValue();
+        }
+        uint32_t frameCount = readCount();
+        for (uint32_t i = 0; i < frameCount; i++) {
+            size_t returnAddress = readUnsigned();
+            size_t framePointer = readUnsigned();
+            if (returnAddress > codeSize || framePointer > context.stack.size()) return false;
+            context.callStack.emplace_back(returnAddress, framePointer);
+        }
+        return context.ip <= codeSize && context.fp <= context.stack.size();
+    }
+
+    bool readHeader(std::string& program) {
+        for (int i = 0; i < 4; i++) {
+            if (pos >= image.size() || image[pos++] != static_cast<uint8_t>(SNAPSHOT_MAGIC[i])) return false;
+        }
+        version = readByte();
+        if (version < 1 || version > SNAPSHOT_VERSION) return false;
+        program = readBytes();
+        return true;
+    }
+};
+
+std::vector<uint8_t> VirtualMachine::snapshot() const {
+    std::vector<uint8_t> out(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 4);
+    out.push_back(SNAPSHOT_VERSION);
+    writeBytes(out, program->path);
+    writeBytes(out, program->hash);
+    writeUnsigned(out, static_cast<uint32_t>(ip));
+    writeUnsigned(out, static_cast<uint32_t>(fp));
+
+    writeUnsigned(out, static_cast<uint32_t>(arrays.size()));
+    for (const ArenaVector<int32_t>& array : arrays) {
+        writeUnsigned(out, static_cast<uint32_t>(array.size()));
+        for (int32_t element : array) {
+            writeSigned(out, element);
+        }
+    }
+
+    writeUnsigned(out, static_cast<uint32_t>(strings.count()));
+    for (size_t handle = 0; handle < strings.capacity(); handle++) {
+        if (strings.contains(static_cast<int32_t>(handle))) {
+            writeUnsigned(out, static_cast<uint32_t>(handle));
+            writeBytes(out, strings.text(static_cast<int32_t>(handle)));
+        }
+    }
+
+    writeUnsigned(out, static_cast<uint32_t>(maps.size()));
+    for (const IntMap& map : maps) {
+        writeUnsigned(out, static_cast<uint32_t>(map.size()));
+        for (size_t slot = 0; slot < map.capacity(); slot++) {
+            int32_t key, value;
+            if (map.entry(slot, key, value)) {
+                writeSigned(out, key);
+                writeSigned(out, value);
+            }
+        }
+    }
+
+    writeUnsigned(out, static_cast<uint32_t>(stack.size()));
+    for (const Value& value : stack) {
+        writeValue(out, value);
+    }
+
+    writeUnsigned(out, static_cast<uint32_t>(globals.size()));
+    for (const auto& global : globals) {
+        writeBytes(out, global.first);
+        writeValue(out, global.second);
+    }
+
+    writeUnsigned(out, static_cast<uint32_t>(callStack.size()));
+    for (const CallFrame& frame : callStack) {
+        writeUnsigned(out, static_cast<uint32_t>(frame.returnAddress));
+        writeUnsigned(out, static_cast<uint32_t>(frame.framePointer));
+    }
+
+    // The running context is the one above; the others are saved here
+    writeSigned(out, runningCoroutine);
+    writeContext(out, mainContext);
+    writeUnsigned(out, static_cast<uint32_t>(coroutines.size()));
+    for (const Coroutine& coroutine : coroutines) {
+        out.push_back(static_cast<uint8_t>(coroutine.state));
+        writeSigned(out, coroutine.caller);
+        writeContext(out, coroutine);
+    }
+    return out;
+}
+
+bool VirtualMachine::snapshotProgram(const std::vector<uint8_t>& image, std::string& program) {
+    try {
+        SnapshotReader reader(image);
+        return reader.readHeader(program);
+    } catch (const std::runtime_error&) {
+        return false;
+    }
+}
+
+bool VirtualMachine::restore(const std::vector<uint8_t>& image) {
+    SnapshotReader reader(image);
+    std::string programPath;
+    if (!reader.readHeader(programPath)) {
+        throw std::runtime_error("Not a snapshot");
+    }
+    if (reader.readBytes() != program->hash) {
+        return false;
+    }
+
+    // Decode into fresh state first so a damaged image changes nothing
+    size_t newIp = reader.readUnsigned();
+    size_t newFp = reader.readUnsigned();
+
+    ArenaVector<ArenaVector<int32_t>> newArrays(reader.readCount());
+    size_t cells = 0;
+    for (ArenaVector<int32_t>& array : newArrays) {
+        array.resize(reader.readCount());
+        cells += array.size();
+        for (int32_t& element : array) {
+            element = reader.readSigned();
+        }
+    }
+
+    StringHeap newStrings;
+    uint32_t stringCount = reader.version >= 2 ? reader.readCount() : 0;
+    for (uint32_t i = 0; i < stringCount; i++) {
+        uint32_t handle = reader.readUnsigned();
+        std::string text = reader.readBytes();
+        if (!newStrings.restore(static_cast<int32_t>(handle), text.data(), text.size())) {
+            throw std::runtime_error("Corrupt snapshot");
+        }
+    }
+
+    ArenaVector<IntMap> newMaps(reader.version >= 3 ? reader.readCount() : 0);
+    size_t slots = 0;
+    for (IntMap& map : newMaps) {
+        uint32_t entryCount = reader.readCount();
+        for (uint32_t i = 0; i < entryCount; i++) {
+            int32_t key = reader.readSigned();
+            int32_t value = reader.readSigned();
+            if (map.full()) {
+                slots += map.grownCapacity() - map.capacity();
+                if (slots > MAX_MAP_SLOTS) {
+                    throw std::runtime_error("Corrupt snapshot");
+                }
+                map.rehash(map.grownCapacity());
+            }
+            map.set(key, value);
+        }
+    }
+
+    ArenaVector<Value> newStack(reader.readCount());
+    for (Value& value : newStack) {
+        value = reader.readValue();
+    }
+
+    ArenaStringMap<Value> newGlobals;
+    uint32_t globalCount = reader.readCount();
+    for (uint32_t i = 0; i < globalCount; i++) {
+        std::string name = reader.readBytes();
+        newGlobals[ArenaString(name.begin(), name.end())] = reader.readValue();
+    }
+
+    ArenaVector<CallFrame> newCallStack;
+    uint32_t frameCount = reader.readCount();
+    for (uint32_t i = 0; i < frameCount; i++) {
+        size_t returnAddress = reader.readUnsigned();
+        size_t framePointer = reader.readUnsigned();
+        if (returnAddress > codeSize || framePointer > newStack.size()) {
+            throw std::runtime_error("Corrupt snapshot");
+        }
+        newCallStack.emplace_back(returnAddress, framePointer);
+    }
+
+    int32_t newRunning = -1;
+    Coroutine newMain = Coroutine();
+    ArenaVector<Coroutine> newCoroutines;
+    bool valid = true;
+    if (reader.version >= 4) {
+        newRunning = reader.readSigned();
+        valid = reader.readContext(newMain, codeSize);
+        uint32_t coroutineCount = reader.readCount();
+        if (coroutineCount > MAX_COROUTINES) {
+            throw std::runtime_error("Corrupt snapshot");
+        }
+        newCoroutines.resize(coroutineCount);
+        for (Coroutine& coroutine : newCoroutines) {
+            uint8_t state = reader.readByte();
+            coroutine.caller = reader.readSigned();
+            if (state > static_cast<uint8_t>(CoroutineState::FINISHED) || !reader.readContext(coroutine, codeSize)) {
+                valid = false;
+                break;
+            }
+            coroutine.state = static_cast<CoroutineState>(state);
+        }
+    }
+    int32_t coroutineCount = static_cast<int32_t>(newCoroutines.size());
+    valid = valid && newRunning >= -1 && newRunning < coroutineCount;
+    for (const Coroutine& coroutine : newCoroutines) {
+        if (coroutine.caller < -1 || coroutine.caller >= coroutineCount) valid = false;
+    }
+
+    auto validValue = [&](const Value& value) {
+        uint32_t index = static_cast<uint32_t>(value.intValue);
+        switch (value.type) {
+            case ValueType::ARRAY: return index < newArrays.size();
+            case ValueType::STRING: return newStrings.contains(value.intValue);
+            case ValueType::MAP: return index < newMaps.size();
+            case ValueType::COROUTINE: return index < newCoroutines.size();
+            default: return true;
+        }
+    };
+    valid = valid && reader.atEnd() && newIp <= codeSize && newFp <= newStack.size() && cells <= MAX_ARRAY_CELLS;
+    for (const Value& value : newStack) {
+        if (!validValue(value)) valid = false;
+    }
+    for (const Value& value : newMain.stack) {
+        if (!validValue(value)) valid = false;
+    }
+    for (const Coroutine& coroutine : newCoroutines) {
+        for (const Value& value : coroutine.stack) {
+            if (!validValue(value)) valid = false;
+        }
+    }
+    for (const auto& global : newGlobals) {
+        if (!validValue(global.second)) valid = false;
+    }
+    for (const ArenaVector<int32_t>& array : newArrays) {
+        if (array.empty()) valid = false;
+    }
+    if (!valid) {
+        throw std::runtime_error("Corrupt snapshot");
+    }
+
+    ip = newIp;
+    fp = newFp;
+    arrays.swap(newArrays);
+    arrayCells = cells;
+    maps.swap(newMaps);
+    mapSlots = slots;
+    strings.swap(newStrings);
+    stringConstants.clear();
+    stack.swap(newStack);
+    globals.swap(newGlobals);
+    callStack.swap(newCallStack);
+    mainContext.stack.swap(newMain.stack);
+    mainContext.callStack.swap(newMain.callStack);
+    mainContext.ip = newMain.ip;
+    mainContext.fp = newMain.fp;
+    coroutines.swap(newCoroutines);
+    runningCoroutine = newRunning;
+    snapshotRequested = false;
+    return true;
 }
 
 void VirtualMachine::push(const Value& value) {
+    // Write barrier for the string collector: a string that moves while
+    // roots are being marked might leave a place not yet marked for one
+    // already marked, so every string pushed is marked. Outside marking
+    // this changes nothing, as live strings carry the live mark already.
+    if (value.type == ValueType::STRING) strings.mark(value.intValue);
     stack.push_back(value);
 }
 
@@ -54,7 +475,7 @@ Value VirtualMachine::pop() {
 }
 
 uint8_t VirtualMachine::readByte() {
-    if (ip >= code.size()) {
+    if (ip >= codeSize) {
         throw std::runtime_error("Instruction pointer out of bounds");
     }
     return code[ip++];
@@ -69,19 +490,305 @@ int32_t VirtualMachine::readInt32() {
     return value;
 }
 
-std::string VirtualMachine::readString() {
+int32_t VirtualMachine::readInt32At(size_t offset) {
+    return static_cast<int32_t>(code[offset] |
+                                (code[offset + 1] << 8) |
+                                (code[offset + 2] << 16) |
+                                (static_cast<uint32_t>(code[offset + 3]) << 24));
+}
+
+ArenaString VirtualMachine::readString() {
     uint8_t length = readByte();
-    std::string str;
-    for (uint8_t i = 0; i < length; i++) {
-        str += static_cast<char>(readByte());
+    if (length > codeSize - ip) {
+        throw std::runtime_error("Instruction pointer out of bounds");
     }
+    ArenaString str(reinterpret_cast<const char*>(code + ip), length);
+    ip += length;
     return str;
 }
 
-void VirtualMachine::execute() {
+ArenaVector<int32_t>& VirtualMachine::arrayRef(const Value& value) {
+    if (value.type != ValueType::ARRAY) {
+        throw std::runtime_error("Value is not an array");
+    }
+    return arrays[value.intValue];
+}
+
+Value VirtualMachine::newArray(int32_t size) {
+    if (size <= 0) {
+        throw std::runtime_error("Invalid array size: " + std::to_string(size));
+    }
+    if (arrayCells + size > MAX_ARRAY_CELLS) {
+        throw std::runtime_error("Array memory limit exceeded");
+    }
+    arrays.emplace_back(size, 0);
+    arrayCells += size;
+    return Value(ValueType::ARRAY, static_cast<int32_t>(arrays.size() - 1));
+}
+
+IntMap& VirtualMachine::mapRef(const Value& value) {
+    if (value.type != ValueType::MAP) {
+        throw std::runtime_error("Value is not a map");
+    }
+    return maps[value.intValue];
+}
+
+Value VirtualMachine::newMap() {
+    maps.emplace_back();
+    return Value(ValueType::MAP, static_cast<int32_t>(maps.size() - 1));
+}
+
+void VirtualMachine::mapSet(const Value& map, int32_t key, int32_t value) {
+    IntMap& target = mapRef(map);
+    if (target.full() && !target.find(key)) {
+        size_t added = target.grownCapacity() - target.capacity();
+        if (mapSlots + added > MAX_MAP_SLOTS) {
+            throw std::runtime_error("Map memory limit exceeded");
+        }
+        target.rehash(target.grownCapacity());
+        mapSlots += added;
+    }
+    target.set(key, value);
+}
+
+void VirtualMachine::printValue(const Value& value) {
+    if (value.type == ValueType::STRING) {
+        std::cout << strings.text(value.intValue) << std::endl;
+        return;
+    }
+    if (value.type == ValueType::MAP) {
+        const IntMap& map = maps[value.intValue];
+        std::cout << "{";
+        bool first = true;
+        for (size_t slot = 0; slot < map.capacity(); slot++) {
+            int32_t key, element;
+            if (!map.entry(slot, key, element)) continue;
+            if (!first) std::cout << ", ";
+            std::cout << key << ": " << element;
+            first = false;
+        }
+        std::cout << "}" << std::endl;
+        return;
+    }
+    if (value.type != ValueType::ARRAY) {
+        std::cout << value.toString() << std::endl;
+        return;
+    }
+
+    const ArenaVector<int32_t>& elements = arrays[value.intValue];
+    std::cout << "[";
+    for (size_t i = 0; i < elements.size(); i++) {
+        if (i > 0) std::cout << ", ";
+        std::cout << elements[i];
+    }
+    std::cout << "]" << std::endl;
+}
+
+Value VirtualMachine::newString(const char* data, size_t length) {
+    collectStrings();
+    return Value(ValueType::STRING, strings.intern(data, length));
+}
+
+const ArenaString& VirtualMachine::stringRef(const Value& value) {
+    if (value.type != ValueType::STRING) {
+        throw std::runtime_error("Value is not a string");
+    }
+    return strings.text(value.intValue);
+}
+
+void VirtualMachine::collectStrings() {
+    if (strings.markingRoots()) {
+        markRoots();
+        return;
+    }
+    if (strings.collecting()) {
+        strings.step();
+        return;
+    }
+    if (!strings.cycleDue()) {
+        return;
+    }
+
+    strings.beginCycle();
+    roots.phase = RootPhase::CONSTANTS;
+    roots.constant = 0;
+    markRoots();
+}
+
+// Strings are only reachable from the constants, globals and stacks;
+// arrays and maps hold plain integers. Strings pushed or interned meanwhile
+// are marked as they go, and a global only gets a string by OP_STORE, which
+// pushes it back, so a root missed here never holds an unmarked string.
+void VirtualMachine::markRoots() {
+    size_t budget = ROOT_STEP;
+    while (budget > 0) {
+        switch (roots.phase) {
+            case RootPhase::CONSTANTS: {
+                auto it = stringConstants.lower_bound(roots.constant);
+                for (; it != stringConstants.end() && budget > 0; ++it, budget--) {
+                    strings.mark(it->second);
+                }
+                if (it != stringConstants.end()) {
+                    roots.constant = it->first;
+                } else {
+                    roots.phase = RootPhase::GLOBALS;
+                    roots.bucket = 0;
+                    roots.buckets = globals.bucket_count();
+                }
+                break;
+            }
+
+            case RootPhase::GLOBALS: {
+                if (globals.bucket_count() != roots.buckets) {
+                    // Rehashed since the last step, so entries have moved
+                    roots.bucket = 0;
+                    roots.buckets = globals.bucket_count();
+                }
+                for (; roots.bucket < roots.buckets && budget > 0; roots.bucket++, budget--) {
+                    for (auto it = globals.begin(roots.bucket); it != globals.end(roots.bucket); ++it) {
+                        if (it->second.type == ValueType::STRING) strings.mark(it->second.intValue);
+                    }
+                }
+                if (roots.bucket == roots.buckets) {
+                    roots.phase = RootPhase::STACKS;
+                    beginStack(-1);
+                }
+                break;
+            }
+
+            case RootPhase::STACKS: {
+                const ArenaVector<Value>& values = roots.owner == runningCoroutine ? stack : context(roots.owner).stack;
+                size_t end = values.size() < roots.limit ? values.size() : roots.limit;
+                for (; roots.index < end && budget > 0; roots.index++, budget--) {
+                    if (values[roots.index].type == ValueType::STRING) strings.mark(values[roots.index].intValue);
+                }
+                if (roots.index >= end) {
+                    if (static_cast<size_t>(roots.owner + 1) >= coroutines.size()) {
+                        strings.finishMarking();
+                        return;
+                    }
+                    beginStack(roots.owner + 1);
+                }
+                break;
+            }
+        }
+    }
+}
+
+void VirtualMachine::beginStack(int32_t owner) {
+    roots.owner = owner;
+    roots.index = 0;
+    roots.limit = owner == runningCoroutine ? stack.size() : context(owner).stack.size();
+}
+
+// '+' with a string on either side joins the text of both operands
+Value VirtualMachine::concat(const Value& a, const Value& b) {
+    char buffer[MAX_STRING_LENGTH];
+    size_t length = 0;
+    const Value* operands[2] = {&a, &b};
+    for (const Value* operand : operands) {
+        std::string number;
+        const char* data;
+        size_t size;
+        if (operand->type == ValueType::STRING) {
+            const ArenaString& text = strings.text(operand->intValue);
+            data = text.data();
+            size = text.size();
+        } else {
+            number = operand->toString();
+            data = number.data();
+            size = number.size();
+        }
+        if (size > MAX_STRING_LENGTH - length) {
+            throw std::runtime_error("String too long");
+        }
+        memcpy(buffer + length, data, size);
+        length += size;
+    }
+    return newString(buffer, length);
+}
+
+// Strings are interned, so two strings are equal exactly when their
+// handles are; a string never equals a value of another type
+bool VirtualMachine::equal(const Value& a, const Value& b) {
+    if (a.type == ValueType::STRING || b.type == ValueType::STRING) {
+        return a.type == b.type && a.intValue == b.intValue;
+    }
+    return a.toInt() == b.toInt();
+}
+
+// Strings order by their bytes and after every other value, so that
+// comparing never fails; everything else orders by integer value
+int VirtualMachine::compare(const Value& a, const Value& b) {
+    if (a.type == ValueType::STRING || b.type == ValueType::STRING) {
+        if (a.type != b.type) {
+            return a.type == ValueType::STRING ? 1 : -1;
+        }
+        int order = stringRef(a).compare(stringRef(b));
+        return order < 0 ? -1 : order > 0 ? 1 : 0;
+    }
+    return a.toInt() < b.toInt() ? -1 : a.toInt() > b.toInt() ? 1 : 0;
+}
+
+Coroutine& VirtualMachine::context(int32_t coroutine) {
+    return coroutine < 0 ? mainContext : coroutines[coroutine];
+}
+
+void VirtualMachine::switchTo(int32_t target) {
+    Coroutine& from = context(runningCoroutine);
+    stack.swap(from.stack);
+    callStack.swap(from.callStack);
+    from.ip = ip;
+    from.fp = fp;
+
+    Coroutine& to = context(target);
+    stack.swap(to.stack);
+    callStack.swap(to.callStack);
+    ip = to.ip;
+    fp = to.fp;
+    runningCoroutine = target;
+}
+
+bool VirtualMachine::coroutineAlive(const Value& value) {
+    if (value.type != ValueType::COROUTINE) {
+        throw std::runtime_error("Value is not a coroutine");
+    }
+    return coroutines[value.intValue].state != CoroutineState::FINISHED;
+}
+
+Value VirtualMachine::channelSend(const Value& id, const Value& value) {
+    if (channels == nullptr) {
+        throw std::runtime_error("Channels are not available here");
+    }
+    // Only plain integers mean the same to the receiving program
+    if (value.type != ValueType::INTEGER) {
+        throw std::runtime_error("Only integers can be sent on a channel");
+    }
+    if (!channels->get(id.toInt()).trySend(this, value.intValue)) {
+        waiting = true;
+        return Value();
+    }
+    channels->transferred();
+    return Value();
+}
+
+Value VirtualMachine::channelReceive(const Value& id, bool wait) {
+    if (channels == nullptr) {
+        throw std::runtime_error("Channels are not available here");
+    }
+    int32_t value;
+    if (!channels->get(id.toInt()).tryReceive(this, value)) {
+        waiting = wait;
+        return Value();
+    }
+    channels->transferred();
+    return Value(value);
+}
+
+bool VirtualMachine::execute() {
     bool running = true;
 
-    while (running && ip < code.size()) {
+    while (running && ip < codeSize) {
         uint8_t opcode = readByte();
 
         switch (opcode) {
@@ -98,6 +805,10 @@ void VirtualMachine::execute() {
             case OP_ADD: {
                 Value b = pop();
                 Value a = pop();
+                if (a.type == ValueType::STRING || b.type == ValueType::STRING) {
+                    push(concat(a, b));
+                    break;
+                }
                 push(Value(a.toInt() + b.toInt()));
                 break;
             }
@@ -135,27 +846,31 @@ void VirtualMachine::execute() {
 
             case OP_NEG: {
                 Value a = pop();
-                push(Value(-a.toInt()));
+                push(Value(static_cast<int32_t>(0u - static_cast<uint32_t>(a.toInt()))));
                 break;
             }
 
             case OP_EQ: {
                 Value b = pop();
                 Value a = pop();
-                push(Value(a.toInt() == b.toInt()));
+                push(Value(equal(a, b)));
                 break;
             }
 
             case OP_NE: {
                 Value b = pop();
                 Value a = pop();
-                push(Value(a.toInt() != b.toInt()));
+                push(Value(!equal(a, b)));
                 break;
             }
 
             case OP_LT: {
                 Value b = pop();
                 Value a = pop();
+                if (a.type == ValueType::STRING || b.type == ValueType::STRING) {
+                    push(Value(compare(a, b) < 0));
+                    break;
+                }
                 push(Value(a.toInt() < b.toInt()));
                 break;
             }
@@ -163,6 +878,10 @@ void VirtualMachine::execute() {
             case OP_LE: {
                 Value b = pop();
                 Value a = pop();
+                if (a.type == ValueType::STRING || b.type == ValueType::STRING) {
+                    push(Value(compare(a, b) <= 0));
+                    break;
+                }
                 push(Value(a.toInt() <= b.toInt()));
                 break;
             }
@@ -170,6 +889,10 @@ void VirtualMachine::execute() {
             case OP_GT: {
                 Value b = pop();
                 Value a = pop();
+                if (a.type == ValueType::STRING || b.type == ValueType::STRING) {
+                    push(Value(compare(a, b) > 0));
+                    break;
+                }
                 push(Value(a.toInt() > b.toInt()));
                 break;
             }
@@ -177,6 +900,10 @@ void VirtualMachine::execute() {
             case OP_GE: {
                 Value b = pop();
                 Value a = pop();
+                if (a.type == ValueType::STRING || b.type == ValueType::STRING) {
+                    push(Value(compare(a, b) >= 0));
+                    break;
+                }
                 push(Value(a.toInt() >= b.toInt()));
                 break;
             }
@@ -202,16 +929,16 @@ void VirtualMachine::execute() {
             }
 
             case OP_LOAD: {
-                std::string varName = readString();
+                ArenaString varName = readString();
                 if (globals.find(varName) == globals.end()) {
-                    throw std::runtime_error("Undefined variable: " + varName);
+                    throw std::runtime_error("Undefined variable: " + std::string(varName.c_str()));
                 }
                 push(globals[varName]);
                 break;
             }
 
             case OP_STORE: {
-                std::string varName = readString();
+                ArenaString varName = readString();
                 Value value = pop();
                 globals[varName] = value;
                 push(value);
@@ -221,22 +948,41 @@ void VirtualMachine::execute() {
             case OP_JMP: {
                 int32_t offset = readInt32();
                 ip = offset;
+                // Loops always pass through a jump, so a collection cycle
+                // keeps moving even while nothing allocates
+                if (strings.collecting()) {
+                    collectStrings();
+                }
                 break;
             }
 
             case OP_JMP_IF: {
+                size_t site = ip - 1;
                 int32_t offset = readInt32();
                 Value condition = pop();
-                if (condition.toBool()) {
+                bool taken = condition.toBool();
+                if (profile) {
+                    BranchCount& count = (*profile)[static_cast<uint32_t>(site)];
+                    if (taken) count.taken++;
+                    else count.notTaken++;
+                }
+                if (taken) {
                     ip = offset;
                 }
                 break;
             }
 
             case OP_JMP_NOT: {
+                size_t site = ip - 1;
                 int32_t offset = readInt32();
                 Value condition = pop();
-                if (!condition.toBool()) {
+                bool taken = !condition.toBool();
+                if (profile) {
+                    BranchCount& count = (*profile)[static_cast<uint32_t>(site)];
+                    if (taken) count.taken++;
+                    else count.notTaken++;
+                }
+                if (taken) {
                     ip = offset;
                 }
                 break;
@@ -277,12 +1023,12 @@ void VirtualMachine::execute() {
 
             case OP_PRINT: {
                 Value val = pop();
-                std::cout << val.toString() << std::endl;
+                printValue(val);
                 break;
             }
 
             case OP_INPUT: {
-                std::string varName = readString();
+                ArenaString varName = readString();
                 int32_t value;
                 std::cin >> value;
                 globals[varName] = Value(value);
@@ -299,6 +1045,288 @@ void VirtualMachine::execute() {
                 running = false;
                 break;
 
+            case OP_NEW_ARRAY: {
+                int32_t size = pop().toInt();
+                push(newArray(size));
+                break;
+            }
+
+            case OP_INDEX_GET: {
+                int32_t index = pop().toInt();
+                ArenaVector<int32_t>& array = arrayRef(pop());
+                if (index < 0 || static_cast<size_t>(index) >= array.size()) {
+                    throw std::runtime_error("Array index out of bounds: " + std::to_string(index));
+                }
+                push(Value(array[index]));
+                break;
+            }
+
+            case OP_INDEX_SET: {
+                Value value = pop();
+                int32_t index = pop().toInt();
+                ArenaVector<int32_t>& array = arrayRef(pop());
+                if (index < 0 || static_cast<size_t>(index) >= array.size()) {
+                    throw std::runtime_error("Array index out of bounds: " + std::to_string(index));
+                }
+                array[index] = value.toInt();
+                push(value);
+                break;
+            }
+
+            case OP_INDEX_GET_UNCHECKED: {
+                int32_t index = pop().toInt();
+                Value array = pop();
+                push(Value(arrays[array.intValue][index]));
+                break;
+            }
+
+            case OP_INDEX_SET_UNCHECKED: {
+                Value value = pop();
+                int32_t index = pop().toInt();
+                Value array = pop();
+                arrays[array.intValue][index] = value.toInt();
+                push(value);
+                break;
+            }
+
+            case OP_CALL_NATIVE: {
+                uint8_t index = readByte();
+                uint8_t argc = readByte();
+                if (index >= nativeCount || argc != nativeTable[index].arity) {
+                    throw std::runtime_error("Invalid native call: " + std::to_string(index));
+                }
+                if (stack.size() < argc) {
+                    throw std::runtime_error("Stack underflow");
+                }
+
+                // Arguments are handed over in place, then dropped in one go
+                Value* args = stack.data() + (stack.size() - argc);
+                Value result = nativeTable[index].function(*this, args, argc);
+                if (waiting) {
+                    // Back to the start of the call, its arguments still in
+                    // place, for the scheduler to retry once the other side
+                    // has run
+                    waiting = false;
+                    ip -= 3;
+                    return false;
+                }
+                stack.resize(stack.size() - argc);
+                push(result);
+
+                // A requested snapshot is taken once the call is complete
+                if (snapshotRequested) {
+                    snapshotRequested = false;
+                    stack.back() = Value(1);
+                    snapshotSink->write(*this);
+                    stack.back() = Value(0);
+                }
+                break;
+            }
+
+            case OP_BIT_AND: {
+                Value b = pop();
+                Value a = pop();
+                push(Value(a.toInt() & b.toInt()));
+                break;
+            }
+
+            case OP_BIT_OR: {
+                Value b = pop();
+                Value a = pop();
+                push(Value(a.toInt() | b.toInt()));
+                break;
+            }
+
+            case OP_BIT_XOR: {
+                Value b = pop();
+                Value a = pop();
+                push(Value(a.toInt() ^ b.toInt()));
+                break;
+            }
+
+            case OP_BIT_NOT: {
+                Value a = pop();
+                push(Value(~a.toInt()));
+                break;
+            }
+
+            case OP_SHL: {
+                Value b = pop();
+                Value a = pop();
+                push(Value(shiftLeft(a.toInt(), b.toInt())));
+                break;
+            }
+
+            case OP_SHR: {
+                Value b = pop();
+                Value a = pop();
+                push(Value(shiftRight(a.toInt(), b.toInt())));
+                break;
+            }
+
+            case OP_SHL_CONST: {
+                uint8_t count = readByte();
+                Value a = pop();
+                push(Value(shiftLeft(a.toInt(), count)));
+                break;
+            }
+
+            case OP_SHR_CONST: {
+                uint8_t count = readByte();
+                Value a = pop();
+                push(Value(shiftRight(a.toInt(), count)));
+                break;
+            }
+
+            case OP_AND_CONST: {
+                int32_t mask = readInt32();
+                Value a = pop();
+                push(Value(a.toInt() & mask));
+                break;
+            }
+
+            case OP_TABLESWITCH: {
+                int32_t value = pop().toInt();
+                int32_t low = readInt32();
+                uint32_t count = static_cast<uint32_t>(readInt32());
+                int32_t defaultTarget = readInt32();
+                if (ip + static_cast<size_t>(count) * 4 > codeSize) {
+                    throw std::runtime_error("Switch table out of bounds");
+                }
+
+                // One unsigned compare covers both ends of the range
+                uint32_t slot = static_cast<uint32_t>(value) - static_cast<uint32_t>(low);
+                ip = slot < count ? readInt32At(ip + slot * 4) : defaultTarget;
+                break;
+            }
+
+            case OP_LOOKUPSWITCH: {
+                int32_t value = pop().toInt();
+                uint32_t count = static_cast<uint32_t>(readInt32());
+                int32_t defaultTarget = readInt32();
+                if (ip + static_cast<size_t>(count) * 8 > codeSize) {
+                    throw std::runtime_error("Switch table out of bounds");
+                }
+
+                size_t table = ip;
+                ip = defaultTarget;
+                size_t lo = 0, hi = count;
+                while (lo < hi) {
+                    size_t mid = (lo + hi) / 2;
+                    int32_t key = readInt32At(table + mid * 8);
+                    if (key == value) {
+                        ip = readInt32At(table + mid * 8 + 4);
+                        break;
+                    }
+                    if (key < value) lo = mid + 1;
+                    else hi = mid;
+                }
+                break;
+            }
+
+            case OP_ADD_CONST: {
+                int32_t constant = readInt32();
+                Value a = pop();
+                push(Value(static_cast<int32_t>(static_cast<uint32_t>(a.toInt()) + static_cast<uint32_t>(constant))));
+                break;
+            }
+
+            case OP_DIV_POW2: {
+                uint8_t k = readByte();
+                Value a = pop();
+                push(Value(divPow2(a.toInt(), k)));
+                break;
+            }
+
+            case OP_MOD_POW2: {
+                uint8_t k = readByte();
+                int32_t value = pop().toInt();
+                int32_t quotient = divPow2(value, k);
+                push(Value(static_cast<int32_t>(static_cast<uint32_t>(value) - (static_cast<uint32_t>(quotient) << k))));
+                break;
+            }
+
+            case OP_INC: {
+                ArenaString varName = readString();
+                int32_t constant = readInt32();
+                auto it = globals.find(varName);
+                if (it == globals.end()) {
+                    throw std::runtime_error("Undefined variable: " + std::string(varName.c_str()));
+                }
+                it->second = Value(static_cast<int32_t>(static_cast<uint32_t>(it->second.toInt()) + static_cast<uint32_t>(constant)));
+                break;
+            }
+
+            case OP_NEW_COROUTINE: {
+                int32_t entry = readInt32();
+                if (static_cast<uint32_t>(entry) >= codeSize) {
+                    throw std::runtime_error("Invalid coroutine address");
+                }
+                if (coroutines.size() >= MAX_COROUTINES) {
+                    throw std::runtime_error("Coroutine limit exceeded");
+                }
+                coroutines.emplace_back();
+                Coroutine& coroutine = coroutines.back();
+                coroutine.ip = entry;
+                coroutine.fp = 0;
+                coroutine.caller = -1;
+                coroutine.state = CoroutineState::SUSPENDED;
+                push(Value(ValueType::COROUTINE, static_cast<int32_t>(coroutines.size() - 1)));
+                break;
+            }
+
+            case OP_RESUME: {
+                Value target = pop();
+                if (target.type != ValueType::COROUTINE) {
+                    throw std::runtime_error("Value is not a coroutine");
+                }
+                Coroutine& coroutine = coroutines[target.intValue];
+                if (coroutine.state == CoroutineState::ACTIVE) {
+                    throw std::runtime_error("Coroutine is already running");
+                }
+                if (coroutine.state == CoroutineState::FINISHED) {
+                    throw std::runtime_error("Cannot resume a finished coroutine");
+                }
+                coroutine.caller = runningCoroutine;
+                coroutine.state = CoroutineState::ACTIVE;
+                switchTo(target.intValue);
+                break;
+            }
+
+            case OP_YIELD:
+            case OP_END_COROUTINE: {
+                if (runningCoroutine < 0) {
+                    throw std::runtime_error("yield outside a coroutine");
+                }
+                Value result = opcode == OP_YIELD ? pop() : Value();
+                Coroutine& coroutine = coroutines[runningCoroutine];
+                coroutine.state = opcode == OP_YIELD ? CoroutineState::SUSPENDED : CoroutineState::FINISHED;
+                switchTo(coroutine.caller);
+                if (coroutine.state == CoroutineState::FINISHED) {
+                    // Nothing will run on it again
+                    ArenaVector<Value>().swap(coroutine.stack);
+                    ArenaVector<CallFrame>().swap(coroutine.callStack);
+                }
+                push(result);
+                break;
+            }
+
+            case OP_PUSH_STRING: {
+                uint32_t site = static_cast<uint32_t>(ip - 1);
+                uint8_t length = readByte();
+                if (length > codeSize - ip) {
+                    throw std::runtime_error("Instruction pointer out of bounds");
+                }
+                auto constant = stringConstants.find(site);
+                if (constant == stringConstants.end()) {
+                    Value value = newString(reinterpret_cast<const char*>(code + ip), length);
+                    constant = stringConstants.insert(std::make_pair(site, value.intValue)).first;
+                }
+                ip += length;
+                push(Value(ValueType::STRING, constant->second));
+                break;
+            }
+
             default: {
                 // Check if this looks like text/source code (ASCII printable characters)
                 if (opcode >= 32 && opcode <= 126) {
@@ -308,6 +1336,7 @@ void VirtualMachine::execute() {
             }
         }
     }
+    return true;
 }
 
 void VirtualMachine::dumpStack() {
@@ -5,6 +5,15 @@
 #include <cstdint>
 #include <string>
 #include <unordered_map>
+#include <memory>
+#include "Arena.h"
+#include "Profile.h"
+#include "ProgramImage.h"
+#include "StringHeap.h"
+#include "IntMap.h"
+
+class SnapshotSink;
+class ChannelSet;
 
 // Instruction set opcodes
 enum Opcode {
@@ -52,14 +61,64 @@ enum Opcode {
 
     // System
     OP_SLEEP,       // Sleep for specified seconds
-    OP_HALT         // Stop execution
+    OP_HALT,        // Stop execution
+
+    // Array operations
+    OP_NEW_ARRAY,   // Allocate a zeroed array of the size on top of stack
+    OP_INDEX_GET,   // Push array[index]
+    OP_INDEX_SET,   // Store value into array[index]
+    OP_INDEX_GET_UNCHECKED, // array[index], index proven in range at compile time
+    OP_INDEX_SET_UNCHECKED, // array[index] = value, index proven in range
+
+    // Native functions
+    OP_CALL_NATIVE, // Call nativeTable[index] with argc arguments from the stack
+
+    // Bitwise operations
+    OP_BIT_AND,     // Bitwise AND of top two values
+    OP_BIT_OR,      // Bitwise OR of top two values
+    OP_BIT_XOR,     // Bitwise XOR of top two values
+    OP_BIT_NOT,     // Bitwise complement of top value
+    OP_SHL,         // Shift left, count taken modulo 32
+    OP_SHR,         // Arithmetic shift right, count taken modulo 32
+    OP_SHL_CONST,   // Shift left by an inline 8-bit count
+    OP_SHR_CONST,   // Arithmetic shift right by an inline 8-bit count
+    OP_AND_CONST,   // Bitwise AND with an inline 32-bit mask
+
+    // Multi-way branches
+    OP_TABLESWITCH, // low, count, default, count targets; indexed by value - low
+    OP_LOOKUPSWITCH, // count, default, count (key, target) pairs sorted by key
+
+    // Strength-reduced forms
+    OP_ADD_CONST,   // Add an inline 32-bit constant
+    OP_DIV_POW2,    // Divide by 2^k (inline 8-bit k), rounding toward zero
+    OP_MOD_POW2,    // Remainder of division by 2^k, sign of the dividend
+    OP_INC,         // Add an inline constant to a variable in place
+
+    // Strings
+    OP_PUSH_STRING, // Push the string constant that follows inline
+
+    // Coroutines
+    OP_NEW_COROUTINE, // Push a new coroutine whose body starts at the inline address
+    OP_RESUME,      // Run the popped coroutine until it yields; push what it yielded
+    OP_YIELD,       // Hand the popped value back to whoever resumed this coroutine
+    OP_END_COROUTINE // Finish this coroutine; its last resume returns nil
 };
 
+// Upper bound on the number of coroutines a program may create
+const size_t MAX_COROUTINES = 64;
+
+// Upper bound on the total number of array elements a program may allocate
+const size_t MAX_ARRAY_CELLS = 16384;
+
 // Value types in the VM
 enum class ValueType {
     INTEGER,
     BOOLEAN,
-    NIL
+    ARRAY,
+    NIL,
+    STRING,
+    MAP,
+    COROUTINE
 };
 
 // Runtime value
@@ -70,12 +129,35 @@ struct Value {
     Value();
     Value(int32_t val);
     Value(bool val);
+    Value(ValueType t, int32_t val);
 
     bool toBool() const;
     int32_t toInt() const;
     std::string toString() const;
 };
 
+// The accessors are inline so that translated programs, which work on
+// Values directly, compile them down to plain integer operations
+inline Value::Value() : type(ValueType::NIL), intValue(0) {}
+
+inline Value::Value(int32_t val) : type(ValueType::INTEGER), intValue(val) {}
+
+inline Value::Value(bool val) : type(ValueType::BOOLEAN), intValue(val ? 1 : 0) {}
+
+inline Value::Value(ValueType t, int32_t val) : type(t), intValue(val) {}
+
+inline bool Value::toBool() const {
+    if (type == ValueType::BOOLEAN) return intValue != 0;
+    if (type == ValueType::INTEGER) return intValue != 0;
+    if (type == ValueType::ARRAY || type == ValueType::STRING || type == ValueType::MAP ||
+        type == ValueType::COROUTINE) return true;
+    return false;
+}
+
+inline int32_t Value::toInt() const {
+    return intValue;
+}
+
 // Call frame for function calls
 struct CallFrame {
     size_t returnAddress;
@@ -84,25 +166,149 @@ struct CallFrame {
     CallFrame(size_t ret, size_t fp);
 };
 
+enum class CoroutineState : uint8_t {
+    SUSPENDED,      // Created or yielded; resume continues it
+    ACTIVE,         // Running, or waiting on a coroutine it resumed
+    FINISHED
+};
+
+// Execution context of a coroutine, or of the main program while a
+// coroutine runs. The one running keeps its stack and call frames in the
+// VM itself; switching swaps the vectors, so no values are copied.
+struct Coroutine {
+    ArenaVector<Value> stack;
+    ArenaVector<CallFrame> callStack;
+    size_t ip;
+    size_t fp;
+    int32_t caller;         // Coroutine that resumed it, -1 for the main program
+    CoroutineState state;
+};
+
+// Roots of the string collector, in the order it marks them
+enum class RootPhase : uint8_t {
+    CONSTANTS,
+    GLOBALS,
+    STACKS
+};
+
+// How far a collection cycle has got marking roots
+struct RootCursor {
+    RootPhase phase;
+    uint32_t constant;  // Site of the next string constant
+    size_t bucket;      // Next bucket of globals
+    size_t buckets;     // Bucket count of globals; a rehash starts them over
+    int32_t owner;      // Whose stack is marked: a coroutine, or -1 for the main program
+    size_t index;
+    size_t limit;       // Size of that stack when marking reached it; anything
+                        // above was pushed since, and push marks strings
+};
+
 class VirtualMachine {
 private:
-    std::vector<Value> stack;
-    std::vector<uint8_t> code;
-    std::unordered_map<std::string, Value> globals;
-    std::vector<CallFrame> callStack;
+    // Execution state is allocated from the arena active when the VM is
+    // created, so a run's allocations go away together
+    ArenaVector<Value> stack;
+    std::shared_ptr<const ProgramImage> program;
+    const uint8_t* code;    // program->code, read by the dispatch loop
+    size_t codeSize;
+    ArenaStringMap<Value> globals;
+    ArenaVector<CallFrame> callStack;
+    ArenaVector<ArenaVector<int32_t>> arrays;
+    size_t arrayCells;  // Elements allocated across all arrays
+    ArenaVector<IntMap> maps;
+    size_t mapSlots;    // Slots allocated across all maps
+    StringHeap strings;
+    RootCursor roots;
+    // String constants already interned, by address of their OP_PUSH_STRING
+    ArenaMap<uint32_t, int32_t> stringConstants;
     size_t ip;  // Instruction pointer
     size_t fp;  // Frame pointer
+    ArenaVector<Coroutine> coroutines;
+    Coroutine mainContext;      // The main program's state while a coroutine runs
+    int32_t runningCoroutine;   // -1 while the main program runs
+    BranchProfile* profile;  // Conditional jump counts, when collecting
+    SnapshotSink* snapshotSink;
+    bool snapshotRequested;  // snapshot() was called by the current native call
+    ChannelSet* channels;
+    bool waiting;   // The current native call found its channel empty or full
+
+    // Roots marked per collection step
+    static const size_t ROOT_STEP = 32;
+
+    // Starts a collection cycle when one is due, or does a step of the one
+    // in progress: marking up to ROOT_STEP roots, or sweeping
+    void collectStrings();
+    void markRoots();
+    // Moves root marking on to the stack of owner
+    void beginStack(int32_t owner);
+    Value concat(const Value& a, const Value& b);
+    bool equal(const Value& a, const Value& b);
+    int compare(const Value& a, const Value& b);
+
+    Coroutine& context(int32_t coroutine);
+    // Makes the target the running coroutine (-1 for the main program)
+    void switchTo(int32_t target);
 
 public:
     VirtualMachine();
 
+    ArenaVector<int32_t>& arrayRef(const Value& value);
+    // Allocate a zeroed array, enforcing MAX_ARRAY_CELLS
+    Value newArray(int32_t size);
+    IntMap& mapRef(const Value& value);
+    // Allocate an empty map; its slots count against MAX_MAP_SLOTS as it grows
+    Value newMap();
+    void mapSet(const Value& map, int32_t key, int32_t value);
+    void printValue(const Value& value);
+    // Interned string with these contents; may do a step of collection
+    Value newString(const char* data, size_t length);
+    const ArenaString& stringRef(const Value& value);
+    // Whether the coroutine can still be resumed
+    bool coroutineAlive(const Value& value);
+    // Used by the chan_* builtins. Sending to a full channel, or receiving
+    // from an empty one with wait set, makes execute() return so the
+    // scheduler can run the other side, and retries the call later;
+    // without wait, receiving from an empty channel gives nil.
+    Value channelSend(const Value& id, const Value& value);
+    Value channelReceive(const Value& id, bool wait);
+
+    // Run a shared program image; the VM keeps it alive while loaded
+    void load(std::shared_ptr<const ProgramImage> image);
     void load(const std::vector<uint8_t>& bytecode);
+    // Count taken and fall-through conditional jumps into counts while
+    // executing; nullptr turns collection off
+    void setProfile(BranchProfile* counts);
+    // Where snapshots requested by the program go; nullptr turns snapshot()
+    // into a no-op that returns -1
+    void setSnapshotSink(SnapshotSink* sink);
+    // Channels shared with the programs running alongside; nullptr makes
+    // the chan_* builtins fail
+    void setChannels(ChannelSet* set);
+    // Used by the snapshot() builtin. The state is captured once the call
+    // completes, so a run restored from it continues after the call, where
+    // snapshot() returns 1; the running program itself sees 0.
+    Value requestSnapshot();
+
+    // Complete execution state (ip, fp, stack, globals, call stack, arrays,
+    // strings, maps and coroutines) in a compact binary image, tagged with the program image's path and
+    // code hash
+    std::vector<uint8_t> snapshot() const;
+    // Program path recorded in an image; false if it is not a snapshot
+    static bool snapshotProgram(const std::vector<uint8_t>& image, std::string& program);
+    // Resume from an image taken of the currently loaded code. Returns false,
+    // leaving the VM as loaded, if the image belongs to different code;
+    // throws if it is damaged.
+    bool restore(const std::vector<uint8_t>& image);
     void push(const Value& value);
     Value pop();
     uint8_t readByte();
     int32_t readInt32();
-    std::string readString();
-    void execute();
+    int32_t readInt32At(size_t offset);
+    ArenaString readString();
+    // Runs until the program halts and returns true, or until it has to
+    // wait on a channel and returns false; calling it again retries the
+    // call it stopped at
+    bool execute();
     void dumpStack();
     void dumpGlobals();
 };
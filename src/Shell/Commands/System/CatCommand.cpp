@@ -28,7 +28,26 @@ void CatCommand::Execute(const std::vector<std::string> &args, Terminal *termina
         return;
     }
 
-    const std::string content = file->Read();
+    FileDescriptor *fd = file->Open(O_RDONLY);
+    if (fd == nullptr)
+    {
+        return;
+    }
+
+    // A piece at a time, so the file is never held whole
+    char chunk[512];
+    off_t offset = 0;
+    ssize_t bytesRead;
+    while ((bytesRead = fd->pread(chunk, sizeof(chunk), offset)) > 0)
+    {
+        output->write(chunk, bytesRead);
+        offset += bytesRead;
+    }
+
+    if (bytesRead < 0)
+    {
+        const std::string errorMsg = "cat: " + filePath + ": Input/output error\n";
 
-    output->write(content.c_str(), content.size());
+        output->write(errorMsg.c_str(), errorMsg.size());
+    }
 }
\ No newline at end of file
@@ -3,8 +3,10 @@
 #include <FileSystem/FileSystem.h>
 #include <FileSystem/File.h>
 #include <FileSystem/Folder.h>
+#include <Runtime/Arena.h>
 #include <Runtime/Lexer.h>
 #include <Runtime/Compiler.h>
+#include <Runtime/Profile.h>
 #include <IO/FileDescriptor.h>
 #include <sstream>
 #include <vector>
@@ -12,17 +14,47 @@
 
 void CompileCommand::Execute(const std::vector<std::string> &args, Terminal *terminal, FileDescriptor *input, FileDescriptor *output)
 {
-    if (args.size() < 1)
+    std::vector<std::string> paths;
+    bool optimize = true;
+    bool emitIR = false;
+    bool useProfile = false;
+    for (const std::string& arg : args)
     {
-        const std::string msg1 = "Usage: compile <source_file> [output_file]\n";
+        if (arg == "-O0")
+        {
+            optimize = false;
+        }
+        else if (arg == "--emit-ir")
+        {
+            emitIR = true;
+        }
+        else if (arg == "--use-profile")
+        {
+            useProfile = true;
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.size() < 1)
+    {
+        const std::string msg1 = "Usage: compile [-O0] [--emit-ir] [--use-profile] <source_file> [output_file]\n";
         output->write(msg1.c_str(), msg1.size());
         const std::string msg2 = "  Compiles source code to .enix bytecode format\n";
         output->write(msg2.c_str(), msg2.size());
+        const std::string msg3 = "  -O0            disable optimizations\n";
+        output->write(msg3.c_str(), msg3.size());
+        const std::string msg4 = "  --emit-ir      print the intermediate representation instead of writing bytecode\n";
+        output->write(msg4.c_str(), msg4.size());
+        const std::string msg5 = "  --use-profile  lay out code by the branch counts in <output>.prof (see run --collect-profile)\n";
+        output->write(msg5.c_str(), msg5.size());
         return;
     }
 
     FileSystem *fileSystem = FileSystem::GetInstance();
-    const std::string& sourceFilePath = args[0];
+    const std::string& sourceFilePath = paths[0];
 
     espnix::File *sourceFile = fileSystem->GetFile(sourceFilePath);
 
@@ -34,9 +66,9 @@ void CompileCommand::Execute(const std::vector<std::string> &args, Terminal *ter
     }
 
     std::string outputFilePath;
-    if (args.size() >= 2)
+    if (paths.size() >= 2)
     {
-        outputFilePath = args[1];
+        outputFilePath = paths[1];
     }
     else
     {
@@ -63,23 +95,61 @@ void CompileCommand::Execute(const std::vector<std::string> &args, Terminal *ter
     {
         std::string sourceCode = sourceFile->Read();
 
-        Lexer lexer(sourceCode.c_str());
-        std::vector<Token>& tokens = lexer.tokenize();
+        // Tokens, syntax tree and graph all come from one arena that goes
+        // back to the heap as a whole once the bytecode is copied out. The
+        // file is written after that: its blocks outlive the command, and
+        // placed while the arena is at its peak they would sit above it
+        // and split the heap once it is gone.
+        std::string bytecodeStr;
+        {
+            Arena arena;
+            Arena::Scope arenaScope(arena);
 
-        const std::string lexMsg = "Lexical analysis complete (" + std::to_string(tokens.size()) + " tokens)\n";
-        output->write(lexMsg.c_str(), lexMsg.size());
+            Lexer lexer(sourceCode.c_str());
+            ArenaVector<Token>& tokens = lexer.tokenize();
 
-        Compiler compiler(tokens);
-        std::vector<uint8_t>& bytecode = compiler.compile();
+            const std::string lexMsg = "Lexical analysis complete (" + std::to_string(tokens.size()) + " tokens)\n";
+            output->write(lexMsg.c_str(), lexMsg.size());
 
-        const std::string compMsg = "Compilation complete (" + std::to_string(bytecode.size()) + " bytes)\n";
-        output->write(compMsg.c_str(), compMsg.size());
+            Compiler compiler(tokens);
+            compiler.setOptimize(optimize);
 
-        std::string bytecodeStr;
-        bytecodeStr.reserve(bytecode.size());
-        for (uint8_t byte : bytecode)
-        {
-            bytecodeStr.push_back(static_cast<char>(byte));
+            if (useProfile)
+            {
+                const std::string profileFilePath = profilePath(outputFilePath);
+                espnix::File *profileFile = fileSystem->GetFile(profileFilePath);
+                BranchProfile profile;
+                uint32_t checksum = 0;
+                if (profileFile == nullptr || !parseProfile(profileFile->Read(), checksum, profile))
+                {
+                    const std::string errMsg = "compile: error: no usable profile at " + profileFilePath +
+                                               " (collect one with: run --collect-profile)\n";
+                    output->write(errMsg.c_str(), errMsg.size());
+                    return;
+                }
+                compiler.setProfile(profile, checksum);
+
+                const std::string profMsg = "Using profile " + profileFilePath + " (" +
+                                            std::to_string(profile.size()) + " branches)\n";
+                output->write(profMsg.c_str(), profMsg.size());
+            }
+            ArenaVector<uint8_t>& bytecode = compiler.compile();
+
+            const std::string compMsg = "Compilation complete (" + std::to_string(bytecode.size()) + " bytes)\n";
+            output->write(compMsg.c_str(), compMsg.size());
+
+            if (emitIR)
+            {
+                const std::string ir = compiler.dumpIR();
+                output->write(ir.c_str(), ir.size());
+                return;
+            }
+
+            bytecodeStr.reserve(bytecode.size());
+            for (uint8_t byte : bytecode)
+            {
+                bytecodeStr.push_back(static_cast<char>(byte));
+            }
         }
 
         espnix::File *outputFile = fileSystem->GetFile(outputFilePath);
@@ -123,10 +193,11 @@ void CompileCommand::Execute(const std::vector<std::string> &args, Terminal *ter
             newFile->name = fileName;
             newFile->permissions = 0644;
 
+            // Added first, so the file is opened where it lives on the card
+            targetFolder->AddFile(newFile);
+
             // Write content using WriteFile for auto-sync
             fileSystem->WriteFile(newFile, bytecodeStr, outputFilePath);
-
-            targetFolder->AddFile(newFile);
             const std::string sizeMsg = "Binary file size : " + std::to_string(bytecodeStr.size()) + " bytes\n";
             output->write(sizeMsg.c_str(), sizeMsg.size());
             const std::string outMsg = "Output written to " + outputFilePath + "\n";
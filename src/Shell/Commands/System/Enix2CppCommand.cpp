@@ -0,0 +1,76 @@
+#include "Enix2CppCommand.h"
+#include <Terminal/Terminal.h>
+#include <FileSystem/FileSystem.h>
+#include <FileSystem/File.h>
+#include <Runtime/Translator.h>
+#include <Runtime/NativePrograms.h>
+#include <IO/FileDescriptor.h>
+#include <vector>
+
+void Enix2CppCommand::Execute(const std::vector<std::string> &args, Terminal *terminal, FileDescriptor *input, FileDescriptor *output)
+{
+    if (args.size() < 1)
+    {
+        const std::string msg1 = "Usage: enix2cpp <bytecode_file> [output_file]\n";
+        output->write(msg1.c_str(), msg1.size());
+        const std::string msg2 = "  Translates a .enix program to C++ that runs it natively\n";
+        output->write(msg2.c_str(), msg2.size());
+        const std::string msg3 = "  Build the output into the firmware and run uses it for that program\n";
+        output->write(msg3.c_str(), msg3.size());
+        return;
+    }
+
+    FileSystem *fileSystem = FileSystem::GetInstance();
+    const std::string& bytecodeFilePath = args[0];
+
+    espnix::File *bytecodeFile = fileSystem->GetFile(bytecodeFilePath);
+    if (bytecodeFile == nullptr)
+    {
+        const std::string errMsg = "enix2cpp: error: " + bytecodeFilePath + ": No such file or directory\n";
+        output->write(errMsg.c_str(), errMsg.size());
+        return;
+    }
+
+    const std::string programName = nativeProgramName(bytecodeFilePath);
+    std::string outputFilePath;
+    if (args.size() >= 2)
+    {
+        outputFilePath = args[1];
+    }
+    else
+    {
+        size_t slash = bytecodeFilePath.find_last_of('/');
+        outputFilePath = (slash != std::string::npos ? bytecodeFilePath.substr(0, slash + 1) : "") + programName + ".cpp";
+    }
+
+    if (!outputFilePath.empty() && outputFilePath[0] != '/')
+    {
+        outputFilePath = fileSystem->currentPath + "/" + outputFilePath;
+    }
+
+    try
+    {
+        std::string bytecodeStr = bytecodeFile->Read();
+        std::vector<uint8_t> bytecode(bytecodeStr.begin(), bytecodeStr.end());
+
+        const std::string source = translateProgram(bytecode, programName);
+
+        espnix::File *outputFile = fileSystem->CreateFile(outputFilePath);
+        if (outputFile == nullptr)
+        {
+            const std::string errMsg = "enix2cpp: error: cannot write " + outputFilePath + "\n";
+            output->write(errMsg.c_str(), errMsg.size());
+            return;
+        }
+        fileSystem->WriteFile(outputFile, source, outputFilePath);
+
+        const std::string outMsg = "Translated " + bytecodeFilePath + " to " + outputFilePath +
+                                   " (program '" + programName + "')\n";
+        output->write(outMsg.c_str(), outMsg.size());
+    }
+    catch (const std::exception& e)
+    {
+        const std::string errMsg = "enix2cpp: error: " + std::string(e.what()) + "\n";
+        output->write(errMsg.c_str(), errMsg.size());
+    }
+}
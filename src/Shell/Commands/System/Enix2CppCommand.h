@@ -0,0 +1,17 @@
+#ifndef ENIX2CPP_COMMAND_H
+#define ENIX2CPP_COMMAND_H
+
+#include <vector>
+#include <string>
+
+#include <Shell/Commands/ICommand.h>
+
+class Terminal;
+
+class Enix2CppCommand : public ICommand
+{
+public:
+    void Execute(const std::vector<std::string> &args, Terminal *terminal, FileDescriptor *input, FileDescriptor *output) override;
+};
+
+#endif
@@ -10,6 +10,12 @@
 
 #include "ListCommand.h"
 
+// Owner column of a long listing; only root has a name so far
+static std::string OwnerName(int owner)
+{
+    return owner == 0 ? "root" : std::to_string(owner);
+}
+
 void ListCommand::Execute(const std::vector<std::string> &args, Terminal *terminal, FileDescriptor *input, FileDescriptor *output)
 {
     std::set<std::string> flags(args.begin(), args.end());
@@ -39,14 +45,14 @@ void ListCommand::Execute(const std::vector<std::string> &args, Terminal *termin
         for (const espnix::Folder *subFolder : folder->folders)
         {
             std::string permissions = fileSystem->GetStringPermissions(subFolder->permissions, "folder");
-            std::string line = permissions + " root root 4096 " + Utils::FormatDate(subFolder->creationDate) + " " + subFolder->name + "\n";
+            std::string line = permissions + " " + OwnerName(subFolder->owner) + " root 4096 " + Utils::FormatDate(subFolder->creationDate) + " " + subFolder->name + "\n";
             output->write(line.c_str(), line.size());
         }
 
         for (const espnix::File *file : folder->files)
         {
             std::string permissions = fileSystem->GetStringPermissions(file->permissions, "file");
-            std::string line = permissions + " root root " + std::to_string(file->GetSize()) + " " + Utils::FormatDate(file->creationDate) + " " + file->name + "\n";
+            std::string line = permissions + " " + OwnerName(file->owner) + " root " + std::to_string(file->GetSize()) + " " + Utils::FormatDate(file->creationDate) + " " + file->name + "\n";
             output->write(line.c_str(), line.size());
         }
 
@@ -37,14 +37,11 @@ void MakeDirectoryCommand::Execute(const std::vector<std::string> &args, Termina
     FileSystem *fileSystem = FileSystem::GetInstance();
     espnix::Folder *folder = fileSystem->GetFolder(fileSystem->currentPath);
 
-    for (auto subFolder : folder->folders)
+    if (folder->FindFolder(args[0]) != nullptr)
     {
-        if (subFolder->name == args[0])
-        {
-            const std::string errorMsg = "mkdir: cannot create directory '" + args[0] + "': File exists\n";
-            output->write(errorMsg.c_str(), errorMsg.size());
-            return;
-        }
+        const std::string errorMsg = "mkdir: cannot create directory '" + args[0] + "': File exists\n";
+        output->write(errorMsg.c_str(), errorMsg.size());
+        return;
     }
 
     espnix::Folder *newFolder = new espnix::Folder();
@@ -2,23 +2,211 @@
 #include <Terminal/Terminal.h>
 #include <FileSystem/FileSystem.h>
 #include <FileSystem/File.h>
+#include <Runtime/Arena.h>
 #include <Runtime/VirtualMachine.h>
+#include <Runtime/ProgramImage.h>
+#include <Runtime/Profile.h>
+#include <Runtime/NativePrograms.h>
+#include <Runtime/Snapshot.h>
+#include <Runtime/Channel.h>
 #include <IO/FileDescriptor.h>
 #include <vector>
+#include <memory>
+#include <stdexcept>
+
+static std::string absolutePath(FileSystem *fileSystem, const std::string &path)
+{
+    if (!path.empty() && path[0] != '/')
+    {
+        return fileSystem->currentPath + "/" + path;
+    }
+    return path;
+}
+
+// Keeps the latest snapshot a program takes in <program>.snap
+class FileSnapshotSink : public SnapshotSink
+{
+private:
+    FileSystem *fileSystem;
+    std::string snapshotFilePath;
+
+public:
+    FileSnapshotSink(FileSystem *fs, const std::string &programPath)
+        : fileSystem(fs), snapshotFilePath(snapshotPath(programPath)) {}
+
+    void write(const VirtualMachine &vm) override
+    {
+        std::vector<uint8_t> image = vm.snapshot();
+        espnix::File *snapshotFile = fileSystem->CreateFile(snapshotFilePath);
+        if (snapshotFile == nullptr)
+        {
+            throw std::runtime_error("cannot write snapshot " + snapshotFilePath);
+        }
+        fileSystem->WriteFile(snapshotFile, std::string(image.begin(), image.end()), snapshotFilePath);
+    }
+};
+
+// Runs several programs side by side on one cooperative scheduler: each
+// runs until it halts or waits on a channel, then the next gets its turn
+static void RunTogether(FileSystem *fileSystem, const std::vector<std::string> &paths, FileDescriptor *output)
+{
+    std::vector<std::shared_ptr<const ProgramImage>> programs;
+    for (const std::string &path : paths)
+    {
+        espnix::File *bytecodeFile = fileSystem->GetFile(path);
+        if (bytecodeFile == nullptr)
+        {
+            const std::string errMsg = "run: error: " + path + ": No such file or directory\n";
+            output->write(errMsg.c_str(), errMsg.size());
+            return;
+        }
+        const std::string loadMsg = "Loading " + path + "...\n";
+        output->write(loadMsg.c_str(), loadMsg.size());
+        try
+        {
+            programs.push_back(loadProgramImage(absolutePath(fileSystem, path), bytecodeFile->Read()));
+        }
+        catch (const std::exception &e)
+        {
+            const std::string errMsg = "run: error: " + path + ": " + e.what() + "\n";
+            output->write(errMsg.c_str(), errMsg.size());
+            return;
+        }
+    }
+
+    size_t current = 0;
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        ChannelSet channels;
+        std::vector<std::unique_ptr<VirtualMachine>> vms;
+        for (const std::shared_ptr<const ProgramImage> &program : programs)
+        {
+            vms.push_back(std::unique_ptr<VirtualMachine>(new VirtualMachine()));
+            vms.back()->load(program);
+            vms.back()->setChannels(&channels);
+        }
+
+        std::vector<size_t> running;
+        for (size_t i = 0; i < vms.size(); i++)
+        {
+            running.push_back(i);
+        }
+        while (!running.empty())
+        {
+            // A round in which nothing halted and no message moved leaves
+            // every program waiting on the same channel state as before
+            uint32_t transfers = channels.transferCount();
+            size_t before = running.size();
+            for (size_t i = 0; i < running.size();)
+            {
+                current = running[i];
+                if (vms[current]->execute())
+                {
+                    running.erase(running.begin() + i);
+                }
+                else
+                {
+                    i++;
+                }
+            }
+            if (running.size() == before && channels.transferCount() == transfers)
+            {
+                current = running.front();
+                throw std::runtime_error("Deadlock: every running program is waiting on a channel");
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        const std::string errMsg = "\nrun: " + paths[current] + ": runtime error: " + std::string(e.what()) + "\n";
+        output->write(errMsg.c_str(), errMsg.size());
+    }
+}
 
 void RunCommand::Execute(const std::vector<std::string> &args, Terminal *terminal, FileDescriptor *input, FileDescriptor *output)
 {
-    if (args.size() < 1)
+    std::vector<std::string> paths;
+    bool collectProfile = false;
+    bool interpret = false;
+    bool restore = false;
+    for (const std::string& arg : args)
+    {
+        if (arg == "--collect-profile")
+        {
+            collectProfile = true;
+        }
+        else if (arg == "--interpret")
+        {
+            interpret = true;
+        }
+        else if (arg == "--restore")
+        {
+            restore = true;
+        }
+        else
+        {
+            paths.push_back(arg);
+        }
+    }
+
+    if (paths.size() < 1)
     {
-        const std::string msg1 = "Usage: run <bytecode_file>\n";
+        const std::string msg1 = "Usage: run [--collect-profile] [--interpret] <bytecode_file>\n"
+                                 "       run --restore <snapshot_file>\n"
+                                 "       run <bytecode_file> <bytecode_file>...\n";
         output->write(msg1.c_str(), msg1.size());
         const std::string msg2 = "  Executes compiled .enix bytecode file\n";
         output->write(msg2.c_str(), msg2.size());
+        const std::string msg3 = "  --collect-profile  record branch counts to <program>.prof for compile --use-profile\n";
+        output->write(msg3.c_str(), msg3.size());
+        const std::string msg4 = "  --interpret        use the VM even if the program was built in with enix2cpp\n";
+        output->write(msg4.c_str(), msg4.size());
+        const std::string msg5 = "  --restore          resume where the program called snapshot() (<program>.snap)\n";
+        output->write(msg5.c_str(), msg5.size());
+        const std::string msg6 = "  Several files run side by side and can talk over chan_send/chan_recv\n";
+        output->write(msg6.c_str(), msg6.size());
         return;
     }
 
     FileSystem *fileSystem = FileSystem::GetInstance();
-    std::string bytecodeFilePath = args[0];
+
+    if (paths.size() > 1)
+    {
+        if (collectProfile || restore)
+        {
+            const std::string errMsg = "run: error: --collect-profile and --restore take a single program\n";
+            output->write(errMsg.c_str(), errMsg.size());
+            return;
+        }
+        RunTogether(fileSystem, paths, output);
+        return;
+    }
+    std::string bytecodeFilePath = paths[0];
+
+    // A snapshot names the program it was taken from
+    std::vector<uint8_t> image;
+    if (restore)
+    {
+        const std::string &snapshotFilePath = paths[0];
+        espnix::File *snapshotFile = fileSystem->GetFile(snapshotFilePath);
+        if (snapshotFile == nullptr)
+        {
+            const std::string errMsg = "run: error: " + snapshotFilePath + ": No such file or directory\n";
+            output->write(errMsg.c_str(), errMsg.size());
+            return;
+        }
+
+        std::string imageStr = snapshotFile->Read();
+        image.assign(imageStr.begin(), imageStr.end());
+        if (!VirtualMachine::snapshotProgram(image, bytecodeFilePath))
+        {
+            const std::string errMsg = "run: error: " + snapshotFilePath + " is not a snapshot\n";
+            output->write(errMsg.c_str(), errMsg.size());
+            return;
+        }
+    }
 
     if (bytecodeFilePath.length() > 3 &&
         bytecodeFilePath.substr(bytecodeFilePath.length() - 3) == ".es")
@@ -58,20 +246,65 @@ void RunCommand::Execute(const std::vector<std::string> &args, Terminal *termina
     const std::string loadMsg = "Loading " + bytecodeFilePath + "...\n";
     output->write(loadMsg.c_str(), loadMsg.size());
 
+    std::shared_ptr<const ProgramImage> program;
+    BranchProfile profile;
+
     try
     {
-        std::string bytecodeStr = bytecodeFile->Read();
+        // Runs of the same file share one copy of its code
+        program = loadProgramImage(absolutePath(fileSystem, bytecodeFilePath), bytecodeFile->Read());
 
-        std::vector<uint8_t> bytecode;
-        bytecode.reserve(bytecodeStr.size());
-        for (char c : bytecodeStr)
+        // A program translated with enix2cpp runs natively, provided it was
+        // translated from exactly this bytecode; profiling and snapshots
+        // need the VM
+        const NativeProgramRegistrar *native = nullptr;
+        if (!interpret && !collectProfile && !restore)
         {
-            bytecode.push_back(static_cast<uint8_t>(c));
+            native = findNativeProgram(nativeProgramName(bytecodeFilePath));
+            if (native != nullptr && native->checksum != codeChecksum(program->code))
+            {
+                const std::string staleMsg = "Built-in native code is out of date, interpreting\n";
+                output->write(staleMsg.c_str(), staleMsg.size());
+                native = nullptr;
+            }
         }
 
+        // The VM's stack, globals and arrays come from one arena, so the run
+        // leaves the heap as it found it
+        Arena arena;
+        Arena::Scope arenaScope(arena);
         VirtualMachine vm;
-        vm.load(bytecode);
-        vm.execute();
+        vm.load(program);
+        FileSnapshotSink snapshotSink(fileSystem, program->path);
+        vm.setSnapshotSink(&snapshotSink);
+        // A program on its own can still pass messages to itself
+        ChannelSet channels;
+        vm.setChannels(&channels);
+
+        if (restore)
+        {
+            // Resuming is only safe on the exact code the snapshot was taken of
+            const std::string restoreMsg = vm.restore(image)
+                ? "Resuming from snapshot " + paths[0] + "\n"
+                : "Snapshot " + paths[0] + " does not match " + bytecodeFilePath + ", starting from the beginning\n";
+            output->write(restoreMsg.c_str(), restoreMsg.size());
+        }
+
+        if (native != nullptr)
+        {
+            native->run(vm);
+        }
+        else
+        {
+            if (collectProfile)
+            {
+                vm.setProfile(&profile);
+            }
+            if (!vm.execute())
+            {
+                throw std::runtime_error("Deadlock: the program is waiting on a channel nothing else uses");
+            }
+        }
     }
     catch (const std::exception& e)
     {
@@ -83,5 +316,23 @@ void RunCommand::Execute(const std::vector<std::string> &args, Terminal *termina
         const std::string errMsg = "\nrun: runtime error: Unknown execution error\n";
         output->write(errMsg.c_str(), errMsg.size());
     }
-}
 
+    // Counts gathered up to a runtime error are still worth keeping
+    if (collectProfile && program)
+    {
+        std::string profileFilePath = absolutePath(fileSystem, profilePath(bytecodeFilePath));
+
+        espnix::File *profileFile = fileSystem->CreateFile(profileFilePath);
+        if (profileFile == nullptr)
+        {
+            const std::string errMsg = "run: error: cannot write profile " + profileFilePath + "\n";
+            output->write(errMsg.c_str(), errMsg.size());
+            return;
+        }
+
+        fileSystem->WriteFile(profileFile, formatProfile(codeChecksum(program->code), profile), profileFilePath);
+        const std::string profMsg = "Profile written to " + profileFilePath + " (" +
+                                    std::to_string(profile.size()) + " branches)\n";
+        output->write(profMsg.c_str(), profMsg.size());
+    }
+}
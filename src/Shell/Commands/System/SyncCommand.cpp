@@ -0,0 +1,31 @@
+#include "SyncCommand.h"
+
+#include <FileSystem/FileSystem.h>
+#include <Terminal/Terminal.h>
+#include <IO/FileDescriptor.h>
+
+void SyncCommand::Execute(const std::vector<std::string> &args, Terminal *terminal, FileDescriptor *input, FileDescriptor *output)
+{
+    if (!args.empty() && args[0] == "--help")
+    {
+        const std::string help =
+            "Usage: sync\n"
+            "Write buffered file changes and metadata to the SD card.\n";
+        output->write(help.c_str(), help.size());
+        return;
+    }
+
+    int failed = FileDescriptor::syncAll();
+
+    FileSystem *fileSystem = FileSystem::GetInstance();
+    if (fileSystem->sdMounted && !fileSystem->inInitramfs)
+    {
+        fileSystem->metadata.Commit(fileSystem->root);
+    }
+
+    if (failed > 0)
+    {
+        const std::string errorMsg = "sync: " + std::to_string(failed) + " file(s) could not be written\n";
+        output->write(errorMsg.c_str(), errorMsg.size());
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef SYNC_COMMAND_H
+#define SYNC_COMMAND_H
+
+#include <vector>
+#include <string>
+
+#include <Shell/Commands/ICommand.h>
+
+class Terminal;
+
+class SyncCommand : public ICommand
+{
+public:
+    void Execute(const std::vector<std::string> &args, Terminal *terminal, FileDescriptor *input, FileDescriptor *output) override;
+};
+
+#endif
\ No newline at end of file
@@ -22,6 +22,8 @@
 #include <Shell/Commands/System/ClearCommand.h>
 #include <Shell/Commands/System/CompileCommand.h>
 #include <Shell/Commands/System/RunCommand.h>
+#include <Shell/Commands/System/Enix2CppCommand.h>
+#include <Shell/Commands/System/SyncCommand.h>
 
 #include <Shell/Commands/Other/IwctlCommand.h>
 
@@ -40,8 +42,10 @@ Shell::Shell() : terminal(nullptr)
     commandRegistry["clear"] = std::make_shared<ClearCommand>();
     commandRegistry["compile"] = std::make_shared<CompileCommand>();
     commandRegistry["run"] = std::make_shared<RunCommand>();
+    commandRegistry["enix2cpp"] = std::make_shared<Enix2CppCommand>();
+    commandRegistry["sync"] = std::make_shared<SyncCommand>();
 
-    BootMessages::PrintOK("Registered 8 built-in commands");
+    BootMessages::PrintOK("Registered 11 built-in commands");
 
     BootMessages::PrintInfo("Loading additional modules");
     commandRegistry["iwctl"] = std::make_shared<IwctlCommand>();
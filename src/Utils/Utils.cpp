@@ -14,4 +14,15 @@ std::string Utils::FormatDate(int timestamp)
     std::stringstream ss;
     ss << std::put_time(localTime, format.c_str());
     return ss.str();
+}
+
+std::string Utils::ReplaceExtension(const std::string &path, const std::string &extension)
+{
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of('/');
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+    {
+        return path.substr(0, dot) + extension;
+    }
+    return path + extension;
 }
\ No newline at end of file
@@ -7,6 +7,9 @@ class Utils
 {
 public:
     static std::string FormatDate(int timestamp);
+
+    // path with its extension replaced: ("/a/prog.enix", ".prof") -> "/a/prog.prof"
+    static std::string ReplaceExtension(const std::string &path, const std::string &extension);
 };
 
 #endif
\ No newline at end of file
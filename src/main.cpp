@@ -2,6 +2,7 @@
 #include <Terminal/Terminal.h>
 #include <Utils/BootMessages.h>
 #include <FileSystem/FileSystem.h>
+#include <IO/FileDescriptor.h>
 
 Terminal *terminalFrame;
 
@@ -45,4 +46,7 @@ void setup()
 void loop()
 {
     terminalFrame->Read();
+
+    // Writes left waiting in file buffers go to the card while idle
+    FileDescriptor::writeBackExpired();
 }
\ No newline at end of file
@@ -0,0 +1,37 @@
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+void HardwareSerial::begin(unsigned long baud)
+{
+}
+
+int HardwareSerial::available()
+{
+    return 0;
+}
+
+int HardwareSerial::read()
+{
+    return -1;
+}
+
+size_t HardwareSerial::readBytes(char *buffer, size_t length)
+{
+    return 0;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    return fwrite(buffer, 1, size, stdout);
+}
+
+size_t HardwareSerial::print(const char *text)
+{
+    return this->write(reinterpret_cast<const uint8_t *>(text), strlen(text));
+}
+
+size_t HardwareSerial::println(const char *text)
+{
+    return this->print(text) + this->print("\n");
+}
@@ -0,0 +1,49 @@
+#ifndef ARDUINO_H
+#define ARDUINO_H
+
+// The little of the Arduino core that the runtime and the file system use,
+// so they can be built and tested on the host (pio test -e native)
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <sys/types.h>
+
+inline unsigned long millis()
+{
+    static const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    return static_cast<unsigned long>(std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+// The console: output goes to stdout, and no input ever arrives
+class HardwareSerial
+{
+public:
+    void begin(unsigned long baud);
+    int available();
+    int read();
+    size_t readBytes(char *buffer, size_t length);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const char *text);
+    size_t println(const char *text = "");
+};
+
+extern HardwareSerial Serial;
+
+class String
+{
+    std::string text;
+
+public:
+    String(const char *text = "") : text(text) {}
+    String(const std::string &text) : text(text) {}
+
+    unsigned int length() const { return static_cast<unsigned int>(this->text.size()); }
+    const char *c_str() const { return this->text.c_str(); }
+};
+
+#endif
@@ -0,0 +1,466 @@
+#include <algorithm>
+#include <cstring>
+
+#include "SD.h"
+
+fs::SDFS SD;
+
+namespace fs
+{
+    static const uint32_t NO_SECTOR = UINT32_MAX;
+
+    struct File::Handle
+    {
+        SDFS *card;
+        std::string path;
+        bool directory;
+        bool open;
+        std::shared_ptr<std::string> data;
+        bool readable;
+        bool writable;
+        bool append;
+        size_t position;
+        uint32_t sector;        // Sector in the file's buffer, NO_SECTOR if none
+        std::vector<std::string> entries;   // A directory's names, listed on open
+        size_t next;
+    };
+
+    // Sectors a transfer of count bytes at offset moves, given the one
+    // already buffered; the buffer then holds the last
+    static uint32_t Touch(uint32_t &buffered, size_t offset, size_t count)
+    {
+        if (count == 0)
+        {
+            return 0;
+        }
+        uint32_t first = static_cast<uint32_t>(offset / SDFS::SECTOR_SIZE);
+        uint32_t last = static_cast<uint32_t>((offset + count - 1) / SDFS::SECTOR_SIZE);
+        uint32_t moved = last - first + 1;
+        if (buffered == first)
+        {
+            moved--;
+        }
+        buffered = last;
+        return moved;
+    }
+
+    static std::string Normalize(const char *path)
+    {
+        std::string normal = path[0] == '/' ? path : std::string("/") + path;
+        while (normal.size() > 1 && normal.back() == '/')
+        {
+            normal.pop_back();
+        }
+        return normal;
+    }
+
+    static std::string Parent(const std::string &path)
+    {
+        size_t slash = path.find_last_of('/');
+        return slash == 0 ? "/" : path.substr(0, slash);
+    }
+
+    static std::string Prefix(const std::string &directory)
+    {
+        return directory == "/" ? directory : directory + "/";
+    }
+
+    File::File()
+    {
+    }
+
+    File::File(std::shared_ptr<Handle> handle) : handle(handle)
+    {
+    }
+
+    File::operator bool() const
+    {
+        return this->handle && this->handle->open;
+    }
+
+    size_t File::write(uint8_t c)
+    {
+        return this->write(&c, 1);
+    }
+
+    size_t File::write(const uint8_t *buffer, size_t size)
+    {
+        if (!*this || !this->handle->writable)
+        {
+            return 0;
+        }
+
+        Handle &file = *this->handle;
+        SDFS &card = *file.card;
+        std::string &data = *file.data;
+        if (file.append)
+        {
+            file.position = data.size();
+        }
+        size = std::min(size, card.writable);
+        if (card.writable != SIZE_MAX)
+        {
+            card.writable -= size;
+        }
+
+        if (data.size() < file.position + size)
+        {
+            data.resize(file.position + size, '\0');
+        }
+        memcpy(&data[file.position], buffer, size);
+        card.charge(1, Touch(file.sector, file.position, size));
+        card.stats.bytesWritten += size;
+        file.position += size;
+        return size;
+    }
+
+    int File::available()
+    {
+        if (!*this || !this->handle->readable || this->handle->directory)
+        {
+            return 0;
+        }
+        return static_cast<int>(this->handle->data->size() - std::min(this->handle->position, this->handle->data->size()));
+    }
+
+    int File::read()
+    {
+        uint8_t c;
+        return this->read(&c, 1) == 1 ? c : -1;
+    }
+
+    size_t File::read(uint8_t *buffer, size_t size)
+    {
+        if (!*this || !this->handle->readable || this->handle->directory)
+        {
+            return 0;
+        }
+
+        Handle &file = *this->handle;
+        SDFS &card = *file.card;
+        const std::string &data = *file.data;
+        size_t position = std::min(file.position, data.size());
+        size = std::min(std::min(size, data.size() - position), card.readable);
+        if (card.readable != SIZE_MAX)
+        {
+            card.readable -= size;
+        }
+
+        memcpy(buffer, data.data() + position, size);
+        card.charge(1, Touch(file.sector, position, size));
+        card.stats.bytesRead += size;
+        file.position = position + size;
+        return size;
+    }
+
+    bool File::seek(uint32_t position)
+    {
+        if (!*this || this->handle->directory)
+        {
+            return false;
+        }
+        this->handle->card->charge(1, 0);
+        this->handle->position = position;
+        return true;
+    }
+
+    size_t File::position() const
+    {
+        return *this ? this->handle->position : 0;
+    }
+
+    size_t File::size() const
+    {
+        return *this && !this->handle->directory ? this->handle->data->size() : 0;
+    }
+
+    void File::flush()
+    {
+        if (*this && this->handle->writable)
+        {
+            this->handle->card->charge(1, 0);
+        }
+    }
+
+    void File::close()
+    {
+        if (this->handle)
+        {
+            this->handle->open = false;
+        }
+    }
+
+    size_t File::print(const char *text)
+    {
+        return this->write(reinterpret_cast<const uint8_t *>(text), strlen(text));
+    }
+
+    size_t File::println(const char *text)
+    {
+        return this->print(text) + this->print("\n");
+    }
+
+    const char *File::name() const
+    {
+        if (!this->handle)
+        {
+            return "";
+        }
+        const std::string &path = this->handle->path;
+        return path.c_str() + (path == "/" ? 0 : path.find_last_of('/') + 1);
+    }
+
+    const char *File::path() const
+    {
+        return this->handle ? this->handle->path.c_str() : "";
+    }
+
+    bool File::isDirectory()
+    {
+        return *this && this->handle->directory;
+    }
+
+    File File::openNextFile(const char *mode)
+    {
+        if (!this->isDirectory() || this->handle->next >= this->handle->entries.size())
+        {
+            return File();
+        }
+        const std::string &name = this->handle->entries[this->handle->next++];
+        return this->handle->card->open(Prefix(this->handle->path) + name, mode);
+    }
+
+    String File::getNextFileName()
+    {
+        if (!this->isDirectory() || this->handle->next >= this->handle->entries.size())
+        {
+            return String();
+        }
+        this->handle->card->charge(1, 0);
+        return String(Prefix(this->handle->path) + this->handle->entries[this->handle->next++]);
+    }
+
+    SDFS::SDFS()
+    {
+        this->reset();
+    }
+
+    void SDFS::reset()
+    {
+        this->nodes.clear();
+        this->nodes["/"] = Node{true, nullptr};
+        this->writable = SIZE_MAX;
+        this->readable = SIZE_MAX;
+        this->renameFails = false;
+        this->resetStats();
+    }
+
+    void SDFS::resetStats()
+    {
+        this->stats = Stats();
+    }
+
+    void SDFS::charge(uint32_t calls, uint32_t sectors)
+    {
+        this->stats.calls += calls;
+        this->stats.sectors += sectors;
+        this->stats.micros += static_cast<uint64_t>(calls) * CALL_MICROS + static_cast<uint64_t>(sectors) * SECTOR_MICROS;
+    }
+
+    bool SDFS::parentExists(const std::string &path) const
+    {
+        auto parent = this->nodes.find(Parent(path));
+        return parent != this->nodes.end() && parent->second.directory;
+    }
+
+    bool SDFS::hasChildren(const std::string &path) const
+    {
+        std::string prefix = Prefix(path);
+        auto it = this->nodes.upper_bound(prefix);
+        return it != this->nodes.end() && it->first.compare(0, prefix.size(), prefix) == 0;
+    }
+
+    bool SDFS::begin()
+    {
+        return true;
+    }
+
+    sdcard_type_t SDFS::cardType()
+    {
+        return CARD_SDHC;
+    }
+
+    uint64_t SDFS::cardSize()
+    {
+        return 4ull << 30;
+    }
+
+    uint64_t SDFS::totalBytes()
+    {
+        return this->cardSize();
+    }
+
+    uint64_t SDFS::usedBytes()
+    {
+        uint64_t used = 0;
+        for (const auto &node : this->nodes)
+        {
+            used += node.second.directory ? 0 : node.second.data->size();
+        }
+        return used;
+    }
+
+    File SDFS::open(const char *path, const char *mode)
+    {
+        this->charge(1, 0);
+
+        std::string normal = Normalize(path);
+        std::string how = mode;
+        auto it = this->nodes.find(normal);
+        bool reading = how == "r" || how == "r+";
+
+        std::shared_ptr<File::Handle> handle(new File::Handle());
+        handle->card = this;
+        handle->path = normal;
+        handle->open = true;
+        handle->readable = false;
+        handle->writable = false;
+        handle->append = false;
+        handle->position = 0;
+        handle->sector = NO_SECTOR;
+        handle->next = 0;
+
+        if (it != this->nodes.end() && it->second.directory)
+        {
+            if (how != "r")
+            {
+                return File();
+            }
+            handle->directory = true;
+            handle->entries = this->list(normal);
+            return File(handle);
+        }
+
+        if (it == this->nodes.end())
+        {
+            if (reading || !this->parentExists(normal))
+            {
+                return File();
+            }
+            it = this->nodes.insert(std::make_pair(normal, Node{false, std::make_shared<std::string>()})).first;
+        }
+        else if (how[0] == 'w')
+        {
+            it->second.data->clear();
+        }
+
+        handle->directory = false;
+        handle->data = it->second.data;
+        handle->readable = how[0] == 'r' || how.find('+') != std::string::npos;
+        handle->writable = how != "r";
+        handle->append = how[0] == 'a';
+        return File(handle);
+    }
+
+    File SDFS::open(const std::string &path, const char *mode)
+    {
+        return this->open(path.c_str(), mode);
+    }
+
+    bool SDFS::exists(const char *path)
+    {
+        this->charge(1, 0);
+        return this->nodes.count(Normalize(path)) > 0;
+    }
+
+    bool SDFS::mkdir(const char *path)
+    {
+        this->charge(1, 0);
+        std::string normal = Normalize(path);
+        if (this->nodes.count(normal) > 0 || !this->parentExists(normal))
+        {
+            return false;
+        }
+        this->nodes[normal] = Node{true, nullptr};
+        return true;
+    }
+
+    bool SDFS::remove(const char *path)
+    {
+        this->charge(1, 0);
+        auto it = this->nodes.find(Normalize(path));
+        if (it == this->nodes.end() || it->second.directory)
+        {
+            return false;
+        }
+        this->nodes.erase(it);
+        return true;
+    }
+
+    bool SDFS::rmdir(const char *path)
+    {
+        this->charge(1, 0);
+        std::string normal = Normalize(path);
+        auto it = this->nodes.find(normal);
+        if (normal == "/" || it == this->nodes.end() || !it->second.directory || this->hasChildren(normal))
+        {
+            return false;
+        }
+        this->nodes.erase(it);
+        return true;
+    }
+
+    bool SDFS::rename(const char *from, const char *to)
+    {
+        this->charge(1, 0);
+        std::string source = Normalize(from);
+        std::string target = Normalize(to);
+        auto it = this->nodes.find(source);
+        if (this->renameFails || source == "/" || it == this->nodes.end() ||
+            this->nodes.count(target) > 0 || !this->parentExists(target))
+        {
+            return false;
+        }
+
+        // A directory takes everything under it along
+        std::vector<std::pair<std::string, Node>> moved;
+        std::string prefix = Prefix(source);
+        for (auto child = this->nodes.upper_bound(prefix);
+             child != this->nodes.end() && child->first.compare(0, prefix.size(), prefix) == 0;)
+        {
+            moved.push_back(std::make_pair(Prefix(target) + child->first.substr(prefix.size()), child->second));
+            child = this->nodes.erase(child);
+        }
+        moved.push_back(std::make_pair(target, it->second));
+        this->nodes.erase(it);
+        this->nodes.insert(moved.begin(), moved.end());
+        return true;
+    }
+
+    bool SDFS::contents(const std::string &path, std::string &data) const
+    {
+        auto it = this->nodes.find(Normalize(path.c_str()));
+        if (it == this->nodes.end() || it->second.directory)
+        {
+            return false;
+        }
+        data = *it->second.data;
+        return true;
+    }
+
+    std::vector<std::string> SDFS::list(const std::string &directory) const
+    {
+        std::vector<std::string> names;
+        std::string prefix = Prefix(Normalize(directory.c_str()));
+        for (auto it = this->nodes.upper_bound(prefix);
+             it != this->nodes.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        {
+            std::string rest = it->first.substr(prefix.size());
+            if (rest.find('/') == std::string::npos)
+            {
+                names.push_back(rest);
+            }
+        }
+        return names;
+    }
+}
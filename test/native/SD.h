@@ -0,0 +1,139 @@
+#ifndef SD_H
+#define SD_H
+
+// Host stand-in for the ESP32 SD library: a card held in memory, so the
+// file system can be built and tested without one. On top of the library's
+// calls, tests can look at what the card holds, make it fail on purpose and
+// see what the file system asked of it.
+//
+// Time is not measured but estimated from a model of a card on the SPI
+// bus, so throughput figures come out the same on every host. Each call
+// that reaches the card costs CALL_MICROS. Each 512-byte sector moved
+// to or from the card costs SECTOR_MICROS, except the one a file already
+// holds in its sector buffer, as FatFs does.
+
+#include <Arduino.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+typedef enum
+{
+    CARD_NONE,
+    CARD_MMC,
+    CARD_SD,
+    CARD_SDHC,
+    CARD_UNKNOWN
+} sdcard_type_t;
+
+namespace fs
+{
+    class SDFS;
+
+    class File
+    {
+        struct Handle;
+        std::shared_ptr<Handle> handle;
+
+        explicit File(std::shared_ptr<Handle> handle);
+        friend class SDFS;
+
+    public:
+        File();
+
+        explicit operator bool() const;
+        size_t write(uint8_t c);
+        size_t write(const uint8_t *buffer, size_t size);
+        int available();
+        int read();
+        size_t read(uint8_t *buffer, size_t size);
+        bool seek(uint32_t position);
+        size_t position() const;
+        size_t size() const;
+        void flush();
+        void close();
+
+        size_t print(const char *text);
+        size_t println(const char *text = "");
+
+        const char *name() const;
+        const char *path() const;
+        bool isDirectory();
+        File openNextFile(const char *mode = FILE_READ);
+        String getNextFileName();
+    };
+
+    class SDFS
+    {
+    public:
+        static const size_t SECTOR_SIZE = 512;
+        static const uint32_t CALL_MICROS = 20;
+        static const uint32_t SECTOR_MICROS = 250;
+
+        struct Stats
+        {
+            uint32_t calls;         // Calls that reached the card
+            uint32_t sectors;       // Sectors moved to or from the card
+            uint64_t bytesRead;
+            uint64_t bytesWritten;
+            uint64_t micros;        // What the calls would have taken
+        };
+
+        bool begin();
+        sdcard_type_t cardType();
+        uint64_t cardSize();
+        uint64_t totalBytes();
+        uint64_t usedBytes();
+
+        File open(const char *path, const char *mode = FILE_READ);
+        File open(const std::string &path, const char *mode = FILE_READ);
+        bool exists(const char *path);
+        bool mkdir(const char *path);
+        bool remove(const char *path);
+        bool rmdir(const char *path);
+        bool rename(const char *from, const char *to);
+
+        // Test hooks. Writes come up short once the card has taken
+        // writable more bytes, reads once it has returned readable more;
+        // renames fail while renameFails is set.
+        size_t writable;
+        size_t readable;
+        bool renameFails;
+        Stats stats;
+
+        SDFS();
+        // An empty card, with no faults set and the counters cleared
+        void reset();
+        void resetStats();
+        // The file's contents; false if there is no such file
+        bool contents(const std::string &path, std::string &data) const;
+        // Names in a directory, in order
+        std::vector<std::string> list(const std::string &directory) const;
+
+    private:
+        friend class File;
+
+        struct Node
+        {
+            bool directory;
+            std::shared_ptr<std::string> data;
+        };
+        std::map<std::string, Node> nodes;
+
+        void charge(uint32_t calls, uint32_t sectors);
+        bool parentExists(const std::string &path) const;
+        bool hasChildren(const std::string &path) const;
+    };
+}
+
+extern fs::SDFS SD;
+
+using namespace fs;
+
+#endif
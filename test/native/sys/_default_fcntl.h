@@ -0,0 +1,7 @@
+#ifndef _SYS__DEFAULT_FCNTL_H_
+#define _SYS__DEFAULT_FCNTL_H_
+
+// newlib's home of the open flags; the host C library keeps them in fcntl.h
+#include <fcntl.h>
+
+#endif
@@ -0,0 +1,131 @@
+// The bulk array builtins against the script loops they replace: each pair
+// of programs must print the same, and the builtin must be clearly faster.
+// Timings are taken on the host; run with -v to see them.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 4096 cells with a value in each, then ROUNDS passes of the operation
+static const char *const SETUP =
+    "var a[4096];\n"
+    "var b[4096];\n"
+    "var i = 0;\n"
+    "while (i < 4096) {\n"
+    "  a[i] = (i * 37) % 101 - 50;\n"
+    "  b[i] = i % 7;\n"
+    "  i = i + 1;\n"
+    "}\n"
+    "var result = 0;\n"
+    "var round = 0;\n"
+    "while (round < 100) {\n";
+
+static const char *const TEARDOWN =
+    "  round = round + 1;\n"
+    "}\n"
+    "print(result);\n"
+    "print(a[4095] + b[4095]);\n";
+
+struct Pair
+{
+    const char *name;
+    const char *loop;       // One pass as a script loop
+    const char *builtin;    // The same pass with the builtin
+};
+
+static const Pair PAIRS[] = {
+    {"sum",
+     "  var s = 0;\n  i = 0;\n  while (i < 4096) {\n    s = s + a[i];\n    i = i + 1;\n  }\n"
+     "  result = result + s;\n",
+     "  result = result + sum(a);\n"},
+    {"dot",
+     "  var d = 0;\n  i = 0;\n  while (i < 4096) {\n    d = d + a[i] * b[i];\n    i = i + 1;\n  }\n"
+     "  result = result + d;\n",
+     "  result = result + dot(a, b);\n"},
+    {"fill and copy",
+     "  i = 0;\n  while (i < 4096) {\n    b[i] = round;\n    i = i + 1;\n  }\n"
+     "  i = 0;\n  while (i < 4096) {\n    a[i] = b[i];\n    i = i + 1;\n  }\n"
+     "  result = result + a[round];\n",
+     "  fill(b, round);\n  copy(a, b);\n  result = result + a[round];\n"},
+    {"find",
+     "  a[4095 - round] = 1000 + round;\n"
+     "  var f = -1;\n  i = 0;\n  while (i < 4096 && f < 0) {\n    if (a[i] == 1000 + round) {\n      f = i;\n    }\n"
+     "    i = i + 1;\n  }\n  result = result + f;\n",
+     "  a[4095 - round] = 1000 + round;\n  result = result + find(a, 1000 + round);\n"},
+};
+
+// Runs the program, timing only its execution, and gives back what it
+// printed or the error that stopped it
+static std::string Run(const std::string &source, double &millis)
+{
+    std::ostringstream output;
+    std::streambuf *console = std::cout.rdbuf(output.rdbuf());
+    millis = 0;
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        Lexer lexer(source.c_str());
+        Compiler compiler(lexer.tokenize());
+        const auto &bytecode = compiler.compile();
+        std::vector<uint8_t> code(bytecode.begin(), bytecode.end());
+        VirtualMachine vm;
+        vm.load(code);
+        auto start = std::chrono::steady_clock::now();
+        while (!vm.execute())
+        {
+        }
+        millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    catch (const std::exception &e)
+    {
+        output << "error: " << e.what() << "\n";
+    }
+    std::cout.rdbuf(console);
+    return output.str();
+}
+
+static const Pair *current;
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_builtin_matches_loop()
+{
+    double loopMillis, builtinMillis;
+    std::string loop = Run(std::string(SETUP) + current->loop + TEARDOWN, loopMillis);
+    std::string builtin = Run(std::string(SETUP) + current->builtin + TEARDOWN, builtinMillis);
+    bool same = loop == builtin && loop.find("error") == std::string::npos;
+
+    char line[128];
+    snprintf(line, sizeof(line), "%s, 100 passes over 4096 cells: loop %.2f ms, builtin %.2f ms",
+             current->name, loopMillis, builtinMillis);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE_MESSAGE(same, "the loop and the builtin printed different results");
+    TEST_ASSERT_TRUE(builtinMillis * 5 < loopMillis);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    for (const Pair &pair : PAIRS)
+    {
+        current = &pair;
+        UnityDefaultTestRun(test_builtin_matches_loop, pair.name, __LINE__);
+    }
+    return UNITY_END();
+}
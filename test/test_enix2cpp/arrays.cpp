@@ -0,0 +1,172 @@
+// Generated by enix2cpp from arrays.enix; do not edit.
+// Linked into the firmware, it replaces the interpreter for `run arrays.enix`
+// as long as the bytecode still matches.
+#include <Runtime/NativePrograms.h>
+#include <Runtime/Natives.h>
+#include <stdexcept>
+
+static void run_arrays(VirtualMachine& vm) {
+    (void)vm;
+    Value s0, s1, s2, s3;
+    Value v0; bool d0 = false;  // "a"
+    Value v1; bool d1 = false;  // "b"
+    Value v2; bool d2 = false;  // "i"
+    Value v3; bool d3 = false;  // "$t0"
+    Value v4; bool d4 = false;  // "composite"
+    Value v5; bool d5 = false;  // "primes"
+    Value v6; bool d6 = false;  // "n"
+    Value v7; bool d7 = false;  // "m"
+    s0 = Value(int32_t(16));
+    s0 = vm.newArray(s0.toInt());
+    v0 = s0; d0 = true;
+    s0 = Value(int32_t(16));
+    s0 = vm.newArray(s0.toInt());
+    v1 = s0; d1 = true;
+    s0 = Value(int32_t(0));
+    v2 = s0; d2 = true;
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    { Value args[] = {s0}; s0 = nativeTable[0].function(vm, args, 1); }  // len
+    v3 = s0; d3 = true;
+a41:
+    if (!d2) throwUndefinedVariable("i");
+    s0 = v2;
+    if (!d3) throwUndefinedVariable("$t0");
+    s1 = v3;
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a106;
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    if (!d2) throwUndefinedVariable("i");
+    s1 = v2;
+    if (!d2) throwUndefinedVariable("i");
+    s2 = v2;
+    if (!d2) throwUndefinedVariable("i");
+    s3 = v2;
+    s2 = Value(int32_t(uint32_t(s2.toInt()) * uint32_t(s3.toInt())));
+    s2 = Value(int32_t(uint32_t(s2.toInt()) + uint32_t(-20)));
+    checkedElement(vm, s0, s1.toInt()) = s2.toInt(); s0 = s2;
+    if (!d1) throwUndefinedVariable("b");
+    s0 = v1;
+    if (!d2) throwUndefinedVariable("i");
+    s1 = v2;
+    if (!d2) throwUndefinedVariable("i");
+    s2 = v2;
+    s2 = Value(int32_t(uint32_t(s2.toInt()) << 2));
+    if (!d2) throwUndefinedVariable("i");
+    s3 = v2;
+    s3 = Value(s3.toInt() >> 1);
+    s2 = Value(int32_t(uint32_t(s2.toInt()) - uint32_t(s3.toInt())));
+    checkedElement(vm, s0, s1.toInt()) = s2.toInt(); s0 = s2;
+    if (!d2) throwUndefinedVariable("i");
+    v2 = Value(int32_t(uint32_t(v2.toInt()) + uint32_t(1)));
+    goto a41;
+a106:
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    { Value args[] = {s0}; s0 = nativeTable[3].function(vm, args, 1); }  // sum
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    { Value args[] = {s0}; s0 = nativeTable[4].function(vm, args, 1); }  // min
+    vm.printValue(s0);
+    if (!d1) throwUndefinedVariable("b");
+    s0 = v1;
+    { Value args[] = {s0}; s0 = nativeTable[5].function(vm, args, 1); }  // max
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    if (!d1) throwUndefinedVariable("b");
+    s1 = v1;
+    { Value args[] = {s0, s1}; s0 = nativeTable[6].function(vm, args, 2); }  // dot
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    s1 = Value(int32_t(29));
+    { Value args[] = {s0, s1}; s0 = nativeTable[7].function(vm, args, 2); }  // find
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    s1 = Value(int32_t(30));
+    { Value args[] = {s0, s1}; s0 = nativeTable[7].function(vm, args, 2); }  // find
+    vm.printValue(s0);
+    if (!d1) throwUndefinedVariable("b");
+    s0 = v1;
+    if (!d0) throwUndefinedVariable("a");
+    s1 = v0;
+    { Value args[] = {s0, s1}; s0 = nativeTable[2].function(vm, args, 2); }  // copy
+    if (!d1) throwUndefinedVariable("b");
+    s0 = v1;
+    { Value args[] = {s0}; s0 = nativeTable[3].function(vm, args, 1); }  // sum
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    s1 = Value(int32_t(-3));
+    { Value args[] = {s0, s1}; s0 = nativeTable[1].function(vm, args, 2); }  // fill
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    { Value args[] = {s0}; s0 = nativeTable[3].function(vm, args, 1); }  // sum
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    vm.printValue(s0);
+    s0 = Value(int32_t(200));
+    s0 = vm.newArray(s0.toInt());
+    v4 = s0; d4 = true;
+    s0 = Value(int32_t(0));
+    v5 = s0; d5 = true;
+    s0 = Value(int32_t(2));
+    v6 = s0; d6 = true;
+a242:
+    if (!d6) throwUndefinedVariable("n");
+    s0 = v6;
+    s1 = Value(int32_t(200));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a368;
+    if (!d4) throwUndefinedVariable("composite");
+    s0 = v4;
+    if (!d6) throwUndefinedVariable("n");
+    s1 = v6;
+    s0 = Value(checkedElement(vm, s0, s1.toInt()));
+    s1 = Value(int32_t(0));
+    s0 = Value(s0.toInt() == s1.toInt());
+    if (!s0.toBool()) goto a356;
+    if (!d5) throwUndefinedVariable("primes");
+    v5 = Value(int32_t(uint32_t(v5.toInt()) + uint32_t(1)));
+    if (!d6) throwUndefinedVariable("n");
+    s0 = v6;
+    if (!d6) throwUndefinedVariable("n");
+    s1 = v6;
+    s0 = Value(int32_t(uint32_t(s0.toInt()) * uint32_t(s1.toInt())));
+    v7 = s0; d7 = true;
+a305:
+    if (!d7) throwUndefinedVariable("m");
+    s0 = v7;
+    s1 = Value(int32_t(200));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a356;
+    if (!d4) throwUndefinedVariable("composite");
+    s0 = v4;
+    if (!d7) throwUndefinedVariable("m");
+    s1 = v7;
+    s2 = Value(int32_t(1));
+    checkedElement(vm, s0, s1.toInt()) = s2.toInt(); s0 = s2;
+    if (!d7) throwUndefinedVariable("m");
+    s0 = v7;
+    if (!d6) throwUndefinedVariable("n");
+    s1 = v6;
+    s0 = Value(int32_t(uint32_t(s0.toInt()) + uint32_t(s1.toInt())));
+    v7 = s0; d7 = true;
+    goto a305;
+a356:
+    if (!d6) throwUndefinedVariable("n");
+    v6 = Value(int32_t(uint32_t(v6.toInt()) + uint32_t(1)));
+    goto a242;
+a368:
+    if (!d5) throwUndefinedVariable("primes");
+    s0 = v5;
+    vm.printValue(s0);
+    return;
+}
+
+static NativeProgramRegistrar registrar("arrays", 0xbac3f244u, run_arrays);
@@ -0,0 +1,178 @@
+// Generated by enix2cpp from branches.enix; do not edit.
+// Linked into the firmware, it replaces the interpreter for `run branches.enix`
+// as long as the bytecode still matches.
+#include <Runtime/NativePrograms.h>
+#include <Runtime/Natives.h>
+#include <stdexcept>
+
+static void run_branches(VirtualMachine& vm) {
+    (void)vm;
+    Value s0, s1, s2;
+    Value v0; bool d0 = false;  // "i"
+    Value v1; bool d1 = false;  // "acc"
+    Value v2; bool d2 = false;  // "cal"
+    Value v3; bool d3 = false;  // "id"
+    s0 = Value(int32_t(0));
+    v0 = s0; d0 = true;
+    s0 = Value(int32_t(0));
+    v1 = s0; d1 = true;
+    s0 = Value(int32_t(0));
+    v2 = s0; d2 = true;
+a31:
+    if (!d0) throwUndefinedVariable("i");
+    s0 = v0;
+    s1 = Value(int32_t(200));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a525;
+    s0 = Value(int32_t(37));
+    if (!d0) throwUndefinedVariable("i");
+    s1 = v0;
+    { int32_t value = s1.toInt(); int32_t quotient = (value + int32_t(uint32_t(value >> 31) & 7u)) >> 3; s1 = Value(int32_t(uint32_t(value) - (uint32_t(quotient) << 3))); }
+    s0 = Value(int32_t(uint32_t(s0.toInt()) * uint32_t(s1.toInt())));
+    s0 = Value(int32_t(uint32_t(s0.toInt()) + uint32_t(1000)));
+    v3 = s0; d3 = true;
+    if (!d3) throwUndefinedVariable("id");
+    s0 = v3;
+    s1 = Value(int32_t(1000));
+    s0 = Value(s0.toInt() == s1.toInt());
+    if (!s0.toBool()) goto a97;
+    s0 = Value(int32_t(3001));
+    v2 = s0; d2 = true;
+    goto a206;
+a97:
+    if (!d3) throwUndefinedVariable("id");
+    s0 = v3;
+    s1 = Value(int32_t(1037));
+    s0 = Value(s0.toInt() == s1.toInt());
+    if (!s0.toBool()) goto a128;
+    s0 = Value(int32_t(3112));
+    v2 = s0; d2 = true;
+    goto a206;
+a128:
+    if (!d3) throwUndefinedVariable("id");
+    s0 = v3;
+    s1 = Value(int32_t(1074));
+    s0 = Value(s0.toInt() == s1.toInt());
+    if (!s0.toBool()) goto a159;
+    s0 = Value(int32_t(3223));
+    v2 = s0; d2 = true;
+    goto a206;
+a159:
+    if (!d3) throwUndefinedVariable("id");
+    s0 = v3;
+    s1 = Value(int32_t(1111));
+    s0 = Value(s0.toInt() == s1.toInt());
+    if (!s0.toBool()) goto a190;
+    s0 = Value(int32_t(3334));
+    v2 = s0; d2 = true;
+    goto a206;
+a190:
+    s0 = Value(int32_t(0));
+    if (!d3) throwUndefinedVariable("id");
+    s1 = v3;
+    s0 = Value(int32_t(uint32_t(s0.toInt()) - uint32_t(s1.toInt())));
+    v2 = s0; d2 = true;
+a206:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    if (!d2) throwUndefinedVariable("cal");
+    s1 = v2;
+    s0 = Value(int32_t(uint32_t(s0.toInt()) + uint32_t(s1.toInt())));
+    v1 = s0; d1 = true;
+    if (!d0) throwUndefinedVariable("i");
+    s0 = v0;
+    s1 = Value(int32_t(5));
+    s0 = Value(s0.toInt() % s1.toInt());
+    switch (s0.toInt()) { case 0: goto a261; case 1: goto a275; case 3: goto a297; default: goto a311; }
+a261:
+    if (!d1) throwUndefinedVariable("acc");
+    v1 = Value(int32_t(uint32_t(v1.toInt()) + uint32_t(1)));
+    goto a324;
+a275:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    s1 = Value(int32_t(3));
+    s0 = Value(int32_t(uint32_t(s0.toInt()) * uint32_t(s1.toInt())));
+    v1 = s0; d1 = true;
+    goto a324;
+a297:
+    if (!d1) throwUndefinedVariable("acc");
+    v1 = Value(int32_t(uint32_t(v1.toInt()) + uint32_t(-7)));
+    goto a324;
+a311:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    { int32_t value = s0.toInt(); int32_t quotient = (value + int32_t(uint32_t(value >> 31) & 1u)) >> 1; s0 = Value(quotient); }
+    v1 = s0; d1 = true;
+a324:
+    if (!d3) throwUndefinedVariable("id");
+    s0 = v3;
+    switch (s0.toInt()) { case 1000: goto a361; case 1111: goto a375; case 1259: goto a397; default: goto a414; }
+a361:
+    if (!d1) throwUndefinedVariable("acc");
+    v1 = Value(int32_t(uint32_t(v1.toInt()) + uint32_t(11)));
+    goto a414;
+a375:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    s1 = Value(int32_t(255));
+    s0 = Value(s0.toInt() ^ s1.toInt());
+    v1 = s0; d1 = true;
+    goto a414;
+a397:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    s1 = Value(int32_t(4096));
+    s0 = Value(s0.toInt() | s1.toInt());
+    v1 = s0; d1 = true;
+a414:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    s1 = Value(int32_t(100000));
+    s0 = Value(s0.toInt() > s1.toInt());
+    if (!d1) throwUndefinedVariable("acc");
+    s1 = v1;
+    { int32_t value = s1.toInt(); int32_t quotient = (value + int32_t(uint32_t(value >> 31) & 1u)) >> 1; s1 = Value(int32_t(uint32_t(value) - (uint32_t(quotient) << 1))); }
+    s2 = Value(int32_t(0));
+    s1 = Value(s1.toInt() == s2.toInt());
+    s1 = Value(!s1.toBool());
+    s0 = Value(s0.toBool() && s1.toBool());
+    if (!s0.toBool()) goto a467;
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    s1 = Value(int32_t(100000));
+    s0 = Value(s0.toInt() % s1.toInt());
+    v1 = s0; d1 = true;
+    goto a513;
+a467:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    s1 = Value(int32_t(-100000));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!d1) throwUndefinedVariable("acc");
+    s1 = v1;
+    s2 = Value(int32_t(0));
+    s1 = Value(s1.toInt() == s2.toInt());
+    s0 = Value(s0.toBool() || s1.toBool());
+    if (!s0.toBool()) goto a513;
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    s0 = Value(int32_t(0u - uint32_t(s0.toInt())));
+    s1 = Value(int32_t(99991));
+    s0 = Value(s0.toInt() % s1.toInt());
+    v1 = s0; d1 = true;
+a513:
+    if (!d0) throwUndefinedVariable("i");
+    v0 = Value(int32_t(uint32_t(v0.toInt()) + uint32_t(1)));
+    goto a31;
+a525:
+    if (!d1) throwUndefinedVariable("acc");
+    s0 = v1;
+    vm.printValue(s0);
+    if (!d2) throwUndefinedVariable("cal");
+    s0 = v2;
+    vm.printValue(s0);
+    return;
+}
+
+static NativeProgramRegistrar registrar("branches", 0x4beedebau, run_branches);
@@ -0,0 +1,58 @@
+// Generated by enix2cpp from errors.enix; do not edit.
+// Linked into the firmware, it replaces the interpreter for `run errors.enix`
+// as long as the bytecode still matches.
+#include <Runtime/NativePrograms.h>
+#include <Runtime/Natives.h>
+#include <stdexcept>
+
+static void run_errors(VirtualMachine& vm) {
+    (void)vm;
+    Value s0, s1, s2;
+    Value v0; bool d0 = false;  // "a"
+    Value v1; bool d1 = false;  // "i"
+    Value v2; bool d2 = false;  // "$t0"
+    s0 = Value(int32_t(4));
+    s0 = vm.newArray(s0.toInt());
+    v0 = s0; d0 = true;
+    s0 = Value(int32_t(0));
+    v1 = s0; d1 = true;
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    s1 = Value(int32_t(1000));
+    s0 = Value(int32_t(uint32_t(s0.toInt()) * uint32_t(s1.toInt())));
+    v2 = s0; d2 = true;
+a34:
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    s1 = Value(int32_t(10));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a96;
+    if (!d2) throwUndefinedVariable("$t0");
+    s0 = v2;
+    s1 = Value(int32_t(3));
+    if (!d1) throwUndefinedVariable("i");
+    s2 = v1;
+    s1 = Value(int32_t(uint32_t(s1.toInt()) - uint32_t(s2.toInt())));
+    if (s1.toInt() == 0) throw std::runtime_error("Division by zero");
+    s0 = Value(s0.toInt() / s1.toInt());
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    if (!d1) throwUndefinedVariable("i");
+    s1 = v1;
+    if (!d1) throwUndefinedVariable("i");
+    s2 = v1;
+    checkedElement(vm, s0, s1.toInt()) = s2.toInt(); s0 = s2;
+    if (!d1) throwUndefinedVariable("i");
+    v1 = Value(int32_t(uint32_t(v1.toInt()) + uint32_t(1)));
+    if (!d2) throwUndefinedVariable("$t0");
+    v2 = Value(int32_t(uint32_t(v2.toInt()) + uint32_t(1000)));
+    goto a34;
+a96:
+    if (!d0) throwUndefinedVariable("a");
+    s0 = v0;
+    vm.printValue(s0);
+    return;
+}
+
+static NativeProgramRegistrar registrar("errors", 0xe3615047u, run_errors);
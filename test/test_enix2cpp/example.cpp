@@ -0,0 +1,58 @@
+// Generated by enix2cpp from example.enix; do not edit.
+// Linked into the firmware, it replaces the interpreter for `run example.enix`
+// as long as the bytecode still matches.
+#include <Runtime/NativePrograms.h>
+#include <Runtime/Natives.h>
+#include <stdexcept>
+
+static void run_example(VirtualMachine& vm) {
+    (void)vm;
+    Value s0, s1;
+    Value v0; bool d0 = false;  // "x"
+    Value v1; bool d1 = false;  // "y"
+    Value v2; bool d2 = false;  // "sum"
+    Value v3; bool d3 = false;  // "counter"
+    s0 = Value(int32_t(10));
+    v0 = s0; d0 = true;
+    s0 = Value(int32_t(20));
+    v1 = s0; d1 = true;
+    if (!d0) throwUndefinedVariable("x");
+    s0 = v0;
+    if (!d1) throwUndefinedVariable("y");
+    s1 = v1;
+    s0 = Value(int32_t(uint32_t(s0.toInt()) + uint32_t(s1.toInt())));
+    v2 = s0; d2 = true;
+    if (!d2) throwUndefinedVariable("sum");
+    s0 = v2;
+    vm.printValue(s0);
+    if (!d2) throwUndefinedVariable("sum");
+    s0 = v2;
+    s1 = Value(int32_t(25));
+    s0 = Value(s0.toInt() > s1.toInt());
+    if (!s0.toBool()) goto a64;
+    s0 = Value(int32_t(1));
+    vm.printValue(s0);
+    goto a70;
+a64:
+    s0 = Value(int32_t(0));
+    vm.printValue(s0);
+a70:
+    s0 = Value(int32_t(0));
+    v3 = s0; d3 = true;
+a85:
+    if (!d3) throwUndefinedVariable("counter");
+    s0 = v3;
+    s1 = Value(int32_t(5));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a133;
+    if (!d3) throwUndefinedVariable("counter");
+    s0 = v3;
+    vm.printValue(s0);
+    if (!d3) throwUndefinedVariable("counter");
+    v3 = Value(int32_t(uint32_t(v3.toInt()) + uint32_t(1)));
+    goto a85;
+a133:
+    return;
+}
+
+static NativeProgramRegistrar registrar("example", 0x884e8f04u, run_example);
@@ -0,0 +1,154 @@
+// Generated by enix2cpp from maps.enix; do not edit.
+// Linked into the firmware, it replaces the interpreter for `run maps.enix`
+// as long as the bytecode still matches.
+#include <Runtime/NativePrograms.h>
+#include <Runtime/Natives.h>
+#include <stdexcept>
+
+static void run_maps(VirtualMachine& vm) {
+    (void)vm;
+    Value s0, s1, s2, s3;
+    Value v0; bool d0 = false;  // "m"
+    Value v1; bool d1 = false;  // "i"
+    Value v2; bool d2 = false;  // "$t0"
+    Value v3; bool d3 = false;  // "removed"
+    Value v4; bool d4 = false;  // "$t1"
+    Value v5; bool d5 = false;  // "keys"
+    Value v6; bool d6 = false;  // "n"
+    Value v7; bool d7 = false;  // "total"
+    s0 = nativeTable[11].function(vm, nullptr, 0);  // map_new
+    v0 = s0; d0 = true;
+    s0 = Value(int32_t(0));
+    v1 = s0; d1 = true;
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    s1 = Value(int32_t(7));
+    s0 = Value(int32_t(uint32_t(s0.toInt()) * uint32_t(s1.toInt())));
+    v2 = s0; d2 = true;
+a31:
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    s1 = Value(int32_t(300));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a81;
+    if (!d0) throwUndefinedVariable("m");
+    s0 = v0;
+    if (!d2) throwUndefinedVariable("$t0");
+    s1 = v2;
+    if (!d1) throwUndefinedVariable("i");
+    s2 = v1;
+    { Value args[] = {s0, s1, s2}; s0 = nativeTable[12].function(vm, args, 3); }  // map_set
+    if (!d1) throwUndefinedVariable("i");
+    v1 = Value(int32_t(uint32_t(v1.toInt()) + uint32_t(1)));
+    if (!d2) throwUndefinedVariable("$t0");
+    v2 = Value(int32_t(uint32_t(v2.toInt()) + uint32_t(7)));
+    goto a31;
+a81:
+    if (!d0) throwUndefinedVariable("m");
+    s0 = v0;
+    { Value args[] = {s0}; s0 = nativeTable[16].function(vm, args, 1); }  // map_size
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("m");
+    s0 = v0;
+    s1 = Value(int32_t(700));
+    { Value args[] = {s0, s1}; s0 = nativeTable[13].function(vm, args, 2); }  // map_get
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("m");
+    s0 = v0;
+    s1 = Value(int32_t(701));
+    { Value args[] = {s0, s1}; s0 = nativeTable[14].function(vm, args, 2); }  // map_has
+    vm.printValue(s0);
+    s0 = Value(int32_t(0));
+    v3 = s0; d3 = true;
+    s0 = Value(int32_t(0));
+    v1 = s0; d1 = true;
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    s1 = Value(int32_t(7));
+    s0 = Value(int32_t(uint32_t(s0.toInt()) * uint32_t(s1.toInt())));
+    v4 = s0; d4 = true;
+a151:
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    s1 = Value(int32_t(300));
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a237;
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    s1 = Value(int32_t(3));
+    s0 = Value(s0.toInt() % s1.toInt());
+    s1 = Value(int32_t(0));
+    s0 = Value(s0.toInt() == s1.toInt());
+    if (!s0.toBool()) goto a216;
+    if (!d3) throwUndefinedVariable("removed");
+    s0 = v3;
+    if (!d0) throwUndefinedVariable("m");
+    s1 = v0;
+    if (!d4) throwUndefinedVariable("$t1");
+    s2 = v4;
+    { Value args[] = {s1, s2}; s1 = nativeTable[15].function(vm, args, 2); }  // map_del
+    s0 = Value(int32_t(uint32_t(s0.toInt()) + uint32_t(s1.toInt())));
+    v3 = s0; d3 = true;
+a216:
+    if (!d1) throwUndefinedVariable("i");
+    v1 = Value(int32_t(uint32_t(v1.toInt()) + uint32_t(1)));
+    if (!d4) throwUndefinedVariable("$t1");
+    v4 = Value(int32_t(uint32_t(v4.toInt()) + uint32_t(7)));
+    goto a151;
+a237:
+    if (!d3) throwUndefinedVariable("removed");
+    s0 = v3;
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("m");
+    s0 = v0;
+    { Value args[] = {s0}; s0 = nativeTable[16].function(vm, args, 1); }  // map_size
+    vm.printValue(s0);
+    s0 = Value(int32_t(300));
+    s0 = vm.newArray(s0.toInt());
+    v5 = s0; d5 = true;
+    if (!d0) throwUndefinedVariable("m");
+    s0 = v0;
+    if (!d5) throwUndefinedVariable("keys");
+    s1 = v5;
+    { Value args[] = {s0, s1}; s0 = nativeTable[17].function(vm, args, 2); }  // map_keys
+    v6 = s0; d6 = true;
+    s0 = Value(int32_t(0));
+    v7 = s0; d7 = true;
+    s0 = Value(int32_t(0));
+    v1 = s0; d1 = true;
+a305:
+    if (!d1) throwUndefinedVariable("i");
+    s0 = v1;
+    if (!d6) throwUndefinedVariable("n");
+    s1 = v6;
+    s0 = Value(s0.toInt() < s1.toInt());
+    if (!s0.toBool()) goto a361;
+    if (!d7) throwUndefinedVariable("total");
+    s0 = v7;
+    if (!d0) throwUndefinedVariable("m");
+    s1 = v0;
+    if (!d5) throwUndefinedVariable("keys");
+    s2 = v5;
+    if (!d1) throwUndefinedVariable("i");
+    s3 = v1;
+    s2 = Value(checkedElement(vm, s2, s3.toInt()));
+    { Value args[] = {s1, s2}; s1 = nativeTable[13].function(vm, args, 2); }  // map_get
+    s0 = Value(int32_t(uint32_t(s0.toInt()) + uint32_t(s1.toInt())));
+    v7 = s0; d7 = true;
+    if (!d1) throwUndefinedVariable("i");
+    v1 = Value(int32_t(uint32_t(v1.toInt()) + uint32_t(1)));
+    goto a305;
+a361:
+    if (!d6) throwUndefinedVariable("n");
+    s0 = v6;
+    vm.printValue(s0);
+    if (!d7) throwUndefinedVariable("total");
+    s0 = v7;
+    vm.printValue(s0);
+    if (!d0) throwUndefinedVariable("m");
+    s0 = v0;
+    vm.printValue(s0);
+    return;
+}
+
+static NativeProgramRegistrar registrar("maps", 0x714e2fbdu, run_maps);
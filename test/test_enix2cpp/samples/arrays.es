@@ -0,0 +1,37 @@
+// Arrays and the natives that work on them
+var a[16];
+var b[16];
+var i = 0;
+while (i < len(a)) {
+    a[i] = i * i - 20;
+    b[i] = (i << 2) - (i >> 1);
+    i = i + 1;
+}
+print(sum(a));
+print(min(a));
+print(max(b));
+print(dot(a, b));
+print(find(a, 29));
+print(find(a, 30));
+copy(b, a);
+print(sum(b));
+fill(a, -3);
+print(sum(a));
+print(a);
+
+// A small sieve
+var composite[200];
+var primes = 0;
+var n = 2;
+while (n < 200) {
+    if (composite[n] == 0) {
+        primes = primes + 1;
+        var m = n * n;
+        while (m < 200) {
+            composite[m] = 1;
+            m = m + n;
+        }
+    }
+    n = n + 1;
+}
+print(primes);
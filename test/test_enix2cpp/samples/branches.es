@@ -0,0 +1,33 @@
+// If/else chains and switch statements, dense and sparse
+var i = 0;
+var acc = 0;
+var cal = 0;
+while (i < 200) {
+    var id = 1000 + 37 * (i % 8);
+    if (id == 1000) { cal = 3001; }
+    else if (id == 1037) { cal = 3112; }
+    else if (id == 1074) { cal = 3223; }
+    else if (id == 1111) { cal = 3334; }
+    else { cal = 0 - id; }
+    acc = acc + cal;
+
+    switch (i % 5) {
+        case 0: acc = acc + 1;
+        case 1: acc = acc * 3;
+        case 3: acc = acc - 7;
+        default: acc = acc / 2;
+    }
+    switch (id) {
+        case 1000: acc = acc + 11;
+        case 1111: acc = acc ^ 255;
+        case 1259: acc = acc | 4096;
+    }
+    if (acc > 100000 and not (acc % 2 == 0)) {
+        acc = acc % 100000;
+    } else if (acc < -100000 or acc == 0) {
+        acc = -acc % 99991;
+    }
+    i = i + 1;
+}
+print(acc);
+print(cal);
@@ -0,0 +1,10 @@
+// Runtime errors must read the same either way; this one stops the
+// program half way through its output
+var a[4];
+var i = 0;
+while (i < 10) {
+    print(i * 1000 / (3 - i));
+    a[i] = i;
+    i = i + 1;
+}
+print(a);
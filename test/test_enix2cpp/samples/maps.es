@@ -0,0 +1,31 @@
+// Integer maps
+var m = map_new();
+var i = 0;
+while (i < 300) {
+    map_set(m, i * 7, i);
+    i = i + 1;
+}
+print(map_size(m));
+print(map_get(m, 700));
+print(map_has(m, 701));
+
+var removed = 0;
+i = 0;
+while (i < 300) {
+    if (i % 3 == 0) { removed = removed + map_del(m, i * 7); }
+    i = i + 1;
+}
+print(removed);
+print(map_size(m));
+
+var keys[300];
+var n = map_keys(m, keys);
+var total = 0;
+i = 0;
+while (i < n) {
+    total = total + map_get(m, keys[i]);
+    i = i + 1;
+}
+print(n);
+print(total);
+print(m);
@@ -0,0 +1,201 @@
+// Runs every sample program twice, through its enix2cpp translation linked
+// into this test and through the interpreter, and checks that both print
+// the same and stop with the same error.
+//
+// The translations next to this file are checked against what enix2cpp
+// makes of the samples now. After changing the compiler or the translator,
+// run the test with ENIX2CPP_UPDATE=1 set to write them again, then run it
+// once more so the new code is built in.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/NativePrograms.h>
+#include <Runtime/Profile.h>
+#include <Runtime/Translator.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Sample
+{
+    const char *name;   // Program name, which its translation registers under
+    const char *path;   // Relative to the project directory
+};
+
+static const Sample SAMPLES[] = {
+    {"example", "example.es"},
+    {"branches", "test/test_enix2cpp/samples/branches.es"},
+    {"arrays", "test/test_enix2cpp/samples/arrays.es"},
+    {"maps", "test/test_enix2cpp/samples/maps.es"},
+    {"errors", "test/test_enix2cpp/samples/errors.es"},
+};
+
+static const Sample *current;
+
+// This directory, and from it the project's, whether the compiler was given
+// absolute paths or ones relative to the project
+static std::string TestDirectory()
+{
+    std::string file = __FILE__;
+    size_t slash = file.find_last_of("/\\");
+    return slash == std::string::npos ? "" : file.substr(0, slash + 1);
+}
+
+static std::string ProjectDirectory()
+{
+    return TestDirectory() + "../../";
+}
+
+static bool ReadFile(const std::string &path, std::string &contents)
+{
+    std::ifstream in(path.c_str(), std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+static std::vector<uint8_t> CompileSource(const std::string &source)
+{
+    Arena arena;
+    Arena::Scope arenaScope(arena);
+    Lexer lexer(source.c_str());
+    Compiler compiler(lexer.tokenize());
+    const auto &bytecode = compiler.compile();
+    return std::vector<uint8_t>(bytecode.begin(), bytecode.end());
+}
+
+// Everything the program printed, followed by the error that stopped it
+static std::string RunProgram(const std::vector<uint8_t> &code, const NativeProgramRegistrar *native)
+{
+    std::ostringstream output;
+    std::streambuf *console = std::cout.rdbuf(output.rdbuf());
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        VirtualMachine vm;
+        vm.load(code);
+        if (native != nullptr)
+        {
+            native->run(vm);
+        }
+        else
+        {
+            while (!vm.execute())
+            {
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        output << "runtime error: " << e.what() << "\n";
+    }
+    std::cout.rdbuf(console);
+    return output.str();
+}
+
+// Unity leaves a failing test with longjmp, which would skip the
+// destructors of any string still alive, so the checks are made here and
+// only their verdict is asserted
+static std::string verdict;
+static bool rewritten;
+
+static bool CheckSample(const Sample &sample)
+{
+    std::string source;
+    std::string sourcePath = ProjectDirectory() + sample.path;
+    if (!ReadFile(sourcePath, source))
+    {
+        verdict = "cannot read " + sourcePath;
+        return false;
+    }
+    std::vector<uint8_t> code = CompileSource(source);
+
+    std::string translation = translateProgram(code, sample.name);
+    std::string translationPath = TestDirectory() + sample.name + ".cpp";
+    std::string linked;
+    if (!ReadFile(translationPath, linked) || linked != translation)
+    {
+        if (getenv("ENIX2CPP_UPDATE") != nullptr)
+        {
+            std::ofstream(translationPath.c_str(), std::ios::binary) << translation;
+            rewritten = true;
+            verdict = translationPath + " written again; run the test once more";
+            return false;
+        }
+        verdict = translationPath + " is out of date; run the test with ENIX2CPP_UPDATE=1";
+        return false;
+    }
+
+    const NativeProgramRegistrar *native = findNativeProgram(sample.name);
+    if (native == nullptr)
+    {
+        verdict = "no native program registered as " + std::string(sample.name);
+        return false;
+    }
+    if (native->checksum != codeChecksum(code))
+    {
+        verdict = "the linked translation was made from other bytecode";
+        return false;
+    }
+
+    std::string interpreted = RunProgram(code, nullptr);
+    std::string translated = RunProgram(code, native);
+    if (interpreted.empty())
+    {
+        verdict = "the sample printed nothing";
+        return false;
+    }
+    if (interpreted != translated)
+    {
+        verdict = "interpreted:\n" + interpreted + "native:\n" + translated;
+        return false;
+    }
+    return true;
+}
+
+void setUp()
+{
+    verdict.clear();
+    rewritten = false;
+}
+
+void tearDown()
+{
+}
+
+static void test_native_matches_interpreter()
+{
+    if (CheckSample(*current))
+    {
+        return;
+    }
+    if (rewritten)
+    {
+        TEST_IGNORE_MESSAGE(verdict.c_str());
+    }
+    TEST_FAIL_MESSAGE(verdict.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    for (const Sample &sample : SAMPLES)
+    {
+        current = &sample;
+        UnityDefaultTestRun(test_native_matches_interpreter, sample.name, __LINE__);
+    }
+    return UNITY_END();
+}
@@ -0,0 +1,290 @@
+// FileDescriptor against the in-memory SD card: random reads, writes,
+// truncations and reopenings checked against a plain string holding what
+// the file should contain, card failures in the middle of a write-back, and
+// reads the card cuts short.
+#include <unity.h>
+
+#include <SD.h>
+#include <FileSystem/File.h>
+#include <IO/FileDescriptor.h>
+#include <IO/PageCache.h>
+
+#include <cstdio>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+static const char *const PATH = "/fz.bin";
+
+static std::string Card(const char *path)
+{
+    std::string data;
+    SD.contents(path, data);
+    return data;
+}
+
+static std::string Letters(size_t count, char first, size_t spread, std::mt19937 &random)
+{
+    return std::string(count, static_cast<char>(first + random() % spread));
+}
+
+void setUp()
+{
+    SD.reset();
+}
+
+void tearDown()
+{
+}
+
+// One run of random operations; the card must match the model after every
+// fsync and close, and reads must match it all along
+static void RunRanges(uint32_t seed)
+{
+    std::mt19937 random(seed);
+    espnix::File file;
+    file.name = "fz.bin";
+    const int flags = O_RDWR | O_CREAT;
+    FileDescriptor *fd = file.Open(flags);
+    std::string model;
+    char where[96];
+
+    for (int step = 0; step < 4000; step++)
+    {
+        snprintf(where, sizeof(where), "seed %u, step %d", seed, step);
+        int op = random() % 100;
+        if (op < 40)
+        {
+            // A write at the position or at an offset, often past the end
+            size_t offset = random() % (model.size() + 3000);
+            std::string data = Letters(1 + random() % 700, 'a', 26, random);
+            if (random() % 2)
+            {
+                TEST_ASSERT_EQUAL_MESSAGE(offset, fd->lseek(offset, SEEK_SET), where);
+                fd->write(data.data(), data.size());
+                TEST_ASSERT_EQUAL_MESSAGE(offset + data.size(), fd->lseek(0, SEEK_CUR), where);
+            }
+            else
+            {
+                fd->lseek(0, SEEK_SET);
+                fd->pwrite(data.data(), data.size(), offset);
+                TEST_ASSERT_EQUAL_MESSAGE(0, fd->lseek(0, SEEK_CUR), where);
+            }
+            if (model.size() < offset + data.size())
+                model.resize(offset + data.size(), '\0');
+            model.replace(offset, data.size(), data);
+        }
+        else if (op < 60)
+        {
+            size_t offset = random() % (model.size() + 10);
+            size_t count = random() % 3000;
+            std::string got(count, '?');
+            ssize_t read = fd->pread(&got[0], count, offset);
+            TEST_ASSERT_TRUE_MESSAGE(read >= 0, where);
+            got.resize(read);
+            TEST_ASSERT_TRUE_MESSAGE(got == (offset < model.size() ? model.substr(offset, count) : ""), where);
+        }
+        else if (op < 63)
+        {
+            fd->clearBuffer();
+            model = Letters(random() % 2000, 'A', 26, random);
+            fd->write(model.data(), model.size());
+        }
+        else if (op < 75)
+        {
+            TEST_ASSERT_EQUAL_MESSAGE(0, fd->fsync(), where);
+            TEST_ASSERT_TRUE_MESSAGE(Card(PATH) == model, where);
+        }
+        else if (op < 78)
+        {
+            file.Close();
+            TEST_ASSERT_TRUE_MESSAGE(Card(PATH) == model, where);
+            fd = file.Open(flags);
+        }
+        else if (op < 79)
+        {
+            size_t length = random() % (model.size() + 2000);
+            TEST_ASSERT_EQUAL_MESSAGE(0, fd->ftruncate(length), where);
+            model.resize(length, '\0');
+            TEST_ASSERT_EQUAL_MESSAGE(length, fd->lseek(0, SEEK_END), where);
+            TEST_ASSERT_EQUAL_MESSAGE(-1, fd->lseek(-1, SEEK_SET), where);
+        }
+        else if (op < 80)
+        {
+            // Appends go to the end whatever the position
+            file.Close();
+            fd = file.Open(O_APPEND);
+            std::string data = Letters(1 + random() % 300, '0', 10, random);
+            fd->write(data.data(), data.size());
+            model += data;
+            file.Close();
+            fd = file.Open(flags);
+        }
+        TEST_ASSERT_EQUAL_MESSAGE(model.size(), fd->size(), where);
+    }
+
+    file.Close();
+    TEST_ASSERT_TRUE(Card(PATH) == model);
+    // The copies made to shrink the file are all gone
+    TEST_ASSERT_EQUAL(1, SD.list("/").size());
+}
+
+static void test_random_ranges_match_a_model()
+{
+    for (uint32_t seed = 1; seed <= 25; seed++)
+    {
+        SD.reset();
+        RunRanges(seed);
+    }
+}
+
+// A file that has shrunk, with its write-back still to come
+static FileDescriptor *Shrunk(espnix::File &file, std::string &before, std::string &after)
+{
+    file.name = "fz.bin";
+    FileDescriptor *fd = file.Open(O_RDWR | O_CREAT);
+    before.clear();
+    for (int i = 0; before.size() < 3 * 4096; i++)
+        before += "line " + std::to_string(i) + "\n";
+    fd->write(before.data(), before.size());
+    fd->fsync();
+
+    after = before.substr(0, 100) + "changed";
+    fd->ftruncate(100);
+    fd->pwrite("changed", 7, 100);
+    return fd;
+}
+
+static void test_failed_rename_keeps_the_file()
+{
+    espnix::File file;
+    std::string before, after;
+    FileDescriptor *fd = Shrunk(file, before, after);
+
+    SD.renameFails = true;
+    TEST_ASSERT_EQUAL(-1, fd->fsync());
+    TEST_ASSERT_TRUE(Card(PATH) == before);
+    TEST_ASSERT_EQUAL(1, SD.list("/").size());
+
+    // Still open, with the changes waiting for the next try
+    TEST_ASSERT_TRUE(fd->isOpen);
+    std::string got(after.size(), '?');
+    TEST_ASSERT_EQUAL(after.size(), fd->pread(&got[0], got.size(), 0));
+    TEST_ASSERT_TRUE(got == after);
+
+    SD.renameFails = false;
+    TEST_ASSERT_EQUAL(0, fd->fsync());
+    TEST_ASSERT_TRUE(Card(PATH) == after);
+    TEST_ASSERT_EQUAL(1, SD.list("/").size());
+    file.Close();
+}
+
+static void test_failed_copy_keeps_the_file()
+{
+    espnix::File file;
+    std::string before, after;
+    FileDescriptor *fd = Shrunk(file, before, after);
+
+    SD.writable = 50;
+    TEST_ASSERT_EQUAL(-1, fd->fsync());
+    TEST_ASSERT_TRUE(Card(PATH) == before);
+    TEST_ASSERT_EQUAL(1, SD.list("/").size());
+
+    SD.writable = SIZE_MAX;
+    TEST_ASSERT_EQUAL(0, fd->fsync());
+    TEST_ASSERT_TRUE(Card(PATH) == after);
+    file.Close();
+}
+
+static void test_short_card_read_is_an_error()
+{
+    espnix::File file;
+    file.name = "fz.bin";
+    FileDescriptor *fd = file.Open(O_RDWR | O_CREAT);
+    std::string data;
+    for (int i = 0; data.size() < 5000; i++)
+        data += std::to_string(i) + ",";
+    fd->write(data.data(), data.size());
+    file.Close();
+    fd = file.Open(O_RDONLY);
+
+    // Nothing of what the card failed to return reads as zeros
+    SD.readable = 1500;
+    std::string got(data.size(), '?');
+    TEST_ASSERT_EQUAL(-1, fd->pread(&got[0], got.size(), 0));
+    TEST_ASSERT_EQUAL(-1, fd->read(&got[0], got.size()));
+    TEST_ASSERT_EQUAL(0, fd->lseek(0, SEEK_CUR));
+
+    // Nor does a page it cut short pass for the end of the file later
+    SD.readable = SIZE_MAX;
+    TEST_ASSERT_EQUAL(data.size(), fd->read(&got[0], got.size()));
+    TEST_ASSERT_TRUE(got == data);
+    file.Close();
+}
+
+static void test_failed_write_back_keeps_the_write()
+{
+    espnix::File file;
+    file.name = "fz.bin";
+    FileDescriptor *fd = file.Open(O_RDWR | O_CREAT);
+    std::string data(FileDescriptor::WRITE_BACK_BYTES + 100, 'w');
+
+    // Enough to be written back at once, which fails; the write is
+    // taken all the same, and only fsync reports the failure
+    SD.writable = 0;
+    TEST_ASSERT_EQUAL(data.size(), fd->write(data.data(), data.size()));
+    TEST_ASSERT_EQUAL(data.size(), fd->size());
+    TEST_ASSERT_EQUAL(-1, fd->fsync());
+
+    SD.writable = SIZE_MAX;
+    TEST_ASSERT_EQUAL(0, fd->fsync());
+    TEST_ASSERT_TRUE(Card(PATH) == data);
+
+    // Nor does closing hide what could not be written
+    SD.writable = 0;
+    TEST_ASSERT_EQUAL(5, fd->write("again", 5));
+    TEST_ASSERT_EQUAL(-1, fd->close());
+    file.Close();
+}
+
+static void test_page_cache_budget_holds_a_page()
+{
+    PageCache &cache = PageCache::instance();
+    bool rejected = false;
+    try
+    {
+        cache.setBudget(PageCache::PAGE_SIZE - 1);
+    }
+    catch (const std::invalid_argument &)
+    {
+        rejected = true;
+    }
+    TEST_ASSERT_TRUE(rejected);
+    TEST_ASSERT_EQUAL(PageCache::DEFAULT_BUDGET, cache.budget());
+
+    // A single page still serves every read
+    cache.setBudget(PageCache::PAGE_SIZE);
+    espnix::File file;
+    file.name = "fz.bin";
+    FileDescriptor *fd = file.Open(O_RDWR | O_CREAT);
+    std::string data(3 * PageCache::PAGE_SIZE + 10, 'x');
+    fd->write(data.data(), data.size());
+    fd->fsync();
+    std::string got(data.size(), '?');
+    TEST_ASSERT_EQUAL(data.size(), fd->pread(&got[0], got.size(), 0));
+    TEST_ASSERT_TRUE(got == data);
+    file.Close();
+    cache.setBudget(PageCache::DEFAULT_BUDGET);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_random_ranges_match_a_model);
+    RUN_TEST(test_failed_rename_keeps_the_file);
+    RUN_TEST(test_failed_copy_keeps_the_file);
+    RUN_TEST(test_short_card_read_is_an_error);
+    RUN_TEST(test_failed_write_back_keeps_the_write);
+    RUN_TEST(test_page_cache_budget_holds_a_page);
+    return UNITY_END();
+}
@@ -0,0 +1,361 @@
+// Fragmentation soak: 5000 compile and run cycles over 8 programs, on a
+// simulated 256 KB first-fit heap like the ESP32's. Between cycles,
+// long-lived blocks come and go as file contents and shell history would,
+// and each cycle keeps its bytecode as a compiled file. The largest free
+// block must stay large when the work is done in an arena and the file
+// written once it is released, as CompileCommand does it. The same soak
+// without an arena, and with the file written while the arena is still
+// there, is run alongside for comparison. Run with -v to see the figures.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Every operator new of this program is served from HEAP_BYTES, first fit,
+// with freed blocks merged with their free neighbours
+namespace
+{
+    const size_t HEAP_BYTES = 256 * 1024;
+
+    struct Block
+    {
+        uint32_t size;      // Including this header
+        uint32_t previous;  // Size of the block before, 0 for the first
+        uint32_t free;
+        uint32_t spare;
+    };
+
+    alignas(16) uint8_t heap[HEAP_BYTES];
+    bool ready;
+
+    Block *At(size_t offset)
+    {
+        return reinterpret_cast<Block *>(heap + offset);
+    }
+
+    size_t OffsetOf(const Block *block)
+    {
+        return reinterpret_cast<const uint8_t *>(block) - heap;
+    }
+
+    void *Allocate(size_t size)
+    {
+        if (!ready)
+        {
+            *At(0) = Block{HEAP_BYTES, 0, 1, 0};
+            ready = true;
+        }
+
+        size_t need = sizeof(Block) + ((size + 15) & ~static_cast<size_t>(15));
+        for (size_t offset = 0; offset < HEAP_BYTES; offset += At(offset)->size)
+        {
+            Block *block = At(offset);
+            if (!block->free || block->size < need)
+            {
+                continue;
+            }
+            if (block->size - need >= 2 * sizeof(Block))
+            {
+                Block *rest = At(offset + need);
+                *rest = Block{static_cast<uint32_t>(block->size - need), static_cast<uint32_t>(need), 1, 0};
+                if (offset + block->size < HEAP_BYTES)
+                {
+                    At(offset + block->size)->previous = rest->size;
+                }
+                block->size = static_cast<uint32_t>(need);
+            }
+            block->free = 0;
+            return block + 1;
+        }
+        throw std::bad_alloc();
+    }
+
+    void Release(void *pointer)
+    {
+        if (pointer == nullptr)
+        {
+            return;
+        }
+        Block *block = static_cast<Block *>(pointer) - 1;
+        block->free = 1;
+
+        size_t next = OffsetOf(block) + block->size;
+        if (next < HEAP_BYTES && At(next)->free)
+        {
+            block->size += At(next)->size;
+        }
+        if (block->previous != 0 && At(OffsetOf(block) - block->previous)->free)
+        {
+            Block *before = At(OffsetOf(block) - block->previous);
+            before->size += block->size;
+            block = before;
+        }
+        next = OffsetOf(block) + block->size;
+        if (next < HEAP_BYTES)
+        {
+            At(next)->previous = block->size;
+        }
+    }
+
+    struct HeapState
+    {
+        size_t largestFree;
+        size_t fragments;   // Free blocks
+    };
+
+    HeapState State()
+    {
+        HeapState state = {0, 0};
+        for (size_t offset = 0; offset < HEAP_BYTES; offset += At(offset)->size)
+        {
+            if (At(offset)->free)
+            {
+                state.fragments++;
+                state.largestFree = At(offset)->size > state.largestFree ? At(offset)->size : state.largestFree;
+            }
+        }
+        return state;
+    }
+}
+
+void *operator new(size_t size)
+{
+    return Allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return Allocate(size);
+    }
+    catch (const std::bad_alloc &)
+    {
+        return nullptr;
+    }
+}
+
+void operator delete(void *pointer) noexcept
+{
+    Release(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    Release(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    Release(pointer);
+}
+
+static const int CYCLES = 5000;
+static const int WARM_UP = 500;
+
+static const char *const SAMPLE_PATHS[] = {
+    "example.es",
+    "test/test_enix2cpp/samples/branches.es",
+    "test/test_enix2cpp/samples/arrays.es",
+    "test/test_enix2cpp/samples/maps.es",
+    "test/test_enix2cpp/samples/errors.es",
+};
+
+static const char *const INLINE_PROGRAMS[] = {
+    "var s = \"\";\n"
+    "var i = 0;\n"
+    "while (i < 40) {\n"
+    "  s = substr(s + i, 0, 60);\n"
+    "  i = i + 1;\n"
+    "}\n"
+    "print(s);\n",
+
+    "var a[64];\n"
+    "var i = 0;\n"
+    "while (i < 64) {\n"
+    "  switch (i % 4) {\n"
+    "    case 0: a[i] = i * 3;\n"
+    "    case 1: a[i] = i / 2;\n"
+    "    default: a[i] = -i;\n"
+    "  }\n"
+    "  i = i + 1;\n"
+    "}\n"
+    "print(sum(a) + max(a) - min(a));\n",
+
+    "var m = map_new();\n"
+    "var i = 0;\n"
+    "while (i < 300) {\n"
+    "  map_set(m, i * 7919 % 1000, i);\n"
+    "  if (i % 3 == 0) {\n"
+    "    map_del(m, i * 13 % 1000);\n"
+    "  }\n"
+    "  i = i + 1;\n"
+    "}\n"
+    "print(map_size(m));\n",
+};
+
+static std::string ProjectDirectory()
+{
+    std::string file = __FILE__;
+    size_t slash = file.find_last_of("/\\");
+    return (slash == std::string::npos ? "" : file.substr(0, slash + 1)) + "../../";
+}
+
+static std::vector<std::string> Programs()
+{
+    std::vector<std::string> programs;
+    for (const char *path : SAMPLE_PATHS)
+    {
+        std::ifstream in((ProjectDirectory() + path).c_str(), std::ios::binary);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        programs.push_back(buffer.str());
+    }
+    for (const char *source : INLINE_PROGRAMS)
+    {
+        programs.push_back(source);
+    }
+    return programs;
+}
+
+enum Mode
+{
+    NO_ARENA,
+    KEPT_IN_ARENA,      // The file is written while the arena is there
+    KEPT_AFTER_ARENA,
+};
+
+// What a compile and run leaves behind is only the bytecode, kept like a
+// file's contents; everything else goes
+static void CompileAndRun(const std::string &source, Mode mode, std::string &image)
+{
+    std::string compiled;
+    bool arena = mode != NO_ARENA;
+    Arena *scopeArena = arena ? new Arena() : nullptr;
+    Arena::Scope *scope = arena ? new Arena::Scope(*scopeArena) : nullptr;
+    try
+    {
+        Lexer lexer(source.c_str());
+        Compiler compiler(lexer.tokenize());
+        const auto &bytecode = compiler.compile();
+        std::vector<uint8_t> code(bytecode.begin(), bytecode.end());
+        compiled.assign(code.begin(), code.end());
+        if (mode != KEPT_AFTER_ARENA)
+        {
+            image = compiled;
+        }
+        VirtualMachine vm;
+        vm.load(code);
+        while (!vm.execute())
+        {
+        }
+    }
+    catch (const std::exception &)
+    {
+        // errors.es stops with an error on purpose
+    }
+    delete scope;
+    delete scopeArena;
+    if (mode == KEPT_AFTER_ARENA)
+    {
+        image = compiled;
+    }
+}
+
+struct Soak
+{
+    size_t finalLargest;
+    size_t minimumLargest;      // After the warm-up
+    size_t maximumFragments;    // Likewise
+};
+
+static bool Run(Mode mode, Soak &soak)
+{
+    std::vector<std::string> programs = Programs();
+    std::vector<std::string> files(12);
+    std::vector<std::string> history(32);
+    std::mt19937 random(36);
+    soak = Soak{0, HEAP_BYTES, 0};
+
+    std::cout.setstate(std::ios::failbit);
+    try
+    {
+        for (int cycle = 0; cycle < CYCLES; cycle++)
+        {
+            // A command typed, a file written and a program built into
+            // another file
+            history[cycle % history.size()] = "run program" + std::to_string(cycle) + ".enix";
+            files[random() % files.size()] = std::string(64 + random() % 1500, 'f');
+            CompileAndRun(programs[cycle % programs.size()], mode, files[random() % files.size()]);
+
+            HeapState state = State();
+            if (cycle >= WARM_UP)
+            {
+                soak.minimumLargest = state.largestFree < soak.minimumLargest ? state.largestFree : soak.minimumLargest;
+                soak.maximumFragments = state.fragments > soak.maximumFragments ? state.fragments : soak.maximumFragments;
+            }
+            soak.finalLargest = state.largestFree;
+        }
+    }
+    catch (const std::bad_alloc &)
+    {
+        std::cout.clear();
+        return false;
+    }
+    std::cout.clear();
+    return true;
+}
+
+static void Report(const char *what, const Soak &soak)
+{
+    char line[160];
+    snprintf(line, sizeof(line), "%s: largest free block %zu bytes at the end, %zu at least after %d cycles, up to %zu fragments",
+             what, soak.finalLargest, soak.minimumLargest, WARM_UP, soak.maximumFragments);
+    TEST_MESSAGE(line);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_arena_keeps_the_heap_whole()
+{
+    Soak plain, inside, after;
+    bool plainFits = Run(NO_ARENA, plain);
+    bool insideFits = Run(KEPT_IN_ARENA, inside);
+    bool afterFits = Run(KEPT_AFTER_ARENA, after);
+    Report("without an arena", plain);
+    Report("file written in the arena", inside);
+    Report("file written after the arena", after);
+
+    TEST_ASSERT_TRUE_MESSAGE(afterFits, "the heap ran out");
+    // Most of the heap stays in one piece, and no less of it than either
+    // way
+    TEST_ASSERT_TRUE(after.minimumLargest > HEAP_BYTES * 3 / 4);
+    TEST_ASSERT_TRUE(!plainFits || after.minimumLargest >= plain.minimumLargest);
+    TEST_ASSERT_TRUE(!insideFits || after.minimumLargest >= inside.minimumLargest);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_arena_keeps_the_heap_whole);
+    return UNITY_END();
+}
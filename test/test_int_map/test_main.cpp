@@ -0,0 +1,232 @@
+// IntMap: random sets, erases and finds checked against a
+// std::unordered_map, and 10k lookups by map_get timed against the if/else
+// chains maps replace. Timings are taken on the host; run with -v to see
+// them.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/IntMap.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+static const int LOOKUPS = 10000;
+
+// Keys for one round: a few hundred in a narrow range, consecutive ones,
+// or spread over the whole range
+static int32_t Key(std::mt19937 &random, int round)
+{
+    switch (round % 3)
+    {
+    case 0:
+        return static_cast<int32_t>(random() % 512);
+    case 1:
+        return static_cast<int32_t>(1000000 + random() % 2500);
+    default:
+        return static_cast<int32_t>(random());
+    }
+}
+
+static bool RunRound(int round, std::string &verdict)
+{
+    std::mt19937 random(round);
+    IntMap map;
+    std::unordered_map<int32_t, int32_t> model;
+
+    for (int step = 0; step < 20000; step++)
+    {
+        int32_t key = Key(random, round);
+        int op = random() % 10;
+        if (op < 4 && model.size() < 3000)
+        {
+            int32_t value = static_cast<int32_t>(random());
+            if (map.full())
+            {
+                map.rehash(map.grownCapacity());
+            }
+            map.set(key, value);
+            model[key] = value;
+        }
+        else if (op < 6)
+        {
+            if (map.erase(key) != (model.erase(key) == 1))
+            {
+                verdict = "erase disagrees";
+            }
+        }
+        else
+        {
+            const int32_t *found = map.find(key);
+            auto known = model.find(key);
+            if ((found == nullptr) != (known == model.end()) || (found != nullptr && *found != known->second))
+            {
+                verdict = "find disagrees";
+            }
+        }
+        if (map.size() != model.size())
+        {
+            verdict = "sizes differ";
+        }
+        if (!verdict.empty())
+        {
+            verdict = "round " + std::to_string(round) + ", step " + std::to_string(step) + ": " + verdict;
+            return false;
+        }
+    }
+
+    // Walking the table finds every key once
+    size_t walked = 0;
+    int32_t key, value;
+    for (size_t slot = 0; slot < map.capacity(); slot++)
+    {
+        if (map.entry(slot, key, value))
+        {
+            auto known = model.find(key);
+            if (known == model.end() || known->second != value)
+            {
+                verdict = "round " + std::to_string(round) + ": the walk found a stray entry";
+                return false;
+            }
+            walked++;
+        }
+    }
+    if (walked != model.size())
+    {
+        verdict = "round " + std::to_string(round) + ": the walk missed entries";
+        return false;
+    }
+    return true;
+}
+
+// Looks up LOOKUPS ids, going through every key in turn, by map or by
+// if chain
+static std::string Program(int keys, bool useMap)
+{
+    std::string source;
+    if (useMap)
+    {
+        source += "var m = map_new();\n";
+        for (int k = 0; k < keys; k++)
+        {
+            source += "map_set(m, " + std::to_string(1000 + 37 * k) + ", " + std::to_string(3001 + 111 * k) + ");\n";
+        }
+    }
+    source +=
+        "var i = 0;\n"
+        "var acc = 0;\n"
+        "var cal = 0;\n"
+        "while (i < " + std::to_string(LOOKUPS) + ") {\n"
+        "  var id = 1000 + 37 * (i % " + std::to_string(keys) + ");\n";
+    if (useMap)
+    {
+        source += "  cal = map_get(m, id);\n";
+    }
+    else
+    {
+        for (int k = 0; k < keys; k++)
+        {
+            source += std::string(k == 0 ? "  if" : "  else if") + " (id == " + std::to_string(1000 + 37 * k) +
+                ") { cal = " + std::to_string(3001 + 111 * k) + "; }\n";
+        }
+    }
+    return source + "  acc = acc + cal;\n  i = i + 1;\n}\nprint(acc);\n";
+}
+
+// Runs the program, timing only its execution, and gives back what it
+// printed or the error that stopped it
+static std::string Run(const std::string &source, double &millis)
+{
+    std::ostringstream output;
+    std::streambuf *console = std::cout.rdbuf(output.rdbuf());
+    millis = 0;
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        Lexer lexer(source.c_str());
+        Compiler compiler(lexer.tokenize());
+        const auto &bytecode = compiler.compile();
+        std::vector<uint8_t> code(bytecode.begin(), bytecode.end());
+        VirtualMachine vm;
+        vm.load(code);
+        auto start = std::chrono::steady_clock::now();
+        while (!vm.execute())
+        {
+        }
+        millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    catch (const std::exception &e)
+    {
+        output << "error: " << e.what() << "\n";
+    }
+    std::cout.rdbuf(console);
+    return output.str();
+}
+
+// Whether both ways print the same; the times go in chainMillis and
+// mapMillis
+static bool Compare(int keys, double &chainMillis, double &mapMillis)
+{
+    std::string chain = Run(Program(keys, false), chainMillis);
+    std::string map = Run(Program(keys, true), mapMillis);
+
+    char line[128];
+    snprintf(line, sizeof(line), "%d keys, %d lookups: if chain %.2f ms, map_get %.2f ms",
+             keys, LOOKUPS, chainMillis, mapMillis);
+    TEST_MESSAGE(line);
+    return chain == map && chain.find("error") == std::string::npos;
+}
+
+static std::string verdict;
+
+void setUp()
+{
+    verdict.clear();
+}
+
+void tearDown()
+{
+}
+
+static void test_random_operations_match_unordered_map()
+{
+    for (int round = 0; round < 200; round++)
+    {
+        if (!RunRound(round, verdict))
+        {
+            TEST_FAIL_MESSAGE(verdict.c_str());
+        }
+    }
+}
+
+static void test_map_beats_a_long_if_chain()
+{
+    double chainMillis, mapMillis;
+    TEST_ASSERT_TRUE_MESSAGE(Compare(64, chainMillis, mapMillis), "the map and the if chain printed different results");
+    TEST_ASSERT_TRUE(mapMillis * 2 < chainMillis);
+}
+
+// Where the chain is short the two are close; only the results are checked
+static void test_map_matches_a_short_if_chain()
+{
+    double chainMillis, mapMillis;
+    TEST_ASSERT_TRUE_MESSAGE(Compare(8, chainMillis, mapMillis), "the map and the if chain printed different results");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_random_operations_match_unordered_map);
+    RUN_TEST(test_map_beats_a_long_if_chain);
+    RUN_TEST(test_map_matches_a_short_if_chain);
+    return UNITY_END();
+}
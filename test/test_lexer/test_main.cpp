@@ -0,0 +1,109 @@
+// Number literals: hexadecimal ones cover all 32 bits, those from
+// 0x80000000 up reading as the negative values with the same bits, and a
+// hex literal without digits or with more than 8 is an error.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Runs the program and gives back what it printed or the error that
+// stopped it
+static std::string Run(const std::string &source)
+{
+    std::ostringstream output;
+    std::streambuf *console = std::cout.rdbuf(output.rdbuf());
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        Lexer lexer(source.c_str());
+        Compiler compiler(lexer.tokenize());
+        const auto &bytecode = compiler.compile();
+        std::vector<uint8_t> code(bytecode.begin(), bytecode.end());
+        VirtualMachine vm;
+        vm.load(code);
+        while (!vm.execute())
+        {
+        }
+    }
+    catch (const std::exception &e)
+    {
+        output << "error: " << e.what() << "\n";
+    }
+    std::cout.rdbuf(console);
+    return output.str();
+}
+
+static void Check(const char *expected, const std::string &source)
+{
+    std::string output = Run(source);
+    TEST_ASSERT_EQUAL_STRING(expected, output.c_str());
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_hex_literals_cover_32_bits()
+{
+    Check("255\n2147483647\n-2147483648\n-1\n-559038737\n0\n",
+          "print(0xFF);\n"
+          "print(0x7FFFFFFF);\n"
+          "print(0x80000000);\n"
+          "print(0xFFFFFFFF);\n"
+          "print(0xdeadBEEF);\n"
+          "print(0x00000000);\n");
+}
+
+static void test_literals_past_int32_max_wrap()
+{
+    Check("-2147483648\n-1\n-2147483648\n",
+          "print(2147483648);\n"
+          "print(4294967295);\n"
+          "print(-0x80000000);\n");
+}
+
+static void test_negative_case_labels()
+{
+    Check("2\n",
+          "var x = 0x80000000;\n"
+          "switch (x) {\n"
+          "  case -1: print(1);\n"
+          "  case -0x80000000: print(2);\n"
+          "  default: print(3);\n"
+          "}\n");
+}
+
+static void test_hex_literal_without_digits()
+{
+    Check("error: line 2: expected hex digits after 0x\n",
+          "var x = 1;\nprint(0x);\n");
+}
+
+static void test_hex_literal_longer_than_32_bits()
+{
+    Check("error: line 1: hex literal longer than 32 bits\n",
+          "print(0x100000000);\n");
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_hex_literals_cover_32_bits);
+    RUN_TEST(test_literals_past_int32_max_wrap);
+    RUN_TEST(test_negative_case_labels);
+    RUN_TEST(test_hex_literal_without_digits);
+    RUN_TEST(test_hex_literal_longer_than_32_bits);
+    return UNITY_END();
+}
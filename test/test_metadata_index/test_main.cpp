@@ -0,0 +1,130 @@
+// MetadataIndex against the in-memory SD card: commits the card takes only
+// in part must leave the index on the card, and the tree's idea of it, as
+// they were.
+#include <unity.h>
+
+#include <SD.h>
+#include <FileSystem/File.h>
+#include <FileSystem/Folder.h>
+#include <FileSystem/MetadataIndex.h>
+
+#include <string>
+
+using espnix::MetadataIndex;
+
+static const char *const REWRITE_PATH = "/sys/.index.new";
+
+static std::string Card(const char *path)
+{
+    std::string data;
+    SD.contents(path, data);
+    return data;
+}
+
+// A root holding a file and a folder with a file of its own; the tree is
+// built by hand so nothing reaches the file system's own index
+static espnix::Folder *Tree()
+{
+    espnix::Folder *root = new espnix::Folder();
+    espnix::File *file = new espnix::File();
+    file->name = "a.txt";
+    file->size = 10;
+    file->parent = root;
+    root->files.push_back(file);
+
+    espnix::Folder *folder = new espnix::Folder();
+    folder->name = "docs";
+    folder->parent = root;
+    root->folders.push_back(folder);
+    espnix::File *inner = new espnix::File();
+    inner->name = "b.txt";
+    inner->size = 20;
+    inner->parent = folder;
+    folder->files.push_back(inner);
+    return root;
+}
+
+void setUp()
+{
+    SD.reset();
+    SD.mkdir("/sys");
+}
+
+void tearDown()
+{
+}
+
+static void test_short_append_keeps_the_previous_tree()
+{
+    espnix::Folder *root = Tree();
+    espnix::Folder *docs = root->folders[0];
+    MetadataIndex index;
+    index.Commit(root);
+    std::string before = Card(MetadataIndex::PATH);
+    TEST_ASSERT_TRUE(before.size() > 0);
+    TEST_ASSERT_FALSE(root->indexDirty);
+    uint32_t rootBlock = root->indexBlock;
+    uint32_t docsBlock = docs->indexBlock;
+
+    // The card stops partway through the new blocks
+    docs->files[0]->size = 30;
+    index.Changed(docs);
+    SD.writable = 10;
+    index.Commit(root);
+    std::string after = Card(MetadataIndex::PATH);
+    TEST_ASSERT_TRUE(after.compare(0, before.size(), before) == 0);
+    TEST_ASSERT_TRUE(root->indexDirty);
+    TEST_ASSERT_TRUE(docs->indexDirty);
+    TEST_ASSERT_EQUAL(rootBlock, root->indexBlock);
+    TEST_ASSERT_EQUAL(docsBlock, docs->indexBlock);
+
+    // The next commit writes over what was left past the end
+    SD.writable = SIZE_MAX;
+    index.Commit(root);
+    TEST_ASSERT_FALSE(root->indexDirty);
+    TEST_ASSERT_FALSE(docs->indexDirty);
+    TEST_ASSERT_EQUAL(before.size(), docs->indexBlock);
+    TEST_ASSERT_TRUE(Card(MetadataIndex::PATH).size() > before.size());
+
+    // And a fresh mount finds the new tree
+    espnix::Folder mounted;
+    MetadataIndex reopened;
+    TEST_ASSERT_TRUE(reopened.Mount(&mounted));
+    TEST_ASSERT_EQUAL(root->indexBlock, mounted.indexBlock);
+    delete root;
+}
+
+static void test_short_rewrite_is_not_swapped_in()
+{
+    espnix::Folder *root = Tree();
+    MetadataIndex index;
+    index.Commit(root);
+    std::string before = Card(MetadataIndex::PATH);
+
+    // An index that has not been mounted writes the whole tree anew
+    espnix::Folder *other = Tree();
+    other->files[0]->size = 99;
+    MetadataIndex fresh;
+    SD.writable = 30;
+    fresh.Commit(other);
+    TEST_ASSERT_TRUE(Card(MetadataIndex::PATH) == before);
+    TEST_ASSERT_FALSE(SD.exists(REWRITE_PATH));
+    TEST_ASSERT_TRUE(other->indexDirty);
+    TEST_ASSERT_EQUAL(0, other->indexBlock);
+
+    SD.writable = SIZE_MAX;
+    fresh.Commit(other);
+    TEST_ASSERT_FALSE(Card(MetadataIndex::PATH) == before);
+    TEST_ASSERT_FALSE(SD.exists(REWRITE_PATH));
+    TEST_ASSERT_FALSE(other->indexDirty);
+    delete root;
+    delete other;
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_short_append_keeps_the_previous_tree);
+    RUN_TEST(test_short_rewrite_is_not_swapped_in);
+    return UNITY_END();
+}
@@ -0,0 +1,152 @@
+// NameIndex: random inserts, removals and lookups checked against a
+// std::map, and lookups in a 10k-entry folder timed against the linear
+// scan they replaced; run with -v to see the timings.
+#include <unity.h>
+
+#include <FileSystem/File.h>
+#include <FileSystem/Folder.h>
+#include <FileSystem/NameIndex.h>
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using espnix::EntityType;
+using espnix::FileSystemEntity;
+using espnix::NameIndex;
+
+typedef std::map<std::pair<std::string, EntityType>, FileSystemEntity *> Model;
+
+// A file or folder standing alone, not in any folder's lists
+static FileSystemEntity *Entity(const std::string &name, EntityType type)
+{
+    FileSystemEntity *entity = type == EntityType::FILE
+        ? static_cast<FileSystemEntity *>(new espnix::File())
+        : static_cast<FileSystemEntity *>(new espnix::Folder());
+    entity->name = name;
+    return entity;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_random_operations_match_a_map()
+{
+    std::mt19937 random(41);
+    NameIndex index;
+    Model model;
+    std::vector<std::unique_ptr<FileSystemEntity>> owned;
+    char where[64];
+
+    for (int step = 0; step < 200000; step++)
+    {
+        snprintf(where, sizeof(where), "step %d", step);
+        // Few enough names that inserts, removals and misses all come up
+        std::string name = "n" + std::to_string(random() % 3000);
+        EntityType type = random() % 2 ? EntityType::FILE : EntityType::FOLDER;
+        auto key = std::make_pair(name, type);
+        auto known = model.find(key);
+        int op = random() % 10;
+
+        if (op < 4 && known == model.end())
+        {
+            FileSystemEntity *entity = Entity(name, type);
+            owned.emplace_back(entity);
+            index.Insert(entity);
+            model[key] = entity;
+        }
+        else if (op < 7 && known != model.end())
+        {
+            index.Remove(known->second);
+            model.erase(known);
+        }
+        else if (op < 9)
+        {
+            FileSystemEntity *expected = known == model.end() ? nullptr : known->second;
+            TEST_ASSERT_TRUE_MESSAGE(index.Find(name, type) == expected, where);
+        }
+        else
+        {
+            // The same name as part of a path
+            std::string path = "/a/" + name + "/b";
+            FileSystemEntity *expected = known == model.end() ? nullptr : known->second;
+            TEST_ASSERT_TRUE_MESSAGE(index.Find(path.c_str() + 3, name.size(), type) == expected, where);
+        }
+    }
+
+    for (const auto &entry : model)
+    {
+        TEST_ASSERT_TRUE(index.Find(entry.first.first, entry.first.second) == entry.second);
+    }
+}
+
+static void test_lookups_in_a_large_folder()
+{
+    const int ENTRIES = 10000;
+    const int LOOKUPS = 10000;
+    NameIndex index;
+    std::vector<std::unique_ptr<FileSystemEntity>> files;
+    for (int i = 0; i < ENTRIES; i++)
+    {
+        files.emplace_back(Entity("file" + std::to_string(i) + ".txt", EntityType::FILE));
+        index.Insert(files.back().get());
+    }
+
+    std::mt19937 random(10000);
+    std::vector<std::string> names;
+    for (int i = 0; i < LOOKUPS; i++)
+    {
+        names.push_back("file" + std::to_string(random() % ENTRIES) + ".txt");
+    }
+
+    // The scan Folder::FindFile did before the index
+    auto start = std::chrono::steady_clock::now();
+    size_t scanned = 0;
+    for (const std::string &name : names)
+    {
+        for (const auto &file : files)
+        {
+            if (file->name == name)
+            {
+                scanned++;
+                break;
+            }
+        }
+    }
+    auto middle = std::chrono::steady_clock::now();
+    size_t indexed = 0;
+    for (const std::string &name : names)
+    {
+        indexed += index.Find(name, EntityType::FILE) != nullptr;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    double scanMicros = std::chrono::duration<double, std::micro>(middle - start).count() / LOOKUPS;
+    double indexMicros = std::chrono::duration<double, std::micro>(end - middle).count() / LOOKUPS;
+    char line[128];
+    snprintf(line, sizeof(line), "%d entries: linear scan %.3f us, index %.3f us per lookup",
+             ENTRIES, scanMicros, indexMicros);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL(LOOKUPS, scanned);
+    TEST_ASSERT_EQUAL(LOOKUPS, indexed);
+    TEST_ASSERT_TRUE(indexMicros * 10 < scanMicros);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_random_operations_match_a_map);
+    RUN_TEST(test_lookups_in_a_large_folder);
+    return UNITY_END();
+}
@@ -0,0 +1,317 @@
+// Random programs compiled with the optimizer off and on must print the
+// same and stop with the same error. The generator leans on what the
+// optimizer rewrites: constant operands, powers of two, nested counting
+// loops with invariant bounds, array stores and switches.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const int PROGRAMS = 500;
+
+class Generator
+{
+    std::mt19937 random;
+    std::vector<std::string> loopVariables;
+    int loops;
+
+    static const std::vector<std::string> &Variables()
+    {
+        static const std::vector<std::string> variables = {"x", "y", "z", "w"};
+        return variables;
+    }
+
+    double Chance()
+    {
+        return std::uniform_real_distribution<double>(0, 1)(this->random);
+    }
+
+    int Range(int low, int high)
+    {
+        return std::uniform_int_distribution<int>(low, high)(this->random);
+    }
+
+    template <typename T>
+    T Pick(const std::vector<T> &choices)
+    {
+        return choices[this->Range(0, static_cast<int>(choices.size()) - 1)];
+    }
+
+    std::string Variable()
+    {
+        return this->Pick(Variables());
+    }
+
+    std::string Atom(int depth)
+    {
+        static const std::vector<std::string> constants = {
+            "0", "1", "2", "3", "4", "7", "8", "16", "-1", "-2", "-4", "-8",
+            "31", "32", "64", "1024", "-2147483648", "2147483647", "5", "100"};
+        double c = this->Chance();
+        if (c < 0.35)
+        {
+            return this->Chance() < 0.8 ? this->Pick(constants)
+                                        : "(-" + this->Pick<std::string>({"1", "2", "4", "8", "3"}) + ")";
+        }
+        if (c < 0.75)
+        {
+            std::vector<std::string> names = Variables();
+            names.insert(names.end(), this->loopVariables.begin(), this->loopVariables.end());
+            return this->Pick(names);
+        }
+        if (c < 0.85)
+        {
+            return "a[" + (this->Chance() < 0.5 ? std::to_string(this->Range(0, 7))
+                                                : "(" + this->Expression(depth - 1) + ") & 7") + "]";
+        }
+        if (c < 0.9)
+        {
+            return "len(a)";
+        }
+        return "(" + this->Expression(depth - 1) + ")";
+    }
+
+    std::string Expression(int depth = 3)
+    {
+        if (depth <= 0)
+        {
+            return this->Atom(0);
+        }
+        if (this->Chance() < 0.3)
+        {
+            return this->Atom(depth);
+        }
+
+        std::string op = this->Pick<std::string>({"+", "-", "*", "/", "%", "&", "|", "^", "<<", ">>", "*", "/", "%", "+"});
+        std::string rhs;
+        if (op == "/" || op == "%")
+        {
+            // No -1: INT_MIN / -1 traps on the host, whatever either
+            // build makes of it
+            rhs = this->Pick<std::string>({"2", "4", "8", "16", "1024", "3", "-4", "1", "7", "2147483647"});
+        }
+        else
+        {
+            rhs = this->Chance() < 0.5 ? this->Atom(depth - 1)
+                                       : this->Pick<std::string>({"2", "4", "8", "16", "1024", "3", "-4", "1", "32", "64"});
+        }
+        std::string lhs = this->Chance() < 0.5 ? this->Atom(depth - 1) : "(" + this->Expression(depth - 1) + ")";
+        std::string expression = lhs + " " + op + " " + rhs;
+        if (this->Chance() < 0.2)
+        {
+            expression = "-(" + expression + ")";
+        }
+        if (this->Chance() < 0.1)
+        {
+            expression = "~(" + expression + ")";
+        }
+        return expression;
+    }
+
+    std::string Statement(int depth, int indent)
+    {
+        std::string pad(2 * indent, ' ');
+        double c = this->Chance();
+
+        if (depth > 0 && c < 0.15 && this->loopVariables.size() < 3)
+        {
+            std::string counter = "c" + std::to_string(this->loops++);
+            std::string out = pad + "var " + counter + " = 0;\n" +
+                pad + "while (" + counter + " < " + this->Pick<std::string>({"10", "n + 3", "n * 2"}) + ") {\n";
+            this->loopVariables.push_back(counter);
+            for (int i = this->Range(1, 4); i > 0; i--)
+            {
+                out += this->Statement(depth - 1, indent + 1);
+            }
+            this->loopVariables.pop_back();
+            return out + pad + "  " + counter + " = " + counter + " + " + std::to_string(this->Range(1, 3)) + ";\n" +
+                pad + "}\n";
+        }
+        if (depth > 0 && c < 0.25)
+        {
+            std::string out = pad + "if (" + this->Expression(2) + " " +
+                this->Pick<std::string>({"<", ">", "==", "!=", "<="}) + " " + this->Expression(2) + ") {\n";
+            for (int i = this->Range(1, 3); i > 0; i--)
+            {
+                out += this->Statement(depth - 1, indent + 1);
+            }
+            out += pad + "} else {\n";
+            for (int i = this->Range(0, 2); i > 0; i--)
+            {
+                out += this->Statement(depth - 1, indent + 1);
+            }
+            return out + pad + "}\n";
+        }
+        if (depth > 0 && c < 0.3)
+        {
+            std::string out = pad + "switch ((" + this->Expression(2) + ") & 7) {\n";
+            std::vector<int> values;
+            for (int v = -2; v <= 8; v++)
+            {
+                values.push_back(v);
+            }
+            std::shuffle(values.begin(), values.end(), this->random);
+            for (int i = this->Range(1, 5); i > 0; i--)
+            {
+                out += pad + "  case " + std::to_string(values[i]) + ":\n";
+                for (int j = this->Range(0, 2); j > 0; j--)
+                {
+                    out += this->Statement(depth - 1, indent + 2);
+                }
+            }
+            if (this->Chance() < 0.5)
+            {
+                out += pad + "  default:\n" + this->Statement(depth - 1, indent + 2);
+            }
+            return out + pad + "}\n";
+        }
+        if (c < 0.4)
+        {
+            // The same subexpression more than once, for the optimizer to
+            // share
+            std::string e = this->Expression(2);
+            if (this->Chance() < 0.5)
+            {
+                return pad + this->Variable() + " = (" + e + ") + (" + e + ") - (" + e + ");\n";
+            }
+            return pad + this->Variable() + " = " + e + ";\n" + pad + this->Variable() + " = (" + e + ") * 3;\n";
+        }
+        if (c < 0.5)
+        {
+            return pad + "a[(" + this->Expression(2) + ") & 7] = " + this->Expression() + ";\n";
+        }
+        if (c < 0.6)
+        {
+            return pad + "print(" + this->Expression() + ");\n";
+        }
+        if (c < 0.65)
+        {
+            return pad + this->Variable() + " = " + this->Variable() + " + " + this->Pick<std::string>({"1", "-3", "5"}) + ";\n";
+        }
+        return pad + this->Variable() + " = " + this->Expression() + ";\n";
+    }
+
+public:
+    explicit Generator(uint32_t seed) : random(seed), loops(0)
+    {
+    }
+
+    std::string Program()
+    {
+        std::string source = "var n = " + std::to_string(this->Range(0, 6)) + ";\nvar a[8];\n";
+        for (const std::string &name : Variables())
+        {
+            source += "var " + name + " = " + std::to_string(this->Range(-50, 50)) + ";\n";
+        }
+        for (int i = this->Range(3, 10); i > 0; i--)
+        {
+            source += this->Statement(3, 0);
+        }
+        for (const std::string &name : Variables())
+        {
+            source += "print(" + name + ");\n";
+        }
+        return source + "print(sum(a));\n";
+    }
+};
+
+// Everything the program printed, followed by the error that stopped it
+static std::string Run(const std::string &source, bool optimize)
+{
+    std::ostringstream output;
+    std::streambuf *console = std::cout.rdbuf(output.rdbuf());
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        Lexer lexer(source.c_str());
+        Compiler compiler(lexer.tokenize());
+        compiler.setOptimize(optimize);
+        const auto &bytecode = compiler.compile();
+        std::vector<uint8_t> code(bytecode.begin(), bytecode.end());
+        VirtualMachine vm;
+        vm.load(code);
+        while (!vm.execute())
+        {
+        }
+    }
+    catch (const std::exception &e)
+    {
+        output << "error: " << e.what() << "\n";
+    }
+    std::cout.rdbuf(console);
+    return output.str();
+}
+
+// Unity leaves a failing test with longjmp, skipping the destructors of
+// any string still alive, so the runs are compared here and only the
+// verdict is asserted
+static std::string verdict;
+
+static bool Compare(uint32_t seed)
+{
+    std::string source = Generator(seed).Program();
+    std::string plain = Run(source, false);
+    std::string optimized = Run(source, true);
+    if (plain == optimized)
+    {
+        return true;
+    }
+    verdict = "seed " + std::to_string(seed) + ":\n" + source + "-O0:\n" + plain + "optimized:\n" + optimized;
+    return false;
+}
+
+void setUp()
+{
+    verdict.clear();
+}
+
+void tearDown()
+{
+}
+
+static void test_optimized_matches_unoptimized()
+{
+    for (uint32_t seed = 1; seed <= PROGRAMS; seed++)
+    {
+        if (!Compare(seed))
+        {
+            TEST_FAIL_MESSAGE(verdict.c_str());
+        }
+    }
+}
+
+// A program that stops with an error stops with the same one
+static void test_errors_match()
+{
+    const char *source =
+        "var x = 5;\n"
+        "var a[4];\n"
+        "var i = 0;\n"
+        "while (i < 10) {\n"
+        "  a[i] = x * 8;\n"
+        "  i = i + 1;\n"
+        "}\n";
+    std::string plain = Run(source, false);
+    std::string optimized = Run(source, true);
+    TEST_ASSERT_TRUE(plain.find("error: ") != std::string::npos);
+    TEST_ASSERT_TRUE(plain == optimized);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_optimized_matches_unoptimized);
+    RUN_TEST(test_errors_match);
+    return UNITY_END();
+}
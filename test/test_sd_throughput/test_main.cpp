@@ -0,0 +1,113 @@
+// Throughput of reading a 1 MB file from the SD card: File::Read, the
+// 512-byte pread loop cat runs, and a byte per library call as the file
+// system once read. Times come from the card model in the SD stand-in, so
+// the figures are the same on every host; run with -v to see them.
+#include <unity.h>
+
+#include <SD.h>
+#include <FileSystem/File.h>
+#include <IO/FileDescriptor.h>
+#include <IO/PageCache.h>
+
+#include <cstdio>
+#include <string>
+
+static const char *const PATH = "/big.bin";
+static const size_t FILE_BYTES = 1024 * 1024;
+
+static std::string content;
+
+// Reports a run and hands back its cost in card calls
+static uint32_t Report(const char *what, size_t bytes)
+{
+    const fs::SDFS::Stats &stats = SD.stats;
+    char line[160];
+    snprintf(line, sizeof(line), "%s: %zu bytes, %u calls, %u sectors, %.1f ms, %.2f MB/s",
+             what, bytes, stats.calls, stats.sectors, stats.micros / 1000.0,
+             stats.micros == 0 ? 0.0 : bytes / (stats.micros / 1e6) / 1048576);
+    TEST_MESSAGE(line);
+    return stats.calls;
+}
+
+void setUp()
+{
+    SD.reset();
+    if (content.empty())
+    {
+        for (size_t i = 0; content.size() < FILE_BYTES; i++)
+        {
+            content += "line " + std::to_string(i) + "\n";
+        }
+        content.resize(FILE_BYTES);
+    }
+    fs::File out = SD.open(PATH, FILE_WRITE);
+    out.write(reinterpret_cast<const uint8_t *>(content.data()), content.size());
+    out.close();
+    SD.resetStats();
+}
+
+void tearDown()
+{
+}
+
+static void test_byte_per_call_baseline()
+{
+    std::string got;
+    fs::File in = SD.open(PATH, FILE_READ);
+    while (in.available())
+    {
+        got += static_cast<char>(in.read());
+    }
+    in.close();
+
+    Report("byte per call", got.size());
+    TEST_ASSERT_TRUE(got == content);
+    TEST_ASSERT_TRUE(SD.stats.calls > FILE_BYTES);
+}
+
+static void test_file_read()
+{
+    espnix::File file;
+    file.name = "big.bin";
+    std::string got = file.Read();
+    file.Close();
+
+    uint32_t calls = Report("File::Read", got.size());
+    TEST_ASSERT_TRUE(got == content);
+    // A seek and a read per cache page, and a few to open and size the
+    // file; no sector is moved twice
+    TEST_ASSERT_LESS_THAN(2 * FILE_BYTES / PageCache::PAGE_SIZE + 16, calls);
+    TEST_ASSERT_LESS_THAN(FILE_BYTES / fs::SDFS::SECTOR_SIZE + 16, SD.stats.sectors);
+}
+
+static void test_cat_loop()
+{
+    espnix::File file;
+    file.name = "big.bin";
+    FileDescriptor *fd = file.Open(O_RDONLY);
+    std::string got;
+    char chunk[512];
+    off_t offset = 0;
+    ssize_t bytesRead;
+    while ((bytesRead = fd->pread(chunk, sizeof(chunk), offset)) > 0)
+    {
+        got.append(chunk, bytesRead);
+        offset += bytesRead;
+    }
+    file.Close();
+
+    uint32_t calls = Report("cat", got.size());
+    TEST_ASSERT_EQUAL(0, bytesRead);
+    TEST_ASSERT_TRUE(got == content);
+    TEST_ASSERT_LESS_THAN(2 * FILE_BYTES / PageCache::PAGE_SIZE + 16, calls);
+    TEST_ASSERT_LESS_THAN(FILE_BYTES / fs::SDFS::SECTOR_SIZE + 16, SD.stats.sectors);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_byte_per_call_baseline);
+    RUN_TEST(test_file_read);
+    RUN_TEST(test_cat_loop);
+    return UNITY_END();
+}
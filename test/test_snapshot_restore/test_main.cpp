@@ -0,0 +1,166 @@
+// Time to steady state for a program that builds a table before its main
+// work: started cold, against resumed from the snapshot it takes once the
+// table is built. The resumed run must finish as the cold one does, and
+// get there far sooner. Timings are taken on the host and leave out the
+// SD card; run with -v to see them.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/Snapshot.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+// 2000 primes by trial division, then the steady state, which only reads
+// the table
+static const char *const SOURCE =
+    "var p[2000];\n"
+    "var n = 0;\n"
+    "var c = 2;\n"
+    "while (n < 2000) {\n"
+    "  var k = 0;\n"
+    "  var prime = 1;\n"
+    "  while (k < n && p[k] * p[k] <= c) {\n"
+    "    if (c % p[k] == 0) {\n"
+    "      prime = 0;\n"
+    "    }\n"
+    "    k = k + 1;\n"
+    "  }\n"
+    "  if (prime == 1) {\n"
+    "    p[n] = c;\n"
+    "    n = n + 1;\n"
+    "  }\n"
+    "  c = c + 1;\n"
+    "}\n"
+    "var resumed = snapshot();\n"
+    "print(p[1999]);\n"
+    "print(sum(p));\n"
+    "print(find(p, 7919));\n";
+
+// Keeps the first image and when it was taken
+class FirstSnapshot : public SnapshotSink
+{
+public:
+    std::vector<uint8_t> image;
+    Clock::time_point at;
+
+    void write(const VirtualMachine &vm) override
+    {
+        if (this->image.empty())
+        {
+            this->image = vm.snapshot();
+            this->at = Clock::now();
+        }
+    }
+};
+
+static int64_t SumOfPrimes()
+{
+    std::vector<int> primes;
+    for (int c = 2; primes.size() < 2000; c++)
+    {
+        bool prime = true;
+        for (size_t k = 0; k < primes.size() && primes[k] * primes[k] <= c; k++)
+        {
+            prime = prime && c % primes[k] != 0;
+        }
+        if (prime)
+        {
+            primes.push_back(c);
+        }
+    }
+    int64_t sum = 0;
+    for (int p : primes)
+    {
+        sum += p;
+    }
+    return sum;
+}
+
+static std::vector<uint8_t> Compile()
+{
+    Arena arena;
+    Arena::Scope arenaScope(arena);
+    Lexer lexer(SOURCE);
+    Compiler compiler(lexer.tokenize());
+    const auto &bytecode = compiler.compile();
+    return std::vector<uint8_t>(bytecode.begin(), bytecode.end());
+}
+
+static void Finish(VirtualMachine &vm)
+{
+    while (!vm.execute())
+    {
+    }
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_restore_reaches_steady_state_sooner()
+{
+    std::vector<uint8_t> code = Compile();
+    std::ostringstream cold, resumed;
+    std::streambuf *console = std::cout.rdbuf(cold.rdbuf());
+    FirstSnapshot sink;
+    double coldMillis, restoreMillis = 1e9;
+    bool restored = true;
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        VirtualMachine vm;
+        Clock::time_point start = Clock::now();
+        vm.load(code);
+        vm.setSnapshotSink(&sink);
+        Finish(vm);
+        coldMillis = std::chrono::duration<double, std::milli>(sink.at - start).count();
+    }
+
+    // The best of a few, as a single restore is over too soon to time
+    std::cout.rdbuf(resumed.rdbuf());
+    for (int run = 0; run < 20 && !sink.image.empty(); run++)
+    {
+        resumed.str("");
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        VirtualMachine vm;
+        Clock::time_point start = Clock::now();
+        vm.load(code);
+        restored = restored && vm.restore(sink.image);
+        double millis = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        restoreMillis = millis < restoreMillis ? millis : restoreMillis;
+        Finish(vm);
+    }
+    std::cout.rdbuf(console);
+
+    char line[128];
+    snprintf(line, sizeof(line), "cold start %.2f ms, restore %.3f ms from a %zu-byte image",
+             coldMillis, restoreMillis, sink.image.size());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_FALSE(sink.image.empty());
+    TEST_ASSERT_TRUE(restored);
+    TEST_ASSERT_TRUE(cold.str() == "17389\n" + std::to_string(SumOfPrimes()) + "\n999\n");
+    TEST_ASSERT_TRUE(resumed.str() == cold.str());
+    TEST_ASSERT_TRUE(restoreMillis * 10 < coldMillis);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_restore_reaches_steady_state_sooner);
+    return UNITY_END();
+}
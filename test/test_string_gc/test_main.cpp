@@ -0,0 +1,118 @@
+// The string collector under load: strings kept in 300 globals, on a
+// coroutine's stack and on the main program's stack across resumes must
+// survive cycle after cycle while thousands of others become garbage. A
+// string reclaimed too early would have its handle reused, and compare
+// unequal to what it was.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const int GLOBALS = 300;
+
+// Counts in bad every string kept that no longer reads back as it was
+static std::string Program()
+{
+    std::string source;
+    for (int k = 0; k < GLOBALS; k++)
+    {
+        source += "var g" + std::to_string(k) + " = \"g\" + " + std::to_string(k) + ";\n";
+    }
+    source +=
+        "coroutine words {\n"
+        "  var n = 0;\n"
+        "  while (n < 100000) {\n"
+        "    var j = 0;\n"
+        "    while (j < 100) {\n"
+        "      var junk = \"j\" + (n * 100 + j);\n"
+        "      j = j + 1;\n"
+        "    }\n"
+        "    yield (\"c\" + n) + resume(inner);\n"
+        "    n = n + 1;\n"
+        "  }\n"
+        "}\n"
+        "coroutine inner {\n"
+        "  var m = 0;\n"
+        "  while (m < 100000) {\n"
+        "    var k = 0;\n"
+        "    while (k < 100) {\n"
+        "      var junk2 = \"k\" + (m * 100 + k);\n"
+        "      k = k + 1;\n"
+        "    }\n"
+        "    yield \"w\" + m;\n"
+        "    m = m + 1;\n"
+        "  }\n"
+        "}\n"
+        "var bad = 0;\n"
+        "var i = 0;\n"
+        "while (i < 2000) {\n"
+        "  var t = \"t\" + i;\n"
+        "  var w = (\"p\" + i) + resume(words);\n"
+        "  if (w != \"p\" + i + \"c\" + i + \"w\" + i) {\n"
+        "    bad = bad + 1;\n"
+        "  }\n"
+        "  i = i + 1;\n"
+        "}\n";
+    for (int k = 0; k < GLOBALS; k++)
+    {
+        std::string n = std::to_string(k);
+        source += "if (g" + n + " != \"g\" + " + n + ") {\n  bad = bad + 1;\n}\n";
+    }
+    return source + "print(bad);\n";
+}
+
+// Runs the program and gives back what it printed or the error that
+// stopped it
+static std::string Run(const std::string &source)
+{
+    std::ostringstream output;
+    std::streambuf *console = std::cout.rdbuf(output.rdbuf());
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        Lexer lexer(source.c_str());
+        Compiler compiler(lexer.tokenize());
+        const auto &bytecode = compiler.compile();
+        std::vector<uint8_t> code(bytecode.begin(), bytecode.end());
+        VirtualMachine vm;
+        vm.load(code);
+        while (!vm.execute())
+        {
+        }
+    }
+    catch (const std::exception &e)
+    {
+        output << "error: " << e.what() << "\n";
+    }
+    std::cout.rdbuf(console);
+    return output.str();
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_kept_strings_survive_collection()
+{
+    std::string output = Run(Program());
+    TEST_ASSERT_EQUAL_STRING("0\n", output.c_str());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_kept_strings_survive_collection);
+    return UNITY_END();
+}
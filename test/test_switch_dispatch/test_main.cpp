@@ -0,0 +1,129 @@
+// A 64-case switch against the if/else chain it replaces, with dense case
+// values (a jump table) and sparse ones (a sorted lookup). Both programs
+// must print the same and the switch must be clearly faster. Timings are
+// taken on the host; run with -v to see them.
+#include <unity.h>
+
+#include <Runtime/Arena.h>
+#include <Runtime/Compiler.h>
+#include <Runtime/Lexer.h>
+#include <Runtime/VirtualMachine.h>
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static const int CASES = 64;
+static const int ITERATIONS = 100000;
+
+// The case value for index k, spread out by stride
+static int Key(int k, int stride)
+{
+    return 1000 + k * stride;
+}
+
+// Looks up ITERATIONS keys, going through every case in turn, by switch or
+// by if chain
+static std::string Program(int stride, bool useSwitch)
+{
+    std::string source =
+        "var i = 0;\n"
+        "var acc = 0;\n"
+        "var v = 0;\n"
+        "while (i < " + std::to_string(ITERATIONS) + ") {\n"
+        "  var id = 1000 + " + std::to_string(stride) + " * (i % " + std::to_string(CASES) + ");\n";
+    if (useSwitch)
+    {
+        source += "  switch (id) {\n";
+        for (int k = 0; k < CASES; k++)
+        {
+            source += "    case " + std::to_string(Key(k, stride)) + ": v = " + std::to_string(3000 + 11 * k) + ";\n";
+        }
+        source += "    default: v = -1;\n  }\n";
+    }
+    else
+    {
+        for (int k = 0; k < CASES; k++)
+        {
+            source += std::string(k == 0 ? "  if" : "  else if") + " (id == " + std::to_string(Key(k, stride)) +
+                ") { v = " + std::to_string(3000 + 11 * k) + "; }\n";
+        }
+        source += "  else { v = -1; }\n";
+    }
+    return source + "  acc = acc + v;\n  i = i + 1;\n}\nprint(acc);\n";
+}
+
+// Runs the program, timing only its execution, and gives back what it
+// printed or the error that stopped it
+static std::string Run(const std::string &source, double &millis)
+{
+    std::ostringstream output;
+    std::streambuf *console = std::cout.rdbuf(output.rdbuf());
+    millis = 0;
+    try
+    {
+        Arena arena;
+        Arena::Scope arenaScope(arena);
+        Lexer lexer(source.c_str());
+        Compiler compiler(lexer.tokenize());
+        const auto &bytecode = compiler.compile();
+        std::vector<uint8_t> code(bytecode.begin(), bytecode.end());
+        VirtualMachine vm;
+        vm.load(code);
+        auto start = std::chrono::steady_clock::now();
+        while (!vm.execute())
+        {
+        }
+        millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    catch (const std::exception &e)
+    {
+        output << "error: " << e.what() << "\n";
+    }
+    std::cout.rdbuf(console);
+    return output.str();
+}
+
+static void Compare(const char *what, int stride)
+{
+    double chainMillis, switchMillis;
+    std::string chain = Run(Program(stride, false), chainMillis);
+    std::string dispatch = Run(Program(stride, true), switchMillis);
+    bool same = chain == dispatch && chain.find("error") == std::string::npos;
+
+    char line[128];
+    snprintf(line, sizeof(line), "%s, %d cases, %d lookups: if chain %.1f ms, switch %.1f ms",
+             what, CASES, ITERATIONS, chainMillis, switchMillis);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE_MESSAGE(same, "the switch and the if chain printed different results");
+    TEST_ASSERT_TRUE(switchMillis * 2 < chainMillis);
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+static void test_dense_switch()
+{
+    Compare("dense", 1);
+}
+
+static void test_sparse_switch()
+{
+    Compare("sparse", 37);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_dense_switch);
+    RUN_TEST(test_sparse_switch);
+    return UNITY_END();
+}